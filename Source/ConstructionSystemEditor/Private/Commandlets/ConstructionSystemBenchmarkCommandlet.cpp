@@ -0,0 +1,612 @@
+//$ Copyright 2015-23, Code Respawn Technologies Pvt Ltd - All Rights Reserved $//
+
+#include "Commandlets/ConstructionSystemBenchmarkCommandlet.h"
+
+#include "Asset/PrefabricatorAsset.h"
+#include "ConstructionSystem/ConstructionSystemCursor.h"
+#include "ConstructionSystem/ConstructionSystemGeometry.h"
+#include "ConstructionSystem/ConstructionSystemSnap.h"
+#include "ConstructionSystem/Net/ConstructionSystemNetSubsystem.h"
+#include "Prefab/PrefabActor.h"
+#include "Prefab/PrefabTools.h"
+#include "Utils/ConstructionSystemUtils.h"
+#include "Utils/PrefabricatorService.h"
+
+#include "CollisionQueryParams.h"
+#include "Engine/Engine.h"
+#include "Engine/OverlapResult.h"
+#include "Engine/World.h"
+#include "HAL/PlatformMemory.h"
+#include "Misc/FileHelper.h"
+#include "Misc/PackageName.h"
+#include "Misc/Paths.h"
+#include "UObject/SoftObjectPath.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogConstructionBenchmark, Log, All);
+
+namespace {
+	const TCHAR* GetPhaseName(EConstructionBenchmarkPhase InPhase) {
+		switch (InPhase) {
+		case EConstructionBenchmarkPhase::CursorTrace: return TEXT("CursorTrace");
+		case EConstructionBenchmarkPhase::SnapSearch: return TEXT("SnapSearch");
+		case EConstructionBenchmarkPhase::PhysicsOverlap: return TEXT("PhysicsOverlap");
+		case EConstructionBenchmarkPhase::GeometryValidation: return TEXT("GeometryValidation");
+		case EConstructionBenchmarkPhase::RemoveTrace: return TEXT("RemoveTrace");
+		case EConstructionBenchmarkPhase::Remove: return TEXT("Remove");
+		default: return TEXT("Unknown");
+		}
+	}
+
+	double GetElapsedMs(double InStartTime) {
+		return (FPlatformTime::Seconds() - InStartTime) * 1000.0;
+	}
+
+	FString FormatMs(double InMs) {
+		return InMs < 0 ? FString() : FString::Printf(TEXT("%.4f"), InMs);
+	}
+
+	double GetUsedMemoryMB() {
+		return FPlatformMemory::GetStats().UsedPhysical / (1024.0 * 1024.0);
+	}
+
+	/** Accepts a full object path, or a package name */
+	UPrefabricatorAssetInterface* LoadPrefab(const FString& InPath) {
+		FString ObjectPath = InPath;
+		if (!ObjectPath.Contains(TEXT("."))) {
+			ObjectPath += TEXT(".") + FPackageName::GetShortName(ObjectPath);
+		}
+		return Cast<UPrefabricatorAssetInterface>(FSoftObjectPath(ObjectPath).TryLoad());
+	}
+
+	/** A file path, or the name of a file in the given directory */
+	FString ResolveInputPath(const FString& InValue, const FString& InDirectory, const TCHAR* InExtension) {
+		return FPaths::FileExists(InValue) ? InValue : InDirectory / (InValue + InExtension);
+	}
+
+	/**
+	 * The world aligned box of the first snap box of a prefab, relative to the prefab actor. A probe piece is built
+	 * (and removed right away) if the net subsystem did not learn the snap boxes of the prefab yet
+	 */
+	bool GetLocalSnapBounds(UConstructionSystemNetSubsystem* InNetSubsystem, UPrefabricatorAssetInterface* InPrefab, FBox& OutBounds) {
+		FConstructionSystemSnapBoxList Boxes;
+		if (!InNetSubsystem->GetPlacementBoxes(InPrefab, 0, FTransform::Identity, Boxes)) {
+			const FConstructionSystemPlacement ProbePlacement(FTransform(FVector(0, 0, -100000.0f)), 0);
+			const uint32 ProbeId = UConstructionSystemNetSubsystem::GetItemId(InNetSubsystem->ConstructItem(InPrefab, ProbePlacement, 0));
+			InNetSubsystem->GetPlacementBoxes(InPrefab, 0, FTransform::Identity, Boxes);
+			InNetSubsystem->RemoveItem(ProbeId);
+		}
+		if (Boxes.Num() == 0) {
+			return false;
+		}
+		OutBounds = Boxes[0].GetBounds();
+		return true;
+	}
+
+	/** Builds with the runtime service, so the timings are not skewed by the actor factories of the editor service */
+	struct FScopedRuntimePrefabService {
+		FScopedRuntimePrefabService()
+			: PreviousService(FPrefabricatorService::Get())
+		{
+			FPrefabricatorService::Set(MakeShareable(new FPrefabricatorRuntimeService));
+		}
+		~FScopedRuntimePrefabService() {
+			FPrefabricatorService::Set(PreviousService);
+		}
+	private:
+		TSharedPtr<IPrefabricatorService> PreviousService;
+	};
+}
+
+FConstructionBenchmarkSample::FConstructionBenchmarkSample()
+{
+	for (double& Ms : PhaseMs) {
+		Ms = -1;
+	}
+}
+
+UConstructionSystemBenchmarkCommandlet::UConstructionSystemBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+
+	HelpDescription = TEXT("Generates a construction base in a headless world and benchmarks the build and remove tool updates along a cursor path");
+	HelpUsage = TEXT("-run=ConstructionSystemBenchmark [-Floor=<Prefab>] [-Wall=<Prefab>] [-Cursor=<Prefab>] [-Pieces=2000] [-Stories=4] [-Updates=2000] [-Seed=0] [-RemoveEvery=0] [-CursorPath=<Name|File.csv>] [-PlacementTrace=<Name|File.cstrace>] [-Output=<File.csv>]");
+	HelpParamNames.Add(TEXT("Floor"));
+	HelpParamDescriptions.Add(TEXT("Floor prefab of the generated base. At least one of Floor and Wall is required"));
+	HelpParamNames.Add(TEXT("Wall"));
+	HelpParamDescriptions.Add(TEXT("Wall prefab of the generated base, one per floor tile"));
+	HelpParamNames.Add(TEXT("Cursor"));
+	HelpParamDescriptions.Add(TEXT("Prefab on the build tool cursor. Defaults to the wall prefab, or the floor prefab"));
+	HelpParamNames.Add(TEXT("Pieces"));
+	HelpParamDescriptions.Add(TEXT("Number of pieces of the generated base. Defaults to 2000"));
+	HelpParamNames.Add(TEXT("Stories"));
+	HelpParamDescriptions.Add(TEXT("Number of stories of the generated base. Defaults to 4"));
+	HelpParamNames.Add(TEXT("Updates"));
+	HelpParamDescriptions.Add(TEXT("Number of cursor updates of the synthetic path. Defaults to 2000"));
+	HelpParamNames.Add(TEXT("Seed"));
+	HelpParamDescriptions.Add(TEXT("Seed of the generated base and of the synthetic path. Defaults to 0"));
+	HelpParamNames.Add(TEXT("RemoveEvery"));
+	HelpParamDescriptions.Add(TEXT("Removes the piece under the cursor every N updates. Defaults to 0 (never)"));
+	HelpParamNames.Add(TEXT("CursorPath"));
+	HelpParamDescriptions.Add(TEXT("Cursor path recorded with ConstructionSystem.CursorPath.Save, replayed instead of the synthetic one"));
+	HelpParamNames.Add(TEXT("PlacementTrace"));
+	HelpParamDescriptions.Add(TEXT("Placement trace saved with ConstructionSystem.Geometry.SaveTrace, timed on a fresh geometry index"));
+	HelpParamNames.Add(TEXT("Output"));
+	HelpParamDescriptions.Add(TEXT("Output CSV file of the updates. Defaults to Saved/ConstructionSystem/Benchmark/ConstructionBenchmark.csv"));
+}
+
+int32 UConstructionSystemBenchmarkCommandlet::Main(const FString& Params)
+{
+	TArray<FString> Tokens;
+	TArray<FString> Switches;
+	TMap<FString, FString> ParamVals;
+	ParseCommandLine(*Params, Tokens, Switches, ParamVals);
+
+	if (const FString* FloorParam = ParamVals.Find(TEXT("Floor"))) {
+		FloorPrefab = LoadPrefab(*FloorParam);
+	}
+	if (const FString* WallParam = ParamVals.Find(TEXT("Wall"))) {
+		WallPrefab = LoadPrefab(*WallParam);
+	}
+	CursorPrefab = WallPrefab ? WallPrefab : FloorPrefab;
+	if (const FString* CursorParam = ParamVals.Find(TEXT("Cursor"))) {
+		CursorPrefab = LoadPrefab(*CursorParam);
+	}
+	if (!FloorPrefab && !WallPrefab) {
+		UE_LOG(LogConstructionBenchmark, Error, TEXT("No base prefab could be loaded. Usage: %s"), *HelpUsage);
+		return 1;
+	}
+	if (!CursorPrefab) {
+		UE_LOG(LogConstructionBenchmark, Error, TEXT("The cursor prefab could not be loaded"));
+		return 1;
+	}
+
+	if (const FString* PiecesParam = ParamVals.Find(TEXT("Pieces"))) {
+		NumPieces = FMath::Max(1, FCString::Atoi(**PiecesParam));
+	}
+	if (const FString* StoriesParam = ParamVals.Find(TEXT("Stories"))) {
+		NumStories = FMath::Max(1, FCString::Atoi(**StoriesParam));
+	}
+	if (const FString* UpdatesParam = ParamVals.Find(TEXT("Updates"))) {
+		NumUpdates = FMath::Max(1, FCString::Atoi(**UpdatesParam));
+	}
+	if (const FString* SeedParam = ParamVals.Find(TEXT("Seed"))) {
+		RandomSeed = FCString::Atoi(**SeedParam);
+	}
+
+	int32 RemoveEvery = 0;
+	if (const FString* RemoveEveryParam = ParamVals.Find(TEXT("RemoveEvery"))) {
+		RemoveEvery = FMath::Max(0, FCString::Atoi(**RemoveEveryParam));
+	}
+
+	const FString ConstructionSavedDir = FPaths::ProjectSavedDir() / TEXT("ConstructionSystem");
+	FString OutputPath = ConstructionSavedDir / TEXT("Benchmark") / TEXT("ConstructionBenchmark.csv");
+	if (const FString* OutputParam = ParamVals.Find(TEXT("Output"))) {
+		OutputPath = *OutputParam;
+	}
+
+	SnapChannel = FConstructionSystemUtils::FindPrefabSnapChannel();
+	FScopedRuntimePrefabService RuntimeService;
+
+	// A game world, so the net subsystem runs as a standalone server. The pieces are built without any cell actor
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, true, TEXT("ConstructionSystemBenchmark"));
+	UConstructionSystemNetSubsystem* NetSubsystem = World->GetSubsystem<UConstructionSystemNetSubsystem>();
+	if (!NetSubsystem) {
+		UE_LOG(LogConstructionBenchmark, Error, TEXT("The construction net subsystem is not available in the benchmark world"));
+		GEngine->DestroyWorldContext(World);
+		World->RemoveFromRoot();
+		World->DestroyWorld(false);
+		return 1;
+	}
+
+	// Every piece is built right away, the frames are not ticked while the base is generated
+	NetSubsystem->MaxImmediateBuildsPerFrame = MAX_int32;
+	NetSubsystem->bCollapseUnsupportedItems = true;
+
+	double MemoryStartMB = GetUsedMemoryMB();
+	double StartTime = FPlatformTime::Seconds();
+	FBox BaseBounds;
+	const int32 NumBuiltPieces = GenerateBase(NetSubsystem, BaseBounds);
+	const double GenerateMs = GetElapsedMs(StartTime);
+	const double GenerateMemoryMB = GetUsedMemoryMB() - MemoryStartMB;
+	UE_LOG(LogConstructionBenchmark, Display, TEXT("Generated %d pieces in %.1f ms, bounds %s"), NumBuiltPieces, GenerateMs, *BaseBounds.ToString());
+
+	// Let the physics scene pick up the bodies of the new pieces before they are queried
+	for (int32 Frame = 0; Frame < 2; Frame++) {
+		World->Tick(LEVELTICK_All, 1.0f / 60.0f);
+	}
+
+	TArray<TPair<FVector, FVector>> CursorRays;
+	if (const FString* CursorPathParam = ParamVals.Find(TEXT("CursorPath"))) {
+		const FString CursorPath = ResolveInputPath(*CursorPathParam, ConstructionSavedDir / TEXT("CursorPaths"), TEXT(".csv"));
+		if (!LoadCursorPath(CursorPath, CursorRays)) {
+			UE_LOG(LogConstructionBenchmark, Error, TEXT("Cannot load the cursor path %s"), *CursorPath);
+		}
+	}
+	else if (BaseBounds.IsValid) {
+		MakeSyntheticCursorPath(BaseBounds, CursorRays);
+	}
+
+	// The cursor ghost of the build tool, ignored by the queries like in game
+	UConstructionSystemCursor* Cursor = NewObject<UConstructionSystemCursor>(this);
+	Cursor->RecreateCursor(World, CursorPrefab);
+	FCollisionQueryParams QueryParams = FCollisionQueryParams::DefaultQueryParam;
+	FPrefabTools::IterateChildrenRecursive(Cursor->GetCursorGhostActor(), [&QueryParams](AActor* ChildCursorActor) {
+		QueryParams.AddIgnoredActor(ChildCursorActor);
+	});
+
+	UE_LOG(LogConstructionBenchmark, Display, TEXT("Replaying %d cursor updates"), CursorRays.Num());
+	MemoryStartMB = GetUsedMemoryMB();
+	StartTime = FPlatformTime::Seconds();
+	TArray<FConstructionBenchmarkSample> Samples;
+	Samples.SetNum(CursorRays.Num());
+	for (int32 Update = 0; Update < CursorRays.Num(); Update++) {
+		const bool bRemoveFocusedItem = RemoveEvery > 0 && (Update + 1) % RemoveEvery == 0;
+		RunCursorUpdate(World, NetSubsystem, Cursor, QueryParams, CursorRays[Update].Key, CursorRays[Update].Value, bRemoveFocusedItem, Samples[Update]);
+	}
+	const double UpdatesMs = GetElapsedMs(StartTime);
+	const double UpdatesMemoryMB = GetUsedMemoryMB() - MemoryStartMB;
+
+	int64 NumTraces = 0;
+	int64 NumSnapHosts = 0;
+	int64 NumSnapCandidates = 0;
+	int32 NumRemoved = 0;
+	for (const FConstructionBenchmarkSample& Sample : Samples) {
+		NumTraces += Sample.NumTraces;
+		NumSnapHosts += Sample.NumSnapHosts;
+		NumSnapCandidates += Sample.NumSnapCandidates;
+		NumRemoved += Sample.RemovedItemId != 0 ? 1 : 0;
+	}
+	const int32 NumSamples = FMath::Max(Samples.Num(), 1);
+
+	TArray<FString> RunRows;
+	RunRows.Add(TEXT("Key,Value"));
+	RunRows.Add(FString::Printf(TEXT("Pieces,%d"), NumBuiltPieces));
+	RunRows.Add(FString::Printf(TEXT("Stories,%d"), FloorPrefab && !WallPrefab ? 1 : NumStories));
+	RunRows.Add(FString::Printf(TEXT("GenerateMs,%.3f"), GenerateMs));
+	RunRows.Add(FString::Printf(TEXT("GenerateMemoryDeltaMB,%.3f"), GenerateMemoryMB));
+	RunRows.Add(FString::Printf(TEXT("Updates,%d"), Samples.Num()));
+	RunRows.Add(FString::Printf(TEXT("UpdatesMs,%.3f"), UpdatesMs));
+	RunRows.Add(FString::Printf(TEXT("UpdatesMemoryDeltaMB,%.3f"), UpdatesMemoryMB));
+	RunRows.Add(FString::Printf(TEXT("TracesPerUpdate,%.3f"), double(NumTraces) / NumSamples));
+	RunRows.Add(FString::Printf(TEXT("SnapHostsPerUpdate,%.3f"), double(NumSnapHosts) / NumSamples));
+	RunRows.Add(FString::Printf(TEXT("SnapCandidatesPerUpdate,%.3f"), double(NumSnapCandidates) / NumSamples));
+	RunRows.Add(FString::Printf(TEXT("RemovedPieces,%d"), NumRemoved));
+
+	if (const FString* TraceParam = ParamVals.Find(TEXT("PlacementTrace"))) {
+		const FString TracePath = ResolveInputPath(*TraceParam, ConstructionSavedDir / TEXT("Traces"), TEXT(".cstrace"));
+		FConstructionSystemPlacementTrace PlacementTrace;
+		if (PlacementTrace.LoadFromFile(TracePath)) {
+			StartTime = FPlatformTime::Seconds();
+			const int32 NumMismatches = PlacementTrace.Replay();
+			const double ReplayMs = GetElapsedMs(StartTime);
+			RunRows.Add(FString::Printf(TEXT("PlacementTraceEntries,%d"), PlacementTrace.Num()));
+			RunRows.Add(FString::Printf(TEXT("PlacementTraceReplayMs,%.3f"), ReplayMs));
+			RunRows.Add(FString::Printf(TEXT("PlacementTraceMismatches,%d"), NumMismatches));
+		}
+		else {
+			UE_LOG(LogConstructionBenchmark, Error, TEXT("Cannot load the placement trace %s"), *TracePath);
+		}
+	}
+
+	Cursor->DestroyCursor();
+	GEngine->DestroyWorldContext(World);
+	World->RemoveFromRoot();
+	World->DestroyWorld(false);
+
+	const FString OutputBasePath = FPaths::GetPath(OutputPath) / FPaths::GetBaseFilename(OutputPath);
+	bool bSuccess = WriteSamplesCsv(OutputPath, Samples);
+	bSuccess &= WriteSummaryCsv(OutputBasePath + TEXT("_Summary.csv"), Samples);
+	bSuccess &= FFileHelper::SaveStringArrayToFile(RunRows, *(OutputBasePath + TEXT("_Run.csv")));
+
+	for (const FString& RunRow : TArrayView<const FString>(RunRows).RightChop(1)) {
+		UE_LOG(LogConstructionBenchmark, Display, TEXT("%s"), *RunRow.Replace(TEXT(","), TEXT(": ")));
+	}
+
+	if (!bSuccess) {
+		UE_LOG(LogConstructionBenchmark, Error, TEXT("Failed to write the benchmark report: %s"), *OutputPath);
+		return 1;
+	}
+	UE_LOG(LogConstructionBenchmark, Display, TEXT("Wrote the benchmark report: %s"), *OutputPath);
+	return 0;
+}
+
+int32 UConstructionSystemBenchmarkCommandlet::GenerateBase(UConstructionSystemNetSubsystem* InNetSubsystem, FBox& OutBounds) const
+{
+	OutBounds.Init();
+
+	FBox FloorBounds(ForceInit);
+	FBox WallBounds(ForceInit);
+	if (FloorPrefab && !GetLocalSnapBounds(InNetSubsystem, FloorPrefab, FloorBounds)) {
+		UE_LOG(LogConstructionBenchmark, Error, TEXT("The floor prefab has no snap component: %s"), *FloorPrefab->GetPathName());
+		return 0;
+	}
+	if (WallPrefab && !GetLocalSnapBounds(InNetSubsystem, WallPrefab, WallBounds)) {
+		UE_LOG(LogConstructionBenchmark, Error, TEXT("The wall prefab has no snap component: %s"), *WallPrefab->GetPathName());
+		return 0;
+	}
+
+	const FVector FloorExtent = FloorBounds.GetExtent();
+	const FVector WallExtent = WallBounds.GetExtent();
+	const bool bWallAlongX = WallExtent.X >= WallExtent.Y;
+	const float WallHalfLength = FMath::Max(WallExtent.X, WallExtent.Y);
+
+	// With floors, each tile gets a wall on its +X edge and the next story rests on the walls.
+	// Without floors, the walls are laid in rows along X
+	const int32 NumBaseStories = FloorPrefab && !WallPrefab ? 1 : NumStories;
+	const int32 PiecesPerTile = (FloorPrefab ? 1 : 0) + (WallPrefab ? 1 : 0);
+	const int32 TilesPerStory = FMath::DivideAndRoundUp(NumPieces, PiecesPerTile * NumBaseStories);
+	const int32 GridSize = FMath::Max(1, FMath::CeilToInt(FMath::Sqrt(float(TilesPerStory))));
+	const FVector TileStep = FloorPrefab
+		? FVector(FloorExtent.X * 2, FloorExtent.Y * 2, FloorExtent.Z * 2 + WallExtent.Z * 2)
+		: FVector(WallHalfLength * 2, WallHalfLength * 2, WallExtent.Z * 2);
+
+	const bool bWallAlongY = FloorPrefab != nullptr;
+	const FRotator WallRotation(0, bWallAlongX == bWallAlongY ? 90 : 0, 0);
+	const FVector WallCenterOffset = FloorPrefab
+		? FloorBounds.GetCenter() + FVector(FloorExtent.X, 0, FloorExtent.Z + WallExtent.Z)
+		: FVector(0, 0, WallExtent.Z);
+	const FVector WallLocationOffset = WallCenterOffset - WallRotation.RotateVector(WallBounds.GetCenter());
+
+	const auto GetTileIndex = [GridSize](int32 X, int32 Y, int32 Story) {
+		return (Story * GridSize + Y) * GridSize + X;
+	};
+	TArray<uint32> FloorIds;
+	TArray<uint32> WallIds;
+	FloorIds.SetNumZeroed(GridSize * GridSize * NumBaseStories);
+	WallIds.SetNumZeroed(GridSize * GridSize * NumBaseStories);
+
+	FRandomStream Random(RandomSeed);
+	int32 NumBuilt = 0;
+	const auto BuildPiece = [&](UPrefabricatorAssetInterface* InPrefab, const FTransform& InTransform, uint32 InSnapParentId) {
+		const FConstructionSystemPlacement Placement(InTransform, Random.RandHelper(MAX_int32));
+		const uint32 ItemId = UConstructionSystemNetSubsystem::GetItemId(InNetSubsystem->ConstructItem(InPrefab, Placement, InSnapParentId));
+		if (ItemId) {
+			NumBuilt++;
+			FConstructionSystemSnapBoxList Boxes;
+			InNetSubsystem->GetPlacementBoxes(InPrefab, Placement.Seed, InTransform, Boxes);
+			for (const FConstructionSystemSnapBox& Box : Boxes) {
+				OutBounds += Box.GetBounds();
+			}
+		}
+		return ItemId;
+	};
+
+	for (int32 Story = 0; Story < NumBaseStories; Story++) {
+		for (int32 Y = 0; Y < GridSize; Y++) {
+			for (int32 X = 0; X < GridSize; X++) {
+				if (NumBuilt >= NumPieces) {
+					return NumBuilt;
+				}
+
+				// The ground story is chained along the rows, the upper stories rest on the pieces below
+				const int32 TileIndex = GetTileIndex(X, Y, Story);
+				const int32 ChainIndex = X > 0 ? GetTileIndex(X - 1, Y, Story) : (Y > 0 ? GetTileIndex(0, Y - 1, Story) : INDEX_NONE);
+				const int32 BelowIndex = Story > 0 ? GetTileIndex(X, Y, Story - 1) : INDEX_NONE;
+				const FVector TileLocation = TileStep * FVector(X, Y, Story);
+
+				if (FloorPrefab) {
+					const uint32 SnapParentId = BelowIndex != INDEX_NONE ? WallIds[BelowIndex] : (ChainIndex != INDEX_NONE ? FloorIds[ChainIndex] : 0);
+					FloorIds[TileIndex] = BuildPiece(FloorPrefab, FTransform(TileLocation), SnapParentId);
+				}
+				if (WallPrefab && NumBuilt < NumPieces) {
+					uint32 SnapParentId = FloorIds[TileIndex];
+					if (!FloorPrefab) {
+						SnapParentId = BelowIndex != INDEX_NONE ? WallIds[BelowIndex] : (ChainIndex != INDEX_NONE ? WallIds[ChainIndex] : 0);
+					}
+					WallIds[TileIndex] = BuildPiece(WallPrefab, FTransform(WallRotation, TileLocation + WallLocationOffset), SnapParentId);
+				}
+			}
+		}
+	}
+	return NumBuilt;
+}
+
+void UConstructionSystemBenchmarkCommandlet::MakeSyntheticCursorPath(const FBox& InBaseBounds, TArray<TPair<FVector, FVector>>& OutRays) const
+{
+	FRandomStream Random(RandomSeed);
+	const FVector Center = InBaseBounds.GetCenter();
+	const FVector Extent = InBaseBounds.GetExtent();
+	const float OrbitRadius = Extent.Size2D() + 1000.0f;
+	const float ViewHeight = InBaseBounds.Max.Z + 500.0f;
+	const FVector AimPhase(Random.FRandRange(0, 2 * PI), Random.FRandRange(0, 2 * PI), Random.FRandRange(0, 2 * PI));
+
+	// The camera orbits the base once every 10 seconds at 60 updates per second, while the aim point wanders over it
+	OutRays.Reset(NumUpdates);
+	for (int32 Update = 0; Update < NumUpdates; Update++) {
+		const float Time = Update / 60.0f;
+		const float OrbitAngle = Time * 2 * PI / 10.0f;
+		const FVector ViewLocation(Center.X + FMath::Cos(OrbitAngle) * OrbitRadius, Center.Y + FMath::Sin(OrbitAngle) * OrbitRadius, ViewHeight);
+		const FVector AimPoint = Center + Extent * FVector(
+			FMath::Sin(Time * 1.3f + AimPhase.X),
+			FMath::Sin(Time * 0.7f + AimPhase.Y),
+			FMath::Sin(Time * 0.5f + AimPhase.Z));
+
+		const FVector Direction = (AimPoint - ViewLocation).GetSafeNormal();
+		const float RayLength = FMath::Max(TraceDistance, FVector::Dist(ViewLocation, AimPoint) + 500.0f);
+		OutRays.Emplace(ViewLocation, ViewLocation + Direction * RayLength);
+	}
+}
+
+bool UConstructionSystemBenchmarkCommandlet::LoadCursorPath(const FString& InPath, TArray<TPair<FVector, FVector>>& OutRays)
+{
+	TArray<FString> Rows;
+	if (!FFileHelper::LoadFileToStringArray(Rows, *InPath)) {
+		return false;
+	}
+
+	OutRays.Reset(Rows.Num());
+	TArray<FString> Fields;
+	for (const FString& Row : Rows) {
+		Row.ParseIntoArray(Fields, TEXT(","));
+		if (Fields.Num() == 6) {
+			OutRays.Emplace(
+				FVector(FCString::Atof(*Fields[0]), FCString::Atof(*Fields[1]), FCString::Atof(*Fields[2])),
+				FVector(FCString::Atof(*Fields[3]), FCString::Atof(*Fields[4]), FCString::Atof(*Fields[5])));
+		}
+	}
+	return OutRays.Num() > 0;
+}
+
+void UConstructionSystemBenchmarkCommandlet::RunCursorUpdate(UWorld* InWorld, UConstructionSystemNetSubsystem* InNetSubsystem, UConstructionSystemCursor* InCursor,
+	const FCollisionQueryParams& InQueryParams, const FVector& InStart, const FVector& InEnd, bool bInRemoveFocusedItem, FConstructionBenchmarkSample& OutSample) const
+{
+	const FCollisionResponseParams& ResponseParams = FCollisionResponseParams::DefaultResponseParam;
+
+	// Build tool: the snap channel sweep, or the static world trace when it missed
+	double StartTime = FPlatformTime::Seconds();
+	FHitResult Hit;
+	OutSample.NumTraces++;
+	if (InWorld->SweepSingleByChannel(Hit, InStart, InEnd, FQuat::Identity, SnapChannel, FCollisionShape::MakeSphere(SweepRadius), InQueryParams, ResponseParams)) {
+		OutSample.bFoundHit = true;
+		OutSample.bHitSnapChannel = true;
+	}
+	else {
+		OutSample.NumTraces++;
+		OutSample.bFoundHit = InWorld->LineTraceSingleByChannel(Hit, InStart, InEnd, ECC_WorldStatic, InQueryParams, ResponseParams);
+	}
+	OutSample.PhaseMs[(int32)EConstructionBenchmarkPhase::CursorTrace] = GetElapsedMs(StartTime);
+
+	// Build tool: the best attachment on the pieces around the hit
+	uint32 SnapParentId = 0;
+	bool bSnapped = false;
+	if (OutSample.bHitSnapChannel) {
+		StartTime = FPlatformTime::Seconds();
+		UPrefabricatorConstructionSnapComponent* HitSnap = Cast<UPrefabricatorConstructionSnapComponent>(Hit.GetComponent());
+		TArray<UPrefabricatorConstructionSnapComponent*> HostSnaps;
+		TArray<FConstructionSystemSnapCandidate> Candidates;
+		if (HitSnap) {
+			FConstructionSystemUtils::GatherSnapHosts(InWorld, HitSnap, Hit.ImpactPoint, SnapSearchRadius, HostSnaps);
+			FConstructionSystemUtils::FindSnapCandidates(HostSnaps, InCursor->GetSnapComponents(), Hit.ImpactPoint, 0, 100, MaxSnapCandidates, Candidates);
+		}
+		if (Candidates.Num() > 0) {
+			InCursor->SetActiveSnapComponentIndex(Candidates[0].CursorSnapIndex);
+			InCursor->SetTransform(Candidates[0].Transform);
+			SnapParentId = UConstructionSystemNetSubsystem::GetItemId(FConstructionSystemUtils::FindTopMostPrefabActor(Candidates[0].HostSnap));
+			bSnapped = true;
+		}
+		OutSample.PhaseMs[(int32)EConstructionBenchmarkPhase::SnapSearch] = GetElapsedMs(StartTime);
+		OutSample.NumSnapHosts = HostSnaps.Num();
+		OutSample.NumSnapCandidates = Candidates.Num();
+	}
+	else if (OutSample.bFoundHit) {
+		InCursor->SetTransform(FTransform(Hit.ImpactPoint));
+	}
+
+	UPrefabricatorConstructionSnapComponent* CursorSnap = InCursor->GetActiveSnapComponent();
+	FTransform CursorTransform;
+	if (OutSample.bFoundHit && CursorSnap && InCursor->GetCursorTransform(CursorTransform)) {
+		// Build tool: the overlap check of the cursor on the physics scene
+		StartTime = FPlatformTime::Seconds();
+		const FConstructionSystemSnapBox CursorBox(CursorSnap->GetComponentTransform(), CursorSnap->GetScaledBoxExtent(), CursorSnap->SnapType);
+		const FVector OverlapExtent = FBox(-CursorBox.Extent, CursorBox.Extent).ExpandBy(-2).GetExtent();
+		TArray<FOverlapResult> Overlaps;
+		OutSample.NumTraces++;
+		if (InWorld->OverlapMultiByChannel(Overlaps, CursorSnap->GetComponentLocation(), CursorSnap->GetComponentQuat(), SnapChannel, FCollisionShape::MakeBox(OverlapExtent), InQueryParams)) {
+			OutSample.bOverlapping = FConstructionSystemCollision::HasCollidingSnapOverlap(CursorBox, Overlaps);
+		}
+		OutSample.PhaseMs[(int32)EConstructionBenchmarkPhase::PhysicsOverlap] = GetElapsedMs(StartTime);
+
+		// The same placement validated on the geometry index, as the server does for the build records
+		StartTime = FPlatformTime::Seconds();
+		FConstructionSystemPlacementQuery Query;
+		if (InNetSubsystem->GetPlacementBoxes(CursorPrefab, 0, CursorTransform, Query.Boxes)) {
+			const FConstructionSystemGeometryIndex& GeometryIndex = InNetSubsystem->GetGeometryIndex();
+			Query.SnapParentId = GeometryIndex.Contains(SnapParentId) ? SnapParentId : 0;
+			Query.bCheckGroundSlope = !bSnapped && CursorSnap->bUseMaxGroundSlopeConstraint;
+			Query.GroundNormal = Hit.ImpactNormal;
+			Query.MaxGroundSlope = CursorSnap->MaxGroundPlacementSlope;
+			OutSample.PlacementResult = FConstructionSystemGeometryIndex::GetResultName(GeometryIndex.ValidatePlacement(Query));
+		}
+		OutSample.PhaseMs[(int32)EConstructionBenchmarkPhase::GeometryValidation] = GetElapsedMs(StartTime);
+	}
+
+	// Remove tool: the piece under the cursor
+	StartTime = FPlatformTime::Seconds();
+	FHitResult RemoveHit;
+	uint32 FocusedItemId = 0;
+	OutSample.NumTraces++;
+	if (InWorld->LineTraceSingleByChannel(RemoveHit, InStart, InEnd, SnapChannel, InQueryParams, ResponseParams)) {
+		if (UPrefabricatorConstructionSnapComponent* FocusedSnap = Cast<UPrefabricatorConstructionSnapComponent>(RemoveHit.GetComponent())) {
+			FocusedItemId = UConstructionSystemNetSubsystem::GetItemId(FConstructionSystemUtils::FindTopMostPrefabActor(FocusedSnap));
+		}
+	}
+	OutSample.PhaseMs[(int32)EConstructionBenchmarkPhase::RemoveTrace] = GetElapsedMs(StartTime);
+
+	if (bInRemoveFocusedItem && FocusedItemId) {
+		StartTime = FPlatformTime::Seconds();
+		if (InNetSubsystem->RemoveItem(FocusedItemId)) {
+			// The support checks are time sliced over the frames, run them to completion
+			while (InNetSubsystem->GetNumPendingSupportChecks() > 0) {
+				InNetSubsystem->Tick(0.0f);
+			}
+			OutSample.RemovedItemId = FocusedItemId;
+		}
+		OutSample.PhaseMs[(int32)EConstructionBenchmarkPhase::Remove] = GetElapsedMs(StartTime);
+	}
+}
+
+bool UConstructionSystemBenchmarkCommandlet::WriteSamplesCsv(const FString& InPath, TArrayView<const FConstructionBenchmarkSample> InSamples)
+{
+	FString Header = TEXT("Update");
+	for (int32 Phase = 0; Phase < (int32)EConstructionBenchmarkPhase::Num; Phase++) {
+		Header += FString::Printf(TEXT(",%sMs"), GetPhaseName((EConstructionBenchmarkPhase)Phase));
+	}
+	Header += TEXT(",Traces,SnapHosts,SnapCandidates,Hit,SnapHit,Overlapping,PlacementResult,RemovedItem");
+
+	TArray<FString> Rows;
+	Rows.Reserve(InSamples.Num() + 1);
+	Rows.Add(Header);
+	for (int32 Update = 0; Update < InSamples.Num(); Update++) {
+		const FConstructionBenchmarkSample& Sample = InSamples[Update];
+		FString Row = FString::FromInt(Update);
+		for (double PhaseMs : Sample.PhaseMs) {
+			Row += TEXT(",") + FormatMs(PhaseMs);
+		}
+		Row += FString::Printf(TEXT(",%d,%d,%d,%d,%d,%d,%s,%u"),
+			Sample.NumTraces,
+			Sample.NumSnapHosts,
+			Sample.NumSnapCandidates,
+			Sample.bFoundHit ? 1 : 0,
+			Sample.bHitSnapChannel ? 1 : 0,
+			Sample.bOverlapping ? 1 : 0,
+			Sample.PlacementResult,
+			Sample.RemovedItemId);
+		Rows.Add(Row);
+	}
+	return FFileHelper::SaveStringArrayToFile(Rows, *InPath);
+}
+
+bool UConstructionSystemBenchmarkCommandlet::WriteSummaryCsv(const FString& InPath, TArrayView<const FConstructionBenchmarkSample> InSamples)
+{
+	TArray<FString> Rows;
+	Rows.Add(TEXT("Phase,Updates,AvgMs,P50Ms,P95Ms,MaxMs,TotalMs"));
+
+	TArray<double> Timings;
+	for (int32 Phase = 0; Phase < (int32)EConstructionBenchmarkPhase::Num; Phase++) {
+		Timings.Reset();
+		double TotalMs = 0;
+		for (const FConstructionBenchmarkSample& Sample : InSamples) {
+			if (Sample.PhaseMs[Phase] >= 0) {
+				Timings.Add(Sample.PhaseMs[Phase]);
+				TotalMs += Sample.PhaseMs[Phase];
+			}
+		}
+		Timings.Sort();
+
+		const auto GetPercentile = [&Timings](double InPercentile) {
+			return Timings.Num() > 0 ? Timings[FMath::Clamp(FMath::CeilToInt(InPercentile * Timings.Num()) - 1, 0, Timings.Num() - 1)] : -1.0;
+		};
+		Rows.Add(FString::Printf(TEXT("%s,%d,%s,%s,%s,%s,%.3f"),
+			GetPhaseName((EConstructionBenchmarkPhase)Phase),
+			Timings.Num(),
+			*FormatMs(Timings.Num() > 0 ? TotalMs / Timings.Num() : -1.0),
+			*FormatMs(GetPercentile(0.5)),
+			*FormatMs(GetPercentile(0.95)),
+			*FormatMs(Timings.Num() > 0 ? Timings.Last() : -1.0),
+			TotalMs));
+	}
+	return FFileHelper::SaveStringArrayToFile(Rows, *InPath);
+}
@@ -0,0 +1,112 @@
+//$ Copyright 2015-23, Code Respawn Technologies Pvt Ltd - All Rights Reserved $//
+
+#pragma once
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "Engine/EngineTypes.h"
+#include "ConstructionSystemBenchmarkCommandlet.generated.h"
+
+class UConstructionSystemCursor;
+class UConstructionSystemNetSubsystem;
+class UPrefabricatorAssetInterface;
+class UWorld;
+struct FCollisionQueryParams;
+
+/** The timed steps of a cursor update */
+enum class EConstructionBenchmarkPhase : uint8 {
+	/** Build tool: snap channel sweep, then the static world line trace */
+	CursorTrace,
+	/** Build tool: gathering the nearby snap hosts and ranking the snap candidates */
+	SnapSearch,
+	/** Build tool: overlap query of the cursor snap box on the physics scene */
+	PhysicsOverlap,
+	/** Build tool: the same placement validated on the construction geometry index */
+	GeometryValidation,
+	/** Remove tool: line trace and lookup of the focused piece */
+	RemoveTrace,
+	/** Removal of the focused piece, with the support checks it starts */
+	Remove,
+	Num
+};
+
+/** One cursor update of the replayed path */
+struct FConstructionBenchmarkSample {
+	/** Negative if the phase did not run in this update */
+	double PhaseMs[(int32)EConstructionBenchmarkPhase::Num];
+
+	int32 NumTraces = 0;
+	int32 NumSnapHosts = 0;
+	int32 NumSnapCandidates = 0;
+	bool bFoundHit = false;
+	bool bHitSnapChannel = false;
+	bool bOverlapping = false;
+	const TCHAR* PlacementResult = TEXT("");
+	uint32 RemovedItemId = 0;
+
+	FConstructionBenchmarkSample();
+};
+
+/**
+ * Benchmarks the construction tools on a procedurally generated base. A grid of floors, with a wall on one edge of each
+ * tile, is built story over story in a headless world through the construction net subsystem. A cursor path is then
+ * replayed over it: every update runs the queries of the build tool (cursor traces, snap search, overlap check and
+ * geometry validation) and of the remove tool, and optionally removes the focused piece. The per update timings and
+ * query counts are written as CSV, along with a summary (average, median, 95th percentile and max of every phase).
+ *
+ * The cursor path is either synthetic (a sweep over the base from an orbiting camera) or recorded in game with
+ * ConstructionSystem.CursorPath.Record / ConstructionSystem.CursorPath.Save. The memory growth of each pass is reported,
+ * run with -trace=memalloc to break the allocations down in Unreal Insights
+ *
+ * Usage:
+ *   UnrealEditor-Cmd.exe <Project> -run=ConstructionSystemBenchmark [-Floor=<Prefab>] [-Wall=<Prefab>] [-Cursor=<Prefab>]
+ *                        [-Pieces=2000] [-Stories=4] [-Updates=2000] [-Seed=0] [-RemoveEvery=0] [-CursorPath=<Name|File.csv>]
+ *                        [-PlacementTrace=<Name|File.cstrace>] [-Output=<File.csv>]
+ */
+UCLASS()
+class CONSTRUCTIONSYSTEMEDITOR_API UConstructionSystemBenchmarkCommandlet : public UCommandlet {
+	GENERATED_BODY()
+public:
+	UConstructionSystemBenchmarkCommandlet();
+
+	/// UCommandlet Interface
+	virtual int32 Main(const FString& Params) override;
+	/// End of UCommandlet Interface
+
+private:
+	/** Builds the base through the net subsystem. Returns the number of built pieces */
+	int32 GenerateBase(UConstructionSystemNetSubsystem* InNetSubsystem, FBox& OutBounds) const;
+
+	void MakeSyntheticCursorPath(const FBox& InBaseBounds, TArray<TPair<FVector, FVector>>& OutRays) const;
+	static bool LoadCursorPath(const FString& InPath, TArray<TPair<FVector, FVector>>& OutRays);
+
+	/** Runs the queries of a build tool and a remove tool update along the ray */
+	void RunCursorUpdate(UWorld* InWorld, UConstructionSystemNetSubsystem* InNetSubsystem, UConstructionSystemCursor* InCursor,
+		const FCollisionQueryParams& InQueryParams, const FVector& InStart, const FVector& InEnd, bool bInRemoveFocusedItem, FConstructionBenchmarkSample& OutSample) const;
+
+	static bool WriteSamplesCsv(const FString& InPath, TArrayView<const FConstructionBenchmarkSample> InSamples);
+	static bool WriteSummaryCsv(const FString& InPath, TArrayView<const FConstructionBenchmarkSample> InSamples);
+
+private:
+	UPROPERTY(Transient)
+	UPrefabricatorAssetInterface* FloorPrefab = nullptr;
+
+	UPROPERTY(Transient)
+	UPrefabricatorAssetInterface* WallPrefab = nullptr;
+
+	/** The prefab on the build tool cursor */
+	UPROPERTY(Transient)
+	UPrefabricatorAssetInterface* CursorPrefab = nullptr;
+
+	int32 NumPieces = 2000;
+	int32 NumStories = 4;
+	int32 NumUpdates = 2000;
+	int32 RandomSeed = 0;
+
+	/** Same settings as the default build tool and construction component */
+	float SweepRadius = 40.0f;
+	float SnapSearchRadius = 500.0f;
+	int32 MaxSnapCandidates = 8;
+	float TraceDistance = 4000.0f;
+
+	TEnumAsByte<ECollisionChannel> SnapChannel = ECC_WorldStatic;
+};
@@ -24,6 +24,7 @@ namespace UnrealBuildTool.Rules
                     "CoreUObject",
                     "UMG",
                     "Engine",
+                    "NetCore",
 					// ... add other public dependencies that you statically link with here ...
 				}
 				);
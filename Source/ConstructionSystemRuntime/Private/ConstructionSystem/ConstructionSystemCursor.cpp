@@ -44,7 +44,7 @@ void UConstructionSystemCursor::RecreateCursor(UWorld* InWorld, UPrefabricatorAs
 
 					for (UActorComponent* Component : ChildActor->GetComponents()) {
 						if (UPrimitiveComponent* Primitive = Cast<UPrimitiveComponent>(Component)) {
-							if (!Primitive->IsA<UPrefabricatorConstructionSnapComponent>()) {
+							if (bPreviewOnly || !Primitive->IsA<UPrefabricatorConstructionSnapComponent>()) {
 								// Disable collision
 								Primitive->SetCollisionEnabled(ECollisionEnabled::NoCollision);
 							}
@@ -148,6 +148,13 @@ void UConstructionSystemCursor::MoveToPrevSnapComponent()
 	}
 }
 
+void UConstructionSystemCursor::SetActiveSnapComponentIndex(int32 InIndex)
+{
+	if (SnapComponents.IsValidIndex(InIndex)) {
+		ActiveSnapComponentIndex = InIndex;
+	}
+}
+
 UPrefabricatorConstructionSnapComponent* UConstructionSystemCursor::GetActiveSnapComponent()
 {
 	if (ActiveSnapComponentIndex < 0 || ActiveSnapComponentIndex >= SnapComponents.Num()) {
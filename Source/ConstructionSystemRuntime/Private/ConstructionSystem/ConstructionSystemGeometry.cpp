@@ -0,0 +1,473 @@
+//$ Copyright 2015-23, Code Respawn Technologies Pvt Ltd - All Rights Reserved $//
+
+#include "ConstructionSystem/ConstructionSystemGeometry.h"
+
+#include "ConstructionSystem/ConstructionSystemSnap.h"
+#include "Utils/ConstructionSystemStats.h"
+#include "Utils/ConstructionSystemUtils.h"
+
+#include "Misc/FileHelper.h"
+#include "Misc/ScopeRWLock.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogConstructionGeometry, Log, All);
+
+namespace {
+	const uint32 PlacementTraceMagic = 0x43535054;	// CSPT
+	const int32 PlacementTraceVersion = 2;
+
+	/** Same shrink as the overlap test of the build tool cursor, so pieces that only touch do not overlap */
+	const float OverlapShrinkAmount = 2.0f;
+}
+
+///////////////////////////////// FConstructionSystemSnapBox /////////////////////////////////
+
+FConstructionSystemSnapBox::FConstructionSystemSnapBox()
+	: Type(EPrefabricatorConstructionSnapType::Floor)
+{
+}
+
+FConstructionSystemSnapBox::FConstructionSystemSnapBox(const FTransform& InTransform, const FVector& InExtent, EPrefabricatorConstructionSnapType InType)
+	: Transform(InTransform.GetRotation(), InTransform.GetLocation())
+	, Extent(InExtent)
+	, Type(InType)
+{
+}
+
+FBox FConstructionSystemSnapBox::GetBounds() const
+{
+	return FBox(-Extent, Extent).TransformBy(Transform);
+}
+
+FArchive& operator<<(FArchive& Ar, FConstructionSystemSnapBox& Box)
+{
+	uint8 Type = static_cast<uint8>(Box.Type);
+	Ar << Box.Transform;
+	Ar << Box.Extent;
+	Ar << Type;
+	Box.Type = static_cast<EPrefabricatorConstructionSnapType>(Type);
+	return Ar;
+}
+
+FArchive& operator<<(FArchive& Ar, FConstructionSystemPlacementQuery& Query)
+{
+	Ar << Query.Boxes;
+	Ar << Query.SnapParentId;
+	Ar << Query.IgnoredItemIds;
+	Ar << Query.bCheckGroundSlope;
+	Ar << Query.GroundNormal;
+	Ar << Query.MaxGroundSlope;
+	return Ar;
+}
+
+///////////////////////////////// FConstructionSystemGeometryIndex /////////////////////////////////
+
+FConstructionSystemGeometryIndex::FConstructionSystemGeometryIndex(float InCellSize)
+	: CellSize(FMath::Max(InCellSize, 1.0f))
+{
+}
+
+void FConstructionSystemGeometryIndex::AddItem(uint32 InItemId, TArrayView<const FConstructionSystemSnapBox> InBoxes)
+{
+	FWriteScopeLock WriteLock(Lock);
+
+	if (FItem* ExistingItem = Items.Find(InItemId)) {
+		// Re-registered, e.g. a replicated piece that was rebuilt. Drop the old cells first
+		for (const FIntVector& Cell : ExistingItem->Cells) {
+			if (TArray<uint32>* CellItems = Cells.Find(Cell)) {
+				CellItems->RemoveSingleSwap(InItemId);
+			}
+		}
+	}
+
+	FItem& Item = Items.FindOrAdd(InItemId);
+	Item.Boxes.Reset();
+	Item.Boxes.Append(InBoxes.GetData(), InBoxes.Num());
+	Item.Cells.Reset();
+
+	TArray<FIntVector, TInlineAllocator<8>> BoxCells;
+	for (const FConstructionSystemSnapBox& Box : InBoxes) {
+		GetCells(Box.GetBounds(), BoxCells);
+		for (const FIntVector& Cell : BoxCells) {
+			if (!Item.Cells.Contains(Cell)) {
+				Item.Cells.Add(Cell);
+				Cells.FindOrAdd(Cell).Add(InItemId);
+			}
+		}
+	}
+}
+
+void FConstructionSystemGeometryIndex::RemoveItem(uint32 InItemId)
+{
+	FWriteScopeLock WriteLock(Lock);
+
+	FItem Item;
+	if (!Items.RemoveAndCopyValue(InItemId, Item)) {
+		return;
+	}
+
+	for (const FIntVector& Cell : Item.Cells) {
+		if (TArray<uint32>* CellItems = Cells.Find(Cell)) {
+			CellItems->RemoveSingleSwap(InItemId);
+			if (CellItems->Num() == 0) {
+				Cells.Remove(Cell);
+			}
+		}
+	}
+}
+
+bool FConstructionSystemGeometryIndex::Contains(uint32 InItemId) const
+{
+	FReadScopeLock ReadLock(Lock);
+	return Items.Contains(InItemId);
+}
+
+int32 FConstructionSystemGeometryIndex::Num() const
+{
+	FReadScopeLock ReadLock(Lock);
+	return Items.Num();
+}
+
+void FConstructionSystemGeometryIndex::Reset()
+{
+	FWriteScopeLock WriteLock(Lock);
+	Items.Reset();
+	Cells.Reset();
+}
+
+EConstructionSystemPlacementResult FConstructionSystemGeometryIndex::ValidatePlacement(const FConstructionSystemPlacementQuery& InQuery, TArrayView<const FConstructionSystemSnapBox> InExtraBoxes) const
+{
+	SCOPE_CYCLE_COUNTER(STAT_ConstructionGeometry_Validate);
+	FReadScopeLock ReadLock(Lock);
+
+	// Snap legality: the piece has to actually touch the piece it claims to be snapped to
+	if (InQuery.SnapParentId != 0) {
+		const FItem* SnapParent = Items.Find(InQuery.SnapParentId);
+		if (!SnapParent || InQuery.IgnoredItemIds.Contains(InQuery.SnapParentId)) {
+			return EConstructionSystemPlacementResult::SnapParentMissing;
+		}
+
+		const FVector Tolerance(SnapTolerance);
+		bool bAttached = false;
+		for (const FConstructionSystemSnapBox& QueryBox : InQuery.Boxes) {
+			for (const FConstructionSystemSnapBox& ParentBox : SnapParent->Boxes) {
+				if (FConstructionSystemCollision::BoxesOverlap(QueryBox.Extent, QueryBox.Transform, ParentBox.Extent + Tolerance, ParentBox.Transform)) {
+					bAttached = true;
+					break;
+				}
+			}
+			if (bAttached) {
+				break;
+			}
+		}
+		if (!bAttached) {
+			return EConstructionSystemPlacementResult::NotAttachedToSnapParent;
+		}
+	}
+	else if (InQuery.bCheckGroundSlope) {
+		const double AngleDeg = FMath::RadiansToDegrees(FMath::Acos(FMath::Clamp(InQuery.GroundNormal.GetSafeNormal().Z, -1.0, 1.0)));
+		if (AngleDeg > InQuery.MaxGroundSlope) {
+			return EConstructionSystemPlacementResult::GroundTooSteep;
+		}
+	}
+
+	// Gather the candidates from the cells and test them in item id order, so the result never depends on the hash layout
+	TArray<uint32, TInlineAllocator<32>> Candidates;
+	TArray<FIntVector, TInlineAllocator<8>> QueryCells;
+	for (const FConstructionSystemSnapBox& QueryBox : InQuery.Boxes) {
+		GetCells(QueryBox.GetBounds(), QueryCells);
+		for (const FIntVector& Cell : QueryCells) {
+			if (const TArray<uint32>* CellItems = Cells.Find(Cell)) {
+				Candidates.Append(*CellItems);
+			}
+		}
+	}
+	Candidates.Sort();
+
+	int32 NumBoxesTested = 0;
+	uint32 LastItemId = 0;
+	for (int32 Index = 0; Index < Candidates.Num(); Index++) {
+		const uint32 ItemId = Candidates[Index];
+		if (Index > 0 && ItemId == LastItemId) {
+			continue;
+		}
+		LastItemId = ItemId;
+		if (InQuery.IgnoredItemIds.Contains(ItemId)) {
+			continue;
+		}
+
+		const FItem& Item = Items.FindChecked(ItemId);
+		for (const FConstructionSystemSnapBox& QueryBox : InQuery.Boxes) {
+			for (const FConstructionSystemSnapBox& ItemBox : Item.Boxes) {
+				NumBoxesTested++;
+				if (Overlaps(QueryBox, ItemBox)) {
+					INC_DWORD_STAT_BY(STAT_ConstructionGeometry_NumBoxesTested, NumBoxesTested);
+					return EConstructionSystemPlacementResult::Overlapping;
+				}
+			}
+		}
+	}
+
+	for (const FConstructionSystemSnapBox& QueryBox : InQuery.Boxes) {
+		for (const FConstructionSystemSnapBox& ExtraBox : InExtraBoxes) {
+			NumBoxesTested++;
+			if (Overlaps(QueryBox, ExtraBox)) {
+				INC_DWORD_STAT_BY(STAT_ConstructionGeometry_NumBoxesTested, NumBoxesTested);
+				return EConstructionSystemPlacementResult::Overlapping;
+			}
+		}
+	}
+
+	INC_DWORD_STAT_BY(STAT_ConstructionGeometry_NumBoxesTested, NumBoxesTested);
+	return EConstructionSystemPlacementResult::Valid;
+}
+
+void FConstructionSystemGeometryIndex::FindItems(const FBox& InBounds, TArray<uint32>& OutItemIds) const
+{
+	FReadScopeLock ReadLock(Lock);
+
+	OutItemIds.Reset();
+	TArray<FIntVector, TInlineAllocator<8>> QueryCells;
+	GetCells(InBounds, QueryCells);
+	for (const FIntVector& Cell : QueryCells) {
+		if (const TArray<uint32>* CellItems = Cells.Find(Cell)) {
+			OutItemIds.Append(*CellItems);
+		}
+	}
+	OutItemIds.Sort();
+
+	int32 NumUnique = 0;
+	uint32 LastItemId = 0;
+	for (int32 Index = 0; Index < OutItemIds.Num(); Index++) {
+		const uint32 ItemId = OutItemIds[Index];
+		if (Index > 0 && ItemId == LastItemId) {
+			continue;
+		}
+		LastItemId = ItemId;
+
+		const FItem& Item = Items.FindChecked(ItemId);
+		const bool bIntersects = Item.Boxes.ContainsByPredicate([&InBounds](const FConstructionSystemSnapBox& Box) {
+			return Box.GetBounds().Intersect(InBounds);
+		});
+		if (bIntersects) {
+			OutItemIds[NumUnique++] = ItemId;
+		}
+	}
+	OutItemIds.SetNum(NumUnique, false);
+}
+
+void FConstructionSystemGeometryIndex::GetBoxes(const FBox& InBounds, TArray<FConstructionSystemSnapBox>& OutBoxes) const
+{
+	TArray<uint32> ItemIds;
+	FindItems(InBounds, ItemIds);
+
+	FReadScopeLock ReadLock(Lock);
+	OutBoxes.Reset();
+	for (uint32 ItemId : ItemIds) {
+		const FItem& Item = Items.FindChecked(ItemId);
+		OutBoxes.Append(Item.Boxes.GetData(), Item.Boxes.Num());
+	}
+}
+
+void FConstructionSystemGeometryIndex::FindTouchingItems(TArrayView<const FConstructionSystemSnapBox> InBoxes, uint32 InIgnoredItemId, TArray<uint32>& OutItemIds) const
+{
+	FReadScopeLock ReadLock(Lock);
+
+	OutItemIds.Reset();
+	const FVector Tolerance(SnapTolerance);
+	TArray<FIntVector, TInlineAllocator<8>> QueryCells;
+	for (const FConstructionSystemSnapBox& Box : InBoxes) {
+		GetCells(Box.GetBounds().ExpandBy(Tolerance), QueryCells);
+		for (const FIntVector& Cell : QueryCells) {
+			if (const TArray<uint32>* CellItems = Cells.Find(Cell)) {
+				OutItemIds.Append(*CellItems);
+			}
+		}
+	}
+	OutItemIds.Sort();
+
+	int32 NumUnique = 0;
+	uint32 LastItemId = 0;
+	for (int32 Index = 0; Index < OutItemIds.Num(); Index++) {
+		const uint32 ItemId = OutItemIds[Index];
+		if ((Index > 0 && ItemId == LastItemId) || ItemId == InIgnoredItemId) {
+			continue;
+		}
+		LastItemId = ItemId;
+
+		const FItem& Item = Items.FindChecked(ItemId);
+		bool bTouching = false;
+		for (const FConstructionSystemSnapBox& Box : InBoxes) {
+			for (const FConstructionSystemSnapBox& ItemBox : Item.Boxes) {
+				if (FConstructionSystemCollision::BoxesOverlap(Box.Extent, Box.Transform, ItemBox.Extent + Tolerance, ItemBox.Transform)) {
+					bTouching = true;
+					break;
+				}
+			}
+			if (bTouching) {
+				break;
+			}
+		}
+		if (bTouching) {
+			OutItemIds[NumUnique++] = ItemId;
+		}
+	}
+	OutItemIds.SetNum(NumUnique, false);
+}
+
+const TCHAR* FConstructionSystemGeometryIndex::GetResultName(EConstructionSystemPlacementResult InResult)
+{
+	switch (InResult) {
+	case EConstructionSystemPlacementResult::Valid: return TEXT("Valid");
+	case EConstructionSystemPlacementResult::Overlapping: return TEXT("Overlapping");
+	case EConstructionSystemPlacementResult::SnapParentMissing: return TEXT("SnapParentMissing");
+	case EConstructionSystemPlacementResult::NotAttachedToSnapParent: return TEXT("NotAttachedToSnapParent");
+	case EConstructionSystemPlacementResult::GroundTooSteep: return TEXT("GroundTooSteep");
+	}
+	return TEXT("Unknown");
+}
+
+void FConstructionSystemGeometryIndex::GetCells(const FBox& InBounds, TArray<FIntVector, TInlineAllocator<8>>& OutCells) const
+{
+	OutCells.Reset();
+	const FIntVector Min(
+		FMath::FloorToInt(InBounds.Min.X / CellSize),
+		FMath::FloorToInt(InBounds.Min.Y / CellSize),
+		FMath::FloorToInt(InBounds.Min.Z / CellSize));
+	const FIntVector Max(
+		FMath::FloorToInt(InBounds.Max.X / CellSize),
+		FMath::FloorToInt(InBounds.Max.Y / CellSize),
+		FMath::FloorToInt(InBounds.Max.Z / CellSize));
+
+	for (int32 Z = Min.Z; Z <= Max.Z; Z++) {
+		for (int32 Y = Min.Y; Y <= Max.Y; Y++) {
+			for (int32 X = Min.X; X <= Max.X; X++) {
+				OutCells.Add(FIntVector(X, Y, Z));
+			}
+		}
+	}
+}
+
+bool FConstructionSystemGeometryIndex::Overlaps(const FConstructionSystemSnapBox& InQueryBox, const FConstructionSystemSnapBox& InBuiltBox)
+{
+	const FVector ShrunkExtent = (InQueryBox.Extent - FVector(OverlapShrinkAmount)).ComponentMax(FVector::ZeroVector);
+	if (!FConstructionSystemCollision::BoxesOverlap(ShrunkExtent, InQueryBox.Transform, InBuiltBox.Extent, InBuiltBox.Transform)) {
+		return false;
+	}
+	return FConstructionSystemCollision::SnapBoxesCollide(InQueryBox.Type, InQueryBox.Extent, InQueryBox.Transform, InBuiltBox.Type, InBuiltBox.Extent, InBuiltBox.Transform);
+}
+
+///////////////////////////////// FConstructionSystemPlacementTrace /////////////////////////////////
+
+void FConstructionSystemPlacementTrace::FEntry::Serialize(FArchive& Ar)
+{
+	uint8 TypeValue = static_cast<uint8>(Type);
+	uint8 ResultValue = static_cast<uint8>(Result);
+	Ar << TypeValue;
+	Ar << ItemId;
+	Ar << Query;
+	Ar << ExtraBoxes;
+	Ar << ResultValue;
+	Type = static_cast<EEntryType>(TypeValue);
+	Result = static_cast<EConstructionSystemPlacementResult>(ResultValue);
+}
+
+void FConstructionSystemPlacementTrace::RecordAddItem(uint32 InItemId, TArrayView<const FConstructionSystemSnapBox> InBoxes)
+{
+	FEntry& Entry = Entries.AddDefaulted_GetRef();
+	Entry.Type = EEntryType::AddItem;
+	Entry.ItemId = InItemId;
+	Entry.Query.Boxes.Append(InBoxes.GetData(), InBoxes.Num());
+}
+
+void FConstructionSystemPlacementTrace::RecordRemoveItem(uint32 InItemId)
+{
+	FEntry& Entry = Entries.AddDefaulted_GetRef();
+	Entry.Type = EEntryType::RemoveItem;
+	Entry.ItemId = InItemId;
+}
+
+void FConstructionSystemPlacementTrace::RecordQuery(const FConstructionSystemPlacementQuery& InQuery, TArrayView<const FConstructionSystemSnapBox> InExtraBoxes, EConstructionSystemPlacementResult InResult)
+{
+	FEntry& Entry = Entries.AddDefaulted_GetRef();
+	Entry.Type = EEntryType::Query;
+	Entry.Query = InQuery;
+	Entry.ExtraBoxes.Append(InExtraBoxes.GetData(), InExtraBoxes.Num());
+	Entry.Result = InResult;
+}
+
+bool FConstructionSystemPlacementTrace::SaveToFile(const FString& InPath) const
+{
+	TArray<uint8> Data;
+	FMemoryWriter Writer(Data);
+
+	uint32 Magic = PlacementTraceMagic;
+	int32 Version = PlacementTraceVersion;
+	int32 NumEntries = Entries.Num();
+	Writer << Magic;
+	Writer << Version;
+	Writer << NumEntries;
+	for (const FEntry& Entry : Entries) {
+		const_cast<FEntry&>(Entry).Serialize(Writer);
+	}
+	return FFileHelper::SaveArrayToFile(Data, *InPath);
+}
+
+bool FConstructionSystemPlacementTrace::LoadFromFile(const FString& InPath)
+{
+	TArray<uint8> Data;
+	if (!FFileHelper::LoadFileToArray(Data, *InPath)) {
+		return false;
+	}
+
+	FMemoryReader Reader(Data);
+	uint32 Magic = 0;
+	int32 Version = 0;
+	int32 NumEntries = 0;
+	Reader << Magic;
+	Reader << Version;
+	Reader << NumEntries;
+	if (Magic != PlacementTraceMagic || Version != PlacementTraceVersion || NumEntries < 0) {
+		UE_LOG(LogConstructionGeometry, Error, TEXT("%s is not a placement trace, or was written by another version"), *InPath);
+		return false;
+	}
+
+	Entries.Reset(NumEntries);
+	for (int32 Index = 0; Index < NumEntries && !Reader.IsError(); Index++) {
+		Entries.AddDefaulted_GetRef().Serialize(Reader);
+	}
+	if (Reader.IsError()) {
+		UE_LOG(LogConstructionGeometry, Error, TEXT("The placement trace %s is truncated"), *InPath);
+		Entries.Reset();
+		return false;
+	}
+	return true;
+}
+
+int32 FConstructionSystemPlacementTrace::Replay(TArray<int32>* OutMismatchedEntries) const
+{
+	FConstructionSystemGeometryIndex Index;
+	int32 NumMismatches = 0;
+	for (int32 EntryIndex = 0; EntryIndex < Entries.Num(); EntryIndex++) {
+		const FEntry& Entry = Entries[EntryIndex];
+		if (Entry.Type == EEntryType::AddItem) {
+			Index.AddItem(Entry.ItemId, Entry.Query.Boxes);
+		}
+		else if (Entry.Type == EEntryType::RemoveItem) {
+			Index.RemoveItem(Entry.ItemId);
+		}
+		else {
+			const EConstructionSystemPlacementResult Result = Index.ValidatePlacement(Entry.Query, Entry.ExtraBoxes);
+			if (Result != Entry.Result) {
+				NumMismatches++;
+				if (OutMismatchedEntries) {
+					OutMismatchedEntries->Add(EntryIndex);
+				}
+				UE_LOG(LogConstructionGeometry, Verbose, TEXT("Trace entry %d: recorded %s, replayed %s"), EntryIndex,
+					FConstructionSystemGeometryIndex::GetResultName(Entry.Result), FConstructionSystemGeometryIndex::GetResultName(Result));
+			}
+		}
+	}
+	return NumMismatches;
+}
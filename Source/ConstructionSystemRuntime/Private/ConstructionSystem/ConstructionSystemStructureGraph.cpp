@@ -0,0 +1,197 @@
+//$ Copyright 2015-23, Code Respawn Technologies Pvt Ltd - All Rights Reserved $//
+
+#include "ConstructionSystem/ConstructionSystemStructureGraph.h"
+
+///////////////////////////////// FConstructionSystemStructureGraph /////////////////////////////////
+
+void FConstructionSystemStructureGraph::AddItem(uint32 InItemId, bool bInGrounded)
+{
+	FNode& Node = Nodes.FindOrAdd(InItemId);
+	Node.bGrounded = bInGrounded;
+}
+
+void FConstructionSystemStructureGraph::RemoveItem(uint32 InItemId, TArray<uint32>* OutNeighbors)
+{
+	FNode Node;
+	if (!Nodes.RemoveAndCopyValue(InItemId, Node)) {
+		return;
+	}
+
+	for (uint32 NeighborId : Node.Neighbors) {
+		if (FNode* Neighbor = Nodes.Find(NeighborId)) {
+			Neighbor->Neighbors.RemoveSingleSwap(InItemId);
+			if (OutNeighbors) {
+				OutNeighbors->Add(NeighborId);
+			}
+		}
+	}
+}
+
+void FConstructionSystemStructureGraph::Connect(uint32 InItemA, uint32 InItemB)
+{
+	FNode* NodeA = Nodes.Find(InItemA);
+	FNode* NodeB = Nodes.Find(InItemB);
+	if (InItemA != InItemB && NodeA && NodeB) {
+		NodeA->Neighbors.AddUnique(InItemB);
+		NodeB->Neighbors.AddUnique(InItemA);
+	}
+}
+
+void FConstructionSystemStructureGraph::Disconnect(uint32 InItemA, uint32 InItemB)
+{
+	if (FNode* NodeA = Nodes.Find(InItemA)) {
+		NodeA->Neighbors.RemoveSingleSwap(InItemB);
+	}
+	if (FNode* NodeB = Nodes.Find(InItemB)) {
+		NodeB->Neighbors.RemoveSingleSwap(InItemA);
+	}
+}
+
+bool FConstructionSystemStructureGraph::IsGrounded(uint32 InItemId) const
+{
+	const FNode* Node = Nodes.Find(InItemId);
+	return Node && Node->bGrounded;
+}
+
+void FConstructionSystemStructureGraph::SetGrounded(uint32 InItemId, bool bInGrounded)
+{
+	if (FNode* Node = Nodes.Find(InItemId)) {
+		Node->bGrounded = bInGrounded;
+	}
+}
+
+const FConstructionSystemStructureGraph::FNeighborList* FConstructionSystemStructureGraph::GetNeighbors(uint32 InItemId) const
+{
+	const FNode* Node = Nodes.Find(InItemId);
+	return Node ? &Node->Neighbors : nullptr;
+}
+
+void FConstructionSystemStructureGraph::GetConnectedItems(uint32 InItemId, TArray<uint32>& OutItems) const
+{
+	OutItems.Reset();
+	if (!Nodes.Contains(InItemId)) {
+		return;
+	}
+
+	TSet<uint32> Visited;
+	Visited.Add(InItemId);
+	OutItems.Add(InItemId);
+	for (int32 Head = 0; Head < OutItems.Num(); Head++) {
+		const FNode& Node = Nodes.FindChecked(OutItems[Head]);
+		for (uint32 NeighborId : Node.Neighbors) {
+			bool bAlreadyVisited = false;
+			Visited.Add(NeighborId, &bAlreadyVisited);
+			if (!bAlreadyVisited) {
+				OutItems.Add(NeighborId);
+			}
+		}
+	}
+}
+
+void FConstructionSystemStructureGraph::FindUnsupportedItems(TArrayView<const uint32> InSeeds, TArray<uint32>& OutUnsupportedItems) const
+{
+	FConstructionSystemSupportQuery Query(*this, InSeeds);
+	Query.Step();
+	Query.GetUnsupportedItems(OutUnsupportedItems);
+}
+
+///////////////////////////////// FConstructionSystemSupportQuery /////////////////////////////////
+
+FConstructionSystemSupportQuery::FConstructionSystemSupportQuery(const FConstructionSystemStructureGraph& InGraph, TArrayView<const uint32> InSeeds)
+	: Graph(&InGraph)
+{
+	for (uint32 SeedId : InSeeds) {
+		if (!Graph->Contains(SeedId) || VisitedBy.Contains(SeedId)) {
+			continue;
+		}
+
+		const int32 SearchIndex = Searches.AddDefaulted();
+		FSearch& Search = Searches[SearchIndex];
+		Search.Queue.Add(SeedId);
+		VisitedBy.Add(SeedId, SearchIndex);
+		if (Graph->IsGrounded(SeedId)) {
+			Search.State = ESearchState::Supported;
+		}
+	}
+}
+
+bool FConstructionSystemSupportQuery::Step(int32 InMaxVisits)
+{
+	int32 NumVisits = 0;
+	while (!bComplete && NumVisits < InMaxVisits) {
+		bool bAnyActive = false;
+		for (int32 SearchIndex = 0; SearchIndex < Searches.Num() && NumVisits < InMaxVisits; SearchIndex++) {
+			const FSearch& Search = Searches[SearchIndex];
+			if (Search.MergedInto == INDEX_NONE && Search.State == ESearchState::Active) {
+				bAnyActive = true;
+				ExpandNext(SearchIndex);
+				NumVisits++;
+				NumExpanded++;
+			}
+		}
+		bComplete = !bAnyActive;
+	}
+	return bComplete;
+}
+
+int32 FConstructionSystemSupportQuery::ResolveSearch(int32 InSearchIndex) const
+{
+	while (Searches[InSearchIndex].MergedInto != INDEX_NONE) {
+		InSearchIndex = Searches[InSearchIndex].MergedInto;
+	}
+	return InSearchIndex;
+}
+
+void FConstructionSystemSupportQuery::ExpandNext(int32 InSearchIndex)
+{
+	FSearch& Search = Searches[InSearchIndex];
+	if (Search.Head >= Search.Queue.Num()) {
+		// Walked the whole island without finding the ground
+		Search.State = ESearchState::Unsupported;
+		return;
+	}
+
+	const uint32 ItemId = Search.Queue[Search.Head++];
+	const FConstructionSystemStructureGraph::FNeighborList* Neighbors = Graph->GetNeighbors(ItemId);
+	if (!Neighbors) {
+		return;
+	}
+
+	for (uint32 NeighborId : *Neighbors) {
+		if (const int32* OwnerPtr = VisitedBy.Find(NeighborId)) {
+			const int32 Owner = ResolveSearch(*OwnerPtr);
+			if (Owner != InSearchIndex) {
+				// Same island as another search. Hand the pieces left to expand (this one included) over to it and share its result
+				FSearch& OwnerSearch = Searches[Owner];
+				if (OwnerSearch.State == ESearchState::Active) {
+					const int32 FirstPending = Search.Head - 1;
+					OwnerSearch.Queue.Append(Search.Queue.GetData() + FirstPending, Search.Queue.Num() - FirstPending);
+				}
+				Search.MergedInto = Owner;
+				return;
+			}
+			continue;
+		}
+
+		VisitedBy.Add(NeighborId, InSearchIndex);
+		Search.Queue.Add(NeighborId);
+		if (Graph->IsGrounded(NeighborId)) {
+			Search.State = ESearchState::Supported;
+			return;
+		}
+	}
+}
+
+void FConstructionSystemSupportQuery::GetUnsupportedItems(TArray<uint32>& OutItems) const
+{
+	OutItems.Reset();
+	if (!bComplete) {
+		return;
+	}
+
+	for (const auto& Entry : VisitedBy) {
+		if (Searches[ResolveSearch(Entry.Value)].State == ESearchState::Unsupported && Graph->Contains(Entry.Key)) {
+			OutItems.Add(Entry.Key);
+		}
+	}
+}
@@ -0,0 +1,149 @@
+//$ Copyright 2015-23, Code Respawn Technologies Pvt Ltd - All Rights Reserved $//
+
+#include "ConstructionSystem/Net/ConstructionSystemNetCell.h"
+
+#include "Asset/PrefabricatorAsset.h"
+#include "ConstructionSystem/Net/ConstructionSystemNetSubsystem.h"
+#include "Prefab/PrefabActor.h"
+#include "Utils/ConstructionSystemUtils.h"
+
+#include "Components/SceneComponent.h"
+#include "Engine/World.h"
+#include "Net/UnrealNetwork.h"
+
+AConstructionSystemNetCell::AConstructionSystemNetCell()
+{
+	PrimaryActorTick.bCanEverTick = false;
+	bReplicates = true;
+	bAlwaysRelevant = false;
+	SetReplicatingMovement(false);
+
+	// The pieces are sent as deltas when they change, there is nothing to poll every frame
+	NetUpdateFrequency = 10.0f;
+
+	// The relevancy is tested against the location of the cell
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+}
+
+void AConstructionSystemNetCell::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(AConstructionSystemNetCell, Palette);
+	DOREPLIFETIME(AConstructionSystemNetCell, ReplicatedItems);
+}
+
+void AConstructionSystemNetCell::PostInitializeComponents()
+{
+	Super::PostInitializeComponents();
+
+	ReplicatedItems.OwnerCell = this;
+}
+
+void AConstructionSystemNetCell::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (!HasAuthority()) {
+		// The cell is no longer relevant to this client. Release the local copies of its pieces
+		UConstructionSystemNetSubsystem* NetSubsystem = GetWorld() ? GetWorld()->GetSubsystem<UConstructionSystemNetSubsystem>() : nullptr;
+		for (const auto& Entry : LocalItems) {
+			if (NetSubsystem) {
+				NetSubsystem->UnregisterItem(Entry.Key);
+			}
+			if (APrefabActor* LocalItem = Entry.Value.Get()) {
+				LocalItem->Destroy();
+			}
+		}
+		LocalItems.Reset();
+		PendingItems.Reset();
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+int32 AConstructionSystemNetCell::FindOrAddPaletteIndex(UPrefabricatorAssetInterface* InPrefab)
+{
+	int32 PaletteIndex = Palette.Find(InPrefab);
+	if (PaletteIndex == INDEX_NONE) {
+		PaletteIndex = Palette.Add(InPrefab);
+	}
+	return PaletteIndex;
+}
+
+UPrefabricatorAssetInterface* AConstructionSystemNetCell::GetPaletteAsset(int32 InPaletteIndex) const
+{
+	return Palette.IsValidIndex(InPaletteIndex) ? Palette[InPaletteIndex] : nullptr;
+}
+
+void AConstructionSystemNetCell::AddItem(const FConstructionSystemReplicatedItem& InItem)
+{
+	FConstructionSystemReplicatedItem& NewItem = ReplicatedItems.Items.Add_GetRef(InItem);
+	ReplicatedItems.MarkItemDirty(NewItem);
+}
+
+bool AConstructionSystemNetCell::RemoveItem(uint32 InItemId)
+{
+	const int32 Index = ReplicatedItems.Items.IndexOfByPredicate([InItemId](const FConstructionSystemReplicatedItem& Item) {
+		return Item.ItemId == InItemId;
+	});
+	if (Index == INDEX_NONE) {
+		return false;
+	}
+
+	ReplicatedItems.Items.RemoveAtSwap(Index);
+	ReplicatedItems.MarkArrayDirty();
+	return true;
+}
+
+void AConstructionSystemNetCell::HandleItemAdded(const FConstructionSystemReplicatedItem& InItem)
+{
+	if (!GetPaletteAsset(InItem.PaletteIndex)) {
+		// The palette is replicated separately and can arrive after the item
+		PendingItems.Add(InItem);
+		return;
+	}
+	BuildLocalItem(InItem);
+}
+
+void AConstructionSystemNetCell::HandleItemRemoved(const FConstructionSystemReplicatedItem& InItem)
+{
+	PendingItems.RemoveAll([&InItem](const FConstructionSystemReplicatedItem& Item) {
+		return Item.ItemId == InItem.ItemId;
+	});
+
+	TWeakObjectPtr<APrefabActor> LocalItem;
+	if (LocalItems.RemoveAndCopyValue(InItem.ItemId, LocalItem)) {
+		if (UConstructionSystemNetSubsystem* NetSubsystem = GetWorld()->GetSubsystem<UConstructionSystemNetSubsystem>()) {
+			NetSubsystem->UnregisterItem(InItem.ItemId);
+		}
+		if (LocalItem.IsValid()) {
+			LocalItem->Destroy();
+		}
+	}
+}
+
+void AConstructionSystemNetCell::OnRep_Palette()
+{
+	TArray<FConstructionSystemReplicatedItem> ItemsToBuild = MoveTemp(PendingItems);
+	for (const FConstructionSystemReplicatedItem& Item : ItemsToBuild) {
+		HandleItemAdded(Item);
+	}
+}
+
+void AConstructionSystemNetCell::BuildLocalItem(const FConstructionSystemReplicatedItem& InItem)
+{
+	UWorld* World = GetWorld();
+	UPrefabricatorAssetInterface* Prefab = GetPaletteAsset(InItem.PaletteIndex);
+	if (!World || !Prefab || LocalItems.Contains(InItem.ItemId)) {
+		return;
+	}
+
+	UConstructionSystemNetSubsystem* NetSubsystem = World->GetSubsystem<UConstructionSystemNetSubsystem>();
+	const bool bDeferBuild = NetSubsystem && NetSubsystem->ShouldDeferBuild(Prefab, InItem.Placement.Seed);
+	APrefabActor* LocalItem = FConstructionSystemUtils::ConstructPrefabItem(World, Prefab, InItem.Placement.GetTransform(), InItem.Placement.Seed, InItem.ItemId, bDeferBuild);
+	if (LocalItem) {
+		LocalItems.Add(InItem.ItemId, LocalItem);
+		if (NetSubsystem) {
+			NetSubsystem->RegisterItem(InItem.ItemId, LocalItem, InItem.SnapParentId);
+		}
+	}
+}
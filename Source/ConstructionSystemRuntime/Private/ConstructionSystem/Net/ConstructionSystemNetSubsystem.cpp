@@ -0,0 +1,698 @@
+//$ Copyright 2015-23, Code Respawn Technologies Pvt Ltd - All Rights Reserved $//
+
+#include "ConstructionSystem/Net/ConstructionSystemNetSubsystem.h"
+
+#include "Asset/PrefabricatorAsset.h"
+#include "ConstructionSystem/Net/ConstructionSystemNetCell.h"
+#include "ConstructionSystemComponent.h"
+#include "Prefab/PrefabActor.h"
+#include "Prefab/PrefabComponent.h"
+#include "Utils/ConstructionSystemStats.h"
+#include "Utils/ConstructionSystemUtils.h"
+
+#include "Engine/World.h"
+#include "GameFramework/Controller.h"
+#include "GameFramework/Pawn.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/DateTime.h"
+#include "Misc/Paths.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogConstructionNet, Log, All);
+
+namespace
+{
+	const TCHAR* GetCommandTypeName(EConstructionSystemCommandType InType)
+	{
+		return InType == EConstructionSystemCommandType::Build ? TEXT("Build") : TEXT("Remove");
+	}
+
+	FString GetPlacementTracePath(const FString& InName)
+	{
+		if (FPaths::FileExists(InName)) {
+			return InName;
+		}
+		return FPaths::ProjectSavedDir() / TEXT("ConstructionSystem") / TEXT("Traces") / (InName + TEXT(".cstrace"));
+	}
+
+	FAutoConsoleCommand RecordPlacementTraceCommand(
+		TEXT("ConstructionSystem.Geometry.RecordTrace"),
+		TEXT("Starts (1) or stops (0) recording the placement checks of the construction geometry index. Usage: ConstructionSystem.Geometry.RecordTrace <0|1>"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World) {
+			if (UConstructionSystemNetSubsystem* NetSubsystem = World ? World->GetSubsystem<UConstructionSystemNetSubsystem>() : nullptr) {
+				NetSubsystem->SetRecordPlacementTrace(Args.Num() == 0 || FCString::Atoi(*Args[0]) != 0);
+			}
+		}));
+
+	FAutoConsoleCommand SavePlacementTraceCommand(
+		TEXT("ConstructionSystem.Geometry.SaveTrace"),
+		TEXT("Writes the recorded placement trace to Saved/ConstructionSystem/Traces. Usage: ConstructionSystem.Geometry.SaveTrace [Name]"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World) {
+			UConstructionSystemNetSubsystem* NetSubsystem = World ? World->GetSubsystem<UConstructionSystemNetSubsystem>() : nullptr;
+			const FConstructionSystemPlacementTrace* Trace = NetSubsystem ? NetSubsystem->GetPlacementTrace() : nullptr;
+			if (!Trace) {
+				UE_LOG(LogConstructionNet, Warning, TEXT("No placement trace is recorded, start one with ConstructionSystem.Geometry.RecordTrace 1"));
+				return;
+			}
+
+			const FString Name = Args.Num() > 0 ? Args[0] : FString::Printf(TEXT("PlacementTrace_%s"), *FDateTime::Now().ToString());
+			const FString Path = GetPlacementTracePath(Name);
+			if (Trace->SaveToFile(Path)) {
+				UE_LOG(LogConstructionNet, Log, TEXT("Placement trace (%d entries) written to %s"), Trace->Num(), *Path);
+			}
+			else {
+				UE_LOG(LogConstructionNet, Error, TEXT("Cannot write the placement trace to %s"), *Path);
+			}
+		}));
+
+	FAutoConsoleCommand ReplayPlacementTraceCommand(
+		TEXT("ConstructionSystem.Geometry.ReplayTrace"),
+		TEXT("Replays a saved placement trace on a fresh geometry index and reports the checks whose result changed. Usage: ConstructionSystem.Geometry.ReplayTrace <Name|Path>"),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args) {
+			if (Args.Num() == 0) {
+				UE_LOG(LogConstructionNet, Warning, TEXT("Usage: ConstructionSystem.Geometry.ReplayTrace <Name|Path>"));
+				return;
+			}
+
+			FConstructionSystemPlacementTrace Trace;
+			const FString Path = GetPlacementTracePath(Args[0]);
+			if (!Trace.LoadFromFile(Path)) {
+				UE_LOG(LogConstructionNet, Error, TEXT("Cannot load the placement trace %s"), *Path);
+				return;
+			}
+
+			const double StartTime = FPlatformTime::Seconds();
+			const int32 NumMismatches = Trace.Replay();
+			const double ElapsedMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+			UE_LOG(LogConstructionNet, Log, TEXT("Replayed %d trace entries in %.2f ms, %d checks changed their result"), Trace.Num(), ElapsedMs, NumMismatches);
+		}));
+}
+
+void UConstructionSystemNetSubsystem::Deinitialize()
+{
+	Items.Reset();
+	PlacementToItem.Reset();
+	Cells.Reset();
+	SupportQueries.Reset();
+	StructureGraph.Reset();
+	GeometryIndex.Reset();
+	SnapBoxTemplates.Reset();
+	PlacementTrace.Reset();
+	PendingSnapEdges.Reset();
+
+	Super::Deinitialize();
+}
+
+TStatId UConstructionSystemNetSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UConstructionSystemNetSubsystem, STATGROUP_Tickables);
+}
+
+void UConstructionSystemNetSubsystem::Tick(float DeltaTime)
+{
+	if (SupportQueries.Num() == 0) {
+		return;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_ConstructionStructure_SupportCheck);
+	int32 VisitBudget = MaxSupportVisitsPerFrame;
+	while (SupportQueries.Num() > 0 && VisitBudget > 0) {
+		FConstructionSystemSupportQuery& Query = SupportQueries[0];
+		const int32 NumExpandedBefore = Query.GetNumExpanded();
+		const bool bComplete = Query.Step(VisitBudget);
+		const int32 NumExpanded = Query.GetNumExpanded() - NumExpandedBefore;
+		VisitBudget -= FMath::Max(NumExpanded, 1);
+		INC_DWORD_STAT_BY(STAT_ConstructionStructure_NumVisited, NumExpanded);
+		if (!bComplete) {
+			break;
+		}
+
+		// Collapsing can start follow up checks, so take the query out of the queue first
+		FConstructionSystemSupportQuery CompletedQuery = MoveTemp(SupportQueries[0]);
+		SupportQueries.RemoveAt(0);
+		CollapseUnsupportedItems(CompletedQuery);
+	}
+	SET_DWORD_STAT(STAT_ConstructionStructure_NumPendingChecks, SupportQueries.Num());
+}
+
+uint32 UConstructionSystemNetSubsystem::GetItemId(const AActor* InPrefabActor)
+{
+	USceneComponent* Root = InPrefabActor ? InPrefabActor->GetRootComponent() : nullptr;
+	UConstructionSystemItemUserData* UserData = Root ? Cast<UConstructionSystemItemUserData>(Root->GetAssetUserDataOfClass(UConstructionSystemItemUserData::StaticClass())) : nullptr;
+	return UserData ? UserData->ItemId : 0;
+}
+
+FIntVector4 UConstructionSystemNetSubsystem::GetPlacementKey(const FVector& InLocation, const FRotator& InRotation)
+{
+	auto QuantizeAxis = [](double InDegrees) -> int32 {
+		const int32 Degrees = FMath::RoundToInt(FRotator::ClampAxis(InDegrees));
+		return Degrees % 360;
+	};
+	const int32 PackedRotation = QuantizeAxis(InRotation.Yaw) | (QuantizeAxis(InRotation.Pitch) << 9) | (QuantizeAxis(InRotation.Roll) << 18);
+	return FIntVector4(FMath::RoundToInt(InLocation.X), FMath::RoundToInt(InLocation.Y), FMath::RoundToInt(InLocation.Z), PackedRotation);
+}
+
+int32 UConstructionSystemNetSubsystem::ExecuteCommands(TArrayView<const FConstructionSystemCommandRecord> InRecords, TArrayView<UPrefabricatorAssetInterface* const> InBuildablePrefabs, AController* InInstigator)
+{
+	SCOPE_CYCLE_COUNTER(STAT_ConstructionNet_ExecuteCommands);
+	INC_DWORD_STAT_BY(STAT_ConstructionNet_NumRecords, InRecords.Num());
+
+	FVector InstigatorLocation = FVector::ZeroVector;
+	const FVector* InstigatorLocationPtr = nullptr;
+	if (const APawn* InstigatorPawn = InInstigator ? InInstigator->GetPawn() : nullptr) {
+		InstigatorLocation = InstigatorPawn->GetActorLocation();
+		InstigatorLocationPtr = &InstigatorLocation;
+	}
+
+	// Validate the whole batch before touching the world, so the records of the batch are checked against each other too
+	TBitArray<> ValidRecords(false, InRecords.Num());
+	{
+		SCOPE_CYCLE_COUNTER(STAT_ConstructionNet_Validate);
+		TSet<TTuple<FIntVector4, UPrefabricatorAssetInterface*>> BatchPlacements;
+		// The snap boxes of the pieces accepted earlier in the batch, hashed so a large batch is not checked in quadratic time
+		FConstructionSystemGeometryIndex BatchGeometry;
+		TSet<uint32> BatchRemovals;
+		for (int32 Index = 0; Index < InRecords.Num(); Index++) {
+			const FConstructionSystemCommandRecord& Record = InRecords[Index];
+			FString Reason;
+			bool bValid = false;
+			if (Record.Type == EConstructionSystemCommandType::Build) {
+				UPrefabricatorAssetInterface* Prefab = InBuildablePrefabs.IsValidIndex(Record.AssetIndex) ? InBuildablePrefabs[Record.AssetIndex] : nullptr;
+
+				// A piece snapped to a piece of the same batch (e.g. a line of walls) is only valid if that piece is
+				const FVector* BatchSnapParentLocation = nullptr;
+				if (Record.IsSnappedToBatchRecord()) {
+					const int32 ParentIndex = Record.SnapParentRecordIndex;
+					if (ParentIndex < Index && ValidRecords[ParentIndex] && InRecords[ParentIndex].Type == EConstructionSystemCommandType::Build) {
+						BatchSnapParentLocation = &InRecords[ParentIndex].Placement.Location;
+					}
+				}
+				// The first piece of an asset has no snap boxes to check against yet
+				if (Prefab && bValidatePlacementGeometry) {
+					LearnSnapBoxTemplate(Prefab, Record.Placement.Seed);
+				}
+				bValid = ValidateBuild(Record, Prefab, InstigatorLocationPtr, BatchSnapParentLocation, BatchPlacements, BatchRemovals, BatchGeometry, Reason);
+				if (bValid) {
+					BatchPlacements.Add(MakeTuple(GetPlacementKey(Record.Placement.Location, Record.Placement.Rotation), Prefab));
+				}
+			}
+			else if (BatchRemovals.Contains(Record.ItemId)) {
+				Reason = TEXT("Removed twice in the same batch");
+			}
+			else {
+				bValid = ValidateRemove(Record, InstigatorLocationPtr, Reason);
+				if (bValid) {
+					BatchRemovals.Add(Record.ItemId);
+				}
+			}
+
+			if (!bValid) {
+				INC_DWORD_STAT(STAT_ConstructionNet_NumRejected);
+				UE_LOG(LogConstructionNet, Verbose, TEXT("Rejected %s record from %s: %s"), GetCommandTypeName(Record.Type), *GetNameSafe(InInstigator), *Reason);
+			}
+			ValidRecords[Index] = bValid;
+		}
+	}
+
+	// Item ids assigned to the build records, for the records snapped to them
+	TArray<uint32> BuiltItemIds;
+	BuiltItemIds.SetNumZeroed(InRecords.Num());
+
+	int32 NumApplied = 0;
+	for (int32 Index = 0; Index < InRecords.Num(); Index++) {
+		if (!ValidRecords[Index]) {
+			continue;
+		}
+
+		const FConstructionSystemCommandRecord& Record = InRecords[Index];
+		bool bApplied = false;
+		if (Record.Type == EConstructionSystemCommandType::Build) {
+			const uint32 SnapParentId = Record.IsSnappedToBatchRecord() ? BuiltItemIds[Record.SnapParentRecordIndex] : Record.SnapParentId;
+			APrefabActor* ItemActor = ConstructItem(InBuildablePrefabs[Record.AssetIndex], Record.Placement, SnapParentId);
+			BuiltItemIds[Index] = GetItemId(ItemActor);
+			bApplied = ItemActor != nullptr;
+		}
+		else {
+			bApplied = RemoveItem(Record.ItemId);
+		}
+		if (bApplied) {
+			NumApplied++;
+		}
+	}
+	return NumApplied;
+}
+
+bool UConstructionSystemNetSubsystem::ValidateBuild(const FConstructionSystemCommandRecord& InRecord, UPrefabricatorAssetInterface* InPrefab, const FVector* InInstigatorLocation,
+		const FVector* InBatchSnapParentLocation, const TSet<TTuple<FIntVector4, UPrefabricatorAssetInterface*>>& InBatchPlacements,
+		const TSet<uint32>& InBatchRemovals, FConstructionSystemGeometryIndex& InOutBatchGeometry, FString& OutReason) const
+{
+	if (!InPrefab) {
+		OutReason = FString::Printf(TEXT("Asset index %d is not buildable"), InRecord.AssetIndex);
+		return false;
+	}
+
+	const FVector Location = InRecord.Placement.Location;
+	if (Location.ContainsNaN() || InRecord.Placement.Rotation.ContainsNaN()) {
+		OutReason = TEXT("Invalid placement");
+		return false;
+	}
+
+	if (InInstigatorLocation && FVector::DistSquared(*InInstigatorLocation, Location) > FMath::Square(MaxBuildDistance)) {
+		OutReason = TEXT("Out of reach");
+		return false;
+	}
+
+	if (InRecord.IsSnappedToBatchRecord()) {
+		if (!InBatchSnapParentLocation) {
+			OutReason = FString::Printf(TEXT("Snapped to the rejected record %d"), InRecord.SnapParentRecordIndex);
+			return false;
+		}
+		if (FVector::DistSquared(*InBatchSnapParentLocation, Location) > FMath::Square(MaxSnapParentDistance)) {
+			OutReason = FString::Printf(TEXT("Too far from the snap parent record %d"), InRecord.SnapParentRecordIndex);
+			return false;
+		}
+	}
+	else if (InRecord.SnapParentId != 0) {
+		if (InBatchRemovals.Contains(InRecord.SnapParentId)) {
+			OutReason = FString::Printf(TEXT("Snap parent %u is removed earlier in the batch"), InRecord.SnapParentId);
+			return false;
+		}
+
+		const FItemEntry* SnapParent = Items.Find(InRecord.SnapParentId);
+		const APrefabActor* SnapParentActor = SnapParent ? SnapParent->Actor.Get() : nullptr;
+		if (!SnapParentActor) {
+			OutReason = FString::Printf(TEXT("Snap parent %u does not exist"), InRecord.SnapParentId);
+			return false;
+		}
+		if (FVector::DistSquared(SnapParentActor->GetActorLocation(), Location) > FMath::Square(MaxSnapParentDistance)) {
+			OutReason = FString::Printf(TEXT("Too far from the snap parent %u"), InRecord.SnapParentId);
+			return false;
+		}
+	}
+
+	const TTuple<FIntVector4, UPrefabricatorAssetInterface*> PlacementKey = MakeTuple(GetPlacementKey(Location, InRecord.Placement.Rotation), InPrefab);
+	// The records are applied in order, so a piece removed earlier in the batch frees its spot
+	const uint32* ExistingItemId = PlacementToItem.Find(PlacementKey);
+	if ((ExistingItemId && !InBatchRemovals.Contains(*ExistingItemId)) || InBatchPlacements.Contains(PlacementKey)) {
+		OutReason = TEXT("The spot is already taken");
+		return false;
+	}
+
+	if (bValidatePlacementGeometry) {
+		// Checked against the quantized placement the piece will be built from
+		FConstructionSystemPlacement Placement = InRecord.Placement;
+		Placement.Quantize();
+
+		FConstructionSystemPlacementQuery Query;
+		if (GetPlacementBoxes(InPrefab, Placement.Seed, Placement.GetTransform(), Query.Boxes)) {
+			// A snap parent of the same batch is not in the index yet, and a parent without snap boxes never is.
+			// Their existence and distance were checked above
+			if (!InRecord.IsSnappedToBatchRecord() && GeometryIndex.Contains(InRecord.SnapParentId)) {
+				Query.SnapParentId = InRecord.SnapParentId;
+			}
+			Query.IgnoredItemIds = InBatchRemovals.Array();
+
+			// Only the batch pieces around the placement can overlap it
+			FBox QueryBounds(EForceInit::ForceInit);
+			for (const FConstructionSystemSnapBox& QueryBox : Query.Boxes) {
+				QueryBounds += QueryBox.GetBounds();
+			}
+			TArray<FConstructionSystemSnapBox> NearbyBatchBoxes;
+			InOutBatchGeometry.GetBoxes(QueryBounds, NearbyBatchBoxes);
+
+			// The records carry no ground normal, the slope is only checked by the build tool cursor
+			const EConstructionSystemPlacementResult Result = GeometryIndex.ValidatePlacement(Query, NearbyBatchBoxes);
+			if (bRecordingPlacementTrace) {
+				PlacementTrace->RecordQuery(Query, NearbyBatchBoxes, Result);
+			}
+			if (Result != EConstructionSystemPlacementResult::Valid) {
+				OutReason = FString::Printf(TEXT("Invalid placement geometry (%s)"), FConstructionSystemGeometryIndex::GetResultName(Result));
+				return false;
+			}
+			InOutBatchGeometry.AddItem(InOutBatchGeometry.Num() + 1, Query.Boxes);
+		}
+	}
+	return true;
+}
+
+bool UConstructionSystemNetSubsystem::ValidateRemove(const FConstructionSystemCommandRecord& InRecord, const FVector* InInstigatorLocation, FString& OutReason) const
+{
+	const FItemEntry* Entry = Items.Find(InRecord.ItemId);
+	const APrefabActor* ItemActor = Entry ? Entry->Actor.Get() : nullptr;
+	if (!ItemActor) {
+		OutReason = FString::Printf(TEXT("Item %u does not exist"), InRecord.ItemId);
+		return false;
+	}
+
+	if (InInstigatorLocation && FVector::DistSquared(*InInstigatorLocation, ItemActor->GetActorLocation()) > FMath::Square(MaxBuildDistance)) {
+		OutReason = TEXT("Out of reach");
+		return false;
+	}
+	return true;
+}
+
+APrefabActor* UConstructionSystemNetSubsystem::ConstructItem(UPrefabricatorAssetInterface* InPrefab, const FConstructionSystemPlacement& InPlacement, uint32 InSnapParentId)
+{
+	UWorld* World = GetWorld();
+	if (!World || !InPrefab) {
+		return nullptr;
+	}
+
+	// Build from the quantized placement, so the server piece matches the copies built by the clients
+	FConstructionSystemPlacement Placement = InPlacement;
+	Placement.Quantize();
+
+	const uint32 ItemId = NextItemId++;
+	APrefabActor* ItemActor = FConstructionSystemUtils::ConstructPrefabItem(World, InPrefab, Placement.GetTransform(), Placement.Seed, ItemId, ShouldDeferBuild(InPrefab, Placement.Seed));
+	if (!ItemActor) {
+		return nullptr;
+	}
+
+	FItemEntry& Entry = Items.Add(ItemId);
+	Entry.Actor = ItemActor;
+	Entry.PrefabKey = InPrefab;
+	Entry.PlacementKey = GetPlacementKey(Placement.Location, Placement.Rotation);
+	Entry.SnapParentId = InSnapParentId;
+	PlacementToItem.Add(MakeTuple(Entry.PlacementKey, InPrefab), ItemId);
+	FConstructionSystemSnapBoxList Boxes;
+	AddToGeometryIndex(ItemId, ItemActor, InPrefab, Boxes);
+	AddToStructureGraph(ItemId, InSnapParentId, Boxes);
+
+	if (World->GetNetMode() != NM_Standalone) {
+		if (AConstructionSystemNetCell* Cell = FindOrCreateCell(Placement.Location)) {
+			FConstructionSystemReplicatedItem ReplicatedItem;
+			ReplicatedItem.ItemId = ItemId;
+			ReplicatedItem.PaletteIndex = static_cast<uint16>(Cell->FindOrAddPaletteIndex(InPrefab));
+			ReplicatedItem.SnapParentId = InSnapParentId;
+			ReplicatedItem.Placement = Placement;
+			Cell->AddItem(ReplicatedItem);
+			Entry.Cell = Cell;
+		}
+	}
+
+	SET_DWORD_STAT(STAT_ConstructionNet_NumItems, Items.Num());
+	return ItemActor;
+}
+
+bool UConstructionSystemNetSubsystem::RemoveItem(uint32 InItemId)
+{
+	TArray<uint32> Neighbors;
+	if (!RemoveItemInternal(InItemId, &Neighbors)) {
+		return false;
+	}
+
+	if (bCollapseUnsupportedItems && Neighbors.Num() > 0) {
+		StartSupportCheck(Neighbors);
+	}
+	return true;
+}
+
+bool UConstructionSystemNetSubsystem::RemoveItemInternal(uint32 InItemId, TArray<uint32>* OutNeighbors)
+{
+	FItemEntry Entry;
+	if (!Items.RemoveAndCopyValue(InItemId, Entry)) {
+		return false;
+	}
+	PlacementToItem.Remove(MakeTuple(Entry.PlacementKey, Entry.PrefabKey));
+	StructureGraph.RemoveItem(InItemId, OutNeighbors);
+	RemoveFromGeometryIndex(InItemId);
+
+	if (AConstructionSystemNetCell* Cell = Entry.Cell.Get()) {
+		Cell->RemoveItem(InItemId);
+	}
+	if (APrefabActor* ItemActor = Entry.Actor.Get()) {
+		ItemActor->Destroy();
+	}
+
+	SET_DWORD_STAT(STAT_ConstructionNet_NumItems, Items.Num());
+	return true;
+}
+
+void UConstructionSystemNetSubsystem::RegisterItem(uint32 InItemId, APrefabActor* InActor, uint32 InSnapParentId)
+{
+	if (!InActor || InItemId == 0) {
+		return;
+	}
+
+	FItemEntry& Entry = Items.FindOrAdd(InItemId);
+	Entry.Actor = InActor;
+	Entry.PrefabKey = InActor->PrefabComponent ? InActor->PrefabComponent->PrefabAssetInterface.Get() : nullptr;
+	Entry.PlacementKey = GetPlacementKey(InActor->GetActorLocation(), InActor->GetActorRotation());
+	Entry.SnapParentId = InSnapParentId;
+	PlacementToItem.Add(MakeTuple(Entry.PlacementKey, Entry.PrefabKey), InItemId);
+	FConstructionSystemSnapBoxList Boxes;
+	AddToGeometryIndex(InItemId, InActor, Entry.PrefabKey, Boxes);
+	AddToStructureGraph(InItemId, InSnapParentId, Boxes);
+
+	// Connect the pieces that were waiting for this one
+	TArray<uint32> WaitingItems;
+	PendingSnapEdges.MultiFind(InItemId, WaitingItems);
+	for (uint32 WaitingItemId : WaitingItems) {
+		StructureGraph.Connect(InItemId, WaitingItemId);
+	}
+	PendingSnapEdges.Remove(InItemId);
+
+	SET_DWORD_STAT(STAT_ConstructionNet_NumItems, Items.Num());
+}
+
+void UConstructionSystemNetSubsystem::UnregisterItem(uint32 InItemId)
+{
+	FItemEntry Entry;
+	if (Items.RemoveAndCopyValue(InItemId, Entry)) {
+		PlacementToItem.Remove(MakeTuple(Entry.PlacementKey, Entry.PrefabKey));
+	}
+
+	// The connections this piece was waiting for are gone with it
+	for (auto It = PendingSnapEdges.CreateIterator(); It; ++It) {
+		if (It.Value() == InItemId) {
+			It.RemoveCurrent();
+		}
+	}
+
+	// The piece only left the relevant cells, its neighbors connect to it again once it replicates back
+	if (const FConstructionSystemStructureGraph::FNeighborList* Neighbors = StructureGraph.GetNeighbors(InItemId)) {
+		for (uint32 NeighborId : *Neighbors) {
+			PendingSnapEdges.AddUnique(InItemId, NeighborId);
+		}
+	}
+	StructureGraph.RemoveItem(InItemId);
+	RemoveFromGeometryIndex(InItemId);
+	SET_DWORD_STAT(STAT_ConstructionNet_NumItems, Items.Num());
+}
+
+uint32 UConstructionSystemNetSubsystem::FindItemAtPlacement(UPrefabricatorAssetInterface* InPrefab, const FTransform& InTransform) const
+{
+	const uint32* ItemIdPtr = PlacementToItem.Find(MakeTuple(GetPlacementKey(InTransform.GetLocation(), InTransform.Rotator()), InPrefab));
+	return ItemIdPtr ? *ItemIdPtr : 0;
+}
+
+bool UConstructionSystemNetSubsystem::ConsumeImmediateBuild()
+{
+	if (ImmediateBuildFrame != GFrameCounter) {
+		ImmediateBuildFrame = GFrameCounter;
+		NumImmediateBuildsThisFrame = 0;
+	}
+	return NumImmediateBuildsThisFrame++ < MaxImmediateBuildsPerFrame;
+}
+
+bool UConstructionSystemNetSubsystem::ShouldDeferBuild(UPrefabricatorAssetInterface* InPrefab, int32 InSeed)
+{
+	const bool bImmediate = ConsumeImmediateBuild();
+	return !bImmediate && SnapBoxTemplates.Contains(GetSnapBoxTemplateKey(InPrefab, InSeed));
+}
+
+bool UConstructionSystemNetSubsystem::GetPlacementBoxes(UPrefabricatorAssetInterface* InPrefab, int32 InSeed, const FTransform& InTransform, FConstructionSystemSnapBoxList& OutBoxes) const
+{
+	OutBoxes.Reset();
+	const TArray<FConstructionSystemSnapBox>* LocalBoxes = SnapBoxTemplates.Find(GetSnapBoxTemplateKey(InPrefab, InSeed));
+	if (!LocalBoxes || LocalBoxes->Num() == 0) {
+		return false;
+	}
+
+	const FTransform PlacementTransform(InTransform.GetRotation(), InTransform.GetLocation());
+	for (const FConstructionSystemSnapBox& LocalBox : *LocalBoxes) {
+		OutBoxes.Add(FConstructionSystemSnapBox(LocalBox.Transform * PlacementTransform, LocalBox.Extent, LocalBox.Type));
+	}
+	return true;
+}
+
+void UConstructionSystemNetSubsystem::SetRecordPlacementTrace(bool bInRecord)
+{
+	if (!bInRecord) {
+		// The recorded trace is kept, so it can still be saved
+		bRecordingPlacementTrace = false;
+		return;
+	}
+
+	// Start with the pieces that already exist, so the trace replays on its own
+	PlacementTrace = MakeUnique<FConstructionSystemPlacementTrace>();
+	bRecordingPlacementTrace = true;
+	FConstructionSystemSnapBoxList Boxes;
+	for (const auto& Entry : Items) {
+		APrefabActor* ItemActor = Entry.Value.Actor.Get();
+		if (ItemActor && GetPlacementBoxes(Entry.Value.PrefabKey, ItemActor->Seed, ItemActor->GetActorTransform(), Boxes)) {
+			PlacementTrace->RecordAddItem(Entry.Key, Boxes);
+		}
+	}
+}
+
+APrefabActor* UConstructionSystemNetSubsystem::FindItemActor(uint32 InItemId) const
+{
+	const FItemEntry* Entry = Items.Find(InItemId);
+	return Entry ? Entry->Actor.Get() : nullptr;
+}
+
+void UConstructionSystemNetSubsystem::AddToStructureGraph(uint32 InItemId, uint32 InSnapParentId, TArrayView<const FConstructionSystemSnapBox> InBoxes)
+{
+	// A piece that was not snapped to another one was placed on the world, it holds up the pieces built on it
+	StructureGraph.AddItem(InItemId, InSnapParentId == 0);
+	if (InSnapParentId != 0) {
+		if (StructureGraph.Contains(InSnapParentId)) {
+			StructureGraph.Connect(InItemId, InSnapParentId);
+		}
+		else {
+			PendingSnapEdges.AddUnique(InSnapParentId, InItemId);
+		}
+	}
+
+	// A piece is also held by everything else it rests on, not only by the piece it was snapped to
+	if (InBoxes.Num() > 0) {
+		TArray<uint32> TouchingItems;
+		GeometryIndex.FindTouchingItems(InBoxes, InItemId, TouchingItems);
+		for (uint32 TouchingItemId : TouchingItems) {
+			StructureGraph.Connect(InItemId, TouchingItemId);
+		}
+	}
+}
+
+void UConstructionSystemNetSubsystem::AddToGeometryIndex(uint32 InItemId, APrefabActor* InActor, UPrefabricatorAssetInterface* InPrefab, FConstructionSystemSnapBoxList& OutBoxes)
+{
+	OutBoxes.Reset();
+	if (!InActor || !InPrefab) {
+		return;
+	}
+
+	const FTransform ActorTransform(InActor->GetActorQuat(), InActor->GetActorLocation());
+	const FSoftObjectPath TemplateKey = GetSnapBoxTemplateKey(InPrefab, InActor->Seed);
+	if (!TemplateKey.IsNull() && !SnapBoxTemplates.Contains(TemplateKey)) {
+		// First piece of this prefab asset, it was built right away (see ShouldDeferBuild). Learn its snap boxes
+		AddSnapBoxTemplate(TemplateKey, InActor);
+	}
+
+	if (GetPlacementBoxes(InPrefab, InActor->Seed, ActorTransform, OutBoxes)) {
+		GeometryIndex.AddItem(InItemId, OutBoxes);
+		if (bRecordingPlacementTrace) {
+			PlacementTrace->RecordAddItem(InItemId, OutBoxes);
+		}
+	}
+}
+
+void UConstructionSystemNetSubsystem::AddSnapBoxTemplate(const FSoftObjectPath& InTemplateKey, APrefabActor* InActor)
+{
+	const FTransform ActorTransform(InActor->GetActorQuat(), InActor->GetActorLocation());
+	TArray<FConstructionSystemSnapBox> WorldBoxes;
+	FConstructionSystemUtils::GetSnapBoxes(InActor, WorldBoxes);
+	TArray<FConstructionSystemSnapBox>& LocalBoxes = SnapBoxTemplates.Add(InTemplateKey);
+	for (const FConstructionSystemSnapBox& WorldBox : WorldBoxes) {
+		LocalBoxes.Add(FConstructionSystemSnapBox(WorldBox.Transform.GetRelativeTransform(ActorTransform), WorldBox.Extent, WorldBox.Type));
+	}
+}
+
+void UConstructionSystemNetSubsystem::LearnSnapBoxTemplate(UPrefabricatorAssetInterface* InPrefab, int32 InSeed)
+{
+	UWorld* World = GetWorld();
+	const FSoftObjectPath TemplateKey = GetSnapBoxTemplateKey(InPrefab, InSeed);
+	if (!World || TemplateKey.IsNull() || SnapBoxTemplates.Contains(TemplateKey)) {
+		return;
+	}
+
+	// Build a probe of the asset once and read its snap boxes. It never enters the item maps or the geometry index
+	SCOPE_CYCLE_COUNTER(STAT_ConstructionNet_LearnSnapBoxes);
+	if (APrefabActor* Probe = FConstructionSystemUtils::ConstructPrefabItem(World, InPrefab, FTransform::Identity, InSeed, 0, false)) {
+		AddSnapBoxTemplate(TemplateKey, Probe);
+		Probe->Destroy();
+	}
+}
+
+FSoftObjectPath UConstructionSystemNetSubsystem::GetSnapBoxTemplateKey(UPrefabricatorAssetInterface* InPrefab, int32 InSeed)
+{
+	if (!InPrefab) {
+		return FSoftObjectPath();
+	}
+
+	FPrefabAssetSelectionConfig SelectionConfig;
+	SelectionConfig.Seed = InSeed;
+	return InPrefab->SelectPrefabAsset(SelectionConfig).ToSoftObjectPath();
+}
+
+void UConstructionSystemNetSubsystem::RemoveFromGeometryIndex(uint32 InItemId)
+{
+	if (GeometryIndex.Contains(InItemId)) {
+		GeometryIndex.RemoveItem(InItemId);
+		if (bRecordingPlacementTrace) {
+			PlacementTrace->RecordRemoveItem(InItemId);
+		}
+	}
+}
+
+void UConstructionSystemNetSubsystem::StartSupportCheck(TArrayView<const uint32> InSeeds)
+{
+	FConstructionSystemSupportQuery Query(StructureGraph, InSeeds);
+	if (SupportQueries.Num() == 0) {
+		// Most removals only walk a few pieces before reaching the ground, resolve them right away
+		SCOPE_CYCLE_COUNTER(STAT_ConstructionStructure_SupportCheck);
+		const bool bComplete = Query.Step(MaxSupportVisitsPerFrame);
+		INC_DWORD_STAT_BY(STAT_ConstructionStructure_NumVisited, Query.GetNumExpanded());
+		if (bComplete) {
+			CollapseUnsupportedItems(Query);
+			return;
+		}
+	}
+	SupportQueries.Add(MoveTemp(Query));
+	SET_DWORD_STAT(STAT_ConstructionStructure_NumPendingChecks, SupportQueries.Num());
+}
+
+void UConstructionSystemNetSubsystem::CollapseUnsupportedItems(const FConstructionSystemSupportQuery& InQuery)
+{
+	TArray<uint32> UnsupportedItems;
+	InQuery.GetUnsupportedItems(UnsupportedItems);
+	if (UnsupportedItems.Num() == 0) {
+		return;
+	}
+
+	TArray<uint32> Neighbors;
+	for (uint32 ItemId : UnsupportedItems) {
+		RemoveItemInternal(ItemId, &Neighbors);
+	}
+	INC_DWORD_STAT_BY(STAT_ConstructionStructure_NumCollapsed, UnsupportedItems.Num());
+	OnItemsCollapsed.Broadcast(UnsupportedItems);
+
+	// Pieces built on the collapsed ones after the check started were not part of it. Check them too
+	const TSet<uint32> CollapsedItems(UnsupportedItems);
+	Neighbors.RemoveAll([this, &CollapsedItems](uint32 NeighborId) {
+		return CollapsedItems.Contains(NeighborId) || !StructureGraph.Contains(NeighborId);
+	});
+	if (Neighbors.Num() > 0) {
+		StartSupportCheck(Neighbors);
+	}
+}
+
+AConstructionSystemNetCell* UConstructionSystemNetSubsystem::FindOrCreateCell(const FVector& InLocation)
+{
+	const FIntVector CellCoord(
+		FMath::FloorToInt(InLocation.X / CellSize),
+		FMath::FloorToInt(InLocation.Y / CellSize),
+		FMath::FloorToInt(InLocation.Z / CellSize));
+
+	TWeakObjectPtr<AConstructionSystemNetCell>& CellPtr = Cells.FindOrAdd(CellCoord);
+	if (!CellPtr.IsValid()) {
+		const FVector CellCenter = (FVector(CellCoord) + FVector(0.5f)) * CellSize;
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		AConstructionSystemNetCell* Cell = GetWorld()->SpawnActor<AConstructionSystemNetCell>(CellCenter, FRotator::ZeroRotator, SpawnParams);
+		if (Cell) {
+			Cell->NetCullDistanceSquared = FMath::Square(NetCullDistance);
+		}
+		CellPtr = Cell;
+	}
+	return CellPtr.Get();
+}
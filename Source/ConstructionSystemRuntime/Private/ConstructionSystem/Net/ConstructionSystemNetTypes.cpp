@@ -0,0 +1,118 @@
+//$ Copyright 2015-23, Code Respawn Technologies Pvt Ltd - All Rights Reserved $//
+
+#include "ConstructionSystem/Net/ConstructionSystemNetTypes.h"
+
+#include "ConstructionSystem/Net/ConstructionSystemNetCell.h"
+
+///////////////////////////////// FConstructionSystemPlacement /////////////////////////////////
+
+FConstructionSystemPlacement::FConstructionSystemPlacement(const FTransform& InTransform, int32 InSeed)
+	: Location(InTransform.GetLocation())
+	, Rotation(InTransform.Rotator())
+	, Seed(InSeed)
+{
+}
+
+void FConstructionSystemPlacement::Quantize()
+{
+	Location = FVector(
+		FMath::RoundToDouble(Location.X * 10.0) / 10.0,
+		FMath::RoundToDouble(Location.Y * 10.0) / 10.0,
+		FMath::RoundToDouble(Location.Z * 10.0) / 10.0);
+
+	Rotation = FRotator(
+		FRotator::DecompressAxisFromShort(FRotator::CompressAxisToShort(Rotation.Pitch)),
+		FRotator::DecompressAxisFromShort(FRotator::CompressAxisToShort(Rotation.Yaw)),
+		FRotator::DecompressAxisFromShort(FRotator::CompressAxisToShort(Rotation.Roll)));
+}
+
+bool FConstructionSystemPlacement::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	bOutSuccess = true;
+	Location.NetSerialize(Ar, Map, bOutSuccess);
+	Rotation.SerializeCompressedShort(Ar);
+
+	// The seeds are small positive numbers (see FPrefabTools::GetRandomSeed)
+	uint32 PackedSeed = static_cast<uint32>(Seed);
+	Ar.SerializeIntPacked(PackedSeed);
+	Seed = static_cast<int32>(PackedSeed);
+	return true;
+}
+
+///////////////////////////////// FConstructionSystemCommandRecord /////////////////////////////////
+
+FConstructionSystemCommandRecord FConstructionSystemCommandRecord::MakeBuild(int32 InAssetIndex, const FTransform& InTransform, int32 InSeed, uint32 InSnapParentId, int32 InSnapParentRecordIndex)
+{
+	FConstructionSystemCommandRecord Record;
+	Record.Type = EConstructionSystemCommandType::Build;
+	Record.AssetIndex = static_cast<uint16>(InAssetIndex);
+	Record.Placement = FConstructionSystemPlacement(InTransform, InSeed);
+	if (InSnapParentRecordIndex != INDEX_NONE) {
+		Record.SnapParentRecordIndex = InSnapParentRecordIndex;
+	}
+	else {
+		Record.SnapParentId = InSnapParentId;
+	}
+	return Record;
+}
+
+FConstructionSystemCommandRecord FConstructionSystemCommandRecord::MakeRemove(uint32 InItemId)
+{
+	FConstructionSystemCommandRecord Record;
+	Record.Type = EConstructionSystemCommandType::Remove;
+	Record.ItemId = InItemId;
+	return Record;
+}
+
+bool FConstructionSystemCommandRecord::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	uint8 bIsRemove = (Type == EConstructionSystemCommandType::Remove) ? 1 : 0;
+	Ar.SerializeBits(&bIsRemove, 1);
+	Type = bIsRemove ? EConstructionSystemCommandType::Remove : EConstructionSystemCommandType::Build;
+
+	bOutSuccess = true;
+	if (bIsRemove) {
+		uint32 PackedItemId = ItemId;
+		Ar.SerializeIntPacked(PackedItemId);
+		ItemId = PackedItemId;
+		return true;
+	}
+
+	uint32 PackedAssetIndex = AssetIndex;
+	Ar.SerializeIntPacked(PackedAssetIndex);
+	AssetIndex = static_cast<uint16>(PackedAssetIndex);
+	Placement.NetSerialize(Ar, Map, bOutSuccess);
+
+	// The snap parent is either a built item or an earlier record of the batch, one bit tells which
+	uint8 bSnappedToRecord = SnapParentRecordIndex != INDEX_NONE ? 1 : 0;
+	Ar.SerializeBits(&bSnappedToRecord, 1);
+	if (bSnappedToRecord) {
+		uint32 PackedRecordIndex = static_cast<uint32>(FMath::Max(SnapParentRecordIndex, 0));
+		Ar.SerializeIntPacked(PackedRecordIndex);
+		SnapParentRecordIndex = static_cast<int32>(FMath::Min<uint32>(PackedRecordIndex, MAX_int32));
+		SnapParentId = 0;
+	}
+	else {
+		uint32 PackedSnapParentId = SnapParentId;
+		Ar.SerializeIntPacked(PackedSnapParentId);
+		SnapParentId = PackedSnapParentId;
+		SnapParentRecordIndex = INDEX_NONE;
+	}
+	return true;
+}
+
+///////////////////////////////// FConstructionSystemReplicatedItem /////////////////////////////////
+
+void FConstructionSystemReplicatedItem::PostReplicatedAdd(const FConstructionSystemReplicatedItemArray& InArraySerializer)
+{
+	if (InArraySerializer.OwnerCell) {
+		InArraySerializer.OwnerCell->HandleItemAdded(*this);
+	}
+}
+
+void FConstructionSystemReplicatedItem::PreReplicatedRemove(const FConstructionSystemReplicatedItemArray& InArraySerializer)
+{
+	if (InArraySerializer.OwnerCell) {
+		InArraySerializer.OwnerCell->HandleItemRemoved(*this);
+	}
+}
@@ -5,6 +5,7 @@
 #include "Asset/PrefabricatorAsset.h"
 #include "ConstructionSystem/ConstructionSystemCursor.h"
 #include "ConstructionSystem/ConstructionSystemSnap.h"
+#include "ConstructionSystem/Net/ConstructionSystemNetSubsystem.h"
 #include "ConstructionSystemComponent.h"
 #include "Prefab/PrefabActor.h"
 #include "Prefab/PrefabTools.h"
@@ -12,10 +13,58 @@
 
 #include "CollisionQueryParams.h"
 #include "DrawDebugHelpers.h"
+#include "Engine/OverlapResult.h"
 #include "Engine/World.h"
 #include "GameFramework/Pawn.h"
 #include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
 #include "Materials/MaterialInterface.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogConstructionBuildTool, Log, All);
+
+namespace {
+	/**
+	 * The view rays of the build tool, one "StartX,StartY,StartZ,EndX,EndY,EndZ" row per update.
+	 * The ConstructionSystemBenchmark commandlet replays them against a generated base
+	 */
+	struct FCursorPathRecorder {
+		bool bRecording = false;
+		TArray<FString> Rows;
+
+		static FCursorPathRecorder& Get() {
+			static FCursorPathRecorder Recorder;
+			return Recorder;
+		}
+	};
+
+	FAutoConsoleCommand RecordCursorPathCommand(
+		TEXT("ConstructionSystem.CursorPath.Record"),
+		TEXT("Starts (1) or stops (0) recording the cursor rays of the build tool. Usage: ConstructionSystem.CursorPath.Record <0|1>"),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args) {
+			FCursorPathRecorder& Recorder = FCursorPathRecorder::Get();
+			Recorder.bRecording = Args.Num() == 0 || FCString::Atoi(*Args[0]) != 0;
+			if (Recorder.bRecording) {
+				Recorder.Rows.Reset();
+			}
+		}));
+
+	FAutoConsoleCommand SaveCursorPathCommand(
+		TEXT("ConstructionSystem.CursorPath.Save"),
+		TEXT("Writes the recorded cursor rays to Saved/ConstructionSystem/CursorPaths. Usage: ConstructionSystem.CursorPath.Save [Name]"),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args) {
+			const FCursorPathRecorder& Recorder = FCursorPathRecorder::Get();
+			const FString Name = Args.Num() > 0 ? Args[0] : FString::Printf(TEXT("CursorPath_%s"), *FDateTime::Now().ToString());
+			const FString Path = FPaths::ProjectSavedDir() / TEXT("ConstructionSystem") / TEXT("CursorPaths") / (Name + TEXT(".csv"));
+			if (FFileHelper::SaveStringArrayToFile(Recorder.Rows, *Path)) {
+				UE_LOG(LogConstructionBuildTool, Log, TEXT("Cursor path (%d rays) written to %s"), Recorder.Rows.Num(), *Path);
+			}
+			else {
+				UE_LOG(LogConstructionBuildTool, Error, TEXT("Cannot write the cursor path to %s"), *Path);
+			}
+		}));
+}
 
 void UConstructionSystemBuildTool::InitializeTool(UConstructionSystemComponent* ConstructionComponent)
 {
@@ -26,11 +75,16 @@ void UConstructionSystemBuildTool::InitializeTool(UConstructionSystemComponent*
 	Cursor->SetCursorInvalidMaterial(ConstructionComponent->CursorInvalidMaterial);
 
 	PrefabSnapChannel = FConstructionSystemUtils::FindPrefabSnapChannel();
+
+	AsyncSweepDelegate.BindUObject(this, &UConstructionSystemBuildTool::HandleAsyncCursorSweep);
+	AsyncLineTraceDelegate.BindUObject(this, &UConstructionSystemBuildTool::HandleAsyncCursorLineTrace);
+	AsyncOverlapDelegate.BindUObject(this, &UConstructionSystemBuildTool::HandleAsyncCursorOverlap);
 }
 
 void UConstructionSystemBuildTool::DestroyTool(UConstructionSystemComponent* ConstructionComponent)
 {
 	UConstructionSystemTool::DestroyTool(ConstructionComponent);
+	DestroyDragGhosts();
 	if (Cursor) {
 		Cursor->DestroyCursor();
 	}
@@ -48,6 +102,9 @@ void UConstructionSystemBuildTool::OnToolEnable(UConstructionSystemComponent* Co
 void UConstructionSystemBuildTool::OnToolDisable(UConstructionSystemComponent* ConstructionComponent)
 {
 	UConstructionSystemTool::OnToolDisable(ConstructionComponent);
+	CancelDragPlacement();
+	DestroyDragGhosts();
+	ResetAsyncCursorTraces();
 
 	if (Cursor) {
 		Cursor->DestroyCursor();
@@ -55,6 +112,118 @@ void UConstructionSystemBuildTool::OnToolDisable(UConstructionSystemComponent* C
 	}
 }
 
+const FCollisionQueryParams& UConstructionSystemBuildTool::GetCursorQueryParams(APawn* InPawn)
+{
+	APrefabActor* GhostActor = Cursor ? Cursor->GetCursorGhostActor() : nullptr;
+	const int32 NumDescendants = GhostActor ? GhostActor->GetDescendants().Num() : INDEX_NONE;
+	if (CursorQueryGhostActor.Get() != GhostActor || CursorQueryPawn.Get() != InPawn || CursorQueryNumDescendants != NumDescendants) {
+		CursorQueryParams = FCollisionQueryParams::DefaultQueryParam;
+		CursorQueryParams.AddIgnoredActor(InPawn);
+		if (GhostActor) {
+			FPrefabTools::IterateChildrenRecursive(GhostActor, [this](AActor* ChildCursorActor) {
+				CursorQueryParams.AddIgnoredActor(ChildCursorActor);
+			});
+		}
+		CursorQueryGhostActor = GhostActor;
+		CursorQueryPawn = InPawn;
+		CursorQueryNumDescendants = NumDescendants;
+	}
+	return CursorQueryParams;
+}
+
+void UConstructionSystemBuildTool::RequestAsyncCursorTraces(UWorld* InWorld, const FVector& InStart, const FVector& InEnd, const FCollisionShape& InSweepShape, const FCollisionQueryParams& InQueryParams)
+{
+	if (AsyncTraces.SweepHandle.IsValid() || AsyncTraces.LineTraceHandle.IsValid()) {
+		// The previous pair is still in flight
+		return;
+	}
+
+	AsyncTraces.bSweepDone = false;
+	AsyncTraces.bLineTraceDone = false;
+	AsyncTraces.SweepHandle = InWorld->AsyncSweepByChannel(EAsyncTraceType::Single, InStart, InEnd, FQuat::Identity, PrefabSnapChannel, InSweepShape,
+		InQueryParams, FCollisionResponseParams::DefaultResponseParam, &AsyncSweepDelegate);
+	AsyncTraces.LineTraceHandle = InWorld->AsyncLineTraceByChannel(EAsyncTraceType::Single, InStart, InEnd, ECC_WorldStatic,
+		InQueryParams, FCollisionResponseParams::DefaultResponseParam, &AsyncLineTraceDelegate);
+}
+
+void UConstructionSystemBuildTool::RequestAsyncCursorOverlap(UWorld* InWorld, const FConstructionSystemSnapBox& InCursorBox, uint32 InSnapParentId, const FCollisionQueryParams& InQueryParams)
+{
+	if (AsyncTraces.OverlapHandle.IsValid()) {
+		return;
+	}
+
+	// Same shrink as the synchronous check
+	const FVector ShrunkExtent = FBox(-InCursorBox.Extent, InCursorBox.Extent).ExpandBy(-2).GetExtent();
+	AsyncTraces.OverlapRequestBox = InCursorBox;
+	AsyncTraces.OverlapRequestSnapParentId = InSnapParentId;
+	AsyncTraces.OverlapHandle = InWorld->AsyncOverlapByChannel(InCursorBox.Transform.GetLocation(), InCursorBox.Transform.GetRotation(), PrefabSnapChannel,
+		FCollisionShape::MakeBox(ShrunkExtent), InQueryParams, FCollisionResponseParams::DefaultResponseParam, &AsyncOverlapDelegate);
+}
+
+void UConstructionSystemBuildTool::HandleAsyncCursorSweep(const FTraceHandle& InHandle, FTraceDatum& InData)
+{
+	if (InHandle != AsyncTraces.SweepHandle) {
+		// Issued before the traces were reset
+		return;
+	}
+
+	AsyncTraces.SweepHit = InData.OutHits.Num() > 0 ? InData.OutHits[0] : FHitResult();
+	AsyncTraces.bSweepDone = true;
+	AsyncTraces.SweepHandle = FTraceHandle();
+	PublishAsyncCursorTraces();
+}
+
+void UConstructionSystemBuildTool::HandleAsyncCursorLineTrace(const FTraceHandle& InHandle, FTraceDatum& InData)
+{
+	if (InHandle != AsyncTraces.LineTraceHandle) {
+		return;
+	}
+
+	AsyncTraces.LineTraceHit = InData.OutHits.Num() > 0 ? InData.OutHits[0] : FHitResult();
+	AsyncTraces.bLineTraceDone = true;
+	AsyncTraces.LineTraceHandle = FTraceHandle();
+	PublishAsyncCursorTraces();
+}
+
+void UConstructionSystemBuildTool::HandleAsyncCursorOverlap(const FTraceHandle& InHandle, FOverlapDatum& InData)
+{
+	if (InHandle != AsyncTraces.OverlapHandle) {
+		return;
+	}
+
+	AsyncTraces.OverlapBox = AsyncTraces.OverlapRequestBox;
+	AsyncTraces.OverlapSnapParentId = AsyncTraces.OverlapRequestSnapParentId;
+	AsyncTraces.bOverlapping = FConstructionSystemCollision::HasCollidingSnapOverlap(AsyncTraces.OverlapBox, InData.OutOverlaps);
+	AsyncTraces.bOverlapDone = true;
+	AsyncTraces.OverlapHandle = FTraceHandle();
+}
+
+bool UConstructionSystemBuildTool::HasAsyncCursorOverlapFor(const FConstructionSystemSnapBox& InCursorBox, uint32 InSnapParentId) const
+{
+	return AsyncTraces.bOverlapDone
+		&& AsyncTraces.OverlapSnapParentId == InSnapParentId
+		&& AsyncTraces.OverlapBox.Type == InCursorBox.Type
+		&& AsyncTraces.OverlapBox.Extent.Equals(InCursorBox.Extent, 0.1)
+		&& AsyncTraces.OverlapBox.Transform.Equals(InCursorBox.Transform, 0.1);
+}
+
+void UConstructionSystemBuildTool::PublishAsyncCursorTraces()
+{
+	if (!AsyncTraces.bSweepDone || !AsyncTraces.bLineTraceDone) {
+		return;
+	}
+
+	AsyncTraces.bHitSnapChannel = AsyncTraces.SweepHit.bBlockingHit;
+	AsyncTraces.bFoundHit = AsyncTraces.SweepHit.bBlockingHit || AsyncTraces.LineTraceHit.bBlockingHit;
+	AsyncTraces.Hit = AsyncTraces.bHitSnapChannel ? AsyncTraces.SweepHit : AsyncTraces.LineTraceHit;
+}
+
+void UConstructionSystemBuildTool::ResetAsyncCursorTraces()
+{
+	// The callbacks of the traces in flight no longer match the handles and are dropped
+	AsyncTraces = FAsyncCursorTraces();
+}
+
 void UConstructionSystemBuildTool::Update(UConstructionSystemComponent* ConstructionComponent)
 {
 	if (!ConstructionComponent) return;
@@ -72,15 +241,14 @@ void UConstructionSystemBuildTool::Update(UConstructionSystemComponent* Construc
 		FVector StartLocation = ViewLocation + CameraDirection * ConstructionComponent->TraceStartDistance;
 		FVector EndLocation = ViewLocation + CameraDirection * (TraceDistance + ConstructionComponent->TraceStartDistance);
 
-		FCollisionResponseParams ResponseParams = FCollisionResponseParams::DefaultResponseParam;
-		FCollisionQueryParams QueryParams = FCollisionQueryParams::DefaultQueryParam;
-		QueryParams.AddIgnoredActor(PlayerController->GetPawn());
-		if (Cursor->GetCursorGhostActor()) {
-			FPrefabTools::IterateChildrenRecursive(Cursor->GetCursorGhostActor(), [&QueryParams](AActor* ChildCursorActor) {
-				QueryParams.AddIgnoredActor(ChildCursorActor);
-			});
+		FCursorPathRecorder& PathRecorder = FCursorPathRecorder::Get();
+		if (PathRecorder.bRecording) {
+			PathRecorder.Rows.Add(FString::Printf(TEXT("%.2f,%.2f,%.2f,%.2f,%.2f,%.2f"), StartLocation.X, StartLocation.Y, StartLocation.Z, EndLocation.X, EndLocation.Y, EndLocation.Z));
 		}
 
+		FCollisionResponseParams ResponseParams = FCollisionResponseParams::DefaultResponseParam;
+		const FCollisionQueryParams& QueryParams = GetCursorQueryParams(PlayerController->GetPawn());
+
 		FHitResult Hit;
 		bCursorFoundHit = false;
 		bCursorModeFreeForm = true;
@@ -88,7 +256,14 @@ void UConstructionSystemBuildTool::Update(UConstructionSystemComponent* Construc
 		bool bHitSnapChannel = false;
 		
 		FCollisionShape SweepShape = FCollisionShape::MakeSphere(ConstructionComponent->TraceSweepRadius);
-		if (World->SweepSingleByChannel(Hit, StartLocation, EndLocation, FQuat::Identity, PrefabSnapChannel, SweepShape, QueryParams, ResponseParams)) {
+		if (ConstructionComponent->bAsyncCursorTraces) {
+			// Work with the traces issued on the previous frame and request the next ones
+			bCursorFoundHit = AsyncTraces.bFoundHit;
+			bHitSnapChannel = AsyncTraces.bHitSnapChannel;
+			Hit = AsyncTraces.Hit;
+			RequestAsyncCursorTraces(World, StartLocation, EndLocation, SweepShape, QueryParams);
+		}
+		else if (World->SweepSingleByChannel(Hit, StartLocation, EndLocation, FQuat::Identity, PrefabSnapChannel, SweepShape, QueryParams, ResponseParams)) {
 			bCursorFoundHit = true;
 			bHitSnapChannel = true;
 		}
@@ -97,25 +272,34 @@ void UConstructionSystemBuildTool::Update(UConstructionSystemComponent* Construc
 			bCursorFoundHit = true;
 		}
 		UPrefabricatorConstructionSnapComponent* SnapHost = nullptr;
+		CursorSnapParentId = 0;
+		SnapCandidates.Reset();
 		if (bCursorFoundHit) {
 			FVector CursorLocation;
 			FQuat CursorRotation;
 			UPrefabricatorConstructionSnapComponent* CursorSnap = Cursor->GetActiveSnapComponent();
 			if (bHitSnapChannel) {
-				// Snap the cursor
+				// Snap the cursor, on the hit host or on one of the pieces around it
 				SnapHost = Cast<UPrefabricatorConstructionSnapComponent>(Hit.GetComponent());
 				if (CursorSnap && SnapHost) {
-					FTransform TargetSnapTransform;
-					if (FConstructionSystemUtils::GetSnapPoint(SnapHost, CursorSnap, Hit.ImpactPoint, TargetSnapTransform, CursorRotationStep, 100)) {
+					TArray<UPrefabricatorConstructionSnapComponent*> HostSnaps;
+					FConstructionSystemUtils::GatherSnapHosts(World, SnapHost, Hit.ImpactPoint, SnapSearchRadius, HostSnaps);
+					FConstructionSystemUtils::FindSnapCandidates(HostSnaps, Cursor->GetSnapComponents(), Hit.ImpactPoint, CursorRotationStep, 100, MaxSnapCandidates, SnapCandidates);
+					if (SnapCandidates.Num() > 0) {
+						const FConstructionSystemSnapCandidate& Candidate = SnapCandidates[SnapCandidateIndex % SnapCandidates.Num()];
+						Cursor->SetActiveSnapComponentIndex(Candidate.CursorSnapIndex);
+						SnapHost = Candidate.HostSnap;
 						bCursorModeFreeForm = false;
-						CursorLocation = TargetSnapTransform.GetLocation();
-						CursorRotation = TargetSnapTransform.GetRotation();
+						CursorSnapParentId = UConstructionSystemNetSubsystem::GetItemId(FConstructionSystemUtils::FindTopMostPrefabActor(SnapHost));
+						CursorLocation = Candidate.Transform.GetLocation();
+						CursorRotation = Candidate.Transform.GetRotation();
 						DrawDebugPoint(World, CursorLocation, 20, FColor::Blue);
 					}
 
 				}
 			}
 			else {
+				SnapCandidateIndex = 0;
 				CursorLocation = Hit.ImpactPoint;
 				CursorRotation = (CursorSnap && CursorSnap->bAlignToGroundSlope)
 						? FQuat::FindBetweenNormals(FVector(0, 0, 1), Hit.Normal)
@@ -141,49 +325,30 @@ void UConstructionSystemBuildTool::Update(UConstructionSystemComponent* Construc
 				FVector BoxLocation = ActiveCursorSnap->GetComponentLocation();
 				FRotator BoxRotation = ActiveCursorSnap->GetComponentRotation();
 				FVector BoxExtent = ActiveCursorSnap->GetScaledBoxExtent();
+				const FConstructionSystemSnapBox CursorBox(ActiveCursorSnap->GetComponentTransform(), BoxExtent, ActiveCursorSnap->SnapType);
 				{
 					FBox Box(-BoxExtent, BoxExtent);
 					Box = Box.ExpandBy(-2);
 					BoxExtent = Box.GetExtent();
 				}
 
-				TArray<FOverlapResult> Overlaps;
-				if (World->OverlapMultiByChannel(Overlaps, BoxLocation, BoxRotation.Quaternion(), PrefabSnapChannel, FCollisionShape::MakeBox(BoxExtent), QueryParams)) {
-					for (const FOverlapResult& Overlap : Overlaps) {
-						if (UPrefabricatorConstructionSnapComponent* OverlapSnap = Cast<UPrefabricatorConstructionSnapComponent>(Overlap.GetComponent())) {
-							if (OverlapSnap == SnapHost) {
-								// We are trying to snap on this object. ignore 
-								//continue;
-							}
-
-							if (ActiveCursorSnap->SnapType == EPrefabricatorConstructionSnapType::Wall && OverlapSnap->SnapType == EPrefabricatorConstructionSnapType::Wall) {
-								if (!FConstructionSystemCollision::WallWallCollision(
-										ActiveCursorSnap->GetScaledBoxExtent(), ActiveCursorSnap->GetComponentTransform(), 
-										OverlapSnap->GetScaledBoxExtent(), OverlapSnap->GetComponentTransform())) {
-									continue;
-								}
-							}
-							else if (ActiveCursorSnap->SnapType == EPrefabricatorConstructionSnapType::Wall && OverlapSnap->SnapType == EPrefabricatorConstructionSnapType::Floor) {
-								if (!FConstructionSystemCollision::WallBoxCollision(
-									ActiveCursorSnap->GetScaledBoxExtent(), ActiveCursorSnap->GetComponentTransform(),
-									OverlapSnap->GetScaledBoxExtent(), OverlapSnap->GetComponentTransform())) {
-									continue;
-								}
-							}
-							else if (ActiveCursorSnap->SnapType == EPrefabricatorConstructionSnapType::Floor && OverlapSnap->SnapType == EPrefabricatorConstructionSnapType::Wall) {
-								if (!FConstructionSystemCollision::WallBoxCollision(
-									OverlapSnap->GetScaledBoxExtent(), OverlapSnap->GetComponentTransform(),
-									ActiveCursorSnap->GetScaledBoxExtent(), ActiveCursorSnap->GetComponentTransform())) {
-									continue;
-								}
-							}
-
-							// TODO: Emit out the reason (encroaching on existing geometry)
-							CursorVisiblity = EConstructionSystemCursorVisiblity::VisibleInvalid;
-							break;
-						}
+				bool bOverlapping = false;
+				if (ConstructionComponent->bAsyncCursorTraces) {
+					// A result made for another placement says nothing about this one. Until the check of the current
+					// placement is back, show it as invalid so it cannot be built
+					bOverlapping = HasAsyncCursorOverlapFor(CursorBox, CursorSnapParentId) ? AsyncTraces.bOverlapping : true;
+					RequestAsyncCursorOverlap(World, CursorBox, CursorSnapParentId, QueryParams);
+				}
+				else {
+					TArray<FOverlapResult> Overlaps;
+					if (World->OverlapMultiByChannel(Overlaps, BoxLocation, BoxRotation.Quaternion(), PrefabSnapChannel, FCollisionShape::MakeBox(BoxExtent), QueryParams)) {
+						bOverlapping = FConstructionSystemCollision::HasCollidingSnapOverlap(CursorBox, Overlaps);
 					}
 				}
+				if (bOverlapping) {
+					// TODO: Emit out the reason (encroaching on existing geometry)
+					CursorVisiblity = EConstructionSystemCursorVisiblity::VisibleInvalid;
+				}
 				//DrawDebugBox(World, BoxLocation, BoxExtent, BoxRotation.Quaternion(), FColor::Red);
 
 				// Check if the ground slope is too steep, while placing in world static geometry
@@ -203,6 +368,16 @@ void UConstructionSystemBuildTool::Update(UConstructionSystemComponent* Construc
 		}
 
 		Cursor->SetVisiblity(CursorVisiblity);
+
+		if (bDragging) {
+			if (CursorVisiblity != EConstructionSystemCursorVisiblity::Hidden) {
+				FTransform CursorTransform;
+				if (Cursor->GetCursorTransform(CursorTransform)) {
+					DragEndLocation = CursorTransform.GetLocation();
+				}
+			}
+			UpdateDragGhosts(World);
+		}
 	}
 }
 
@@ -211,11 +386,13 @@ void UConstructionSystemBuildTool::RegisterInputCallbacks(UInputComponent* Input
 	UConstructionSystemTool::RegisterInputCallbacks(InputComponent);
 
 	InputBindings.BuildAtCursor = InputComponent->BindAction("CSBuiltAtCursor", IE_Pressed, this, &UConstructionSystemBuildTool::HandleInput_ConstructAtCursor);
+	InputBindings.BuildAtCursorReleased = InputComponent->BindAction("CSBuiltAtCursor", IE_Released, this, &UConstructionSystemBuildTool::HandleInput_ConstructAtCursorReleased);
+	InputBindings.CyclePlacementMode = InputComponent->BindAction("CSCyclePlacementMode", IE_Pressed, this, &UConstructionSystemBuildTool::HandleInput_CyclePlacementMode);
 	InputBindings.CursorItemNext = InputComponent->BindAction("CSCursorItemNext", IE_Pressed, this, &UConstructionSystemBuildTool::HandleInput_CursorMoveNext);
 	InputBindings.CursorItemPrev = InputComponent->BindAction("CSCursorItemPrev", IE_Pressed, this, &UConstructionSystemBuildTool::HandleInput_CursorMovePrev);
+	InputBindings.CursorSnapNext = InputComponent->BindAction("CSCursorSnapNext", IE_Pressed, this, &UConstructionSystemBuildTool::HandleInput_CursorSnapNext);
+	InputBindings.CursorSnapPrev = InputComponent->BindAction("CSCursorSnapPrev", IE_Pressed, this, &UConstructionSystemBuildTool::HandleInput_CursorSnapPrev);
 	InputBindings.CursorRotate = InputComponent->BindAxis("CSCursorRotate", this, &UConstructionSystemBuildTool::HandleInput_RotateCursorStep);
-
-	// TODO: Map bindings to cursor next/prev snap points
 }
 
 void UConstructionSystemBuildTool::UnregisterInputCallbacks(UInputComponent* InputComponent)
@@ -223,8 +400,12 @@ void UConstructionSystemBuildTool::UnregisterInputCallbacks(UInputComponent* Inp
 	UConstructionSystemTool::UnregisterInputCallbacks(InputComponent);
 	
 	InputBindings.BuildAtCursor.ActionDelegate.Unbind();
+	InputBindings.BuildAtCursorReleased.ActionDelegate.Unbind();
+	InputBindings.CyclePlacementMode.ActionDelegate.Unbind();
 	InputBindings.CursorItemNext.ActionDelegate.Unbind();
 	InputBindings.CursorItemPrev.ActionDelegate.Unbind();
+	InputBindings.CursorSnapNext.ActionDelegate.Unbind();
+	InputBindings.CursorSnapPrev.ActionDelegate.Unbind();
 	InputBindings.CursorRotate.AxisDelegate.Unbind();
 
 	InputBindings = FCSBuildToolInputBindings();
@@ -237,6 +418,12 @@ void UConstructionSystemBuildTool::SetActivePrefab(UPrefabricatorAssetInterface*
 	Cursor->RecreateCursor(GetWorld(), InActivePrefabAsset);
 }
 
+void UConstructionSystemBuildTool::SetPlacementMode(EConstructionSystemPlacementMode InPlacementMode)
+{
+	CancelDragPlacement();
+	PlacementMode = InPlacementMode;
+}
+
 void UConstructionSystemBuildTool::CursorMoveNext()
 {
 	if (!bToolEnabled) return;
@@ -251,6 +438,18 @@ void UConstructionSystemBuildTool::CursorMovePrev()
 	Cursor->RecreateCursor(GetWorld(), ActivePrefabAsset);
 }
 
+void UConstructionSystemBuildTool::CursorSnapNext()
+{
+	if (!bToolEnabled) return;
+	SnapCandidateIndex = SnapCandidates.Num() > 0 ? (SnapCandidateIndex + 1) % SnapCandidates.Num() : 0;
+}
+
+void UConstructionSystemBuildTool::CursorSnapPrev()
+{
+	if (!bToolEnabled) return;
+	SnapCandidateIndex = SnapCandidates.Num() > 0 ? (SnapCandidateIndex + SnapCandidates.Num() - 1) % SnapCandidates.Num() : 0;
+}
+
 void UConstructionSystemBuildTool::RotateCursorStep(float NumSteps)
 {
 	if (!bToolEnabled) return;
@@ -260,7 +459,32 @@ void UConstructionSystemBuildTool::RotateCursorStep(float NumSteps)
 void UConstructionSystemBuildTool::HandleInput_ConstructAtCursor()
 {
 	if (!bInputPaused) {
-		ConstructAtCursor();
+		if (PlacementMode == EConstructionSystemPlacementMode::Single) {
+			ConstructAtCursor();
+		}
+		else {
+			BeginDragPlacement();
+		}
+	}
+}
+
+void UConstructionSystemBuildTool::HandleInput_ConstructAtCursorReleased()
+{
+	if (bDragging) {
+		if (bInputPaused) {
+			CancelDragPlacement();
+		}
+		else {
+			EndDragPlacement();
+		}
+	}
+}
+
+void UConstructionSystemBuildTool::HandleInput_CyclePlacementMode()
+{
+	if (!bInputPaused) {
+		const int32 NextMode = (static_cast<int32>(PlacementMode) + 1) % (static_cast<int32>(EConstructionSystemPlacementMode::Grid) + 1);
+		SetPlacementMode(static_cast<EConstructionSystemPlacementMode>(NextMode));
 	}
 }
 
@@ -278,6 +502,20 @@ void UConstructionSystemBuildTool::HandleInput_CursorMovePrev()
 	}
 }
 
+void UConstructionSystemBuildTool::HandleInput_CursorSnapNext()
+{
+	if (!bInputPaused) {
+		CursorSnapNext();
+	}
+}
+
+void UConstructionSystemBuildTool::HandleInput_CursorSnapPrev()
+{
+	if (!bInputPaused) {
+		CursorSnapPrev();
+	}
+}
+
 void UConstructionSystemBuildTool::HandleInput_RotateCursorStep(float NumSteps)
 {
 	if (!bInputPaused) {
@@ -306,7 +544,7 @@ void UConstructionSystemBuildTool::ConstructAtCursor()
 	if (World && ActivePrefabAsset) {
 		FTransform Transform;
 		if (Cursor->GetCursorTransform(Transform)) {
-			APrefabActor* SpawnedPrefab = FConstructionSystemUtils::ConstructPrefabItem(ConstructionComponent->GetWorld(), ActivePrefabAsset, Transform, Cursor->GetCursorSeed());
+			ConstructionComponent->SubmitBuildCommand(ActivePrefabAsset, Transform, Cursor->GetCursorSeed(), CursorSnapParentId);
 
 			if (!bCursorModeFreeForm) {
 				// A prefab was created at the cursor on a snapped location. Reset the local cursor rotation
@@ -316,3 +554,117 @@ void UConstructionSystemBuildTool::ConstructAtCursor()
 	}
 }
 
+
+void UConstructionSystemBuildTool::BeginDragPlacement()
+{
+	if (!bToolEnabled || !ActivePrefabAsset) return;
+
+	FTransform Transform;
+	if (Cursor->GetVisiblity() != EConstructionSystemCursorVisiblity::Visible || !Cursor->GetCursorTransform(Transform)) {
+		// Current cursor location is invalid
+		return;
+	}
+
+	bDragging = true;
+	DragStartTransform = Transform;
+	DragEndLocation = Transform.GetLocation();
+	DragSnapParentId = CursorSnapParentId;
+}
+
+void UConstructionSystemBuildTool::EndDragPlacement()
+{
+	UConstructionSystemComponent* ConstructionComponent = Cast<UConstructionSystemComponent>(GetOuter());
+	TArray<FTransform> Transforms;
+	TArray<int32> ParentIndices;
+	if (bToolEnabled && ConstructionComponent && ActivePrefabAsset && GetDragPlacements(Transforms, ParentIndices)) {
+		ConstructionComponent->SubmitBuildCommands(ActivePrefabAsset, Transforms, ParentIndices, Cursor->GetCursorSeed(), DragSnapParentId);
+	}
+	bDragging = false;
+	HideDragGhosts();
+}
+
+void UConstructionSystemBuildTool::CancelDragPlacement()
+{
+	bDragging = false;
+	HideDragGhosts();
+}
+
+bool UConstructionSystemBuildTool::GetDragPlacements(TArray<FTransform>& OutTransforms, TArray<int32>& OutParentIndices) const
+{
+	UConstructionSystemComponent* ConstructionComponent = Cast<UConstructionSystemComponent>(GetOuter());
+	APrefabActor* GhostActor = Cursor ? Cursor->GetCursorGhostActor() : nullptr;
+	UPrefabricatorConstructionSnapComponent* SnapComponent = Cursor ? Cursor->GetActiveSnapComponent() : nullptr;
+	if (!ConstructionComponent || !GhostActor || !SnapComponent) {
+		return false;
+	}
+
+	const bool bGrid = PlacementMode == EConstructionSystemPlacementMode::Grid;
+	FConstructionSystemUtils::GetDragPlacements(SnapComponent, GhostActor->GetActorTransform(), DragStartTransform, DragEndLocation,
+		bGrid, ConstructionComponent->MaxCommandsPerBatch, OutTransforms, OutParentIndices);
+	return OutTransforms.Num() > 0;
+}
+
+void UConstructionSystemBuildTool::UpdateDragGhosts(UWorld* InWorld)
+{
+	TArray<FTransform> Transforms;
+	TArray<int32> ParentIndices;
+	if (!GetDragPlacements(Transforms, ParentIndices)) {
+		HideDragGhosts();
+		return;
+	}
+
+	// The ghosts are built from the cursor prefab and seed, so they look like the pieces that will be built
+	if (DragGhostPrefab != ActivePrefabAsset || DragGhostSeed != Cursor->GetCursorSeed()) {
+		DestroyDragGhosts();
+		DragGhostPrefab = ActivePrefabAsset;
+		DragGhostSeed = Cursor->GetCursorSeed();
+	}
+
+	UConstructionSystemComponent* ConstructionComponent = Cast<UConstructionSystemComponent>(GetOuter());
+	while (DragGhosts.Num() < Transforms.Num()) {
+		UConstructionSystemCursor* Ghost = NewObject<UConstructionSystemCursor>(this);
+		Ghost->SetPreviewOnly(true);
+		Ghost->SetCursorSeed(DragGhostSeed);
+		if (ConstructionComponent) {
+			Ghost->SetCursorMaterial(ConstructionComponent->CursorMaterial);
+			Ghost->SetCursorInvalidMaterial(ConstructionComponent->CursorInvalidMaterial);
+		}
+		Ghost->RecreateCursor(InWorld, DragGhostPrefab);
+		DragGhosts.Add(Ghost);
+	}
+
+	const UConstructionSystemNetSubsystem* NetSubsystem = InWorld->GetSubsystem<UConstructionSystemNetSubsystem>();
+	for (int32 Index = 0; Index < DragGhosts.Num(); Index++) {
+		UConstructionSystemCursor* Ghost = DragGhosts[Index];
+		if (!Transforms.IsValidIndex(Index)) {
+			Ghost->SetVisiblity(EConstructionSystemCursorVisiblity::Hidden);
+			continue;
+		}
+
+		// Only the construction index is checked while dragging, the server validates the whole batch again when it receives it
+		const FTransform& Transform = Transforms[Index];
+		const bool bTaken = NetSubsystem && NetSubsystem->FindItemAtPlacement(ActivePrefabAsset, Transform) != 0;
+		Ghost->SetTransform(Transform);
+		Ghost->SetVisiblity(bTaken ? EConstructionSystemCursorVisiblity::VisibleInvalid : EConstructionSystemCursorVisiblity::Visible);
+	}
+}
+
+void UConstructionSystemBuildTool::HideDragGhosts()
+{
+	for (UConstructionSystemCursor* Ghost : DragGhosts) {
+		if (Ghost) {
+			Ghost->SetVisiblity(EConstructionSystemCursorVisiblity::Hidden);
+		}
+	}
+}
+
+void UConstructionSystemBuildTool::DestroyDragGhosts()
+{
+	for (UConstructionSystemCursor* Ghost : DragGhosts) {
+		if (Ghost) {
+			Ghost->DestroyCursor();
+		}
+	}
+	DragGhosts.Reset();
+	DragGhostPrefab = nullptr;
+}
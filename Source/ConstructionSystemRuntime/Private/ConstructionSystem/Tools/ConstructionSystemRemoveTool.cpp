@@ -21,6 +21,7 @@ void UConstructionSystemRemoveTool::InitializeTool(UConstructionSystemComponent*
 	UConstructionSystemTool::InitializeTool(ConstructionComponent);
 
 	PrefabSnapChannel = FConstructionSystemUtils::FindPrefabSnapChannel();
+	AsyncTraceDelegate.BindUObject(this, &UConstructionSystemRemoveTool::HandleAsyncCursorTrace);
 }
 
 void UConstructionSystemRemoveTool::DestroyTool(UConstructionSystemComponent* ConstructionComponent)
@@ -38,6 +39,10 @@ void UConstructionSystemRemoveTool::OnToolDisable(UConstructionSystemComponent*
 {
 	UConstructionSystemTool::OnToolDisable(ConstructionComponent);
 
+	// Drop the trace in flight, its callback no longer matches the handle
+	AsyncTraceHandle = FTraceHandle();
+	AsyncTraceHit = FHitResult();
+
 }
 
 void UConstructionSystemRemoveTool::Update(UConstructionSystemComponent* ConstructionComponent)
@@ -66,27 +71,53 @@ void UConstructionSystemRemoveTool::Update(UConstructionSystemComponent* Constru
 		FCollisionQueryParams QueryParams = FCollisionQueryParams::DefaultQueryParam;
 		QueryParams.AddIgnoredActor(PlayerController->GetPawn());
 
-		FHitResult Hit;
-		if (World->LineTraceSingleByChannel(Hit, StartLocation, EndLocation, PrefabSnapChannel, QueryParams, ResponseParams)) {
-			UPrefabricatorConstructionSnapComponent* SnapComponent = Cast<UPrefabricatorConstructionSnapComponent>(Hit.GetComponent());
-			if (SnapComponent) {
-				// find the prefab actor
-				AActor* CurrentActor = Hit.GetActor();
-				while (APrefabActor* ParentPrefab = Cast<APrefabActor>(CurrentActor->GetAttachParentActor())) {
-					FocusedActor = ParentPrefab;
-					CurrentActor = ParentPrefab;
-					bCursorFoundHit = true;
-
-				}
-				DrawDebugPoint(World, Hit.ImpactPoint, 20, FColor::Blue);
-				FBox Bounds = FPrefabTools::GetPrefabBounds(FocusedActor.Get());
-				DrawDebugBox(World, Bounds.GetCenter(), Bounds.GetExtent(), FColor::Red);
+		if (ConstructionComponent->bAsyncCursorTraces) {
+			// Work with the trace issued on the previous frame and request the next one
+			if (AsyncTraceHit.bBlockingHit) {
+				FocusCursorHit(World, AsyncTraceHit);
+			}
+			if (!AsyncTraceHandle.IsValid()) {
+				AsyncTraceHandle = World->AsyncLineTraceByChannel(EAsyncTraceType::Single, StartLocation, EndLocation, PrefabSnapChannel, QueryParams, ResponseParams, &AsyncTraceDelegate);
+			}
+		}
+		else {
+			FHitResult Hit;
+			if (World->LineTraceSingleByChannel(Hit, StartLocation, EndLocation, PrefabSnapChannel, QueryParams, ResponseParams)) {
+				FocusCursorHit(World, Hit);
 			}
 		}
 	}
 
 }
 
+void UConstructionSystemRemoveTool::FocusCursorHit(UWorld* InWorld, const FHitResult& InHit)
+{
+	UPrefabricatorConstructionSnapComponent* SnapComponent = Cast<UPrefabricatorConstructionSnapComponent>(InHit.GetComponent());
+	AActor* CurrentActor = InHit.GetActor();
+	if (SnapComponent && CurrentActor) {
+		// find the prefab actor
+		while (APrefabActor* ParentPrefab = Cast<APrefabActor>(CurrentActor->GetAttachParentActor())) {
+			FocusedActor = ParentPrefab;
+			CurrentActor = ParentPrefab;
+			bCursorFoundHit = true;
+
+		}
+		DrawDebugPoint(InWorld, InHit.ImpactPoint, 20, FColor::Blue);
+		FBox Bounds = FPrefabTools::GetPrefabBounds(FocusedActor.Get());
+		DrawDebugBox(InWorld, Bounds.GetCenter(), Bounds.GetExtent(), FColor::Red);
+	}
+}
+
+void UConstructionSystemRemoveTool::HandleAsyncCursorTrace(const FTraceHandle& InHandle, FTraceDatum& InData)
+{
+	if (InHandle != AsyncTraceHandle) {
+		return;
+	}
+
+	AsyncTraceHit = InData.OutHits.Num() > 0 ? InData.OutHits[0] : FHitResult();
+	AsyncTraceHandle = FTraceHandle();
+}
+
 void UConstructionSystemRemoveTool::HandleInput_RemoveAtCursor()
 {
 	if (!bInputPaused) {
@@ -97,7 +128,10 @@ void UConstructionSystemRemoveTool::HandleInput_RemoveAtCursor()
 void UConstructionSystemRemoveTool::RemoveAtCursor()
 {
 	if (bToolEnabled && bCursorFoundHit && FocusedActor.IsValid()) {
-		FocusedActor->Destroy();
+		UConstructionSystemComponent* ConstructionComponent = Cast<UConstructionSystemComponent>(GetOuter());
+		if (ConstructionComponent) {
+			ConstructionComponent->SubmitRemoveCommand(FocusedActor.Get());
+		}
 		FocusedActor = nullptr;
 		bCursorFoundHit = false;
 	}
@@ -3,13 +3,16 @@
 #include "ConstructionSystemComponent.h"
 
 #include "Asset/PrefabricatorAsset.h"
+#include "ConstructionSystem/Net/ConstructionSystemNetSubsystem.h"
 #include "ConstructionSystem/Tools/ConstructionSystemBuildTool.h"
 #include "ConstructionSystem/Tools/ConstructionSystemRemoveTool.h"
 #include "ConstructionSystem/Tools/ConstructionSystemTool.h"
 #include "ConstructionSystem/UI/ConstructionSystemUI.h"
+#include "ConstructionSystem/UI/ConstructionSystemUIAsset.h"
 #include "Prefab/PrefabActor.h"
 #include "Prefab/PrefabComponent.h"
 #include "Save/ConstructionSystemSaveGame.h"
+#include "Utils/ConstructionSystemStats.h"
 #include "Utils/ConstructionSystemUtils.h"
 #include "Utils/PrefabricatorFunctionLibrary.h"
 
@@ -109,6 +112,143 @@ void UConstructionSystemComponent::TickComponent(float DeltaTime, enum ELevelTic
 		CreateBuildMenu();
 		bInputBound = true;
 	}
+
+	if (PendingCommands.Num() > 0) {
+		// Send at most one batch per net update of the owning controller
+		TimeSinceCommandFlush += DeltaTime;
+		const AActor* Owner = GetOwner();
+		const float FlushInterval = (Owner && Owner->NetUpdateFrequency > 0) ? 1.0f / Owner->NetUpdateFrequency : 0.0f;
+		if (TimeSinceCommandFlush >= FlushInterval) {
+			FlushCommands();
+		}
+	}
+}
+
+void UConstructionSystemComponent::GetBuildablePrefabs(TArray<UPrefabricatorAssetInterface*>& OutPrefabs) const
+{
+	OutPrefabs.Reset();
+	if (BuildMenuData) {
+		for (const FConstructionSystemUICategory& Category : BuildMenuData->Categories) {
+			for (const FConstructionSystemUIPrefabEntry& Entry : Category.PrefabEntries) {
+				OutPrefabs.Add(Entry.Prefab);
+			}
+		}
+	}
+	OutPrefabs.Append(AdditionalBuildablePrefabs);
+}
+
+int32 UConstructionSystemComponent::FindBuildablePrefabIndex(UPrefabricatorAssetInterface* InPrefab) const
+{
+	TArray<UPrefabricatorAssetInterface*> BuildablePrefabs;
+	GetBuildablePrefabs(BuildablePrefabs);
+	return InPrefab ? BuildablePrefabs.Find(InPrefab) : INDEX_NONE;
+}
+
+void UConstructionSystemComponent::SubmitBuildCommand(UPrefabricatorAssetInterface* InPrefab, const FTransform& InTransform, int32 InSeed, uint32 InSnapParentId)
+{
+	const int32 AssetIndex = FindBuildablePrefabIndex(InPrefab);
+	if (AssetIndex == INDEX_NONE || AssetIndex > MAX_uint16) {
+		UE_LOG(LogConstructionSystem, Warning, TEXT("Prefab %s is not buildable. Add it to the build menu or the additional buildable prefabs"), *GetNameSafe(InPrefab));
+		return;
+	}
+	PendingCommands.Add(FConstructionSystemCommandRecord::MakeBuild(AssetIndex, InTransform, InSeed, InSnapParentId));
+}
+
+int32 UConstructionSystemComponent::SubmitBuildCommands(UPrefabricatorAssetInterface* InPrefab, TArrayView<const FTransform> InTransforms, TArrayView<const int32> InParentIndices, int32 InSeed, uint32 InSnapParentId)
+{
+	const int32 AssetIndex = FindBuildablePrefabIndex(InPrefab);
+	if (AssetIndex == INDEX_NONE || AssetIndex > MAX_uint16) {
+		UE_LOG(LogConstructionSystem, Warning, TEXT("Prefab %s is not buildable. Add it to the build menu or the additional buildable prefabs"), *GetNameSafe(InPrefab));
+		return 0;
+	}
+
+	// The records refer to each other by index, so the whole placement has to go out in the same RPC
+	const int32 NumPlacements = FMath::Min(InTransforms.Num(), MaxCommandsPerBatch);
+	if (PendingCommands.Num() + NumPlacements > MaxCommandsPerBatch) {
+		FlushCommands();
+	}
+
+	UWorld* World = GetWorld();
+	const UConstructionSystemNetSubsystem* NetSubsystem = World ? World->GetSubsystem<UConstructionSystemNetSubsystem>() : nullptr;
+
+	// What each placement can be snapped to: the piece already built there, or the record queued for it
+	TArray<uint32> PlacementItemIds;
+	TArray<int32> PlacementRecordIndices;
+	PlacementItemIds.SetNumZeroed(NumPlacements);
+	PlacementRecordIndices.Init(INDEX_NONE, NumPlacements);
+
+	int32 NumQueued = 0;
+	for (int32 Index = 0; Index < NumPlacements; Index++) {
+		const int32 ParentIndex = InParentIndices.IsValidIndex(Index) ? InParentIndices[Index] : INDEX_NONE;
+		const bool bSnappedToPlacement = ParentIndex >= 0 && ParentIndex < Index;
+		const uint32 SnapParentId = bSnappedToPlacement ? PlacementItemIds[ParentIndex] : InSnapParentId;
+		const int32 SnapParentRecordIndex = bSnappedToPlacement ? PlacementRecordIndices[ParentIndex] : INDEX_NONE;
+
+		const uint32 ExistingItemId = NetSubsystem ? NetSubsystem->FindItemAtPlacement(InPrefab, InTransforms[Index]) : 0;
+		if (ExistingItemId != 0) {
+			PlacementItemIds[Index] = ExistingItemId;
+			continue;
+		}
+
+		PlacementRecordIndices[Index] = PendingCommands.Num();
+		PendingCommands.Add(FConstructionSystemCommandRecord::MakeBuild(AssetIndex, InTransforms[Index], InSeed, SnapParentId, SnapParentRecordIndex));
+		NumQueued++;
+	}
+	return NumQueued;
+}
+
+void UConstructionSystemComponent::SubmitRemoveCommand(APrefabActor* InPrefabActor)
+{
+	const uint32 ItemId = UConstructionSystemNetSubsystem::GetItemId(InPrefabActor);
+	if (ItemId != 0) {
+		PendingCommands.Add(FConstructionSystemCommandRecord::MakeRemove(ItemId));
+	}
+	else if (InPrefabActor && InPrefabActor->HasAuthority()) {
+		// Not built through the construction system (e.g. placed in the level). Only the authority can remove it
+		InPrefabActor->Destroy();
+	}
+}
+
+void UConstructionSystemComponent::FlushCommands()
+{
+	TimeSinceCommandFlush = 0.0f;
+	TArray<FConstructionSystemCommandRecord> Records = MoveTemp(PendingCommands);
+
+	AActor* Owner = GetOwner();
+	if (!Owner || Owner->HasAuthority()) {
+		ExecuteCommands(Records);
+		return;
+	}
+
+	const int32 BatchSize = FMath::Max(MaxCommandsPerBatch, 1);
+	for (int32 StartIndex = 0; StartIndex < Records.Num(); StartIndex += BatchSize) {
+		const int32 Count = FMath::Min(BatchSize, Records.Num() - StartIndex);
+		ServerSubmitCommands(TArray<FConstructionSystemCommandRecord>(Records.GetData() + StartIndex, Count));
+		INC_DWORD_STAT_BY(STAT_ConstructionNet_NumSent, Count);
+	}
+}
+
+void UConstructionSystemComponent::ExecuteCommands(TArrayView<const FConstructionSystemCommandRecord> InRecords)
+{
+	UWorld* World = GetWorld();
+	UConstructionSystemNetSubsystem* NetSubsystem = World ? World->GetSubsystem<UConstructionSystemNetSubsystem>() : nullptr;
+	if (!NetSubsystem) {
+		return;
+	}
+
+	TArray<UPrefabricatorAssetInterface*> BuildablePrefabs;
+	GetBuildablePrefabs(BuildablePrefabs);
+	NetSubsystem->ExecuteCommands(InRecords, BuildablePrefabs, Cast<AController>(GetOwner()));
+}
+
+bool UConstructionSystemComponent::ServerSubmitCommands_Validate(const TArray<FConstructionSystemCommandRecord>& InRecords)
+{
+	return InRecords.Num() <= MaxCommandsPerBatch;
+}
+
+void UConstructionSystemComponent::ServerSubmitCommands_Implementation(const TArray<FConstructionSystemCommandRecord>& InRecords)
+{
+	ExecuteCommands(InRecords);
 }
 
 void UConstructionSystemComponent::EnableConstructionSystem(EConstructionSystemToolType InToolType)
@@ -3,6 +3,7 @@
 #include "Save/ConstructionSystemSaveGame.h"
 
 #include "Asset/PrefabricatorAsset.h"
+#include "ConstructionSystem/Net/ConstructionSystemNetSubsystem.h"
 #include "ConstructionSystemComponent.h"
 #include "Prefab/PrefabActor.h"
 #include "Utils/ConstructionSystemUtils.h"
@@ -85,8 +86,15 @@ void UConstructionSystemSaveSystem::HandleConstructionSystemLevelLoad(const UObj
 	LoadGameInstance = Cast<UConstructionSystemSaveGame>(UGameplayStatics::LoadGameFromSlot(SaveSlotName, UserIndex));
 
 	if (LoadGameInstance) {
+		// Restore through the net subsystem so the pieces get an item id and replicate to the clients
+		UConstructionSystemNetSubsystem* NetSubsystem = World->GetSubsystem<UConstructionSystemNetSubsystem>();
 		for (const FConstructionSystemSaveConstructedItem& Item : LoadGameInstance->ConstructedItems) {
-			FConstructionSystemUtils::ConstructPrefabItem(World, Item.PrefabAsset, Item.Transform, Item.Seed);
+			if (NetSubsystem) {
+				NetSubsystem->ConstructItem(Item.PrefabAsset, FConstructionSystemPlacement(Item.Transform, Item.Seed), 0);
+			}
+			else {
+				FConstructionSystemUtils::ConstructPrefabItem(World, Item.PrefabAsset, Item.Transform, Item.Seed);
+			}
 		}
 
 		if (LoadGameInstance->PlayerInfo.bRestorePlayerInfo) {
@@ -3,14 +3,49 @@
 #include "Utils/ConstructionSystemUtils.h"
 
 #include "Asset/PrefabricatorAsset.h"
+#include "ConstructionSystem/ConstructionSystemGeometry.h"
 #include "ConstructionSystem/ConstructionSystemSnap.h"
+#include "ConstructionSystem/Net/ConstructionSystemNetSubsystem.h"
 #include "ConstructionSystemComponent.h"
 #include "Prefab/PrefabActor.h"
 #include "Prefab/PrefabComponent.h"
+#include "Prefab/PrefabMaterializationSubsystem.h"
+#include "Prefab/PrefabTools.h"
 #include "Utils/ConstructionSystemDefs.h"
 #include "Utils/PrefabricatorFunctionLibrary.h"
 
+#include "Algo/BinarySearch.h"
 #include "Engine/CollisionProfile.h"
+#include "Engine/OverlapResult.h"
+#include "Engine/World.h"
+
+namespace {
+	/** Builds a constructed piece on the time sliced build system, exactly like ConstructPrefabItem would synchronously */
+	class FConstructionSystemBuildCommand_BuildItem : public FPrefabBuildSystemCommand {
+	public:
+		FConstructionSystemBuildCommand_BuildItem(APrefabActor* InPrefab, int32 InSeed)
+			: Prefab(InPrefab)
+			, Random(InSeed)
+		{
+		}
+
+		virtual void Execute(FPrefabBuildSystem& BuildSystem) override
+		{
+			if (Prefab.IsValid()) {
+				UPrefabricatorBlueprintLibrary::RandomizePrefab(Prefab.Get(), Random);
+			}
+		}
+
+		virtual FString GetTraceName() const override
+		{
+			return FString::Printf(TEXT("BuildConstructionItem %s"), Prefab.IsValid() ? *Prefab->GetName() : TEXT("[NONE]"));
+		}
+
+	private:
+		TWeakObjectPtr<APrefabActor> Prefab;
+		FRandomStream Random;
+	};
+}
 
 ECollisionChannel FConstructionSystemUtils::FindPrefabSnapChannel()
 {
@@ -484,21 +519,203 @@ bool FConstructionSystemUtils::GetSnapPoint(UPrefabricatorConstructionSnapCompon
 
 
 
-APrefabActor* FConstructionSystemUtils::ConstructPrefabItem(UWorld* InWorld, UPrefabricatorAssetInterface* InPrefabAsset, const FTransform& InTransform, int32 InSeed)
+APrefabActor* FConstructionSystemUtils::ConstructPrefabItem(UWorld* InWorld, UPrefabricatorAssetInterface* InPrefabAsset, const FTransform& InTransform, int32 InSeed, uint32 InItemId, bool bInDeferBuild)
 {
 	APrefabActor* SpawnedPrefab = InWorld->SpawnActor<APrefabActor>(APrefabActor::StaticClass(), InTransform);
 	SpawnedPrefab->PrefabComponent->PrefabAssetInterface = InPrefabAsset;
 
-	FRandomStream RandomStream(InSeed);
-	UPrefabricatorBlueprintLibrary::RandomizePrefab(SpawnedPrefab, RandomStream);
+	UPrefabMaterializationSubsystem* BuildSubsystem = bInDeferBuild ? InWorld->GetSubsystem<UPrefabMaterializationSubsystem>() : nullptr;
+	if (BuildSubsystem) {
+		BuildSubsystem->EnqueueCommand(MakeShareable(new FConstructionSystemBuildCommand_BuildItem(SpawnedPrefab, InSeed)));
+	}
+	else {
+		FRandomStream RandomStream(InSeed);
+		UPrefabricatorBlueprintLibrary::RandomizePrefab(SpawnedPrefab, RandomStream);
+	}
 
 	UConstructionSystemItemUserData* UserData = NewObject<UConstructionSystemItemUserData>(SpawnedPrefab->GetRootComponent());
 	UserData->Seed = InSeed;
+	UserData->ItemId = InItemId;
 	SpawnedPrefab->GetRootComponent()->AddAssetUserData(UserData);
 
 	return SpawnedPrefab;
 }
 
+void FConstructionSystemUtils::GetDragPlacements(UPrefabricatorConstructionSnapComponent* InSnapComponent, const FTransform& InItemTransform, const FTransform& InStartTransform,
+		const FVector& InEndLocation, bool bInGrid, int32 InMaxPlacements, TArray<FTransform>& OutTransforms, TArray<int32>& OutParentIndices)
+{
+	OutTransforms.Reset();
+	OutParentIndices.Reset();
+	if (!InSnapComponent || InMaxPlacements <= 0) {
+		return;
+	}
+
+	// Step along the axes of the snap box, placed relative to the first piece like it is on the cursor piece
+	const FQuat SnapToItem = InItemTransform.GetRotation().Inverse() * InSnapComponent->GetComponentQuat();
+	const FQuat StepRotation = InStartTransform.GetRotation() * SnapToItem;
+	const FVector StepSize = InSnapComponent->GetScaledBoxExtent() * 2.0f;
+	const FVector AxisX = StepRotation.GetAxisX();
+	const FVector AxisY = StepRotation.GetAxisY();
+	const FVector Delta = InEndLocation - InStartTransform.GetLocation();
+
+	auto GetSteps = [&Delta](const FVector& InAxis, float InStepSize, int32& OutNumSteps, float& OutSign) {
+		const float Projection = FVector::DotProduct(Delta, InAxis);
+		OutNumSteps = InStepSize > KINDA_SMALL_NUMBER ? FMath::RoundToInt(FMath::Abs(Projection) / InStepSize) : 0;
+		OutSign = Projection < 0 ? -1.0f : 1.0f;
+	};
+
+	int32 NumStepsX = 0, NumStepsY = 0;
+	float SignX = 1.0f, SignY = 1.0f;
+	GetSteps(AxisX, StepSize.X, NumStepsX, SignX);
+	GetSteps(AxisY, StepSize.Y, NumStepsY, SignY);
+
+	if (InSnapComponent->SnapType == EPrefabricatorConstructionSnapType::Wall) {
+		// Walls are only laid along their length
+		if (StepSize.X >= StepSize.Y) {
+			NumStepsY = 0;
+		}
+		else {
+			NumStepsX = 0;
+		}
+	}
+	else if (!bInGrid) {
+		// A line follows the axis the drag is the longest on
+		if (NumStepsX * StepSize.X >= NumStepsY * StepSize.Y) {
+			NumStepsY = 0;
+		}
+		else {
+			NumStepsX = 0;
+		}
+	}
+
+	const int32 CountX = FMath::Min(NumStepsX + 1, InMaxPlacements);
+	const int32 CountY = FMath::Min(NumStepsY + 1, FMath::Max(InMaxPlacements / CountX, 1));
+	OutTransforms.Reserve(CountX * CountY);
+	OutParentIndices.Reserve(CountX * CountY);
+	for (int32 Y = 0; Y < CountY; Y++) {
+		for (int32 X = 0; X < CountX; X++) {
+			FTransform Transform = InStartTransform;
+			Transform.AddToTranslation(AxisX * (SignX * X * StepSize.X) + AxisY * (SignY * Y * StepSize.Y));
+			OutTransforms.Add(Transform);
+
+			// Snapped to the previous piece of the row. The first piece of a row is snapped to the first piece of the previous row
+			OutParentIndices.Add(X > 0 ? OutTransforms.Num() - 2 : (Y > 0 ? (Y - 1) * CountX : INDEX_NONE));
+		}
+	}
+}
+
+void FConstructionSystemUtils::GatherSnapHosts(UWorld* InWorld, UPrefabricatorConstructionSnapComponent* InHitSnap, const FVector& InLocation, float InRadius, TArray<UPrefabricatorConstructionSnapComponent*>& OutHostSnaps)
+{
+	OutHostSnaps.Reset();
+	if (InHitSnap) {
+		OutHostSnaps.Add(InHitSnap);
+	}
+
+	// The constructed pieces are looked up in the geometry index of the construction system, no physics query is needed
+	UConstructionSystemNetSubsystem* NetSubsystem = InWorld ? InWorld->GetSubsystem<UConstructionSystemNetSubsystem>() : nullptr;
+	if (!NetSubsystem || InRadius <= 0.0f) {
+		return;
+	}
+
+	TArray<uint32> ItemIds;
+	NetSubsystem->GetGeometryIndex().FindItems(FBox::BuildAABB(InLocation, FVector(InRadius)), ItemIds);
+	for (uint32 ItemId : ItemIds) {
+		FPrefabTools::IterateChildrenRecursive(NetSubsystem->FindItemActor(ItemId), [&OutHostSnaps, InHitSnap](AActor* ChildActor) {
+			if (ChildActor) {
+				for (UActorComponent* Component : ChildActor->GetComponents()) {
+					UPrefabricatorConstructionSnapComponent* SnapComponent = Cast<UPrefabricatorConstructionSnapComponent>(Component);
+					if (SnapComponent && SnapComponent != InHitSnap) {
+						OutHostSnaps.Add(SnapComponent);
+					}
+				}
+			}
+		});
+	}
+}
+
+void FConstructionSystemUtils::FindSnapCandidates(TArrayView<UPrefabricatorConstructionSnapComponent* const> InHostSnaps, TArrayView<UPrefabricatorConstructionSnapComponent* const> InCursorSnaps,
+		const FVector& InRequestedSnapLocation, int32 CursorRotationStep, float InSnapTolerrance, int32 InMaxCandidates, TArray<FConstructionSystemSnapCandidate>& OutCandidates)
+{
+	OutCandidates.Reset();
+	if (InMaxCandidates <= 0) {
+		return;
+	}
+
+	// Where each cursor snap box sits relative to its prefab, and how far it reaches from its snap point
+	struct FCursorSnapInfo {
+		FVector LocalCenter;
+		float Radius;
+	};
+	TArray<FCursorSnapInfo, TInlineAllocator<8>> CursorSnapInfos;
+	float MaxCursorReach = 0.0f;
+	for (UPrefabricatorConstructionSnapComponent* CursorSnap : InCursorSnaps) {
+		FCursorSnapInfo& Info = CursorSnapInfos.AddDefaulted_GetRef();
+		APrefabActor* CursorPrefab = CursorSnap ? FindTopMostPrefabActor(CursorSnap) : nullptr;
+		Info.LocalCenter = CursorSnap ? CursorSnap->GetComponentLocation() : FVector::ZeroVector;
+		if (CursorPrefab) {
+			Info.LocalCenter = CursorPrefab->GetActorTransform().InverseTransformPosition(Info.LocalCenter);
+		}
+		Info.Radius = CursorSnap ? CursorSnap->GetScaledBoxExtent().Size() : 0.0f;
+		MaxCursorReach = FMath::Max(MaxCursorReach, Info.Radius * 2.0f);
+	}
+
+	for (UPrefabricatorConstructionSnapComponent* HostSnap : InHostSnaps) {
+		if (!HostSnap) {
+			continue;
+		}
+
+		// The attached cursor box touches the host box. A host this far away would attach the cursor out of the player's aim
+		const float HostRadius = HostSnap->GetScaledBoxExtent().Size();
+		const float MaxReach = HostRadius + MaxCursorReach + InSnapTolerrance;
+		if (FVector::DistSquared(HostSnap->GetComponentLocation(), InRequestedSnapLocation) > FMath::Square(MaxReach)) {
+			continue;
+		}
+
+		for (int32 CursorSnapIndex = 0; CursorSnapIndex < InCursorSnaps.Num(); CursorSnapIndex++) {
+			UPrefabricatorConstructionSnapComponent* CursorSnap = InCursorSnaps[CursorSnapIndex];
+			FTransform TargetTransform;
+			if (!CursorSnap || !GetSnapPoint(HostSnap, CursorSnap, InRequestedSnapLocation, TargetTransform, CursorRotationStep, InSnapTolerrance)) {
+				continue;
+			}
+
+			const float Score = FVector::DistSquared(TargetTransform.TransformPosition(CursorSnapInfos[CursorSnapIndex].LocalCenter), InRequestedSnapLocation);
+			if (OutCandidates.Num() == InMaxCandidates && Score >= OutCandidates.Last().Score) {
+				continue;
+			}
+
+			// Keep the list sorted. Ties keep the earlier pair, so the order is stable from frame to frame
+			const int32 InsertIndex = Algo::UpperBoundBy(OutCandidates, Score, &FConstructionSystemSnapCandidate::Score);
+			FConstructionSystemSnapCandidate Candidate;
+			Candidate.HostSnap = HostSnap;
+			Candidate.CursorSnapIndex = CursorSnapIndex;
+			Candidate.Transform = TargetTransform;
+			Candidate.Score = Score;
+			OutCandidates.Insert(Candidate, InsertIndex);
+			if (OutCandidates.Num() > InMaxCandidates) {
+				OutCandidates.Pop(false);
+			}
+		}
+	}
+}
+
+void FConstructionSystemUtils::GetSnapBoxes(APrefabActor* InItemActor, TArray<FConstructionSystemSnapBox>& OutBoxes)
+{
+	OutBoxes.Reset();
+	if (!InItemActor) {
+		return;
+	}
+
+	FPrefabTools::IterateChildrenRecursive(InItemActor, [&OutBoxes](AActor* ChildActor) {
+		if (ChildActor) {
+			for (UActorComponent* Component : ChildActor->GetComponents()) {
+				if (UPrefabricatorConstructionSnapComponent* SnapComponent = Cast<UPrefabricatorConstructionSnapComponent>(Component)) {
+					OutBoxes.Add(FConstructionSystemSnapBox(SnapComponent->GetComponentTransform(), SnapComponent->GetScaledBoxExtent(), SnapComponent->SnapType));
+				}
+			}
+		}
+	});
+}
+
 namespace {
 	FORCEINLINE bool IsPointInsideExtent2D(const FVector2D& Extent2D, const FVector2D& P, float ShrinkExtentAmount) {
 		return
@@ -620,3 +837,85 @@ bool FConstructionSystemCollision::WallWallCollision(const FVector& ExtentA, con
 	return false;
 }
 
+
+bool FConstructionSystemCollision::BoxesOverlap(const FVector& ExtentA, const FTransform& TransformA, const FVector& ExtentB, const FTransform& TransformB)
+{
+	const FQuat RotationA = TransformA.GetRotation();
+	const FQuat RotationB = TransformB.GetRotation();
+	const FVector AxesA[] = { RotationA.GetAxisX(), RotationA.GetAxisY(), RotationA.GetAxisZ() };
+	const FVector AxesB[] = { RotationB.GetAxisX(), RotationB.GetAxisY(), RotationB.GetAxisZ() };
+	const FVector Delta = TransformB.GetLocation() - TransformA.GetLocation();
+
+	// Rotation of B in the frame of A. The epsilon keeps the edge cross products stable when edges are parallel
+	const double Epsilon = 1e-6;
+	double R[3][3];
+	double AbsR[3][3];
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++) {
+			R[i][j] = FVector::DotProduct(AxesA[i], AxesB[j]);
+			AbsR[i][j] = FMath::Abs(R[i][j]) + Epsilon;
+		}
+	}
+	const double T[] = { FVector::DotProduct(Delta, AxesA[0]), FVector::DotProduct(Delta, AxesA[1]), FVector::DotProduct(Delta, AxesA[2]) };
+
+	// Face axes of A
+	for (int i = 0; i < 3; i++) {
+		const double RadiusB = ExtentB.X * AbsR[i][0] + ExtentB.Y * AbsR[i][1] + ExtentB.Z * AbsR[i][2];
+		if (FMath::Abs(T[i]) > ExtentA[i] + RadiusB) {
+			return false;
+		}
+	}
+
+	// Face axes of B
+	for (int j = 0; j < 3; j++) {
+		const double RadiusA = ExtentA.X * AbsR[0][j] + ExtentA.Y * AbsR[1][j] + ExtentA.Z * AbsR[2][j];
+		const double Distance = T[0] * R[0][j] + T[1] * R[1][j] + T[2] * R[2][j];
+		if (FMath::Abs(Distance) > RadiusA + ExtentB[j]) {
+			return false;
+		}
+	}
+
+	// Edge cross products
+	for (int i = 0; i < 3; i++) {
+		const int i1 = (i + 1) % 3;
+		const int i2 = (i + 2) % 3;
+		for (int j = 0; j < 3; j++) {
+			const int j1 = (j + 1) % 3;
+			const int j2 = (j + 2) % 3;
+			const double RadiusA = ExtentA[i1] * AbsR[i2][j] + ExtentA[i2] * AbsR[i1][j];
+			const double RadiusB = ExtentB[j1] * AbsR[i][j2] + ExtentB[j2] * AbsR[i][j1];
+			const double Distance = T[i2] * R[i1][j] - T[i1] * R[i2][j];
+			if (FMath::Abs(Distance) > RadiusA + RadiusB) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool FConstructionSystemCollision::SnapBoxesCollide(EPrefabricatorConstructionSnapType TypeA, const FVector& ExtentA, const FTransform& TransformA,
+		EPrefabricatorConstructionSnapType TypeB, const FVector& ExtentB, const FTransform& TransformB)
+{
+	if (TypeA == EPrefabricatorConstructionSnapType::Wall && TypeB == EPrefabricatorConstructionSnapType::Wall) {
+		return WallWallCollision(ExtentA, TransformA, ExtentB, TransformB);
+	}
+	else if (TypeA == EPrefabricatorConstructionSnapType::Wall && TypeB == EPrefabricatorConstructionSnapType::Floor) {
+		return WallBoxCollision(ExtentA, TransformA, ExtentB, TransformB);
+	}
+	else if (TypeA == EPrefabricatorConstructionSnapType::Floor && TypeB == EPrefabricatorConstructionSnapType::Wall) {
+		return WallBoxCollision(ExtentB, TransformB, ExtentA, TransformA);
+	}
+	return true;
+}
+
+bool FConstructionSystemCollision::HasCollidingSnapOverlap(const FConstructionSystemSnapBox& InBox, TArrayView<const FOverlapResult> InOverlaps)
+{
+	for (const FOverlapResult& Overlap : InOverlaps) {
+		if (UPrefabricatorConstructionSnapComponent* OverlapSnap = Cast<UPrefabricatorConstructionSnapComponent>(Overlap.GetComponent())) {
+			if (SnapBoxesCollide(InBox.Type, InBox.Extent, InBox.Transform, OverlapSnap->SnapType, OverlapSnap->GetScaledBoxExtent(), OverlapSnap->GetComponentTransform())) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
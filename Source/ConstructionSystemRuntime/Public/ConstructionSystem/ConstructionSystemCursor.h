@@ -32,8 +32,12 @@ public:
 
 	FORCEINLINE void IncrementSeed() { ++CursorSeed;  }
 	FORCEINLINE void DecrementSeed() { --CursorSeed; }
+	FORCEINLINE void SetCursorSeed(int32 InSeed) { CursorSeed = InSeed; }
 	FORCEINLINE int32 GetCursorSeed() const { return CursorSeed; }
 
+	/** Preview cursors (e.g. the drag placement ghosts) disable the collision of their snap components too, so the cursor traces ignore them */
+	FORCEINLINE void SetPreviewOnly(bool bInPreviewOnly) { bPreviewOnly = bInPreviewOnly; }
+
 	FORCEINLINE void SetCursorMaterial(UMaterialInterface* InCursorMaterial) { CursorMaterial = InCursorMaterial; }
 	FORCEINLINE void SetCursorInvalidMaterial(UMaterialInterface* InCursorInvalidMaterial) { CursorInvalidMaterial = InCursorInvalidMaterial; }
 
@@ -41,6 +45,8 @@ public:
 	void MoveToPrevSnapComponent();
 
 	UPrefabricatorConstructionSnapComponent* GetActiveSnapComponent();
+	void SetActiveSnapComponentIndex(int32 InIndex);
+	const TArray<UPrefabricatorConstructionSnapComponent*>& GetSnapComponents() const { return SnapComponents; }
 
 private:
 	void AssignMaterialRecursive(UMaterialInterface* Material) const;
@@ -65,5 +71,6 @@ private:
 	int32 ActiveSnapComponentIndex = 0;
 
 	EConstructionSystemCursorVisiblity Visiblity = EConstructionSystemCursorVisiblity::Visible;
+	bool bPreviewOnly = false;
 };
 
@@ -0,0 +1,140 @@
+//$ Copyright 2015-23, Code Respawn Technologies Pvt Ltd - All Rights Reserved $//
+
+#pragma once
+#include "CoreMinimal.h"
+
+enum class EPrefabricatorConstructionSnapType : uint8;
+
+/** A snap box of a constructed piece, in world space. The transform has no scale, the extent is already scaled */
+struct CONSTRUCTIONSYSTEMRUNTIME_API FConstructionSystemSnapBox {
+	FTransform Transform;
+	FVector Extent = FVector::ZeroVector;
+	EPrefabricatorConstructionSnapType Type;
+
+	FConstructionSystemSnapBox();
+	FConstructionSystemSnapBox(const FTransform& InTransform, const FVector& InExtent, EPrefabricatorConstructionSnapType InType);
+
+	FBox GetBounds() const;
+	friend FArchive& operator<<(FArchive& Ar, FConstructionSystemSnapBox& Box);
+};
+
+typedef TArray<FConstructionSystemSnapBox, TInlineAllocator<4>> FConstructionSystemSnapBoxList;
+
+/** A piece to validate before it is built */
+struct CONSTRUCTIONSYSTEMRUNTIME_API FConstructionSystemPlacementQuery {
+	/** The snap boxes of the new piece, at the placement */
+	FConstructionSystemSnapBoxList Boxes;
+
+	/** The item the piece is snapped to, zero if it is placed on the world */
+	uint32 SnapParentId = 0;
+
+	/** Pieces of the index to treat as gone, e.g. the pieces removed earlier in the same batch */
+	TArray<uint32> IgnoredItemIds;
+
+	/** Slope limit of a piece placed on the world */
+	bool bCheckGroundSlope = false;
+	FVector GroundNormal = FVector::UpVector;
+	float MaxGroundSlope = 60.0f;
+
+	friend FArchive& operator<<(FArchive& Ar, FConstructionSystemPlacementQuery& Query);
+};
+
+enum class EConstructionSystemPlacementResult : uint8 {
+	Valid,
+	Overlapping,
+	SnapParentMissing,
+	NotAttachedToSnapParent,
+	GroundTooSteep
+};
+
+/**
+ * The snap boxes of the constructed pieces, hashed on a uniform grid. Placements are validated against it with the same
+ * rules as the physics based cursor checks of the build tool (see FConstructionSystemCollision), but without touching the
+ * physics scene. The queries are deterministic and can run on any thread, the updates are made on the game thread
+ */
+class CONSTRUCTIONSYSTEMRUNTIME_API FConstructionSystemGeometryIndex {
+public:
+	explicit FConstructionSystemGeometryIndex(float InCellSize = 1000.0f);
+
+	void AddItem(uint32 InItemId, TArrayView<const FConstructionSystemSnapBox> InBoxes);
+	void RemoveItem(uint32 InItemId);
+	bool Contains(uint32 InItemId) const;
+	int32 Num() const;
+	void Reset();
+
+	/** Validates a placement. InExtraBoxes are treated as built pieces, e.g. the pieces accepted earlier in the same batch */
+	EConstructionSystemPlacementResult ValidatePlacement(const FConstructionSystemPlacementQuery& InQuery, TArrayView<const FConstructionSystemSnapBox> InExtraBoxes = TArrayView<const FConstructionSystemSnapBox>()) const;
+
+	/** Gathers the pieces with a snap box touching the bounds, sorted by item id */
+	void FindItems(const FBox& InBounds, TArray<uint32>& OutItemIds) const;
+
+	/** Gathers the snap boxes of the pieces found by FindItems, in item id order */
+	void GetBoxes(const FBox& InBounds, TArray<FConstructionSystemSnapBox>& OutBoxes) const;
+
+	/**
+	 * Gathers the pieces with a snap box within SnapTolerance of one of the given boxes, with the same test as the snap
+	 * legality check. Sorted by item id. The item the boxes belong to is skipped
+	 */
+	void FindTouchingItems(TArrayView<const FConstructionSystemSnapBox> InBoxes, uint32 InIgnoredItemId, TArray<uint32>& OutItemIds) const;
+
+	static const TCHAR* GetResultName(EConstructionSystemPlacementResult InResult);
+
+public:
+	/** The snap boxes of a snapped piece have to be within this distance of the boxes of its snap parent */
+	float SnapTolerance = 5.0f;
+
+private:
+	struct FItem {
+		FConstructionSystemSnapBoxList Boxes;
+		TArray<FIntVector, TInlineAllocator<4>> Cells;
+	};
+
+	void GetCells(const FBox& InBounds, TArray<FIntVector, TInlineAllocator<8>>& OutCells) const;
+	static bool Overlaps(const FConstructionSystemSnapBox& InQueryBox, const FConstructionSystemSnapBox& InBuiltBox);
+
+private:
+	TMap<uint32, FItem> Items;
+	TMap<FIntVector, TArray<uint32>> Cells;
+	float CellSize;
+	mutable FRWLock Lock;
+};
+
+/**
+ * Index updates and placement queries recorded from a running game. Replaying them on a fresh index reproduces
+ * the validation run in isolation, e.g. to check a change of the validation rules against real placements
+ */
+class CONSTRUCTIONSYSTEMRUNTIME_API FConstructionSystemPlacementTrace {
+public:
+	void RecordAddItem(uint32 InItemId, TArrayView<const FConstructionSystemSnapBox> InBoxes);
+	void RecordRemoveItem(uint32 InItemId);
+	void RecordQuery(const FConstructionSystemPlacementQuery& InQuery, TArrayView<const FConstructionSystemSnapBox> InExtraBoxes, EConstructionSystemPlacementResult InResult);
+
+	bool SaveToFile(const FString& InPath) const;
+	bool LoadFromFile(const FString& InPath);
+
+	/** Replays the trace on a fresh index. Returns the number of queries whose result differs from the recorded one */
+	int32 Replay(TArray<int32>* OutMismatchedEntries = nullptr) const;
+
+	int32 Num() const { return Entries.Num(); }
+	void Reset() { Entries.Reset(); }
+
+private:
+	enum class EEntryType : uint8 {
+		AddItem,
+		RemoveItem,
+		Query
+	};
+
+	struct FEntry {
+		EEntryType Type = EEntryType::Query;
+		uint32 ItemId = 0;
+
+		/** AddItem: the boxes of the piece. Query: the placement */
+		FConstructionSystemPlacementQuery Query;
+		TArray<FConstructionSystemSnapBox> ExtraBoxes;
+		EConstructionSystemPlacementResult Result = EConstructionSystemPlacementResult::Valid;
+
+		void Serialize(FArchive& Ar);
+	};
+	TArray<FEntry> Entries;
+};
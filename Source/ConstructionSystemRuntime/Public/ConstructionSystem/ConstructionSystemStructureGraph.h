@@ -0,0 +1,97 @@
+//$ Copyright 2015-23, Code Respawn Technologies Pvt Ltd - All Rights Reserved $//
+
+#pragma once
+#include "CoreMinimal.h"
+
+/**
+ * Connections between the constructed pieces, keyed by item id. A piece is connected to the piece it was snapped to, and
+ * to every piece its snap boxes touch (e.g. a wall resting on two floors, or a floor closing a loop of walls).
+ * Grounded pieces rest on the world (e.g. they were placed freely on the terrain) and support everything connected to them
+ *
+ * The graph is updated incrementally as pieces are built and removed, so the structural queries do not need any physics traces
+ */
+class CONSTRUCTIONSYSTEMRUNTIME_API FConstructionSystemStructureGraph {
+public:
+	typedef TArray<uint32, TInlineAllocator<6>> FNeighborList;
+
+	void AddItem(uint32 InItemId, bool bInGrounded);
+
+	/** Removes the piece and its connections. The former neighbors are appended to OutNeighbors, if provided */
+	void RemoveItem(uint32 InItemId, TArray<uint32>* OutNeighbors = nullptr);
+
+	void Connect(uint32 InItemA, uint32 InItemB);
+	void Disconnect(uint32 InItemA, uint32 InItemB);
+
+	bool Contains(uint32 InItemId) const { return Nodes.Contains(InItemId); }
+	bool IsGrounded(uint32 InItemId) const;
+	void SetGrounded(uint32 InItemId, bool bInGrounded);
+
+	/** Returns null if the piece is not in the graph */
+	const FNeighborList* GetNeighbors(uint32 InItemId) const;
+
+	/** Gathers every piece reachable from the given piece, including itself */
+	void GetConnectedItems(uint32 InItemId, TArray<uint32>& OutItems) const;
+
+	/** Finds the pieces, reachable from the seeds, that are no longer connected to a grounded piece. Runs to completion */
+	void FindUnsupportedItems(TArrayView<const uint32> InSeeds, TArray<uint32>& OutUnsupportedItems) const;
+
+	int32 Num() const { return Nodes.Num(); }
+	void Reset() { Nodes.Reset(); }
+
+private:
+	struct FNode {
+		FNeighborList Neighbors;
+		bool bGrounded = false;
+	};
+	TMap<uint32, FNode> Nodes;
+};
+
+/**
+ * Finds the pieces that lost their support after a removal. Start it with the neighbors of the removed pieces
+ *
+ * One breadth first search is run from each seed and the searches are advanced in lockstep. A search ends when it
+ * reaches a grounded piece, when it runs into another search (it is the same island, so it shares its result) or when it
+ * runs out of pieces, in which case everything it visited is unsupported. The cost is proportional to the smallest islands,
+ * the large supported part of a base is rarely walked entirely. The search can be spread over several frames with Step
+ */
+class CONSTRUCTIONSYSTEMRUNTIME_API FConstructionSystemSupportQuery {
+public:
+	FConstructionSystemSupportQuery(const FConstructionSystemStructureGraph& InGraph, TArrayView<const uint32> InSeeds);
+
+	/** Visits at most InMaxVisits pieces. Returns true once the query is complete */
+	bool Step(int32 InMaxVisits = MAX_int32);
+
+	bool IsComplete() const { return bComplete; }
+	int32 GetNumVisited() const { return VisitedBy.Num(); }
+	int32 GetNumExpanded() const { return NumExpanded; }
+
+	/** Valid once the query is complete. The pieces removed from the graph since the query started are skipped */
+	void GetUnsupportedItems(TArray<uint32>& OutItems) const;
+
+private:
+	enum class ESearchState : uint8 {
+		Active,
+		Supported,
+		Unsupported
+	};
+
+	struct FSearch {
+		/** The visited pieces in visit order. The ones from Head onwards are not expanded yet */
+		TArray<uint32> Queue;
+		int32 Head = 0;
+
+		/** The search this one was merged into */
+		int32 MergedInto = INDEX_NONE;
+		ESearchState State = ESearchState::Active;
+	};
+
+	int32 ResolveSearch(int32 InSearchIndex) const;
+	void ExpandNext(int32 InSearchIndex);
+
+private:
+	const FConstructionSystemStructureGraph* Graph;
+	TArray<FSearch> Searches;
+	TMap<uint32, int32> VisitedBy;
+	int32 NumExpanded = 0;
+	bool bComplete = false;
+};
@@ -0,0 +1,64 @@
+//$ Copyright 2015-23, Code Respawn Technologies Pvt Ltd - All Rights Reserved $//
+
+#pragma once
+#include "CoreMinimal.h"
+#include "ConstructionSystem/Net/ConstructionSystemNetTypes.h"
+
+#include "GameFramework/Actor.h"
+#include "ConstructionSystemNetCell.generated.h"
+
+class APrefabActor;
+class UPrefabricatorAssetInterface;
+
+/**
+ * Replicates the pieces built in one cell of the construction grid. The clients only receive the cells within their
+ * net cull distance, and only the added / removed pieces are sent once a cell is open. The clients build their own
+ * copy of each piece locally, the pieces themselves are not replicated
+ */
+UCLASS(NotPlaceable, Transient)
+class CONSTRUCTIONSYSTEMRUNTIME_API AConstructionSystemNetCell : public AActor {
+	GENERATED_BODY()
+public:
+	AConstructionSystemNetCell();
+
+	//~ Begin AActor Interface
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+	virtual void PostInitializeComponents() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	//~ End AActor Interface
+
+	/** Server: adds the prefab to the palette of the cell if needed and returns its index */
+	int32 FindOrAddPaletteIndex(UPrefabricatorAssetInterface* InPrefab);
+	UPrefabricatorAssetInterface* GetPaletteAsset(int32 InPaletteIndex) const;
+
+	/** Server: replicates a piece that was built in this cell */
+	void AddItem(const FConstructionSystemReplicatedItem& InItem);
+
+	/** Server: stops replicating the piece. Returns false if the piece is not in this cell */
+	bool RemoveItem(uint32 InItemId);
+
+	int32 GetNumItems() const { return ReplicatedItems.Items.Num(); }
+
+	/** Client: builds / destroys the local copy of a replicated piece */
+	void HandleItemAdded(const FConstructionSystemReplicatedItem& InItem);
+	void HandleItemRemoved(const FConstructionSystemReplicatedItem& InItem);
+
+private:
+	UFUNCTION()
+	void OnRep_Palette();
+
+	void BuildLocalItem(const FConstructionSystemReplicatedItem& InItem);
+
+private:
+	UPROPERTY(ReplicatedUsing = OnRep_Palette)
+	TArray<TObjectPtr<UPrefabricatorAssetInterface>> Palette;
+
+	UPROPERTY(Replicated)
+	FConstructionSystemReplicatedItemArray ReplicatedItems;
+
+	/** Client: items that arrived before their palette entry */
+	TArray<FConstructionSystemReplicatedItem> PendingItems;
+
+	/** Client: the local copies of the pieces of this cell */
+	TMap<uint32, TWeakObjectPtr<APrefabActor>> LocalItems;
+};
@@ -0,0 +1,183 @@
+//$ Copyright 2015-23, Code Respawn Technologies Pvt Ltd - All Rights Reserved $//
+
+#pragma once
+#include "CoreMinimal.h"
+#include "ConstructionSystem/ConstructionSystemGeometry.h"
+#include "ConstructionSystem/ConstructionSystemStructureGraph.h"
+#include "ConstructionSystem/Net/ConstructionSystemNetTypes.h"
+
+#include "Subsystems/WorldSubsystem.h"
+#include "UObject/SoftObjectPath.h"
+#include "ConstructionSystemNetSubsystem.generated.h"
+
+class AConstructionSystemNetCell;
+class AController;
+class APrefabActor;
+class UPrefabricatorAssetInterface;
+
+/**
+ * Server authoritative construction. The build / remove records of the players are validated here in batches and
+ * applied to the world. The built pieces are replicated to the clients through the cell actors (AConstructionSystemNetCell)
+ *
+ * Every constructed piece gets an item id, on the server and on the clients, which the records use to refer to it.
+ * The pieces and their snap connections are tracked in a structure graph, which the server uses to find the pieces that
+ * lost their support when a piece is removed (see bCollapseUnsupportedItems)
+ *
+ * The snap boxes of the pieces are kept in a geometry index, so the server validates the placements of the records
+ * (overlaps and snap legality) without any physics query (see bValidatePlacementGeometry)
+ */
+UCLASS()
+class CONSTRUCTIONSYSTEMRUNTIME_API UConstructionSystemNetSubsystem : public UTickableWorldSubsystem {
+	GENERATED_BODY()
+public:
+	/// USubsystem Interface
+	virtual void Deinitialize() override;
+	/// End of USubsystem Interface
+
+	/// FTickableGameObject Interface
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	/// End of FTickableGameObject Interface
+
+	/**
+	 * Server: validates a batch of records sent by a player and applies the valid ones.
+	 * The asset index of the build records refers to the given buildable prefab list. Returns the number of applied records
+	 */
+	int32 ExecuteCommands(TArrayView<const FConstructionSystemCommandRecord> InRecords, TArrayView<UPrefabricatorAssetInterface* const> InBuildablePrefabs, AController* InInstigator);
+
+	/** Server: builds a piece without any validation (e.g. restored from a save game) */
+	APrefabActor* ConstructItem(UPrefabricatorAssetInterface* InPrefab, const FConstructionSystemPlacement& InPlacement, uint32 InSnapParentId);
+
+	/** Returns the piece of this prefab built at the location with the same rotation, or zero if the spot is free */
+	uint32 FindItemAtPlacement(UPrefabricatorAssetInterface* InPrefab, const FTransform& InTransform) const;
+
+	/**
+	 * Returns false once MaxImmediateBuildsPerFrame pieces were built this frame. The pieces beyond that are built on the
+	 * time sliced prefab build system, so a large batch (or a burst of replicated pieces) is spread over several frames
+	 */
+	bool ConsumeImmediateBuild();
+
+	/**
+	 * Like ConsumeImmediateBuild, but the first piece of a prefab asset is always built right away, to learn its snap boxes
+	 * (unless the server already learned them from a probe while validating). The seed picks the asset of a prefab collection
+	 */
+	bool ShouldDeferBuild(UPrefabricatorAssetInterface* InPrefab, int32 InSeed);
+
+	/**
+	 * Computes the world snap boxes of a prefab at the given placement, for the asset the seed picks from a prefab collection.
+	 * Returns false if no piece of this asset was built yet
+	 */
+	bool GetPlacementBoxes(UPrefabricatorAssetInterface* InPrefab, int32 InSeed, const FTransform& InTransform, FConstructionSystemSnapBoxList& OutBoxes) const;
+
+	/** Server: destroys a constructed piece */
+	bool RemoveItem(uint32 InItemId);
+
+	/** Tracks a piece that was built locally from a replicated cell */
+	void RegisterItem(uint32 InItemId, APrefabActor* InActor, uint32 InSnapParentId);
+	void UnregisterItem(uint32 InItemId);
+
+	APrefabActor* FindItemActor(uint32 InItemId) const;
+	int32 GetNumItems() const { return Items.Num(); }
+
+	/** Returns the item id of a constructed piece, or zero if the actor was not built by the construction system */
+	static uint32 GetItemId(const AActor* InPrefabActor);
+
+	const FConstructionSystemStructureGraph& GetStructureGraph() const { return StructureGraph; }
+	const FConstructionSystemGeometryIndex& GetGeometryIndex() const { return GeometryIndex; }
+
+	/** Records the geometry index updates and the placement checks, to replay them later (see FConstructionSystemPlacementTrace) */
+	void SetRecordPlacementTrace(bool bInRecord);
+	const FConstructionSystemPlacementTrace* GetPlacementTrace() const { return PlacementTrace.Get(); }
+	int32 GetNumPendingSupportChecks() const { return SupportQueries.Num(); }
+
+	/** Server: called with the pieces that were removed because they lost their support */
+	DECLARE_MULTICAST_DELEGATE_OneParam(FOnItemsCollapsed, const TArray<uint32>& /* ItemIds */);
+	FOnItemsCollapsed OnItemsCollapsed;
+
+public:
+	/** Size of the replication cells. The clients receive the pieces of the cells within NetCullDistance of their view */
+	float CellSize = 5000.0f;
+	float NetCullDistance = 15000.0f;
+
+	/** The pieces cannot be built or removed further than this from the instigator's pawn */
+	float MaxBuildDistance = 10000.0f;
+
+	/** A snapped piece has to be within this distance of the piece it was snapped to */
+	float MaxSnapParentDistance = 2000.0f;
+
+	/** Number of pieces built synchronously per frame, see ConsumeImmediateBuild */
+	int32 MaxImmediateBuildsPerFrame = 8;
+
+	/** Server: removes the pieces that are no longer connected to a grounded piece after a removal */
+	bool bCollapseUnsupportedItems = false;
+
+	/** Number of pieces the support checks can walk per frame. The larger checks continue on the next frames */
+	int32 MaxSupportVisitsPerFrame = 4096;
+
+	/** Server: rejects the build records that overlap existing pieces, or do not touch the piece they are snapped to */
+	bool bValidatePlacementGeometry = true;
+
+private:
+	struct FItemEntry {
+		TWeakObjectPtr<APrefabActor> Actor;
+		TWeakObjectPtr<AConstructionSystemNetCell> Cell;
+		/** Only used as a key of PlacementToItem, never dereferenced */
+		UPrefabricatorAssetInterface* PrefabKey = nullptr;
+		FIntVector4 PlacementKey;
+		uint32 SnapParentId = 0;
+	};
+
+	bool ValidateBuild(const FConstructionSystemCommandRecord& InRecord, UPrefabricatorAssetInterface* InPrefab, const FVector* InInstigatorLocation,
+		const FVector* InBatchSnapParentLocation, const TSet<TTuple<FIntVector4, UPrefabricatorAssetInterface*>>& InBatchPlacements,
+		const TSet<uint32>& InBatchRemovals, FConstructionSystemGeometryIndex& InOutBatchGeometry, FString& OutReason) const;
+	bool ValidateRemove(const FConstructionSystemCommandRecord& InRecord, const FVector* InInstigatorLocation, FString& OutReason) const;
+
+	/** Connects the piece to its snap parent, and to the pieces its snap boxes touch. Call after AddToGeometryIndex */
+	void AddToStructureGraph(uint32 InItemId, uint32 InSnapParentId, TArrayView<const FConstructionSystemSnapBox> InBoxes);
+	void AddToGeometryIndex(uint32 InItemId, APrefabActor* InActor, UPrefabricatorAssetInterface* InPrefab, FConstructionSystemSnapBoxList& OutBoxes);
+
+	/** Stores the snap boxes of a built piece, relative to the piece */
+	void AddSnapBoxTemplate(const FSoftObjectPath& InTemplateKey, APrefabActor* InActor);
+
+	/** Builds a probe of the asset to learn its snap boxes, if no piece of it was built yet */
+	void LearnSnapBoxTemplate(UPrefabricatorAssetInterface* InPrefab, int32 InSeed);
+
+	/** The prefab asset the seed picks, without loading it. The snap boxes are learned per asset, not per collection */
+	static FSoftObjectPath GetSnapBoxTemplateKey(UPrefabricatorAssetInterface* InPrefab, int32 InSeed);
+	void RemoveFromGeometryIndex(uint32 InItemId);
+	bool RemoveItemInternal(uint32 InItemId, TArray<uint32>* OutNeighbors);
+	void StartSupportCheck(TArrayView<const uint32> InSeeds);
+	void CollapseUnsupportedItems(const FConstructionSystemSupportQuery& InQuery);
+
+	AConstructionSystemNetCell* FindOrCreateCell(const FVector& InLocation);
+	/** The location rounded to the unit, and the rotation rounded to the degree. Pieces rotated differently do not share a spot */
+	static FIntVector4 GetPlacementKey(const FVector& InLocation, const FRotator& InRotation);
+
+private:
+	TMap<uint32, FItemEntry> Items;
+
+	/** Occupied placements, so the same piece is not built twice at the same spot */
+	TMap<TTuple<FIntVector4, UPrefabricatorAssetInterface*>, uint32> PlacementToItem;
+
+	TMap<FIntVector, TWeakObjectPtr<AConstructionSystemNetCell>> Cells;
+
+	FConstructionSystemStructureGraph StructureGraph;
+	TArray<FConstructionSystemSupportQuery> SupportQueries;
+
+	FConstructionSystemGeometryIndex GeometryIndex;
+
+	/** Snap boxes of each prefab asset, relative to the prefab actor. The assets of a collection each have their own */
+	TMap<FSoftObjectPath, TArray<FConstructionSystemSnapBox>> SnapBoxTemplates;
+	TUniquePtr<FConstructionSystemPlacementTrace> PlacementTrace;
+	bool bRecordingPlacementTrace = false;
+
+	/**
+	 * Client: connections to pieces that did not replicate yet, or left the relevant cells, keyed by the missing piece.
+	 * They are restored when the missing piece is registered again
+	 */
+	TMultiMap<uint32, uint32> PendingSnapEdges;
+	uint32 NextItemId = 1;
+
+	uint64 ImmediateBuildFrame = 0;
+	int32 NumImmediateBuildsThisFrame = 0;
+};
@@ -0,0 +1,135 @@
+//$ Copyright 2015-23, Code Respawn Technologies Pvt Ltd - All Rights Reserved $//
+
+#pragma once
+#include "CoreMinimal.h"
+#include "Engine/NetSerialization.h"
+#include "Net/Serialization/FastArraySerializer.h"
+#include "ConstructionSystemNetTypes.generated.h"
+
+class AConstructionSystemNetCell;
+
+/** Where and how a piece is built. Quantized to a few bytes on the wire */
+USTRUCT()
+struct CONSTRUCTIONSYSTEMRUNTIME_API FConstructionSystemPlacement {
+	GENERATED_BODY()
+
+	UPROPERTY()
+	FVector_NetQuantize10 Location;
+
+	UPROPERTY()
+	FRotator Rotation = FRotator::ZeroRotator;
+
+	UPROPERTY()
+	int32 Seed = 0;
+
+	FConstructionSystemPlacement() {}
+	FConstructionSystemPlacement(const FTransform& InTransform, int32 InSeed);
+
+	FTransform GetTransform() const { return FTransform(Rotation, Location); }
+
+	/** Rounds the placement the same way NetSerialize does, so a piece built from it matches the replicated copies */
+	void Quantize();
+
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
+};
+
+template<>
+struct TStructOpsTypeTraits<FConstructionSystemPlacement> : public TStructOpsTypeTraitsBase2<FConstructionSystemPlacement> {
+	enum {
+		WithNetSerializer = true
+	};
+};
+
+UENUM()
+enum class EConstructionSystemCommandType : uint8 {
+	Build,
+	Remove
+};
+
+/** A build or remove request sent by a player to the server */
+USTRUCT()
+struct CONSTRUCTIONSYSTEMRUNTIME_API FConstructionSystemCommandRecord {
+	GENERATED_BODY()
+
+	UPROPERTY()
+	EConstructionSystemCommandType Type = EConstructionSystemCommandType::Build;
+
+	/** Build: index of the prefab in the buildable list of the construction component */
+	UPROPERTY()
+	uint16 AssetIndex = 0;
+
+	/** Build: the placement of the new piece */
+	UPROPERTY()
+	FConstructionSystemPlacement Placement;
+
+	/** Remove: the item to remove */
+	UPROPERTY()
+	uint32 ItemId = 0;
+
+	/** Build: the item the piece was snapped to, zero if it was placed freely or snapped to a record of the same batch */
+	UPROPERTY()
+	uint32 SnapParentId = 0;
+
+	/** Build: the earlier build record of the same batch the piece was snapped to (e.g. a line of walls), INDEX_NONE otherwise */
+	UPROPERTY()
+	int32 SnapParentRecordIndex = INDEX_NONE;
+
+	static FConstructionSystemCommandRecord MakeBuild(int32 InAssetIndex, const FTransform& InTransform, int32 InSeed, uint32 InSnapParentId, int32 InSnapParentRecordIndex = INDEX_NONE);
+	static FConstructionSystemCommandRecord MakeRemove(uint32 InItemId);
+
+	bool IsSnappedToBatchRecord() const { return Type == EConstructionSystemCommandType::Build && SnapParentRecordIndex != INDEX_NONE; }
+
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
+};
+
+template<>
+struct TStructOpsTypeTraits<FConstructionSystemCommandRecord> : public TStructOpsTypeTraitsBase2<FConstructionSystemCommandRecord> {
+	enum {
+		WithNetSerializer = true
+	};
+};
+
+/** A piece built by the server, replicated to the clients the owning cell is relevant to */
+USTRUCT()
+struct CONSTRUCTIONSYSTEMRUNTIME_API FConstructionSystemReplicatedItem : public FFastArraySerializerItem {
+	GENERATED_BODY()
+
+	UPROPERTY()
+	uint32 ItemId = 0;
+
+	/** Index in the prefab palette of the cell */
+	UPROPERTY()
+	uint16 PaletteIndex = 0;
+
+	UPROPERTY()
+	uint32 SnapParentId = 0;
+
+	UPROPERTY()
+	FConstructionSystemPlacement Placement;
+
+	void PostReplicatedAdd(const struct FConstructionSystemReplicatedItemArray& InArraySerializer);
+	void PreReplicatedRemove(const struct FConstructionSystemReplicatedItemArray& InArraySerializer);
+};
+
+USTRUCT()
+struct CONSTRUCTIONSYSTEMRUNTIME_API FConstructionSystemReplicatedItemArray : public FFastArraySerializer {
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<FConstructionSystemReplicatedItem> Items;
+
+	UPROPERTY(NotReplicated)
+	TObjectPtr<AConstructionSystemNetCell> OwnerCell = nullptr;
+
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+	{
+		return FFastArraySerializer::FastArrayDeltaSerialize<FConstructionSystemReplicatedItem, FConstructionSystemReplicatedItemArray>(Items, DeltaParms, *this);
+	}
+};
+
+template<>
+struct TStructOpsTypeTraits<FConstructionSystemReplicatedItemArray> : public TStructOpsTypeTraitsBase2<FConstructionSystemReplicatedItemArray> {
+	enum {
+		WithNetDeltaSerializer = true
+	};
+};
@@ -2,14 +2,27 @@
 
 #pragma once
 #include "CoreMinimal.h"
+#include "ConstructionSystem/ConstructionSystemGeometry.h"
 #include "ConstructionSystem/Tools/ConstructionSystemTool.h"
+#include "Utils/ConstructionSystemUtils.h"
 
+#include "CollisionQueryParams.h"
 #include "Components/InputComponent.h"
 #include "Engine/AssetUserData.h"
+#include "Engine/HitResult.h"
+#include "WorldCollision.h"
 #include "ConstructionSystemBuildTool.generated.h"
 
 class UPrefabricatorAssetInterface;
 class UConstructionSystemCursor;
+class APawn;
+
+UENUM(BlueprintType)
+enum class EConstructionSystemPlacementMode : uint8 {
+	Single		UMETA(DisplayName = "Single"),
+	Line		UMETA(DisplayName = "Line"),
+	Grid		UMETA(DisplayName = "Grid")
+};
 
 UCLASS(BlueprintType)
 class CONSTRUCTIONSYSTEMRUNTIME_API UConstructionSystemBuildTool : public UConstructionSystemTool {
@@ -27,6 +40,10 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "ConstructionSystem")
 	void SetActivePrefab(UPrefabricatorAssetInterface* InActivePrefabAsset);
 
+	/** In the line and grid modes, the pieces are laid from where the build input is pressed to where it is released */
+	UFUNCTION(BlueprintCallable, Category = "ConstructionSystem")
+	void SetPlacementMode(EConstructionSystemPlacementMode InPlacementMode);
+
 protected: 
 	virtual void RegisterInputCallbacks(UInputComponent* InputComponent) override;
 	virtual void UnregisterInputCallbacks(UInputComponent* InputComponent) override;
@@ -36,17 +53,49 @@ private:
 	UFUNCTION()
 	void HandleInput_ConstructAtCursor();
 	UFUNCTION()
+	void HandleInput_ConstructAtCursorReleased();
+	UFUNCTION()
+	void HandleInput_CyclePlacementMode();
+	UFUNCTION()
 	void HandleInput_CursorMoveNext();
 	UFUNCTION()
 	void HandleInput_CursorMovePrev();
 	UFUNCTION()
+	void HandleInput_CursorSnapNext();
+	UFUNCTION()
+	void HandleInput_CursorSnapPrev();
+	UFUNCTION()
 	void HandleInput_RotateCursorStep(float NumSteps);
 
 	void ConstructAtCursor();
+	void BeginDragPlacement();
+	void EndDragPlacement();
+	void CancelDragPlacement();
+	bool GetDragPlacements(TArray<FTransform>& OutTransforms, TArray<int32>& OutParentIndices) const;
+	/** Shows the pieces of the line / grid being dragged with a pool of ghost cursors, tinted with the cursor materials */
+	void UpdateDragGhosts(UWorld* InWorld);
+	void HideDragGhosts();
+	void DestroyDragGhosts();
 	void CursorMoveNext();
 	void CursorMovePrev();
+	void CursorSnapNext();
+	void CursorSnapPrev();
 	void RotateCursorStep(float NumSteps);
 
+	/** Returns the cursor trace params, rebuilding the ignore list only when the pawn or the cursor hierarchy changes */
+	const FCollisionQueryParams& GetCursorQueryParams(APawn* InPawn);
+
+	/** Async cursor traces (see UConstructionSystemComponent::bAsyncCursorTraces). The results arrive on the next frame */
+	void RequestAsyncCursorTraces(UWorld* InWorld, const FVector& InStart, const FVector& InEnd, const FCollisionShape& InSweepShape, const FCollisionQueryParams& InQueryParams);
+	void RequestAsyncCursorOverlap(UWorld* InWorld, const FConstructionSystemSnapBox& InCursorBox, uint32 InSnapParentId, const FCollisionQueryParams& InQueryParams);
+	/** True if the last completed overlap check was made for this cursor box and snap target */
+	bool HasAsyncCursorOverlapFor(const FConstructionSystemSnapBox& InCursorBox, uint32 InSnapParentId) const;
+	void HandleAsyncCursorSweep(const FTraceHandle& InHandle, FTraceDatum& InData);
+	void HandleAsyncCursorLineTrace(const FTraceHandle& InHandle, FTraceDatum& InData);
+	void HandleAsyncCursorOverlap(const FTraceHandle& InHandle, FOverlapDatum& InData);
+	void PublishAsyncCursorTraces();
+	void ResetAsyncCursorTraces();
+
 public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ConstructionSystem")
 	float TraceDistance = 4000.0f;
@@ -54,6 +103,17 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ConstructionSystem")
 	float CursorRotationStepAngle = 15.0f;
 
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "ConstructionSystem")
+	EConstructionSystemPlacementMode PlacementMode = EConstructionSystemPlacementMode::Single;
+
+	/** The pieces within this distance of the aimed snap point are snap hosts too, not only the one under the cursor */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ConstructionSystem")
+	float SnapSearchRadius = 500.0f;
+
+	/** Number of attachments kept around the aimed snap point, cycled with the snap next / prev inputs */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ConstructionSystem")
+	int32 MaxSnapCandidates = 8;
+
 private:
 	UPROPERTY(Transient)
 	UConstructionSystemCursor* Cursor;
@@ -61,16 +121,79 @@ private:
 	UPROPERTY(Transient)
 	UPrefabricatorAssetInterface* ActivePrefabAsset;
 
+	/** Ghosts of the dragged pieces. Reused from frame to frame, and rebuilt when the prefab or the cursor seed changes */
+	UPROPERTY(Transient)
+	TArray<UConstructionSystemCursor*> DragGhosts;
+
+	UPROPERTY(Transient)
+	UPrefabricatorAssetInterface* DragGhostPrefab = nullptr;
+	int32 DragGhostSeed = 0;
+
 	int32 CursorRotationStep = 0;
 	ECollisionChannel PrefabSnapChannel;
 	bool bCursorFoundHit = false;
 	bool bCursorModeFreeForm = true;
 
+	/** Item id of the piece the cursor is snapped to, zero if the cursor is free form */
+	uint32 CursorSnapParentId = 0;
+
+	/** Best attachments around the aimed snap point. The cursor uses the one at SnapCandidateIndex */
+	TArray<FConstructionSystemSnapCandidate> SnapCandidates;
+	int32 SnapCandidateIndex = 0;
+
+	/** The line / grid being dragged. The first piece is placed where the drag started */
+	bool bDragging = false;
+	FTransform DragStartTransform;
+	FVector DragEndLocation = FVector::ZeroVector;
+	uint32 DragSnapParentId = 0;
+
+	FCollisionQueryParams CursorQueryParams;
+	TWeakObjectPtr<AActor> CursorQueryGhostActor;
+	TWeakObjectPtr<APawn> CursorQueryPawn;
+	int32 CursorQueryNumDescendants = INDEX_NONE;
+
+	/**
+	 * The snap channel sweep and the static world line trace are issued together. Once both are back, the sweep hit
+	 * wins over the line trace hit, like on the synchronous path, and the result is used until the next pair completes
+	 */
+	struct FAsyncCursorTraces {
+		FTraceHandle SweepHandle;
+		FTraceHandle LineTraceHandle;
+		FTraceHandle OverlapHandle;
+
+		FHitResult SweepHit;
+		FHitResult LineTraceHit;
+		bool bSweepDone = false;
+		bool bLineTraceDone = false;
+
+		/** Last completed trace pair */
+		FHitResult Hit;
+		bool bFoundHit = false;
+		bool bHitSnapChannel = false;
+
+		/** The cursor box and snap target of the overlap check in flight */
+		FConstructionSystemSnapBox OverlapRequestBox;
+		uint32 OverlapRequestSnapParentId = 0;
+
+		/** Last completed overlap check, and the cursor box and snap target it was requested for */
+		FConstructionSystemSnapBox OverlapBox;
+		uint32 OverlapSnapParentId = 0;
+		bool bOverlapDone = false;
+		bool bOverlapping = false;
+	};
+	FAsyncCursorTraces AsyncTraces;
+	FTraceDelegate AsyncSweepDelegate;
+	FTraceDelegate AsyncLineTraceDelegate;
+	FOverlapDelegate AsyncOverlapDelegate;
 
 	struct FCSBuildToolInputBindings {
 		FInputActionBinding BuildAtCursor;
+		FInputActionBinding BuildAtCursorReleased;
+		FInputActionBinding CyclePlacementMode;
 		FInputActionBinding CursorItemNext;
 		FInputActionBinding CursorItemPrev;
+		FInputActionBinding CursorSnapNext;
+		FInputActionBinding CursorSnapPrev;
 		FInputAxisBinding CursorRotate;
 	};
 	FCSBuildToolInputBindings InputBindings;
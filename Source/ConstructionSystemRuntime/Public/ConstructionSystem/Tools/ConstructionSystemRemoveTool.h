@@ -5,6 +5,7 @@
 #include "ConstructionSystem/Tools/ConstructionSystemTool.h"
 
 #include "Components/InputComponent.h"
+#include "WorldCollision.h"
 #include "ConstructionSystemRemoveTool.generated.h"
 
 class UConstructionSystemCursor;
@@ -31,6 +32,12 @@ protected:
 
 	void RemoveAtCursor();
 
+	/** Focuses the constructed piece that owns the hit snap component */
+	void FocusCursorHit(UWorld* InWorld, const FHitResult& InHit);
+
+	/** Async cursor trace (see UConstructionSystemComponent::bAsyncCursorTraces). The result arrives on the next frame */
+	void HandleAsyncCursorTrace(const FTraceHandle& InHandle, FTraceDatum& InData);
+
 public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ConstructionSystem")
 	float TraceDistance = 4000.0f;
@@ -42,6 +49,12 @@ private:
 	ECollisionChannel PrefabSnapChannel;
 	bool bCursorFoundHit = false;
 
+	FTraceHandle AsyncTraceHandle;
+	FTraceDelegate AsyncTraceDelegate;
+
+	/** Last completed async trace */
+	FHitResult AsyncTraceHit;
+
 private:
 	struct FCSRemoveToolInputBindings {
 		FInputActionBinding RemoveAtCursor;
@@ -2,6 +2,8 @@
 
 #pragma once
 #include "CoreMinimal.h"
+#include "ConstructionSystem/Net/ConstructionSystemNetTypes.h"
+
 #include "Components/ActorComponent.h"
 #include "Engine/AssetUserData.h"
 #include "ConstructionSystemComponent.generated.h"
@@ -63,6 +65,23 @@ public:
 	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "ConstructionSystem")
 	UConstructionSystemTool* GetTool(EConstructionSystemToolType InToolType);
 
+	/** The prefabs this player can build: the build menu entries followed by AdditionalBuildablePrefabs. The build records refer to them by index */
+	void GetBuildablePrefabs(TArray<UPrefabricatorAssetInterface*>& OutPrefabs) const;
+	int32 FindBuildablePrefabIndex(UPrefabricatorAssetInterface* InPrefab) const;
+
+	/**
+	 * Queues a build / remove request. The queued requests are sent to the server in one batch per net update,
+	 * where they are validated before being applied (see UConstructionSystemNetSubsystem)
+	 */
+	void SubmitBuildCommand(UPrefabricatorAssetInterface* InPrefab, const FTransform& InTransform, int32 InSeed, uint32 InSnapParentId);
+
+	/**
+	 * Queues the pieces of a multi placement (line, grid) as one batch. InParentIndices holds, for each placement, the earlier
+	 * placement it is snapped to, or INDEX_NONE to snap it to InSnapParentId. The placements already taken by the same prefab
+	 * are skipped in one pass over the construction index. Returns the number of queued pieces
+	 */
+	int32 SubmitBuildCommands(UPrefabricatorAssetInterface* InPrefab, TArrayView<const FTransform> InTransforms, TArrayView<const int32> InParentIndices, int32 InSeed, uint32 InSnapParentId);
+	void SubmitRemoveCommand(APrefabActor* InPrefabActor);
 
 private:
 	APlayerController* GetPlayerController();
@@ -78,6 +97,12 @@ private:
 
 	void CreateBuildMenu();
 
+	void FlushCommands();
+	void ExecuteCommands(TArrayView<const FConstructionSystemCommandRecord> InRecords);
+
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerSubmitCommands(const TArray<FConstructionSystemCommandRecord>& InRecords);
+
 public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Cursor")
 	UMaterialInterface* CursorMaterial;
@@ -91,6 +116,13 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Cursor")
 	float TraceSweepRadius = 40;
 
+	/**
+	 * Runs the cursor traces of the build and remove tools on the engine's async trace system. The tools then work
+	 * with the results of the previous frame, which keeps the queries off the game thread (e.g. with several split screen builders)
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Cursor")
+	bool bAsyncCursorTraces = false;
+
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Camera")
 	AActor* ConstructionCameraActor;
 
@@ -106,6 +138,14 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "UI")
 	UConstructionSystemUIAsset* BuildMenuData;
 
+	/** Prefabs that can be built even though they are not listed in the build menu */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Network")
+	TArray<UPrefabricatorAssetInterface*> AdditionalBuildablePrefabs;
+
+	/** The server rejects the batches with more records than this */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Network")
+	int32 MaxCommandsPerBatch = 256;
+
 	UPROPERTY(Transient)
 	UUserWidget* BuildMenuUIInstance;
 
@@ -118,6 +158,9 @@ public:
 private:
 	bool bConstructionSystemEnabled = false;
 	bool bInputBound = false;
+
+	TArray<FConstructionSystemCommandRecord> PendingCommands;
+	float TimeSinceCommandFlush = 0.0f;
 };
 
 
@@ -127,5 +170,9 @@ class CONSTRUCTIONSYSTEMRUNTIME_API UConstructionSystemItemUserData : public UAs
 public:
 	UPROPERTY(VisibleAnywhere, Category = "Prefabricator")
 	int32 Seed;
+
+	/** Id of the piece in the construction system, shared by the server and the clients. Zero if the piece is not tracked */
+	UPROPERTY(VisibleAnywhere, Category = "Prefabricator")
+	uint32 ItemId = 0;
 };
 
@@ -0,0 +1,22 @@
+//$ Copyright 2015-23, Code Respawn Technologies Pvt Ltd - All Rights Reserved $//
+
+#pragma once
+#include "CoreMinimal.h"
+
+DECLARE_STATS_GROUP(TEXT("ConstructionSystem"), STATGROUP_ConstructionSystem, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT(TEXT("Net - Execute Commands"), STAT_ConstructionNet_ExecuteCommands, STATGROUP_ConstructionSystem);
+DECLARE_CYCLE_STAT(TEXT("Net - Validate Batch"), STAT_ConstructionNet_Validate, STATGROUP_ConstructionSystem);
+DECLARE_CYCLE_STAT(TEXT("Net - Learn Snap Boxes"), STAT_ConstructionNet_LearnSnapBoxes, STATGROUP_ConstructionSystem);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Net - Records Received"), STAT_ConstructionNet_NumRecords, STATGROUP_ConstructionSystem);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Net - Records Rejected"), STAT_ConstructionNet_NumRejected, STATGROUP_ConstructionSystem);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Net - Records Sent"), STAT_ConstructionNet_NumSent, STATGROUP_ConstructionSystem);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Net - Constructed Items"), STAT_ConstructionNet_NumItems, STATGROUP_ConstructionSystem);
+
+DECLARE_CYCLE_STAT(TEXT("Structure - Support Check"), STAT_ConstructionStructure_SupportCheck, STATGROUP_ConstructionSystem);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Structure - Pieces Visited"), STAT_ConstructionStructure_NumVisited, STATGROUP_ConstructionSystem);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Structure - Pieces Collapsed"), STAT_ConstructionStructure_NumCollapsed, STATGROUP_ConstructionSystem);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Structure - Pending Support Checks"), STAT_ConstructionStructure_NumPendingChecks, STATGROUP_ConstructionSystem);
+
+DECLARE_CYCLE_STAT(TEXT("Geometry - Validate Placement"), STAT_ConstructionGeometry_Validate, STATGROUP_ConstructionSystem);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Geometry - Boxes Tested"), STAT_ConstructionGeometry_NumBoxesTested, STATGROUP_ConstructionSystem);
@@ -7,19 +7,66 @@
 class APrefabActor;
 class UPrefabricatorConstructionSnapComponent;
 class UPrefabricatorAssetInterface;
+enum class EPrefabricatorConstructionSnapType : uint8;
+struct FConstructionSystemSnapBox;
+struct FOverlapResult;
+
+/** A way to attach the cursor to a nearby piece, see FConstructionSystemUtils::FindSnapCandidates */
+struct FConstructionSystemSnapCandidate {
+	UPrefabricatorConstructionSnapComponent* HostSnap = nullptr;
+	int32 CursorSnapIndex = INDEX_NONE;
+	FTransform Transform;
+	/** Squared distance from the attached cursor snap box to the requested location, lower is better */
+	float Score = 0.0f;
+};
 
 class CONSTRUCTIONSYSTEMRUNTIME_API FConstructionSystemUtils {
 public:
 	static ECollisionChannel FindPrefabSnapChannel();
 	static APrefabActor* FindTopMostPrefabActor(UPrefabricatorConstructionSnapComponent* SnapComponent);
-	static APrefabActor* ConstructPrefabItem(UWorld* InWorld, UPrefabricatorAssetInterface* InPrefabAsset, const FTransform& InTransform, int32 InSeed);
+	/** Spawns a constructed piece. With bInDeferBuild, the children are built later on the time sliced prefab build system */
+	static APrefabActor* ConstructPrefabItem(UWorld* InWorld, UPrefabricatorAssetInterface* InPrefabAsset, const FTransform& InTransform, int32 InSeed, uint32 InItemId = 0, bool bInDeferBuild = false);
 	static bool GetSnapPoint(UPrefabricatorConstructionSnapComponent* InFixedSnapComp, UPrefabricatorConstructionSnapComponent* InNewSnapComp,
 		const FVector& InRequestedSnapLocation, FTransform& OutTargetSnapTransform, int32 CursorRotationStep = 0, float InSnapTolerrance = 200.0f);
+
+	/**
+	 * Computes the placements of a drag, from the start transform towards the end location, stepping by the size of the snap box.
+	 * Walls are laid along their length. Floors are laid along their dominant axis, or over a grid with bInGrid.
+	 * OutParentIndices holds, for each placement, the index of the earlier placement it is snapped to (INDEX_NONE for the first one)
+	 */
+	static void GetDragPlacements(UPrefabricatorConstructionSnapComponent* InSnapComponent, const FTransform& InItemTransform, const FTransform& InStartTransform,
+		const FVector& InEndLocation, bool bInGrid, int32 InMaxPlacements, TArray<FTransform>& OutTransforms, TArray<int32>& OutParentIndices);
+
+	/** Gathers the hit snap host and the snap components of the constructed pieces within InRadius of the location, from the construction geometry index */
+	static void GatherSnapHosts(UWorld* InWorld, UPrefabricatorConstructionSnapComponent* InHitSnap, const FVector& InLocation, float InRadius, TArray<UPrefabricatorConstructionSnapComponent*>& OutHostSnaps);
+
+	/**
+	 * Tries every (host snap, cursor snap) pair with GetSnapPoint and keeps the InMaxCandidates best attachments, sorted by score.
+	 * The hosts too far from the requested location to be reached by any cursor snap are skipped before calling GetSnapPoint
+	 */
+	static void FindSnapCandidates(TArrayView<UPrefabricatorConstructionSnapComponent* const> InHostSnaps, TArrayView<UPrefabricatorConstructionSnapComponent* const> InCursorSnaps,
+		const FVector& InRequestedSnapLocation, int32 CursorRotationStep, float InSnapTolerrance, int32 InMaxCandidates, TArray<FConstructionSystemSnapCandidate>& OutCandidates);
+
+	/** Gathers the world space snap boxes of a built piece, from the snap components of all its children */
+	static void GetSnapBoxes(APrefabActor* InItemActor, TArray<FConstructionSystemSnapBox>& OutBoxes);
 };
 
 class CONSTRUCTIONSYSTEMRUNTIME_API FConstructionSystemCollision {
 public:
 	static bool WallWallCollision(const FVector& ExtentA, const FTransform& TransformA, const FVector& ExtentB, const FTransform& TransformB);
 	static bool WallBoxCollision(const FVector& WallExtent, const FTransform& WallTransform, const FVector& BoxExtent, const FTransform& BoxTransform);
+
+	/** Separating axis test of two oriented boxes. The transforms have no scale */
+	static bool BoxesOverlap(const FVector& ExtentA, const FTransform& TransformA, const FVector& ExtentB, const FTransform& TransformB);
+
+	/**
+	 * Decides if a new snap box (A) collides with an existing one (B) whose bounds it overlaps.
+	 * Walls may touch other walls and floors along their edges, everything else collides
+	 */
+	static bool SnapBoxesCollide(EPrefabricatorConstructionSnapType TypeA, const FVector& ExtentA, const FTransform& TransformA,
+		EPrefabricatorConstructionSnapType TypeB, const FVector& ExtentB, const FTransform& TransformB);
+
+	/** Returns true if one of the overlapped snap components collides with the new snap box */
+	static bool HasCollidingSnapOverlap(const FConstructionSystemSnapBox& InBox, TArrayView<const FOverlapResult> InOverlaps);
 };
 
@@ -62,6 +62,7 @@ namespace UnrealBuildTool.Rules
 				    "ContentBrowser",
 				    "ContentBrowserData",
                     "Projects",
+                    "Json",
                     "PrefabricatorRuntime",
 					"SceneOutliner"
 					// ... add private dependencies that you statically link with here ...
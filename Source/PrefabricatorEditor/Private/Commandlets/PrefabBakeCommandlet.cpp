@@ -0,0 +1,357 @@
+//$ Copyright 2015-23, Code Respawn Technologies Pvt Ltd - All Rights Reserved $//
+
+#include "Commandlets/PrefabBakeCommandlet.h"
+
+#include "Asset/PrefabricatorAsset.h"
+#include "Asset/PrefabricatorAssetUserData.h"
+#include "Prefab/PrefabActor.h"
+#include "Prefab/PrefabComponent.h"
+#include "Prefab/Random/PrefabRandomizerActor.h"
+#include "Prefab/Random/PrefabSeedLinker.h"
+
+#include "AssetRegistry/IAssetRegistry.h"
+#include "Dom/JsonObject.h"
+#include "Engine/Level.h"
+#include "Engine/World.h"
+#include "Misc/FileHelper.h"
+#include "Misc/PackageName.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+#include "UObject/Package.h"
+#include "UObject/SavePackage.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogPrefabBake, Log, All);
+
+namespace {
+	/** Root components that were saved into the prefab live on the prefab actor itself and would be lost with it */
+	bool HasPrefabRootComponents(APrefabActor* InPrefab) {
+		for (UActorComponent* Component : InPrefab->GetComponents()) {
+			// The prefab component of a nested prefab carries the user data of the parent prefab
+			if (Component && Component != InPrefab->GetRootComponent() && Component->GetAssetUserData<UPrefabricatorAssetUserData>()) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void StripPrefabUserData(AActor* InActor) {
+		for (UActorComponent* Component : InActor->GetComponents()) {
+			if (Component) {
+				Component->RemoveUserDataOfClass(UPrefabricatorAssetUserData::StaticClass());
+			}
+		}
+	}
+
+	FString GetPrefabAssetPath(APrefabActor* InPrefab) {
+		return InPrefab && InPrefab->PrefabComponent ? InPrefab->PrefabComponent->PrefabAssetInterface.ToString() : FString();
+	}
+
+	/** Prefabs whose children are changed at runtime by other actors in the level */
+	void GatherDynamicPrefabs(ULevel* InLevel, TSet<APrefabActor*>& OutDynamicPrefabs, bool& bOutAllDynamic) {
+		for (AActor* Actor : InLevel->Actors) {
+			if (APrefabRandomizer* Randomizer = Cast<APrefabRandomizer>(Actor)) {
+				if (Randomizer->bRandomizeOnBeginPlay) {
+					// An empty list randomizes every prefab in the level
+					if (Randomizer->ActorsToRandomize.Num() == 0) {
+						bOutAllDynamic = true;
+					}
+					for (APrefabActor* Prefab : Randomizer->ActorsToRandomize) {
+						OutDynamicPrefabs.Add(Prefab);
+					}
+				}
+			}
+			else if (APrefabSeedLinker* SeedLinker = Cast<APrefabSeedLinker>(Actor)) {
+				for (const TWeakObjectPtr<APrefabActor>& Prefab : SeedLinker->LinkedActors) {
+					OutDynamicPrefabs.Add(Prefab.Get());
+				}
+			}
+		}
+	}
+}
+
+UPrefabBakeCommandlet::UPrefabBakeCommandlet()
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+
+	HelpDescription = TEXT("Flattens static prefab instances into plain level actors and writes a manifest of the baked actors");
+	HelpUsage = TEXT("-run=PrefabBake -Maps=/Game/Maps/MapA+/Game/Maps/MapB [-AllMaps] [-Manifest=<File>] [-DryRun]");
+	HelpParamNames.Add(TEXT("Maps"));
+	HelpParamDescriptions.Add(TEXT("'+' separated list of map packages to bake"));
+	HelpParamNames.Add(TEXT("AllMaps"));
+	HelpParamDescriptions.Add(TEXT("Bake every map under /Game"));
+	HelpParamNames.Add(TEXT("Manifest"));
+	HelpParamDescriptions.Add(TEXT("Output file of the manifest. Defaults to Saved/Prefabricator/PrefabBakeManifest.json"));
+	HelpParamNames.Add(TEXT("DryRun"));
+	HelpParamDescriptions.Add(TEXT("Only write the manifest, the maps are not modified"));
+}
+
+int32 UPrefabBakeCommandlet::Main(const FString& Params)
+{
+	TArray<FString> Tokens;
+	TArray<FString> Switches;
+	TMap<FString, FString> ParamVals;
+	ParseCommandLine(*Params, Tokens, Switches, ParamVals);
+
+	const bool bDryRun = Switches.Contains(TEXT("DryRun"));
+
+	TArray<FString> MapPackageNames;
+	if (const FString* MapsParam = ParamVals.Find(TEXT("Maps"))) {
+		MapsParam->ParseIntoArray(MapPackageNames, TEXT("+"));
+	}
+
+	if (Switches.Contains(TEXT("AllMaps"))) {
+		IAssetRegistry& AssetRegistry = IAssetRegistry::GetChecked();
+		AssetRegistry.SearchAllAssets(true);
+
+		TArray<FAssetData> MapAssets;
+		AssetRegistry.GetAssetsByClass(UWorld::StaticClass()->GetClassPathName(), MapAssets);
+		for (const FAssetData& MapAsset : MapAssets) {
+			const FString PackageName = MapAsset.PackageName.ToString();
+			if (PackageName.StartsWith(TEXT("/Game/"))) {
+				MapPackageNames.AddUnique(PackageName);
+			}
+		}
+	}
+
+	if (MapPackageNames.Num() == 0) {
+		UE_LOG(LogPrefabBake, Error, TEXT("No maps specified. Usage: %s"), *HelpUsage);
+		return 1;
+	}
+
+	FString ManifestPath = FPaths::ProjectSavedDir() / TEXT("Prefabricator") / TEXT("PrefabBakeManifest.json");
+	if (const FString* ManifestParam = ParamVals.Find(TEXT("Manifest"))) {
+		ManifestPath = *ManifestParam;
+	}
+
+	TArray<TSharedPtr<FJsonValue>> MapEntries;
+	int32 NumFailedMaps = 0;
+	for (const FString& MapPackageName : MapPackageNames) {
+		TSharedPtr<FJsonObject> MapEntry;
+		if (!BakeMap(MapPackageName, bDryRun, MapEntry)) {
+			NumFailedMaps++;
+		}
+		if (MapEntry.IsValid()) {
+			MapEntries.Add(MakeShared<FJsonValueObject>(MapEntry));
+		}
+	}
+
+	TSharedRef<FJsonObject> Manifest = MakeShared<FJsonObject>();
+	Manifest->SetNumberField(TEXT("Version"), 1);
+	Manifest->SetBoolField(TEXT("DryRun"), bDryRun);
+	Manifest->SetArrayField(TEXT("Maps"), MapEntries);
+
+	FString ManifestText;
+	TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&ManifestText);
+	FJsonSerializer::Serialize(Manifest, Writer);
+	if (!FFileHelper::SaveStringToFile(ManifestText, *ManifestPath)) {
+		UE_LOG(LogPrefabBake, Error, TEXT("Failed to write the bake manifest: %s"), *ManifestPath);
+		return 1;
+	}
+	UE_LOG(LogPrefabBake, Display, TEXT("Wrote the bake manifest: %s"), *ManifestPath);
+
+	return NumFailedMaps == 0 ? 0 : 1;
+}
+
+bool UPrefabBakeCommandlet::BakeMap(const FString& InMapPackageName, bool bDryRun, TSharedPtr<FJsonObject>& OutMapEntry)
+{
+	UPackage* Package = LoadPackage(nullptr, *InMapPackageName, LOAD_None);
+	UWorld* World = Package ? UWorld::FindWorldInPackage(Package) : nullptr;
+	if (!World) {
+		UE_LOG(LogPrefabBake, Error, TEXT("Failed to load map: %s"), *InMapPackageName);
+		return false;
+	}
+
+	OutMapEntry = MakeShared<FJsonObject>();
+	OutMapEntry->SetStringField(TEXT("Map"), InMapPackageName);
+
+	if (World->IsPartitionedWorld()) {
+		// The actors of partitioned worlds live in external packages that are not loaded here
+		UE_LOG(LogPrefabBake, Warning, TEXT("Skipping world partition map: %s"), *InMapPackageName);
+		OutMapEntry->SetStringField(TEXT("Skipped"), TEXT("World partition maps are not supported"));
+		return true;
+	}
+
+	const bool bInitializeWorld = !World->bIsWorldInitialized;
+	if (bInitializeWorld) {
+		World->WorldType = EWorldType::Editor;
+		World->InitWorld(UWorld::InitializationValues()
+			.AllowAudioPlayback(false)
+			.CreatePhysicsScene(false)
+			.RequiresHitProxies(false)
+			.CreateNavigation(false)
+			.CreateAISystem(false)
+			.ShouldSimulatePhysics(false)
+			.SetTransactional(false));
+		World->UpdateWorldComponents(true, false);
+	}
+
+	const int32 NumBaked = BakeWorld(World, bDryRun, OutMapEntry);
+
+	bool bSuccess = true;
+	if (!bDryRun && NumBaked > 0) {
+		const FString Filename = FPackageName::LongPackageNameToFilename(InMapPackageName, FPackageName::GetMapPackageExtension());
+		FSavePackageArgs SaveArgs;
+		SaveArgs.TopLevelFlags = RF_Standalone;
+		bSuccess = UPackage::SavePackage(Package, World, *Filename, SaveArgs);
+		if (!bSuccess) {
+			UE_LOG(LogPrefabBake, Error, TEXT("Failed to save map: %s"), *Filename);
+		}
+	}
+	UE_LOG(LogPrefabBake, Display, TEXT("%s: baked %d prefab instances"), *InMapPackageName, NumBaked);
+
+	if (bInitializeWorld) {
+		World->DestroyWorld(false);
+	}
+	CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+	return bSuccess;
+}
+
+int32 UPrefabBakeCommandlet::BakeWorld(UWorld* InWorld, bool bDryRun, TSharedPtr<FJsonObject> MapEntry)
+{
+	ULevel* Level = InWorld->PersistentLevel;
+
+	TSet<APrefabActor*> DynamicPrefabs;
+	bool bAllDynamic = false;
+	GatherDynamicPrefabs(Level, DynamicPrefabs, bAllDynamic);
+
+	TArray<TSharedPtr<FJsonValue>> PrefabEntries;
+	TArray<TSharedPtr<FJsonValue>> SkippedEntries;
+	if (bAllDynamic) {
+		MapEntry->SetStringField(TEXT("Skipped"), TEXT("A randomizer re-randomizes every prefab in the level on begin play"));
+	}
+	else {
+		// Copy the list, baking destroys actors
+		TArray<APrefabActor*> TopLevelPrefabs;
+		for (AActor* Actor : Level->Actors) {
+			APrefabActor* Prefab = Cast<APrefabActor>(Actor);
+			if (Prefab && !Prefab->IsPendingKillPending() && !Cast<APrefabActor>(Prefab->GetAttachParentActor())) {
+				TopLevelPrefabs.Add(Prefab);
+			}
+		}
+
+		for (APrefabActor* Prefab : TopLevelPrefabs) {
+			FString SkipReason;
+			if (!CanBakePrefab(Prefab, DynamicPrefabs, SkipReason)) {
+				TSharedPtr<FJsonObject> SkippedEntry = MakeShared<FJsonObject>();
+				SkippedEntry->SetStringField(TEXT("Actor"), Prefab->GetName());
+				SkippedEntry->SetStringField(TEXT("Prefab"), GetPrefabAssetPath(Prefab));
+				SkippedEntry->SetStringField(TEXT("Reason"), SkipReason);
+				SkippedEntries.Add(MakeShared<FJsonValueObject>(SkippedEntry));
+				continue;
+			}
+
+			PrefabEntries.Add(MakeShared<FJsonValueObject>(BakePrefab(Prefab, bDryRun)));
+		}
+	}
+
+	MapEntry->SetArrayField(TEXT("Prefabs"), PrefabEntries);
+	MapEntry->SetArrayField(TEXT("SkippedPrefabs"), SkippedEntries);
+	return PrefabEntries.Num();
+}
+
+bool UPrefabBakeCommandlet::CanBakePrefab(APrefabActor* InPrefab, const TSet<APrefabActor*>& InDynamicPrefabs, FString& OutReason) const
+{
+	TArray<APrefabActor*> PrefabTree;
+	PrefabTree.Add(InPrefab);
+	InPrefab->ForEachDescendant([&PrefabTree](AActor* Descendant) {
+		if (APrefabActor* NestedPrefab = Cast<APrefabActor>(Descendant)) {
+			PrefabTree.Add(NestedPrefab);
+		}
+	});
+
+	for (APrefabActor* Prefab : PrefabTree) {
+		if (Prefab->IsA<AReplicablePrefabActor>()) {
+			OutReason = FString::Printf(TEXT("%s is replicated"), *Prefab->GetName());
+			return false;
+		}
+		if (Prefab->bMaterializeOnDemand) {
+			OutReason = FString::Printf(TEXT("%s materializes on demand"), *Prefab->GetName());
+			return false;
+		}
+		if (InDynamicPrefabs.Contains(Prefab)) {
+			OutReason = FString::Printf(TEXT("%s is randomized at runtime"), *Prefab->GetName());
+			return false;
+		}
+		if (HasPrefabRootComponents(Prefab)) {
+			OutReason = FString::Printf(TEXT("%s has components on the prefab root"), *Prefab->GetName());
+			return false;
+		}
+	}
+	return true;
+}
+
+TSharedPtr<FJsonObject> UPrefabBakeCommandlet::BakePrefab(APrefabActor* InPrefab, bool bDryRun)
+{
+	TSharedPtr<FJsonObject> PrefabEntry = MakeShared<FJsonObject>();
+	PrefabEntry->SetStringField(TEXT("Actor"), InPrefab->GetName());
+	PrefabEntry->SetStringField(TEXT("Label"), InPrefab->GetActorLabel());
+	PrefabEntry->SetStringField(TEXT("Prefab"), GetPrefabAssetPath(InPrefab));
+	PrefabEntry->SetNumberField(TEXT("Seed"), InPrefab->Seed);
+	PrefabEntry->SetStringField(TEXT("Transform"), InPrefab->GetActorTransform().ToString());
+
+	// Parents come before their children in the descendant list
+	TArray<APrefabActor*> Prefabs;
+	TArray<AActor*> BakedActors;
+	Prefabs.Add(InPrefab);
+	InPrefab->ForEachDescendant([&Prefabs, &BakedActors](AActor* Descendant) {
+		if (APrefabActor* NestedPrefab = Cast<APrefabActor>(Descendant)) {
+			Prefabs.Add(NestedPrefab);
+		}
+		else {
+			BakedActors.Add(Descendant);
+		}
+	});
+
+	TArray<TSharedPtr<FJsonValue>> ActorEntries;
+	for (AActor* BakedActor : BakedActors) {
+		TSharedPtr<FJsonObject> ActorEntry = MakeShared<FJsonObject>();
+		ActorEntry->SetStringField(TEXT("Name"), BakedActor->GetName());
+		ActorEntry->SetStringField(TEXT("Label"), BakedActor->GetActorLabel());
+
+		APrefabActor* OwningPrefab = Cast<APrefabActor>(BakedActor->GetAttachParentActor());
+		USceneComponent* RootComponent = BakedActor->GetRootComponent();
+		if (UPrefabricatorAssetUserData* PrefabUserData = RootComponent ? RootComponent->GetAssetUserData<UPrefabricatorAssetUserData>() : nullptr) {
+			ActorEntry->SetStringField(TEXT("ItemID"), PrefabUserData->ItemID.ToString());
+			if (PrefabUserData->PrefabActor.IsValid()) {
+				OwningPrefab = PrefabUserData->PrefabActor.Get();
+			}
+		}
+		if (OwningPrefab) {
+			ActorEntry->SetStringField(TEXT("SourcePrefab"), GetPrefabAssetPath(OwningPrefab));
+			ActorEntry->SetStringField(TEXT("SourceActor"), OwningPrefab->GetName());
+		}
+		ActorEntries.Add(MakeShared<FJsonValueObject>(ActorEntry));
+	}
+	PrefabEntry->SetArrayField(TEXT("BakedActors"), ActorEntries);
+
+	if (bDryRun) {
+		return PrefabEntry;
+	}
+
+	// Actors attached to a prefab move up to whatever the top level prefab was attached to.
+	// Attachments between plain actors are kept as they are
+	AActor* NewParent = InPrefab->GetAttachParentActor();
+	const FName FolderPath = InPrefab->GetFolderPath();
+	for (AActor* BakedActor : BakedActors) {
+		if (Cast<APrefabActor>(BakedActor->GetAttachParentActor())) {
+			BakedActor->DetachFromActor(FDetachmentTransformRules::KeepWorldTransform);
+			if (NewParent) {
+				BakedActor->AttachToActor(NewParent, FAttachmentTransformRules::KeepWorldTransform);
+			}
+		}
+		StripPrefabUserData(BakedActor);
+		BakedActor->SetFolderPath(FolderPath);
+	}
+
+	// Children first. The prefabs are empty at this point so destroying them doesn't take anything else along
+	for (int32 Index = Prefabs.Num() - 1; Index >= 0; Index--) {
+		Prefabs[Index]->GetWorld()->EditorDestroyActor(Prefabs[Index], true);
+	}
+
+	return PrefabEntry;
+}
+
@@ -0,0 +1,405 @@
+//$ Copyright 2015-23, Code Respawn Technologies Pvt Ltd - All Rights Reserved $//
+
+#include "Commandlets/PrefabCostReportCommandlet.h"
+
+#include "Asset/PrefabricatorAsset.h"
+#include "Prefab/PrefabActor.h"
+#include "Prefab/PrefabComponent.h"
+#include "Prefab/PrefabLayoutResolver.h"
+#include "Prefab/PrefabTools.h"
+#include "Utils/PrefabricatorService.h"
+#include "Utils/PrefabricatorTelemetry.h"
+
+#include "AssetRegistry/ARFilter.h"
+#include "AssetRegistry/IAssetRegistry.h"
+#include "Engine/Level.h"
+#include "Engine/LevelStreaming.h"
+#include "Engine/World.h"
+#include "Misc/FileHelper.h"
+#include "Misc/PackageName.h"
+#include "Misc/Paths.h"
+#include "Serialization/ArchiveCountMem.h"
+#include "UObject/Package.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogPrefabCostReport, Log, All);
+
+namespace {
+	int64 GetSerializedBytes(const FPrefabricatorItemBase& InItem) {
+		int64 NumBytes = 0;
+		for (const FPrefabricatorProperty& Property : InItem.SerializedProperties) {
+			NumBytes += Property.ExportedValue.Len() * sizeof(TCHAR);
+			for (const auto& SerializedItemEntry : Property.SerializedItems) {
+				NumBytes += (SerializedItemEntry.Key.Len() + SerializedItemEntry.Value.ExportedValue.Len()) * sizeof(TCHAR);
+			}
+		}
+		return NumBytes;
+	}
+
+	void AddItemStats(const FPrefabricatorItemBase& InItem, FPrefabCostReportEntry& OutEntry) {
+		OutEntry.NumProperties += InItem.SerializedProperties.Num();
+		OutEntry.NumCrossReferences += InItem.CrossReferences.Num();
+		OutEntry.SerializedBytes += GetSerializedBytes(InItem);
+	}
+
+	FString FormatMs(double InMs) {
+		return InMs < 0 ? FString() : FString::Printf(TEXT("%.3f"), InMs);
+	}
+
+	/** Builds with the runtime service, so the timings are not skewed by the actor factories of the editor service */
+	struct FScopedRuntimePrefabService {
+		FScopedRuntimePrefabService()
+			: PreviousService(FPrefabricatorService::Get())
+		{
+			FPrefabricatorService::Set(MakeShareable(new FPrefabricatorRuntimeService));
+		}
+		~FScopedRuntimePrefabService() {
+			FPrefabricatorService::Set(PreviousService);
+		}
+	private:
+		TSharedPtr<IPrefabricatorService> PreviousService;
+	};
+}
+
+double FPrefabCostReportEntry::GetCost() const
+{
+	const double BuildMs = LoadMs >= 0 ? LoadMs : FirstLoadMs;
+	return FMath::Max(BuildMs, 0.0) * FMath::Max(NumInstances, 1);
+}
+
+UPrefabCostReportCommandlet::UPrefabCostReportCommandlet()
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+
+	HelpDescription = TEXT("Writes a CSV report of the cost of every prefab asset and ranks the most expensive ones");
+	HelpUsage = TEXT("-run=PrefabCostReport [-Paths=/Game/A+/Game/B] [-Maps=/Game/Maps/MapA+/Game/Maps/MapB] [-AllMaps] [-Output=<File.csv>] [-Top=20] [-Iterations=5] [-NoTiming]");
+	HelpParamNames.Add(TEXT("Paths"));
+	HelpParamDescriptions.Add(TEXT("'+' separated list of content paths to search for prefab assets. Defaults to /Game"));
+	HelpParamNames.Add(TEXT("Maps"));
+	HelpParamDescriptions.Add(TEXT("'+' separated list of maps to count the prefab instances of"));
+	HelpParamNames.Add(TEXT("AllMaps"));
+	HelpParamDescriptions.Add(TEXT("Count the prefab instances of every map under /Game"));
+	HelpParamNames.Add(TEXT("Output"));
+	HelpParamDescriptions.Add(TEXT("Output CSV file. Defaults to Saved/Prefabricator/PrefabCostReport.csv"));
+	HelpParamNames.Add(TEXT("Top"));
+	HelpParamDescriptions.Add(TEXT("Number of prefabs in the ranked list. Defaults to 20"));
+	HelpParamNames.Add(TEXT("Iterations"));
+	HelpParamDescriptions.Add(TEXT("Number of builds of each prefab that are timed. Defaults to 5"));
+	HelpParamNames.Add(TEXT("NoTiming"));
+	HelpParamDescriptions.Add(TEXT("Skip the build timings"));
+}
+
+int32 UPrefabCostReportCommandlet::Main(const FString& Params)
+{
+	TArray<FString> Tokens;
+	TArray<FString> Switches;
+	TMap<FString, FString> ParamVals;
+	ParseCommandLine(*Params, Tokens, Switches, ParamVals);
+
+	const bool bMeasureTime = !Switches.Contains(TEXT("NoTiming"));
+
+	TArray<FString> SearchPaths;
+	if (const FString* PathsParam = ParamVals.Find(TEXT("Paths"))) {
+		PathsParam->ParseIntoArray(SearchPaths, TEXT("+"));
+	}
+	if (SearchPaths.Num() == 0) {
+		SearchPaths.Add(TEXT("/Game"));
+	}
+
+	int32 TopCount = 20;
+	if (const FString* TopParam = ParamVals.Find(TEXT("Top"))) {
+		TopCount = FMath::Max(1, FCString::Atoi(**TopParam));
+	}
+
+	int32 Iterations = 5;
+	if (const FString* IterationsParam = ParamVals.Find(TEXT("Iterations"))) {
+		Iterations = FMath::Max(1, FCString::Atoi(**IterationsParam));
+	}
+
+	FString OutputPath = FPaths::ProjectSavedDir() / TEXT("Prefabricator") / TEXT("PrefabCostReport.csv");
+	if (const FString* OutputParam = ParamVals.Find(TEXT("Output"))) {
+		OutputPath = *OutputParam;
+	}
+
+	IAssetRegistry& AssetRegistry = IAssetRegistry::GetChecked();
+	AssetRegistry.SearchAllAssets(true);
+
+	TArray<FString> MapPackageNames;
+	if (const FString* MapsParam = ParamVals.Find(TEXT("Maps"))) {
+		MapsParam->ParseIntoArray(MapPackageNames, TEXT("+"));
+	}
+	if (Switches.Contains(TEXT("AllMaps"))) {
+		TArray<FAssetData> MapAssets;
+		AssetRegistry.GetAssetsByClass(UWorld::StaticClass()->GetClassPathName(), MapAssets);
+		for (const FAssetData& MapAsset : MapAssets) {
+			const FString PackageName = MapAsset.PackageName.ToString();
+			if (PackageName.StartsWith(TEXT("/Game/"))) {
+				MapPackageNames.AddUnique(PackageName);
+			}
+		}
+	}
+
+	// Instance counts first, the maps are released before the prefabs are measured
+	TMap<FString, int32> InstancesByPrefab;
+	TMap<FString, int32> LevelsByPrefab;
+	TArray<FString> LevelRows;
+	LevelRows.Add(TEXT("Map,Prefab,Instances"));
+	for (const FString& MapPackageName : MapPackageNames) {
+		TMap<FString, int32> MapInstances;
+		if (!CountInstances(MapPackageName, MapInstances)) {
+			continue;
+		}
+		for (const auto& Entry : MapInstances) {
+			InstancesByPrefab.FindOrAdd(Entry.Key) += Entry.Value;
+			LevelsByPrefab.FindOrAdd(Entry.Key)++;
+			LevelRows.Add(FString::Printf(TEXT("%s,%s,%d"), *FPrefabSpawnTelemetry::ToCsvField(MapPackageName), *FPrefabSpawnTelemetry::ToCsvField(Entry.Key), Entry.Value));
+		}
+		CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+	}
+
+	FARFilter Filter;
+	Filter.ClassPaths.Add(UPrefabricatorAsset::StaticClass()->GetClassPathName());
+	Filter.bRecursiveClasses = true;
+	Filter.bRecursivePaths = true;
+	for (const FString& SearchPath : SearchPaths) {
+		Filter.PackagePaths.Add(*SearchPath);
+	}
+
+	TArray<FAssetData> PrefabAssets;
+	AssetRegistry.GetAssets(Filter, PrefabAssets);
+	UE_LOG(LogPrefabCostReport, Display, TEXT("Measuring %d prefab assets"), PrefabAssets.Num());
+
+	UWorld* ScratchWorld = nullptr;
+	if (bMeasureTime) {
+		// Rooted by CreateWorld, so it survives the garbage collections between the assets
+		ScratchWorld = UWorld::CreateWorld(EWorldType::Editor, false, TEXT("PrefabCostReport"));
+	}
+
+	TArray<FPrefabCostReportEntry> Entries;
+	Entries.Reserve(PrefabAssets.Num());
+	for (int32 AssetIndex = 0; AssetIndex < PrefabAssets.Num(); AssetIndex++) {
+		UPrefabricatorAsset* PrefabAsset = Cast<UPrefabricatorAsset>(PrefabAssets[AssetIndex].GetAsset());
+		if (!PrefabAsset) {
+			UE_LOG(LogPrefabCostReport, Warning, TEXT("Failed to load prefab asset: %s"), *PrefabAssets[AssetIndex].PackageName.ToString());
+			continue;
+		}
+
+		FPrefabCostReportEntry& Entry = Entries.AddDefaulted_GetRef();
+		GatherAssetStats(PrefabAsset, Entry);
+		Entry.NumInstances = InstancesByPrefab.FindRef(Entry.PrefabPath);
+		Entry.NumLevels = LevelsByPrefab.FindRef(Entry.PrefabPath);
+		if (ScratchWorld) {
+			MeasureLoadTime(ScratchWorld, PrefabAsset, Iterations, Entry);
+		}
+
+		if ((AssetIndex + 1) % 64 == 0) {
+			UE_LOG(LogPrefabCostReport, Display, TEXT("Measured %d / %d"), AssetIndex + 1, PrefabAssets.Num());
+			CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+		}
+	}
+
+	if (ScratchWorld) {
+		ScratchWorld->RemoveFromRoot();
+		ScratchWorld->DestroyWorld(false);
+	}
+
+	Entries.Sort([](const FPrefabCostReportEntry& A, const FPrefabCostReportEntry& B) {
+		return A.GetCost() != B.GetCost() ? A.GetCost() > B.GetCost() : A.SerializedBytes > B.SerializedBytes;
+	});
+
+	bool bSuccess = WriteCsv(OutputPath, Entries);
+	const FString TopPath = FPaths::GetPath(OutputPath) / FPaths::GetBaseFilename(OutputPath) + FString::Printf(TEXT("_Top%d.csv"), TopCount);
+	bSuccess &= WriteCsv(TopPath, TArrayView<const FPrefabCostReportEntry>(Entries).Left(TopCount));
+	if (MapPackageNames.Num() > 0) {
+		const FString LevelsPath = FPaths::GetPath(OutputPath) / FPaths::GetBaseFilename(OutputPath) + TEXT("_Levels.csv");
+		bSuccess &= FFileHelper::SaveStringArrayToFile(LevelRows, *LevelsPath);
+	}
+
+	UE_LOG(LogPrefabCostReport, Display, TEXT("Top %d prefabs by build cost:"), FMath::Min(TopCount, Entries.Num()));
+	for (int32 Rank = 0; Rank < FMath::Min(TopCount, Entries.Num()); Rank++) {
+		const FPrefabCostReportEntry& Entry = Entries[Rank];
+		UE_LOG(LogPrefabCostReport, Display, TEXT("%3d. %s: %.3f ms x %d instances, %d actors, depth %d, %lld bytes"),
+			Rank + 1, *Entry.PrefabPath, FMath::Max(Entry.LoadMs, Entry.FirstLoadMs), Entry.NumInstances, Entry.NumActors, Entry.NestingDepth, Entry.SerializedBytes);
+	}
+
+	if (!bSuccess) {
+		UE_LOG(LogPrefabCostReport, Error, TEXT("Failed to write the cost report: %s"), *OutputPath);
+		return 1;
+	}
+	UE_LOG(LogPrefabCostReport, Display, TEXT("Wrote the cost report: %s"), *OutputPath);
+	return 0;
+}
+
+void UPrefabCostReportCommandlet::GatherAssetStats(UPrefabricatorAsset* InPrefabAsset, FPrefabCostReportEntry& OutEntry)
+{
+	OutEntry.PrefabPath = InPrefabAsset->GetPathName();
+	OutEntry.NumActors = InPrefabAsset->ActorItems.Num();
+	OutEntry.NumComponents = InPrefabAsset->ComponentItems.Num();
+
+	for (const FPrefabricatorComponentData& ComponentItem : InPrefabAsset->ComponentItems) {
+		AddItemStats(ComponentItem, OutEntry);
+	}
+	for (const FPrefabricatorActorData& ActorItem : InPrefabAsset->ActorItems) {
+		AddItemStats(ActorItem, OutEntry);
+		OutEntry.NumComponents += ActorItem.ComponentItems.Num();
+		for (const FPrefabricatorComponentData& ComponentItem : ActorItem.ComponentItems) {
+			AddItemStats(ComponentItem, OutEntry);
+		}
+	}
+
+	OutEntry.NestingDepth = GetNestingDepth(InPrefabAsset, 0);
+
+	// Everything the asset object owns: the item arrays, the property text and the lookups
+	FArchiveCountMem CountMem(InPrefabAsset);
+	OutEntry.EstimatedMemoryBytes = CountMem.GetMax();
+}
+
+int32 UPrefabCostReportCommandlet::GetNestingDepth(UPrefabricatorAssetInterface* InPrefab, int32 InDepth)
+{
+	if (!InPrefab) {
+		return 0;
+	}
+
+	const FSoftObjectPath PrefabPath(InPrefab);
+	if (const int32* CachedDepth = NestingDepthCache.Find(PrefabPath)) {
+		return *CachedDepth;
+	}
+
+	if (InDepth >= FPrefabLayoutResolver::MaxNestingDepth) {
+		UE_LOG(LogPrefabCostReport, Warning, TEXT("Prefab nesting is too deep, possible circular reference: %s"), *InPrefab->GetPathName());
+		return 0;
+	}
+
+	int32 Depth = 0;
+	if (UPrefabricatorAssetCollection* Collection = Cast<UPrefabricatorAssetCollection>(InPrefab)) {
+		// Any of the collection items may be picked, so take the deepest
+		for (const FPrefabricatorAssetCollectionItem& CollectionItem : Collection->Prefabs) {
+			Depth = FMath::Max(Depth, GetNestingDepth(CollectionItem.PrefabAsset.LoadSynchronous(), InDepth));
+		}
+	}
+	else if (UPrefabricatorAsset* PrefabAsset = Cast<UPrefabricatorAsset>(InPrefab)) {
+		for (const FPrefabricatorActorData& ActorItem : PrefabAsset->ActorItems) {
+			const FSoftObjectPath NestedPrefabPath = FPrefabLayoutResolver::GetNestedPrefabPath(ActorItem);
+			if (!NestedPrefabPath.IsNull()) {
+				UPrefabricatorAssetInterface* NestedPrefab = Cast<UPrefabricatorAssetInterface>(NestedPrefabPath.TryLoad());
+				Depth = FMath::Max(Depth, 1 + GetNestingDepth(NestedPrefab, InDepth + 1));
+			}
+		}
+	}
+
+	NestingDepthCache.Add(PrefabPath, Depth);
+	return Depth;
+}
+
+void UPrefabCostReportCommandlet::MeasureLoadTime(UWorld* InWorld, UPrefabricatorAsset* InPrefabAsset, int32 InIterations, FPrefabCostReportEntry& OutEntry) const
+{
+	FScopedRuntimePrefabService RuntimeService;
+
+	double WarmLoadMs = 0;
+	for (int32 Iteration = 0; Iteration < InIterations; Iteration++) {
+		APrefabActor* PrefabActor = InWorld->SpawnActor<APrefabActor>(APrefabActor::StaticClass(), FTransform::Identity);
+		if (!PrefabActor) {
+			UE_LOG(LogPrefabCostReport, Warning, TEXT("Failed to spawn a prefab actor for %s"), *OutEntry.PrefabPath);
+			return;
+		}
+		PrefabActor->PrefabComponent->PrefabAssetInterface = InPrefabAsset;
+
+		// Same settings as a runtime spawn with a fixed seed. The templates are left out so every iteration loads the item state
+		FRandomStream Random(0);
+		FPrefabLoadSettings LoadSettings;
+		LoadSettings.bRandomizeNestedSeed = true;
+		LoadSettings.Random = &Random;
+		LoadSettings.bCanLoadFromCachedTemplate = false;
+		LoadSettings.bCanSaveToCachedTemplate = false;
+
+		const double StartTime = FPlatformTime::Seconds();
+		FPrefabTools::LoadStateFromPrefabAsset(PrefabActor, LoadSettings);
+		const double LoadMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+		if (Iteration == 0) {
+			// Includes loading the classes and assets the prefab references
+			OutEntry.FirstLoadMs = LoadMs;
+		}
+		else {
+			WarmLoadMs += LoadMs;
+		}
+
+		// Children first
+		const TArray<TWeakObjectPtr<AActor>> Descendants = PrefabActor->GetDescendants();
+		for (int32 Index = Descendants.Num() - 1; Index >= 0; Index--) {
+			if (AActor* Descendant = Descendants[Index].Get()) {
+				InWorld->DestroyActor(Descendant);
+			}
+		}
+		InWorld->DestroyActor(PrefabActor);
+	}
+
+	OutEntry.LoadMs = InIterations > 1 ? WarmLoadMs / (InIterations - 1) : OutEntry.FirstLoadMs;
+}
+
+bool UPrefabCostReportCommandlet::CountInstances(const FString& InMapPackageName, TMap<FString, int32>& OutInstancesByPrefab) const
+{
+	UPackage* Package = LoadPackage(nullptr, *InMapPackageName, LOAD_None);
+	UWorld* World = Package ? UWorld::FindWorldInPackage(Package) : nullptr;
+	if (!World) {
+		UE_LOG(LogPrefabCostReport, Error, TEXT("Failed to load map: %s"), *InMapPackageName);
+		return false;
+	}
+
+	if (World->IsPartitionedWorld()) {
+		// The actors of partitioned worlds live in external packages that are not loaded here
+		UE_LOG(LogPrefabCostReport, Warning, TEXT("Skipping world partition map: %s"), *InMapPackageName);
+		return false;
+	}
+
+	TArray<ULevel*> Levels;
+	Levels.Add(World->PersistentLevel);
+	for (ULevelStreaming* StreamingLevel : World->GetStreamingLevels()) {
+		if (ULevel* StreamedLevel = StreamingLevel ? StreamingLevel->GetLoadedLevel() : nullptr) {
+			Levels.Add(StreamedLevel);
+		}
+	}
+
+	// Nested prefab actors are counted as instances of their own asset
+	for (ULevel* Level : Levels) {
+		for (AActor* Actor : Level->Actors) {
+			APrefabActor* PrefabActor = Cast<APrefabActor>(Actor);
+			if (PrefabActor && PrefabActor->PrefabComponent) {
+				const FString PrefabPath = PrefabActor->PrefabComponent->PrefabAssetInterface.ToSoftObjectPath().GetAssetPathString();
+				if (!PrefabPath.IsEmpty()) {
+					OutInstancesByPrefab.FindOrAdd(PrefabPath)++;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+bool UPrefabCostReportCommandlet::WriteCsv(const FString& InPath, TArrayView<const FPrefabCostReportEntry> InEntries)
+{
+	TArray<FString> Rows;
+	Rows.Reserve(InEntries.Num() + 1);
+	Rows.Add(TEXT("Rank,Prefab,Actors,Components,Properties,CrossReferences,NestingDepth,SerializedBytes,EstimatedMemoryBytes,FirstLoadMs,LoadMs,Instances,Levels,TotalCostMs"));
+	for (int32 Rank = 0; Rank < InEntries.Num(); Rank++) {
+		const FPrefabCostReportEntry& Entry = InEntries[Rank];
+		Rows.Add(FString::Printf(TEXT("%d,%s,%d,%d,%d,%d,%d,%lld,%lld,%s,%s,%d,%d,%.3f"),
+			Rank + 1,
+			*FPrefabSpawnTelemetry::ToCsvField(Entry.PrefabPath),
+			Entry.NumActors,
+			Entry.NumComponents,
+			Entry.NumProperties,
+			Entry.NumCrossReferences,
+			Entry.NestingDepth,
+			Entry.SerializedBytes,
+			Entry.EstimatedMemoryBytes,
+			*FormatMs(Entry.FirstLoadMs),
+			*FormatMs(Entry.LoadMs),
+			Entry.NumInstances,
+			Entry.NumLevels,
+			Entry.GetCost()));
+	}
+	return FFileHelper::SaveStringArrayToFile(Rows, *InPath);
+}
+
@@ -0,0 +1,422 @@
+//$ Copyright 2015-23, Code Respawn Technologies Pvt Ltd - All Rights Reserved $//
+
+#include "Commandlets/PrefabUpgradeCommandlet.h"
+
+#include "Asset/PrefabricatorAsset.h"
+#include "Prefab/PrefabTools.h"
+
+#include "AssetRegistry/ARFilter.h"
+#include "AssetRegistry/IAssetRegistry.h"
+#include "Dom/JsonObject.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/PackageName.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+#include "UObject/Package.h"
+#include "UObject/SavePackage.h"
+#include "UObject/UObjectHash.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogPrefabUpgrade, Log, All);
+
+namespace {
+	namespace UpgradeStatus {
+		static const TCHAR* LoadFailed = TEXT("LoadFailed");
+		static const TCHAR* UpToDate = TEXT("UpToDate");
+		static const TCHAR* NeedsUpgrade = TEXT("NeedsUpgrade");
+		static const TCHAR* Upgraded = TEXT("Upgraded");
+		static const TCHAR* SaveFailed = TEXT("SaveFailed");
+	}
+
+	void ForEachAssetMapping(FPrefabricatorProperty& InProperty, TFunctionRef<void(FPrefabricatorPropertyAssetMapping&)> Visit) {
+		for (FPrefabricatorPropertyAssetMapping& Mapping : InProperty.AssetSoftReferenceMappings) {
+			Visit(Mapping);
+		}
+		for (auto& SerializedItemEntry : InProperty.SerializedItems) {
+			for (FPrefabricatorPropertyAssetMapping& Mapping : SerializedItemEntry.Value.AssetSoftReferenceMappings) {
+				Visit(Mapping);
+			}
+		}
+	}
+
+	/**
+	 * The assets that were processed in the mode of this run. The failed and invalid ones are processed again by a resumed run,
+	 * and so are the ones a validate-only run left for a run that upgrades and saves them
+	 */
+	bool IsEntryDone(const TSharedPtr<FJsonObject>& InEntry, bool bInValidateOnly) {
+		const FString Status = InEntry->GetStringField(TEXT("Status"));
+		if (Status == UpgradeStatus::LoadFailed || Status == UpgradeStatus::SaveFailed || !InEntry->GetBoolField(TEXT("Valid"))) {
+			return false;
+		}
+
+		// Only a validate-only run leaves an asset out of date, it is done once it was upgraded and saved
+		if (Status == UpgradeStatus::NeedsUpgrade) {
+			return bInValidateOnly;
+		}
+
+		bool bEntryValidateOnly = false;
+		InEntry->TryGetBoolField(TEXT("ValidateOnly"), bEntryValidateOnly);
+		return bInValidateOnly || !bEntryValidateOnly;
+	}
+
+	bool IsScriptPackage(const FString& InPackageName) {
+		return InPackageName.StartsWith(TEXT("/Script/"));
+	}
+
+	TArray<TSharedPtr<FJsonValue>> ToJsonArray(const TArray<FString>& InStrings) {
+		TArray<TSharedPtr<FJsonValue>> Values;
+		for (const FString& String : InStrings) {
+			Values.Add(MakeShared<FJsonValueString>(String));
+		}
+		return Values;
+	}
+
+	/** Returns the entries of an earlier report, so an interrupted run can skip the assets it already processed */
+	void ReadReportEntries(const FString& InReportPath, TArray<TSharedPtr<FJsonObject>>& OutEntries) {
+		FString ReportText;
+		if (!FFileHelper::LoadFileToString(ReportText, *InReportPath)) {
+			UE_LOG(LogPrefabUpgrade, Warning, TEXT("No report to resume from: %s"), *InReportPath);
+			return;
+		}
+
+		TSharedPtr<FJsonObject> Report;
+		TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(ReportText);
+		const TArray<TSharedPtr<FJsonValue>>* AssetValues = nullptr;
+		if (!FJsonSerializer::Deserialize(Reader, Report) || !Report.IsValid() || !Report->TryGetArrayField(TEXT("Assets"), AssetValues)) {
+			UE_LOG(LogPrefabUpgrade, Warning, TEXT("Could not parse the report, starting over: %s"), *InReportPath);
+			return;
+		}
+
+		for (const TSharedPtr<FJsonValue>& AssetValue : *AssetValues) {
+			const TSharedPtr<FJsonObject>* AssetEntry = nullptr;
+			if (AssetValue.IsValid() && AssetValue->TryGetObject(AssetEntry) && AssetEntry->IsValid()) {
+				OutEntries.Add(*AssetEntry);
+			}
+		}
+	}
+}
+
+UPrefabUpgradeCommandlet::UPrefabUpgradeCommandlet()
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+
+	HelpDescription = TEXT("Upgrades the prefab assets to the latest version, validates them and saves the ones that changed");
+	HelpUsage = TEXT("-run=PrefabUpgrade [-Paths=/Game/A+/Game/B] [-BatchSize=32] [-Report=<File>] [-Resume] [-ValidateOnly]");
+	HelpParamNames.Add(TEXT("Paths"));
+	HelpParamDescriptions.Add(TEXT("'+' separated list of content paths to search. Defaults to /Game"));
+	HelpParamNames.Add(TEXT("BatchSize"));
+	HelpParamDescriptions.Add(TEXT("Number of assets loaded together. Defaults to 32"));
+	HelpParamNames.Add(TEXT("Report"));
+	HelpParamDescriptions.Add(TEXT("Output file of the report. Defaults to Saved/Prefabricator/PrefabUpgradeReport.json"));
+	HelpParamNames.Add(TEXT("Resume"));
+	HelpParamDescriptions.Add(TEXT("Skip the assets the report lists as processed. The failed and invalid ones are processed again, and so are the ones a validate-only run found out of date"));
+	HelpParamNames.Add(TEXT("ValidateOnly"));
+	HelpParamDescriptions.Add(TEXT("Only validate, nothing is upgraded or saved"));
+}
+
+int32 UPrefabUpgradeCommandlet::Main(const FString& Params)
+{
+	TArray<FString> Tokens;
+	TArray<FString> Switches;
+	TMap<FString, FString> ParamVals;
+	ParseCommandLine(*Params, Tokens, Switches, ParamVals);
+
+	const bool bValidateOnly = Switches.Contains(TEXT("ValidateOnly"));
+	const bool bResume = Switches.Contains(TEXT("Resume"));
+
+	TArray<FString> SearchPaths;
+	if (const FString* PathsParam = ParamVals.Find(TEXT("Paths"))) {
+		PathsParam->ParseIntoArray(SearchPaths, TEXT("+"));
+	}
+	if (SearchPaths.Num() == 0) {
+		SearchPaths.Add(TEXT("/Game"));
+	}
+
+	int32 BatchSize = 32;
+	if (const FString* BatchSizeParam = ParamVals.Find(TEXT("BatchSize"))) {
+		BatchSize = FMath::Max(1, FCString::Atoi(**BatchSizeParam));
+	}
+
+	FString ReportPath = FPaths::ProjectSavedDir() / TEXT("Prefabricator") / TEXT("PrefabUpgradeReport.json");
+	if (const FString* ReportParam = ParamVals.Find(TEXT("Report"))) {
+		ReportPath = *ReportParam;
+	}
+
+	AssetRegistry = &IAssetRegistry::GetChecked();
+	AssetRegistry->SearchAllAssets(true);
+
+	FARFilter Filter;
+	Filter.ClassPaths.Add(UPrefabricatorAsset::StaticClass()->GetClassPathName());
+	Filter.bRecursiveClasses = true;
+	Filter.bRecursivePaths = true;
+	for (const FString& SearchPath : SearchPaths) {
+		Filter.PackagePaths.Add(*SearchPath);
+	}
+
+	TArray<FAssetData> PrefabAssets;
+	AssetRegistry->GetAssets(Filter, PrefabAssets);
+
+	// A stable order, so the batches of a resumed run line up with the report
+	PrefabAssets.Sort([](const FAssetData& A, const FAssetData& B) {
+		return A.PackageName.LexicalLess(B.PackageName);
+	});
+
+	TArray<TSharedPtr<FJsonObject>> Entries;
+	if (bResume) {
+		ReadReportEntries(ReportPath, Entries);
+
+		// The entries of the assets to process again are replaced by the new ones
+		Entries.RemoveAll([bValidateOnly](const TSharedPtr<FJsonObject>& Entry) {
+			return !IsEntryDone(Entry, bValidateOnly);
+		});
+		TSet<FName> ProcessedPackages;
+		for (const TSharedPtr<FJsonObject>& Entry : Entries) {
+			ProcessedPackages.Add(*Entry->GetStringField(TEXT("Package")));
+		}
+		const int32 NumFound = PrefabAssets.Num();
+		PrefabAssets.RemoveAll([&ProcessedPackages](const FAssetData& AssetData) {
+			return ProcessedPackages.Contains(AssetData.PackageName);
+		});
+		UE_LOG(LogPrefabUpgrade, Display, TEXT("Resuming, %d of %d prefab assets were already processed"), NumFound - PrefabAssets.Num(), NumFound);
+	}
+
+	UE_LOG(LogPrefabUpgrade, Display, TEXT("Processing %d prefab assets in batches of %d"), PrefabAssets.Num(), BatchSize);
+
+	bool bReportWritten = WriteReport(ReportPath, Entries, PrefabAssets.Num());
+	for (int32 BatchStart = 0; BatchStart < PrefabAssets.Num(); BatchStart += BatchSize) {
+		const int32 NumInBatch = FMath::Min(BatchSize, PrefabAssets.Num() - BatchStart);
+		ProcessBatch(TArrayView<const FAssetData>(PrefabAssets).Slice(BatchStart, NumInBatch), bValidateOnly, Entries);
+
+		const int32 NumPending = PrefabAssets.Num() - (BatchStart + NumInBatch);
+		bReportWritten = WriteReport(ReportPath, Entries, NumPending);
+		UE_LOG(LogPrefabUpgrade, Display, TEXT("Processed %d / %d"), BatchStart + NumInBatch, PrefabAssets.Num());
+
+		// The packages of the batch were released in ProcessBatch, so the memory stays flat over the whole run
+		CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+	}
+
+	if (!bReportWritten) {
+		UE_LOG(LogPrefabUpgrade, Error, TEXT("Failed to write the upgrade report: %s"), *ReportPath);
+		return 1;
+	}
+	UE_LOG(LogPrefabUpgrade, Display, TEXT("Wrote the upgrade report: %s"), *ReportPath);
+
+	for (const TSharedPtr<FJsonObject>& Entry : Entries) {
+		const FString Status = Entry->GetStringField(TEXT("Status"));
+		if (Status == UpgradeStatus::LoadFailed || Status == UpgradeStatus::SaveFailed || !Entry->GetBoolField(TEXT("Valid"))) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+void UPrefabUpgradeCommandlet::ProcessBatch(TArrayView<const FAssetData> InBatch, bool bValidateOnly, TArray<TSharedPtr<FJsonObject>>& OutEntries)
+{
+	// Request the whole batch up front so the async loader can work on the packages in parallel
+	TArray<FName> LoadedPackages;
+	for (const FAssetData& AssetData : InBatch) {
+		if (!AssetData.IsAssetLoaded()) {
+			LoadPackageAsync(AssetData.PackageName.ToString());
+			LoadedPackages.Add(AssetData.PackageName);
+		}
+	}
+	FlushAsyncLoading();
+
+	for (const FAssetData& AssetData : InBatch) {
+		OutEntries.Add(ProcessAsset(AssetData, bValidateOnly));
+	}
+
+	// The loaded assets are standalone and would survive the garbage collection. Release the ones this batch loaded
+	for (FName PackageName : LoadedPackages) {
+		if (UPackage* Package = FindPackage(nullptr, *PackageName.ToString())) {
+			ForEachObjectWithPackage(Package, [](UObject* Object) {
+				Object->ClearFlags(RF_Standalone);
+				return true;
+			}, false);
+		}
+	}
+}
+
+TSharedPtr<FJsonObject> UPrefabUpgradeCommandlet::ProcessAsset(const FAssetData& InAssetData, bool bValidateOnly)
+{
+	TSharedPtr<FJsonObject> Entry = MakeShared<FJsonObject>();
+	Entry->SetStringField(TEXT("Package"), InAssetData.PackageName.ToString());
+	Entry->SetBoolField(TEXT("ValidateOnly"), bValidateOnly);
+
+	UPrefabricatorAsset* PrefabAsset = Cast<UPrefabricatorAsset>(InAssetData.GetAsset());
+	if (!PrefabAsset) {
+		UE_LOG(LogPrefabUpgrade, Error, TEXT("Failed to load prefab asset: %s"), *InAssetData.PackageName.ToString());
+		Entry->SetStringField(TEXT("Status"), UpgradeStatus::LoadFailed);
+		Entry->SetBoolField(TEXT("Valid"), false);
+		return Entry;
+	}
+
+	const uint32 FromVersion = PrefabAsset->Version;
+	const bool bOutOfDate = FromVersion != (uint32)EPrefabricatorAssetVersion::LatestVersion;
+	bool bChanged = false;
+	if (bOutOfDate && !bValidateOnly) {
+		FPrefabVersionControl::UpgradeToLatestVersion(PrefabAsset);
+		bChanged = true;
+	}
+
+	TArray<FString> Errors;
+	TArray<FString> Warnings;
+	const int32 NumFixedReferences = ValidateAsset(PrefabAsset, !bValidateOnly, Errors, Warnings);
+	if (NumFixedReferences > 0) {
+		PrefabAsset->Modify();
+		bChanged = true;
+	}
+
+	// The nested assets may have been saved since this one was flattened. They are not loaded while saving, so it is done here
+	if (PrefabAsset->bPreflattenNestedPrefabs && !bValidateOnly && PrefabAsset->UpdateFlattenedData()) {
+		PrefabAsset->Modify();
+		bChanged = true;
+	}
+
+	const TCHAR* Status = bOutOfDate ? UpgradeStatus::NeedsUpgrade : UpgradeStatus::UpToDate;
+	if (bChanged) {
+		UPackage* Package = PrefabAsset->GetPackage();
+		const FString Filename = FPackageName::LongPackageNameToFilename(Package->GetName(), FPackageName::GetAssetPackageExtension());
+		FSavePackageArgs SaveArgs;
+		SaveArgs.TopLevelFlags = RF_Standalone;
+		if (UPackage::SavePackage(Package, PrefabAsset, *Filename, SaveArgs)) {
+			Status = UpgradeStatus::Upgraded;
+		}
+		else {
+			UE_LOG(LogPrefabUpgrade, Error, TEXT("Failed to save prefab asset: %s"), *Filename);
+			Status = UpgradeStatus::SaveFailed;
+		}
+	}
+
+	for (const FString& Error : Errors) {
+		UE_LOG(LogPrefabUpgrade, Error, TEXT("%s: %s"), *InAssetData.PackageName.ToString(), *Error);
+	}
+	for (const FString& Warning : Warnings) {
+		UE_LOG(LogPrefabUpgrade, Warning, TEXT("%s: %s"), *InAssetData.PackageName.ToString(), *Warning);
+	}
+
+	Entry->SetStringField(TEXT("Status"), Status);
+	Entry->SetNumberField(TEXT("FromVersion"), FromVersion);
+	Entry->SetNumberField(TEXT("ToVersion"), PrefabAsset->Version);
+	Entry->SetNumberField(TEXT("FixedSoftReferences"), NumFixedReferences);
+	Entry->SetBoolField(TEXT("Valid"), Errors.Num() == 0);
+	Entry->SetArrayField(TEXT("Errors"), ToJsonArray(Errors));
+	Entry->SetArrayField(TEXT("Warnings"), ToJsonArray(Warnings));
+	return Entry;
+}
+
+int32 UPrefabUpgradeCommandlet::ValidateAsset(UPrefabricatorAsset* InPrefabAsset, bool bFixSoftReferences, TArray<FString>& OutErrors, TArray<FString>& OutWarnings) const
+{
+	int32 NumFixed = 0;
+	FPrefabricatorAssetUtils::ForEachPrefabItem(InPrefabAsset, [&](FPrefabricatorItemBase& Item) {
+		// Missing classes. Blueprint classes are only looked up, not loaded
+		const FSoftClassPath ClassPath = Item.ClassPathRef.IsValid() ? Item.ClassPathRef : FSoftClassPath(Item.ClassPath);
+		UClass* ItemClass = ClassPath.ResolveClass();
+		if (ClassPath.IsNull()) {
+			OutErrors.Add(FString::Printf(TEXT("Item %s has no class"), *Item.Name));
+		}
+		else if (!ItemClass) {
+			const FString ClassPackageName = ClassPath.GetLongPackageName();
+			if (IsScriptPackage(ClassPackageName) || !FPackageName::DoesPackageExist(ClassPackageName)) {
+				OutErrors.Add(FString::Printf(TEXT("Item %s uses a missing class: %s"), *Item.Name, *ClassPath.ToString()));
+			}
+		}
+
+		// Broken cross references
+		for (const FPrefabricatorCrossReference& CrossReference : Item.CrossReferences) {
+			if (!InPrefabAsset->ActorItems.IsValidIndex(CrossReference.TargetIndex)) {
+				OutErrors.Add(FString::Printf(TEXT("Item %s has a cross reference to a missing actor item (%d)"), *Item.Name, CrossReference.TargetIndex));
+			}
+			else if (ItemClass && CrossReference.PropertyPath.Num() > 0) {
+				const FName PropertyName = CrossReference.PropertyPath[0].PropertyName;
+				if (!FindFProperty<FProperty>(ItemClass, PropertyName)) {
+					OutErrors.Add(FString::Printf(TEXT("Item %s has a cross reference through a missing property: %s"), *Item.Name, *PropertyName.ToString()));
+				}
+			}
+		}
+
+		for (FPrefabricatorProperty& Property : Item.SerializedProperties) {
+			if (Property.bIsCrossReferencedActor) {
+				for (const auto& SerializedItemEntry : Property.SerializedItems) {
+					const FGuid& TargetItemId = SerializedItemEntry.Value.CrossReferencePrefabActorId;
+					if (TargetItemId.IsValid() && InPrefabAsset->FindActorItemIndex(TargetItemId) == INDEX_NONE) {
+						OutErrors.Add(FString::Printf(TEXT("Item %s: %s references a removed actor item"), *Item.Name, *SerializedItemEntry.Key));
+					}
+				}
+			}
+
+			// Stale soft references. Redirected assets are followed and written back, missing assets can only be reported
+			ForEachAssetMapping(Property, [&](FPrefabricatorPropertyAssetMapping& Mapping) {
+				const FSoftObjectPath& AssetPath = Mapping.AssetReference;
+				if (AssetPath.IsNull() || IsScriptPackage(AssetPath.GetLongPackageName())) {
+					return;
+				}
+
+				const FAssetData ReferencedAsset = AssetRegistry->GetAssetByObjectPath(AssetPath.GetWithoutSubPath());
+				if (!ReferencedAsset.IsValid()) {
+					OutErrors.Add(FString::Printf(TEXT("Item %s: %s references a missing asset: %s"), *Item.Name, *Property.PropertyName.ToString(), *AssetPath.ToString()));
+				}
+				else if (ReferencedAsset.IsRedirector()) {
+					UObject* RedirectedObject = bFixSoftReferences ? AssetPath.TryLoad() : nullptr;
+					if (RedirectedObject) {
+						Mapping.AssetReference = FSoftObjectPath(RedirectedObject);
+						NumFixed++;
+					}
+					else {
+						OutWarnings.Add(FString::Printf(TEXT("Item %s: %s references a redirector: %s"), *Item.Name, *Property.PropertyName.ToString(), *AssetPath.ToString()));
+					}
+				}
+			});
+		}
+	});
+
+	if (NumFixed > 0) {
+		// Patch the exported text with the new paths
+		InPrefabAsset->ResolveSoftReferenceRedirects();
+	}
+	return NumFixed;
+}
+
+bool UPrefabUpgradeCommandlet::WriteReport(const FString& InReportPath, const TArray<TSharedPtr<FJsonObject>>& InEntries, int32 InNumPending) const
+{
+	int32 NumUpgraded = 0, NumNeedsUpgrade = 0, NumInvalid = 0, NumFailed = 0;
+	TArray<TSharedPtr<FJsonValue>> AssetValues;
+	for (const TSharedPtr<FJsonObject>& Entry : InEntries) {
+		const FString Status = Entry->GetStringField(TEXT("Status"));
+		if (Status == UpgradeStatus::Upgraded) NumUpgraded++;
+		else if (Status == UpgradeStatus::NeedsUpgrade) NumNeedsUpgrade++;
+		else if (Status == UpgradeStatus::LoadFailed || Status == UpgradeStatus::SaveFailed) NumFailed++;
+		if (!Entry->GetBoolField(TEXT("Valid"))) NumInvalid++;
+		AssetValues.Add(MakeShared<FJsonValueObject>(Entry));
+	}
+
+	TSharedRef<FJsonObject> Summary = MakeShared<FJsonObject>();
+	Summary->SetNumberField(TEXT("NumAssets"), InEntries.Num());
+	Summary->SetNumberField(TEXT("NumUpgraded"), NumUpgraded);
+	Summary->SetNumberField(TEXT("NumNeedsUpgrade"), NumNeedsUpgrade);
+	Summary->SetNumberField(TEXT("NumInvalid"), NumInvalid);
+	Summary->SetNumberField(TEXT("NumFailed"), NumFailed);
+
+	TSharedRef<FJsonObject> Report = MakeShared<FJsonObject>();
+	Report->SetNumberField(TEXT("Version"), 1);
+	Report->SetNumberField(TEXT("LatestAssetVersion"), (int32)EPrefabricatorAssetVersion::LatestVersion);
+	Report->SetBoolField(TEXT("Complete"), InNumPending == 0);
+	Report->SetNumberField(TEXT("NumPending"), InNumPending);
+	Report->SetObjectField(TEXT("Summary"), Summary);
+	Report->SetArrayField(TEXT("Assets"), AssetValues);
+
+	FString ReportText;
+	TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&ReportText);
+	FJsonSerializer::Serialize(Report, Writer);
+
+	// Write next to the report and move it over, so an interruption never leaves a truncated report behind
+	const FString TempReportPath = InReportPath + TEXT(".tmp");
+	return FFileHelper::SaveStringToFile(ReportText, *TempReportPath)
+		&& IFileManager::Get().Move(*InReportPath, *TempReportPath, true);
+}
+
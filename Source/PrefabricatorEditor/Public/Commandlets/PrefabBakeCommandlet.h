@@ -0,0 +1,38 @@
+//$ Copyright 2015-23, Code Respawn Technologies Pvt Ltd - All Rights Reserved $//
+
+#pragma once
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "PrefabBakeCommandlet.generated.h"
+
+class APrefabActor;
+class FJsonObject;
+class UWorld;
+
+/**
+ * Flattens the static prefab instances of the given maps into plain level actors, so the shipped level carries
+ * no prefab actors, prefab components or prefab asset user data. Meant to run on the build machine before cooking.
+ * Dynamic instances (on demand, replicated, linked to a seed linker or to a randomizer that runs on begin play) are left alone.
+ *
+ * A manifest is written that maps every baked actor back to the prefab instance and the prefab asset it came from.
+ *
+ * Usage:
+ *   UnrealEditor-Cmd.exe <Project> -run=PrefabBake -Maps=/Game/Maps/MapA+/Game/Maps/MapB [-AllMaps] [-Manifest=<File>] [-DryRun]
+ */
+UCLASS()
+class PREFABRICATOREDITOR_API UPrefabBakeCommandlet : public UCommandlet {
+	GENERATED_BODY()
+public:
+	UPrefabBakeCommandlet();
+
+	/// UCommandlet Interface
+	virtual int32 Main(const FString& Params) override;
+	/// End of UCommandlet Interface
+
+private:
+	bool BakeMap(const FString& InMapPackageName, bool bDryRun, TSharedPtr<FJsonObject>& OutMapEntry);
+	int32 BakeWorld(UWorld* InWorld, bool bDryRun, TSharedPtr<FJsonObject> MapEntry);
+	bool CanBakePrefab(APrefabActor* InPrefab, const TSet<APrefabActor*>& InDynamicPrefabs, FString& OutReason) const;
+	TSharedPtr<FJsonObject> BakePrefab(APrefabActor* InPrefab, bool bDryRun);
+};
+
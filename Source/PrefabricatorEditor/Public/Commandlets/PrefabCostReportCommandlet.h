@@ -0,0 +1,67 @@
+//$ Copyright 2015-23, Code Respawn Technologies Pvt Ltd - All Rights Reserved $//
+
+#pragma once
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "PrefabCostReportCommandlet.generated.h"
+
+class UPrefabricatorAsset;
+class UPrefabricatorAssetInterface;
+class UWorld;
+
+/** The measured cost of a single prefab asset */
+struct FPrefabCostReportEntry {
+	FString PrefabPath;
+	int32 NumActors = 0;
+	int32 NumComponents = 0;
+	int32 NumProperties = 0;
+	int32 NumCrossReferences = 0;
+	int32 NestingDepth = 0;
+	int64 SerializedBytes = 0;
+	int64 EstimatedMemoryBytes = 0;
+
+	/** LoadStateFromPrefabAsset time of the first build (cold) and the average of the following ones. Negative if not measured */
+	double FirstLoadMs = -1;
+	double LoadMs = -1;
+
+	int32 NumInstances = 0;
+	int32 NumLevels = 0;
+
+	/** Ranking key. The build time of all the placed instances, or of a single one if the prefab is not placed in any of the levels */
+	double GetCost() const;
+};
+
+/**
+ * Writes a CSV with the cost of every prefab asset of the project: item, property and cross reference counts, nesting
+ * depth, serialized size, estimated memory, and the time LoadStateFromPrefabAsset takes to build it in a scratch world.
+ * The instance counts are gathered from the given maps. The most expensive prefabs are also listed in a ranked top N.
+ *
+ * Usage:
+ *   UnrealEditor-Cmd.exe <Project> -run=PrefabCostReport [-Paths=/Game/A+/Game/B] [-Maps=/Game/Maps/MapA+/Game/Maps/MapB] [-AllMaps]
+ *                        [-Output=<File.csv>] [-Top=20] [-Iterations=5] [-NoTiming]
+ */
+UCLASS()
+class PREFABRICATOREDITOR_API UPrefabCostReportCommandlet : public UCommandlet {
+	GENERATED_BODY()
+public:
+	UPrefabCostReportCommandlet();
+
+	/// UCommandlet Interface
+	virtual int32 Main(const FString& Params) override;
+	/// End of UCommandlet Interface
+
+private:
+	void GatherAssetStats(UPrefabricatorAsset* InPrefabAsset, FPrefabCostReportEntry& OutEntry);
+	int32 GetNestingDepth(UPrefabricatorAssetInterface* InPrefab, int32 InDepth);
+	void MeasureLoadTime(UWorld* InWorld, UPrefabricatorAsset* InPrefabAsset, int32 InIterations, FPrefabCostReportEntry& OutEntry) const;
+
+	/** Counts the prefab actors of each asset in the map. Returns false if the map could not be loaded */
+	bool CountInstances(const FString& InMapPackageName, TMap<FString, int32>& OutInstancesByPrefab) const;
+
+	static bool WriteCsv(const FString& InPath, TArrayView<const FPrefabCostReportEntry> InEntries);
+
+private:
+	/** Nesting depth of the assets that were already visited */
+	TMap<FSoftObjectPath, int32> NestingDepthCache;
+};
+
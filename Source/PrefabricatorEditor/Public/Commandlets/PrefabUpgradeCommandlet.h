@@ -0,0 +1,46 @@
+//$ Copyright 2015-23, Code Respawn Technologies Pvt Ltd - All Rights Reserved $//
+
+#pragma once
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "PrefabUpgradeCommandlet.generated.h"
+
+class FJsonObject;
+class IAssetRegistry;
+class UPrefabricatorAsset;
+struct FAssetData;
+
+/**
+ * Upgrades every prefab asset of the project to the latest version and validates it (missing classes, broken
+ * cross references, soft references that point to redirectors or missing assets). Only the packages that changed are saved.
+ *
+ * The assets are found through the asset registry and loaded asynchronously in batches. The report is rewritten after
+ * every batch, so an interrupted run picks up from the last finished batch with -Resume. A resumed run processes the
+ * assets that failed to load or save, or did not validate, again. The loaded assets are released after every batch.
+ *
+ * Usage:
+ *   UnrealEditor-Cmd.exe <Project> -run=PrefabUpgrade [-Paths=/Game/A+/Game/B] [-BatchSize=32] [-Report=<File>] [-Resume] [-ValidateOnly]
+ */
+UCLASS()
+class PREFABRICATOREDITOR_API UPrefabUpgradeCommandlet : public UCommandlet {
+	GENERATED_BODY()
+public:
+	UPrefabUpgradeCommandlet();
+
+	/// UCommandlet Interface
+	virtual int32 Main(const FString& Params) override;
+	/// End of UCommandlet Interface
+
+private:
+	void ProcessBatch(TArrayView<const FAssetData> InBatch, bool bValidateOnly, TArray<TSharedPtr<FJsonObject>>& OutEntries);
+	TSharedPtr<FJsonObject> ProcessAsset(const FAssetData& InAssetData, bool bValidateOnly);
+
+	/** Returns the number of stale soft references that were fixed up */
+	int32 ValidateAsset(UPrefabricatorAsset* InPrefabAsset, bool bFixSoftReferences, TArray<FString>& OutErrors, TArray<FString>& OutWarnings) const;
+
+	bool WriteReport(const FString& InReportPath, const TArray<TSharedPtr<FJsonObject>>& InEntries, int32 InNumPending) const;
+
+private:
+	IAssetRegistry* AssetRegistry = nullptr;
+};
+
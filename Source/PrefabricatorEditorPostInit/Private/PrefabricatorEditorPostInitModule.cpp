@@ -2,12 +2,14 @@
 
 #include "PrefabricatorEditorPostInitModule.h"
 
+#include "Prefab/PrefabActor.h"
 #include "Prefab/PrefabComponent.h"
 #include "Prefab/Random/PrefabSeedLinker.h"
 #include "Visualizers/PrefabComponentVisualizer.h"
 #include "Visualizers/PrefabSeedLinkerVisualizer.h"
 
 #include "Editor/UnrealEdEngine.h"
+#include "Engine/Engine.h"
 #include "IAssetTools.h"
 #include "IAssetTypeActions.h"
 #include "UnrealEdGlobals.h"
@@ -22,11 +24,21 @@ class FPrefabricatorEditorPostInitModule : public IPrefabricatorEditorPostInitMo
 	{
 		// Register component visualizers
 		RegisterComponentVisualizers();
+
+		// The attachments made in the level editor below the children of a prefab
+		if (GEngine) {
+			LevelActorAttachedHandle = GEngine->OnLevelActorAttached().AddStatic(&APrefabActor::HandleAttachmentChanged);
+			LevelActorDetachedHandle = GEngine->OnLevelActorDetached().AddStatic(&APrefabActor::HandleAttachmentChanged);
+		}
 	}
 
 	virtual void ShutdownModule() override {
 		UnregisterComponentVisualizers();
 
+		if (GEngine) {
+			GEngine->OnLevelActorAttached().Remove(LevelActorAttachedHandle);
+			GEngine->OnLevelActorDetached().Remove(LevelActorDetachedHandle);
+		}
 	}
 
 private:
@@ -55,6 +67,9 @@ private:
 
 	FName PrefabComponentClassName;
 	FName PrefabSeedLinkerComponentClassName;
+
+	FDelegateHandle LevelActorAttachedHandle;
+	FDelegateHandle LevelActorDetachedHandle;
 };
 
 IMPLEMENT_MODULE(FPrefabricatorEditorPostInitModule, PrefabricatorEditorPostInit)
@@ -2,6 +2,8 @@
 
 #include "Asset/PrefabricatorAsset.h"
 
+#include "Prefab/PrefabActor.h"
+#include "Prefab/PrefabLayoutResolver.h"
 #include "Prefab/PrefabTools.h"
 #include "PrefabricatorSettings.h"
 #include "Utils/PrefabricatorConstants.h"
@@ -11,17 +13,28 @@
 #include "GameFramework/Actor.h"
 #include "Internationalization/Regex.h"
 #include "Misc/PackageName.h"
+#include "UObject/ObjectSaveContext.h"
 
 DEFINE_LOG_CATEGORY_STATIC(LogPrefabricatorAsset, Log, All);
 
 UPrefabricatorAsset::UPrefabricatorAsset(const FObjectInitializer& ObjectInitializer) : Super(ObjectInitializer) {
 }
 
+TSoftObjectPtr<UPrefabricatorAsset> UPrefabricatorAssetInterface::SelectPrefabAsset(const FPrefabAssetSelectionConfig& InConfig) const
+{
+	return TSoftObjectPtr<UPrefabricatorAsset>();
+}
+
 UPrefabricatorAsset* UPrefabricatorAsset::GetPrefabAsset(const FPrefabAssetSelectionConfig& InConfig)
 {
 	return this;
 }
 
+TSoftObjectPtr<UPrefabricatorAsset> UPrefabricatorAsset::SelectPrefabAsset(const FPrefabAssetSelectionConfig& InConfig) const
+{
+	return TSoftObjectPtr<UPrefabricatorAsset>(const_cast<UPrefabricatorAsset*>(this));
+}
+
 FVector FPrefabricatorAssetUtils::FindPivot(const TArray<AActor*>& InActors)
 {
 	FVector Pivot = FVector::ZeroVector;
@@ -79,6 +92,19 @@ EComponentMobility::Type FPrefabricatorAssetUtils::FindMobility(const TArray<AAc
 	*/
 }
 
+void FPrefabricatorAssetUtils::ForEachPrefabItem(UPrefabricatorAsset* InPrefabAsset, TFunctionRef<void(FPrefabricatorItemBase&)> Visit)
+{
+	for (FPrefabricatorComponentData& ComponentItem : InPrefabAsset->ComponentItems) {
+		Visit(ComponentItem);
+	}
+	for (FPrefabricatorActorData& ActorItem : InPrefabAsset->ActorItems) {
+		Visit(ActorItem);
+		for (FPrefabricatorComponentData& ComponentItem : ActorItem.ComponentItems) {
+			Visit(ComponentItem);
+		}
+	}
+}
+
 ///////////////////////////////////////// UPrefabricatorAssetCollection ///////////////////////////////////////// 
 
 UPrefabricatorAssetCollection::UPrefabricatorAssetCollection(const FObjectInitializer& ObjectInitializer) : Super(ObjectInitializer) {
@@ -87,7 +113,13 @@ UPrefabricatorAssetCollection::UPrefabricatorAssetCollection(const FObjectInitia
 
 UPrefabricatorAsset* UPrefabricatorAssetCollection::GetPrefabAsset(const FPrefabAssetSelectionConfig& InConfig)
 {
-	if (Prefabs.Num() == 0) return nullptr;
+	TSoftObjectPtr<UPrefabricatorAsset> PrefabAssetPtr = SelectPrefabAsset(InConfig);
+	return PrefabAssetPtr.IsNull() ? nullptr : PrefabAssetPtr.LoadSynchronous();
+}
+
+TSoftObjectPtr<UPrefabricatorAsset> UPrefabricatorAssetCollection::SelectPrefabAsset(const FPrefabAssetSelectionConfig& InConfig) const
+{
+	if (Prefabs.Num() == 0) return TSoftObjectPtr<UPrefabricatorAsset>();
 
 	float TotalWeight = 0.0f;
 	for (const FPrefabricatorAssetCollectionItem& Item : Prefabs) {
@@ -121,7 +153,7 @@ UPrefabricatorAsset* UPrefabricatorAssetCollection::GetPrefabAsset(const FPrefab
 			PrefabAssetPtr = Prefabs.Last().PrefabAsset;
 		}
 	}
-	return PrefabAssetPtr.LoadSynchronous();
+	return PrefabAssetPtr;
 }
 
 void UPrefabricatorEventListener::PostSpawn_Implementation(APrefabActor* Prefab)
@@ -130,10 +162,10 @@ void UPrefabricatorEventListener::PostSpawn_Implementation(APrefabActor* Prefab)
 }
 
 namespace {
-	static const FString PrefabAssetInterfaceRefProperty = "PrefabAssetInterface";
+	static const FName PrefabAssetInterfaceRefProperty = "PrefabAssetInterface";
 }
 
-void UPrefabricatorProperty::SaveReferencedAssetValues()
+void FPrefabricatorProperty::SaveReferencedAssetValues()
 {
 	AssetSoftReferenceMappings.Reset();
 
@@ -144,6 +176,8 @@ void UPrefabricatorProperty::SaveReferencedAssetValues()
 		Mapping.AssetClassName = "";		// Not used, since it is handled differently during load
 		Mapping.AssetObjectPath = *ExportedValue;
 		Mapping.bUseQuotes = false;
+		Mapping.PathOffset = 0;
+		Mapping.PathLength = ExportedValue.Len();
 		AssetSoftReferenceMappings.Add(Mapping);
 	}
 	else {
@@ -153,18 +187,26 @@ void UPrefabricatorProperty::SaveReferencedAssetValues()
 		for (auto& SerializedItemEntry : SerializedItems)
 		{
 			auto& SerializedItem = SerializedItemEntry.Value;
+			SerializedItem.AssetSoftReferenceMappings.Reset();
+
+			// Object references are always exported as Class'Path'. Skip the regex on plain values
+			if (!SerializedItem.ExportedValue.Contains(TEXT("'"), ESearchCase::CaseSensitive)) {
+				continue;
+			}
+
 			FRegexMatcher Matcher(Pattern, SerializedItem.ExportedValue);
 
 			while (Matcher.FindNext()) {
-				FString FullPath = Matcher.GetCaptureGroup(0);
 				FString ClassName = Matcher.GetCaptureGroup(1);
 				FString ObjectPath = Matcher.GetCaptureGroup(2);
 				if (ClassName == "PrefabricatorAssetUserData") {
 					continue;
 				}
+				int32 PathOffset = Matcher.GetCaptureGroupBeginning(2);
 				bool bUseQuotes = false;
 				if (ObjectPath.Len() >= 2 && ObjectPath.StartsWith("\"") && ObjectPath.EndsWith("\"")) {
 					ObjectPath = ObjectPath.Mid(1, ObjectPath.Len() - 2);
+					PathOffset++;
 					bUseQuotes = true;
 				}
 
@@ -176,6 +218,8 @@ void UPrefabricatorProperty::SaveReferencedAssetValues()
 					Mapping.AssetClassName = ClassName;
 					Mapping.AssetObjectPath = *ObjectPath;
 					Mapping.bUseQuotes = bUseQuotes;
+					Mapping.PathOffset = PathOffset;
+					Mapping.PathLength = ObjectPath.Len();
 					SerializedItem.AssetSoftReferenceMappings.Add(Mapping);
 					//UE_LOG(LogPrefabricatorAsset, Log, TEXT("######>>> Found Asset Ref: [%s][%s] | %s"), *Mapping.AssetClassName, *Mapping.AssetObjectPath.ToString(), *Mapping.AssetReference.GetAssetPathName().ToString());
 				}
@@ -186,18 +230,19 @@ void UPrefabricatorProperty::SaveReferencedAssetValues()
 
 namespace
 {
-	bool LoadReferencedAssetValues(FPrefabricatorPropertyAssetMapping& Mapping, const FString& PropertyName, FString& OutExportedValue)
+	/** Patches the exported text of a single mapping if the soft reference now points somewhere else (e.g. a redirected asset) */
+	bool ResolveReferencedAssetValue(FPrefabricatorPropertyAssetMapping& Mapping, const FName& PropertyName, FString& OutExportedValue, int32& InOutOffsetDelta)
 	{
-		// Check if the name has changed
-		//if (!Mapping.AssetReference.IsValid()) {
-		//	continue;
-		//}
+		// Earlier edits of the same text moved this path, even if the path itself does not change
+		if (Mapping.PathOffset != INDEX_NONE) {
+			Mapping.PathOffset += InOutOffsetDelta;
+		}
 
 		FName ReferencedPath;
 		{
-			//SCOPE_CYCLE_COUNTER(STAT_LoadReferencedAssetValues_GetAssetPathName);
+			SCOPE_CYCLE_COUNTER(STAT_LoadReferencedAssetValues_GetAssetPathName);
 			ReferencedPath = *Mapping.AssetReference.GetAssetPath().ToString();
-			if (ReferencedPath.ToString().IsEmpty()) {
+			if (ReferencedPath.IsNone()) {
 				return false;
 			}
 
@@ -207,25 +252,31 @@ namespace
 			}
 		}
 
-		// The object path has changed.  Update it and mark as modified
-		FString ReplaceFrom, ReplaceTo;
-		if (PropertyName == PrefabAssetInterfaceRefProperty) {
-			ReplaceFrom = Mapping.AssetObjectPath.ToString();
-			ReplaceTo = ReferencedPath.ToString();
+		const FString ReferencedPathString = ReferencedPath.ToString();
+		const int32 PathOffset = Mapping.PathOffset;
+		if (PathOffset != INDEX_NONE && PathOffset >= 0 && PathOffset + Mapping.PathLength <= OutExportedValue.Len()) {
+			// Splice the new path in at the location recorded during save
+			SCOPE_CYCLE_COUNTER(STAT_LoadReferencedAssetValues_Replacements1);
+			OutExportedValue = OutExportedValue.Left(PathOffset) + ReferencedPathString + OutExportedValue.Mid(PathOffset + Mapping.PathLength);
+			InOutOffsetDelta += ReferencedPathString.Len() - Mapping.PathLength;
+			Mapping.PathLength = ReferencedPathString.Len();
 		}
 		else {
-			SCOPE_CYCLE_COUNTER(STAT_LoadReferencedAssetValues_Replacements1);
-			if (Mapping.bUseQuotes) {
+			// Mappings saved before offsets were recorded. Fall back to a search and replace
+			FString ReplaceFrom, ReplaceTo;
+			if (PropertyName == PrefabAssetInterfaceRefProperty) {
+				ReplaceFrom = Mapping.AssetObjectPath.ToString();
+				ReplaceTo = ReferencedPathString;
+			}
+			else if (Mapping.bUseQuotes) {
 				ReplaceFrom = FString::Printf(TEXT("%s\'\"%s\"\'"), *Mapping.AssetClassName, *Mapping.AssetObjectPath.ToString());
-				ReplaceTo = FString::Printf(TEXT("%s\'\"%s\"\'"), *Mapping.AssetClassName, *ReferencedPath.ToString());
+				ReplaceTo = FString::Printf(TEXT("%s\'\"%s\"\'"), *Mapping.AssetClassName, *ReferencedPathString);
 			}
 			else {
 				ReplaceFrom = FString::Printf(TEXT("%s\'%s\'"), *Mapping.AssetClassName, *Mapping.AssetObjectPath.ToString());
-				ReplaceTo = FString::Printf(TEXT("%s\'%s\'"), *Mapping.AssetClassName, *ReferencedPath.ToString());
+				ReplaceTo = FString::Printf(TEXT("%s\'%s\'"), *Mapping.AssetClassName, *ReferencedPathString);
 			}
-		}
 
-		{
 			SCOPE_CYCLE_COUNTER(STAT_LoadReferencedAssetValues_Replacements2);
 			OutExportedValue = OutExportedValue.Replace(*ReplaceFrom, *ReplaceTo);
 		}
@@ -234,31 +285,389 @@ namespace
 	}
 }
 
-
-void UPrefabricatorProperty::LoadReferencedAssetValues()
+bool FPrefabricatorProperty::ResolveReferencedAssetValues()
 {
 	SCOPE_CYCLE_COUNTER(STAT_LoadReferencedAssetValues);
 	bool bModified = false;
-	for (auto& Mapping : AssetSoftReferenceMappings) {		
-		if (::LoadReferencedAssetValues(Mapping, ExportedValue, PropertyName))
-		{
-			bModified = true;
+	{
+		int32 OffsetDelta = 0;
+		for (auto& Mapping : AssetSoftReferenceMappings) {
+			bModified |= ResolveReferencedAssetValue(Mapping, PropertyName, ExportedValue, OffsetDelta);
 		}
 	}
 	for (auto& SerializedItemsEntry : SerializedItems)
 	{
 		auto& SerializedItem = SerializedItemsEntry.Value;
+		// Mappings are stored in the order they appear in the text, so earlier edits only shift the later ones
+		int32 OffsetDelta = 0;
 		for (auto& Mapping : SerializedItem.AssetSoftReferenceMappings) {
-			if (::LoadReferencedAssetValues(Mapping, SerializedItem.ExportedValue, PropertyName))
-			{
-				bModified = true;
+			bModified |= ResolveReferencedAssetValue(Mapping, PropertyName, SerializedItem.ExportedValue, OffsetDelta);
+		}
+	}
+	return bModified;
+}
+
+void UPrefabricatorProperty::ConvertTo(FPrefabricatorProperty& OutProperty) const
+{
+	OutProperty.PropertyName = *PropertyName;
+	OutProperty.ExportedValue = ExportedValue;
+	OutProperty.AssetSoftReferenceMappings = AssetSoftReferenceMappings;
+	OutProperty.bIsCrossReferencedActor = bIsCrossReferencedActor;
+	OutProperty.bContainsStructProperty = bContainsStructProperty;
+	OutProperty.SerializedItems = SerializedItems;
+}
+
+FPrefabricatorProperty* FPrefabricatorItemBase::FindProperty(const FName& InPropertyName)
+{
+	return SerializedProperties.FindByPredicate([&InPropertyName](const FPrefabricatorProperty& Property) {
+		return Property.PropertyName == InPropertyName;
+	});
+}
+
+const FPrefabricatorProperty* FPrefabricatorItemBase::FindProperty(const FName& InPropertyName) const
+{
+	return const_cast<FPrefabricatorItemBase*>(this)->FindProperty(InPropertyName);
+}
+
+bool FPrefabricatorItemBase::ConvertLegacyProperties()
+{
+	if (Properties.Num() == 0) {
+		return false;
+	}
+
+	SerializedProperties.Reserve(SerializedProperties.Num() + Properties.Num());
+	for (const auto& PropertyEntry : Properties) {
+		UPrefabricatorProperty* LegacyProperty = PropertyEntry.Value;
+		if (!LegacyProperty) continue;
+
+		FPrefabricatorProperty* Property = FindProperty(*LegacyProperty->PropertyName);
+		if (!Property) {
+			Property = &SerializedProperties.AddDefaulted_GetRef();
+		}
+		LegacyProperty->ConvertTo(*Property);
+
+		// Keep the converted object out of the package when the asset is resaved
+		LegacyProperty->SetFlags(RF_Transient);
+	}
+
+	// Drop the references so the property objects can be collected
+	Properties.Empty();
+	return true;
+}
+
+void UPrefabricatorAsset::PostLoad()
+{
+	Super::PostLoad();
+
+	// Older assets keep their items in GUID keyed maps and their properties as separate objects. Convert them in
+	// memory, the version is left untouched so the asset is still reported for upgrade until it is resaved
+	ConvertLegacyItemStorage();
+	ConvertLegacyProperties();
+	RebuildItemIndex();
+
+	// Older items only have the class path string. Fix up the soft class path here so spawning doesn't need to
+	FPrefabricatorAssetUtils::ForEachPrefabItem(this, [](FPrefabricatorItemBase& Item) {
+		if (!Item.ClassPathRef.IsValid() && !Item.ClassPath.IsEmpty()) {
+			Item.ClassPathRef = FSoftClassPath(Item.ClassPath);
+		}
+	});
+
+	if (Version < (uint32)EPrefabricatorAssetVersion::AddedCrossReferenceTable) {
+		RebuildCrossReferenceTables();
+	}
+	ResolveSoftReferenceRedirects();
+}
+
+#if WITH_EDITOR
+void UPrefabricatorAsset::PreSave(FObjectPreSaveContext SaveContext)
+{
+	Super::PreSave(SaveContext);
+
+	// Assets may have been renamed while this prefab was loaded
+	ResolveSoftReferenceRedirects();
+
+	// The flattened data is not rebuilt here, that would load the nested packages during save and cook.
+	// It is rebuilt when the prefab is saved from the level, when the setting changes, and by the upgrade commandlet
+}
+
+void UPrefabricatorAsset::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	if (PropertyChangedEvent.GetPropertyName() == GET_MEMBER_NAME_CHECKED(UPrefabricatorAsset, bPreflattenNestedPrefabs)) {
+		RebuildFlattenedData();
+	}
+}
+#endif // WITH_EDITOR
+
+int32 UPrefabricatorAsset::ResolveSoftReferenceRedirects()
+{
+	int32 NumResolved = 0;
+	FPrefabricatorAssetUtils::ForEachPrefabItem(this, [&NumResolved](FPrefabricatorItemBase& Item) {
+		for (FPrefabricatorProperty& Property : Item.SerializedProperties) {
+			if (Property.ResolveReferencedAssetValues()) {
+				NumResolved++;
+			}
+		}
+	});
+
+	if (NumResolved > 0) {
+		UE_LOG(LogPrefabricatorAsset, Verbose, TEXT("Resolved %d redirected asset references in %s"), NumResolved, *GetPathName());
+	}
+	return NumResolved;
+}
+
+bool UPrefabricatorAsset::ConvertLegacyProperties()
+{
+	bool bConverted = false;
+	FPrefabricatorAssetUtils::ForEachPrefabItem(this, [&bConverted](FPrefabricatorItemBase& Item) {
+		bConverted |= Item.ConvertLegacyProperties();
+	});
+	return bConverted;
+}
+
+bool UPrefabricatorAsset::ConvertLegacyItemStorage()
+{
+	bool bConverted = false;
+	if (ComponentData.Num() > 0) {
+		ComponentItems.Reserve(ComponentItems.Num() + ComponentData.Num());
+		for (auto& ComponentDataEntry : ComponentData) {
+			ComponentItems.Add(MoveTemp(ComponentDataEntry.Value));
+		}
+		ComponentData.Empty();
+		bConverted = true;
+	}
+
+	if (ActorData.Num() > 0) {
+		ActorItems.Reserve(ActorItems.Num() + ActorData.Num());
+		for (auto& ActorDataEntry : ActorData) {
+			ActorItems.Add(MoveTemp(ActorDataEntry.Value));
+		}
+		ActorData.Empty();
+		bConverted = true;
+	}
+
+	for (FPrefabricatorActorData& ActorItem : ActorItems) {
+		if (ActorItem.Components.Num() > 0) {
+			ActorItem.ComponentItems.Reserve(ActorItem.ComponentItems.Num() + ActorItem.Components.Num());
+			for (auto& ComponentDataEntry : ActorItem.Components) {
+				ActorItem.ComponentItems.Add(MoveTemp(ComponentDataEntry.Value));
 			}
+			ActorItem.Components.Empty();
+			bConverted = true;
 		}
 	}
 
-	if (bModified) {
-		SCOPE_CYCLE_COUNTER(STAT_LoadReferencedAssetValues_Modify);
-		Modify();
+	if (bConverted) {
+		RebuildItemIndex();
 	}
+	return bConverted;
 }
 
+namespace {
+	template<typename TItem>
+	int32 FindItemIndex(const TArray<TItem>& InItems, const TMap<FGuid, int32>& InIndexByID, const FGuid& InItemID) {
+		const int32* SearchResult = InIndexByID.Find(InItemID);
+		if (SearchResult && InItems.IsValidIndex(*SearchResult) && InItems[*SearchResult].PrefabItemID == InItemID) {
+			return *SearchResult;
+		}
+		// The items were edited after the index was built
+		return InItems.IndexOfByPredicate([&InItemID](const TItem& Item) { return Item.PrefabItemID == InItemID; });
+	}
+
+	template<typename TItem>
+	void BuildItemIndex(const TArray<TItem>& InItems, TMap<FGuid, int32>& OutIndexByID) {
+		OutIndexByID.Reset();
+		OutIndexByID.Reserve(InItems.Num());
+		for (int32 Index = 0; Index < InItems.Num(); Index++) {
+			OutIndexByID.Add(InItems[Index].PrefabItemID, Index);
+		}
+	}
+}
+
+int32 UPrefabricatorAsset::FindActorItemIndex(const FGuid& InItemID) const
+{
+	return FindItemIndex(ActorItems, ActorItemIndexByID, InItemID);
+}
+
+int32 UPrefabricatorAsset::FindComponentItemIndex(const FGuid& InItemID) const
+{
+	return FindItemIndex(ComponentItems, ComponentItemIndexByID, InItemID);
+}
+
+void UPrefabricatorAsset::RebuildItemIndex()
+{
+	BuildItemIndex(ActorItems, ActorItemIndexByID);
+	BuildItemIndex(ComponentItems, ComponentItemIndexByID);
+}
+
+namespace {
+	/** Splits a serialized item path ("|Property|ArrayProperty[Index]|StructMember") into segments that can be walked without string work */
+	bool ParseCrossReferencePath(const FPrefabricatorProperty& InProperty, const FString& InPath, TArray<FPrefabricatorPropertyPathSegment>& OutSegments) {
+		TArray<FString> Tokens;
+		InPath.ParseIntoArray(Tokens, TEXT("|"));
+
+		FString ParentPath;
+		for (const FString& Token : Tokens) {
+			FPrefabricatorPropertyPathSegment& Segment = OutSegments.AddDefaulted_GetRef();
+			int32 BracketIndex = INDEX_NONE;
+			if (Token.FindChar(TEXT('['), BracketIndex)) {
+				const FString ArrayPropertyName = Token.Left(BracketIndex);
+				Segment.PropertyName = *ArrayPropertyName;
+				Segment.ArrayIndex = FCString::Atoi(*Token.Mid(BracketIndex + 1));
+
+				// The array length is stored on the item of the array property itself
+				if (const FPrefabPropertySerializedItem* ArrayItem = InProperty.SerializedItems.Find(ParentPath + TEXT("|") + ArrayPropertyName)) {
+					Segment.ArrayLength = ArrayItem->ArrayLength;
+				}
+			}
+			else {
+				Segment.PropertyName = *Token;
+			}
+			ParentPath += TEXT("|") + Token;
+		}
+
+		return OutSegments.Num() > 0 && OutSegments[0].PropertyName == InProperty.PropertyName;
+	}
+}
+
+void UPrefabricatorAsset::RebuildCrossReferenceTables()
+{
+	FPrefabricatorAssetUtils::ForEachPrefabItem(this, [this](FPrefabricatorItemBase& Item) {
+		Item.CrossReferences.Reset();
+		for (const FPrefabricatorProperty& Property : Item.SerializedProperties) {
+			if (!Property.bIsCrossReferencedActor) continue;
+
+			for (const auto& SerializedItemEntry : Property.SerializedItems) {
+				const FGuid& TargetItemId = SerializedItemEntry.Value.CrossReferencePrefabActorId;
+				if (!TargetItemId.IsValid()) continue;
+
+				FPrefabricatorCrossReference CrossReference;
+				CrossReference.TargetIndex = FindActorItemIndex(TargetItemId);
+				if (CrossReference.TargetIndex == INDEX_NONE) continue;
+
+				if (!ParseCrossReferencePath(Property, SerializedItemEntry.Key, CrossReference.PropertyPath)) {
+					UE_LOG(LogPrefabricatorAsset, Warning, TEXT("Invalid cross reference path: %s"), *SerializedItemEntry.Key);
+					continue;
+				}
+				Item.CrossReferences.Add(MoveTemp(CrossReference));
+			}
+		}
+	});
+}
+
+namespace {
+	void FlattenPrefabRecursive(UPrefabricatorAsset* InPrefabAsset, int32 InParentIndex, int32 InParentActorItemIndex, int32 InDepth, TArray<FPrefabricatorFlattenedPrefab>& OutEntries)
+	{
+		const int32 EntryIndex = OutEntries.AddDefaulted();
+		{
+			FPrefabricatorFlattenedPrefab& Entry = OutEntries[EntryIndex];
+			Entry.ParentIndex = InParentIndex;
+			Entry.ParentActorItemIndex = InParentActorItemIndex;
+			Entry.PrefabAsset = InPrefabAsset;
+			Entry.PrefabAssetUpdateID = InPrefabAsset->LastUpdateID;
+		}
+
+		if (InDepth >= FPrefabLayoutResolver::MaxNestingDepth) {
+			// The nested prefabs below this level are built on their own
+			UE_LOG(LogPrefabricatorAsset, Warning, TEXT("Prefab nesting is too deep to flatten, possible circular reference: %s"), *InPrefabAsset->GetPathName());
+			return;
+		}
+
+		// Same order as the actor loop of LoadStateFromPrefabAsset, so the random stream is consumed the same way
+		for (int32 ItemIndex = 0; ItemIndex < InPrefabAsset->ActorItems.Num(); ItemIndex++) {
+			const FPrefabricatorActorData& ActorItemData = InPrefabAsset->ActorItems[ItemIndex];
+			UClass* ActorClass = ActorItemData.ClassPathRef.TryLoadClass<UObject>();
+			if (!ActorClass || !ActorClass->IsChildOf(APrefabActor::StaticClass())) continue;
+
+			UObject* NestedPrefab = FPrefabLayoutResolver::GetNestedPrefabPath(ActorItemData).TryLoad();
+			if (UPrefabricatorAsset* NestedPrefabAsset = Cast<UPrefabricatorAsset>(NestedPrefab)) {
+				FlattenPrefabRecursive(NestedPrefabAsset, EntryIndex, ItemIndex, InDepth + 1, OutEntries);
+			}
+			else if (NestedPrefab && NestedPrefab->IsA<UPrefabricatorAssetInterface>()) {
+				FPrefabricatorFlattenedPrefab& ChoicePoint = OutEntries.AddDefaulted_GetRef();
+				ChoicePoint.ParentIndex = EntryIndex;
+				ChoicePoint.ParentActorItemIndex = ItemIndex;
+				ChoicePoint.bIsChoicePoint = true;
+			}
+		}
+
+		OutEntries[EntryIndex].SubtreeSize = OutEntries.Num() - EntryIndex;
+	}
+}
+
+void UPrefabricatorAsset::RebuildFlattenedData()
+{
+	FlattenedPrefabs.Reset();
+	ResolvedFlattenedAssets.Reset();
+	if (bPreflattenNestedPrefabs) {
+		FlattenPrefabRecursive(this, INDEX_NONE, INDEX_NONE, 0, FlattenedPrefabs);
+	}
+}
+
+bool UPrefabricatorAsset::UpdateFlattenedData()
+{
+	const TArray<FPrefabricatorFlattenedPrefab> OldFlattenedPrefabs = FlattenedPrefabs;
+	RebuildFlattenedData();
+	if (OldFlattenedPrefabs.Num() != FlattenedPrefabs.Num()) {
+		return true;
+	}
+
+	for (int32 EntryIndex = 0; EntryIndex < FlattenedPrefabs.Num(); EntryIndex++) {
+		const FPrefabricatorFlattenedPrefab& Old = OldFlattenedPrefabs[EntryIndex];
+		const FPrefabricatorFlattenedPrefab& New = FlattenedPrefabs[EntryIndex];
+		if (Old.PrefabAsset != New.PrefabAsset || Old.PrefabAssetUpdateID != New.PrefabAssetUpdateID || Old.ParentIndex != New.ParentIndex
+			|| Old.ParentActorItemIndex != New.ParentActorItemIndex || Old.SubtreeSize != New.SubtreeSize || Old.bIsChoicePoint != New.bIsChoicePoint) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool UPrefabricatorAsset::IsFlattenedDataUpToDate() const
+{
+	if (FlattenedPrefabs.Num() == 0 || ResolvedFlattenedAssets.Num() != FlattenedPrefabs.Num()) {
+		return false;
+	}
+
+	for (int32 EntryIndex = 0; EntryIndex < FlattenedPrefabs.Num(); EntryIndex++) {
+		const FPrefabricatorFlattenedPrefab& Entry = FlattenedPrefabs[EntryIndex];
+		if (Entry.bIsChoicePoint) continue;
+
+		const UPrefabricatorAsset* EntryAsset = ResolvedFlattenedAssets[EntryIndex];
+		if (!EntryAsset || EntryAsset->LastUpdateID != Entry.PrefabAssetUpdateID) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool UPrefabricatorAsset::ResolveFlattenedData()
+{
+	if (!bPreflattenNestedPrefabs) {
+		return false;
+	}
+
+	if (ResolvedFlattenedAssets.Num() != FlattenedPrefabs.Num()) {
+		ResolvedFlattenedAssets.Reset(FlattenedPrefabs.Num());
+		for (const FPrefabricatorFlattenedPrefab& Entry : FlattenedPrefabs) {
+			ResolvedFlattenedAssets.Add(Entry.bIsChoicePoint ? nullptr : Entry.PrefabAsset.LoadSynchronous());
+		}
+	}
+
+	if (IsFlattenedDataUpToDate()) {
+		return true;
+	}
+
+#if WITH_EDITOR
+	// A nested asset was saved after this one. Flatten again in memory, the asset is updated on its next save
+	RebuildFlattenedData();
+	ResolvedFlattenedAssets.Reset(FlattenedPrefabs.Num());
+	for (const FPrefabricatorFlattenedPrefab& Entry : FlattenedPrefabs) {
+		ResolvedFlattenedAssets.Add(Entry.bIsChoicePoint ? nullptr : Entry.PrefabAsset.Get());
+	}
+	return IsFlattenedDataUpToDate();
+#else
+	return false;
+#endif // WITH_EDITOR
+}
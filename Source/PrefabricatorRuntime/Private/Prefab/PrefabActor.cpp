@@ -5,8 +5,11 @@
 #include "Asset/PrefabricatorAsset.h"
 #include "Asset/PrefabricatorAssetUserData.h"
 #include "Prefab/PrefabComponent.h"
+#include "Prefab/PrefabMaterializationSubsystem.h"
 #include "Prefab/PrefabTools.h"
 #include "Utils/PrefabricatorStats.h"
+#include "Utils/PrefabricatorTelemetry.h"
+#include "Utils/PrefabricatorTrace.h"
 
 #include "IPropertyChangeListener.h"
 #include "PropertyEditorModule.h"
@@ -14,6 +17,10 @@
 // Unsupported component (seem to be added by default), that's why this is causing issue
 #include "Components/BillboardComponent.h"
 #include "Components/ActorComponent.h"
+#include "Components/BoxComponent.h"
+#include "Engine/World.h"
+#include "Net/UnrealNetwork.h"
+#include "ProfilingDebugging/CountersTrace.h"
 
 #include "Containers/Array.h"
 
@@ -23,6 +30,10 @@
 
 DEFINE_LOG_CATEGORY_STATIC(LogPrefabActor, Log, All);
 
+TRACE_DECLARE_INT_COUNTER(PrefabBuildSystem_QueueDepth, TEXT("Prefabricator/BuildSystem/QueueDepth"));
+TRACE_DECLARE_INT_COUNTER(PrefabBuildSystem_CommandsPerTick, TEXT("Prefabricator/BuildSystem/CommandsPerTick"));
+TRACE_DECLARE_FLOAT_COUNTER(PrefabBuildSystem_BudgetUsed, TEXT("Prefabricator/BuildSystem/BudgetUsed"));
+
 
 APrefabActor::APrefabActor(const FObjectInitializer& ObjectInitializer) 
 	: Super(ObjectInitializer)
@@ -63,13 +74,16 @@ void APrefabActor::Destroyed()
 	Super::Destroyed();
 
 	// Destroy all attached actors
-	{
-		TSet<AActor*> Visited;
-		TArray<AActor*> AttachedActors;
-		GetAttachedActors(AttachedActors);
-		for (AActor* AttachedActor : AttachedActors) {
-			DestroyAttachedActorsRecursive(AttachedActor, Visited);
-		}
+	DestroyAttachedActors();
+}
+
+void APrefabActor::DestroyAttachedActors()
+{
+	TSet<AActor*> Visited;
+	TArray<AActor*> AttachedActors;
+	GetAttachedActors(AttachedActors);
+	for (AActor* AttachedActor : AttachedActors) {
+		DestroyAttachedActorsRecursive(AttachedActor, Visited);
 	}
 }
 
@@ -83,9 +97,153 @@ void APrefabActor::PostActorCreated()
 {
 	Super::PostActorCreated();
 
+	// In game, the properties of a deferred spawn (asset, seed, materialization) are not applied yet
+	const UWorld* World = GetWorld();
+	if (World && World->IsGameWorld()) {
+		bCreationBuildPending = true;
+		return;
+	}
+
 	LoadPrefab();
 }
 
+void APrefabActor::PostInitializeComponents()
+{
+	Super::PostInitializeComponents();
+
+	if (!bCreationBuildPending) {
+		return;
+	}
+	bCreationBuildPending = false;
+
+	if (ShouldMaterializeOnDemand()) {
+		// Start out as just the root. The materialization subsystem builds the children once a player is in range
+		bMaterialized = false;
+		return;
+	}
+
+	if (bBuildOnCreation) {
+		LoadPrefab();
+	}
+}
+
+void APrefabActor::BeginPlay()
+{
+	Super::BeginPlay();
+
+	FGlobalPrefabSpawnTelemetry::NotifyInstanceBeginPlay();
+
+	if (ShouldMaterializeOnDemand()) {
+		if (UPrefabMaterializationSubsystem* Materialization = GetWorld()->GetSubsystem<UPrefabMaterializationSubsystem>()) {
+			// Placed instances start out materialized and are released on the first tick if nobody is near
+			Materialization->RegisterPrefab(this);
+		}
+		if (!bMaterialized) {
+			UpdateCollisionProxy();
+		}
+	}
+}
+
+void APrefabActor::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UWorld* World = GetWorld()) {
+		if (UPrefabMaterializationSubsystem* Materialization = World->GetSubsystem<UPrefabMaterializationSubsystem>()) {
+			Materialization->UnregisterPrefab(this);
+		}
+	}
+	FGlobalPrefabSpawnTelemetry::NotifyInstanceEndPlay();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+bool APrefabActor::ShouldMaterializeOnDemand() const
+{
+	const UWorld* World = GetWorld();
+	return bMaterializeOnDemand && World && World->IsGameWorld();
+}
+
+void APrefabActor::Materialize(bool bSynchronous)
+{
+	if (bMaterialized) {
+		return;
+	}
+	bMaterialized = true;
+
+	UPrefabMaterializationSubsystem* Materialization = GetWorld() ? GetWorld()->GetSubsystem<UPrefabMaterializationSubsystem>() : nullptr;
+	if (!bSynchronous && Materialization) {
+		// The collision proxy stays until the children are built
+		bMaterializePending = true;
+		Materialization->EnqueueBuild(this, ++MaterializeRequestId);
+	}
+	else {
+		// Nested seeds come from the actor's seed, so every materialization builds the same children
+		FRandomStream Random(Seed);
+		FPrefabLoadSettings LoadSettings;
+		LoadSettings.bRandomizeNestedSeed = true;
+		LoadSettings.Random = &Random;
+		LoadPrefabWithSettings(LoadSettings);
+		UpdateCollisionProxy();
+	}
+}
+
+void APrefabActor::HandleMaterializeBuildComplete(uint32 InRequestId)
+{
+	if (!IsMaterializeRequestPending(InRequestId)) {
+		return;
+	}
+	bMaterializePending = false;
+	UpdateCollisionProxy();
+}
+
+void APrefabActor::Dematerialize()
+{
+	if (!bMaterialized) {
+		return;
+	}
+
+	// Cancel the queued build. The nested builds it already queued are skipped once their prefabs are destroyed below
+	bMaterializePending = false;
+	MaterializeRequestId++;
+
+	DestroyAttachedActors();
+	bMaterialized = false;
+
+	// Without children the bounds come from the asset
+	InvalidateDescendants();
+	if (PrefabComponent) {
+		PrefabComponent->InvalidateCachedBounds();
+		PrefabComponent->UpdateBounds();
+	}
+	UpdateCollisionProxy();
+}
+
+void APrefabActor::UpdateCollisionProxy()
+{
+	const bool bWantsProxy = (!bMaterialized || bMaterializePending) && bUseCollisionProxy && PrefabComponent;
+	if (!bWantsProxy) {
+		if (CollisionProxy) {
+			CollisionProxy->DestroyComponent();
+			CollisionProxy = nullptr;
+		}
+		return;
+	}
+
+	const FBox LocalBounds = PrefabComponent->GetCachedLocalBounds(false);
+	if (!LocalBounds.IsValid) {
+		return;
+	}
+
+	if (!CollisionProxy) {
+		CollisionProxy = NewObject<UBoxComponent>(this, NAME_None, RF_Transient);
+		CollisionProxy->SetupAttachment(PrefabComponent);
+		CollisionProxy->SetHiddenInGame(true);
+		CollisionProxy->RegisterComponent();
+	}
+	CollisionProxy->SetRelativeLocation(LocalBounds.GetCenter());
+	CollisionProxy->SetBoxExtent(LocalBounds.GetExtent());
+	CollisionProxy->SetCollisionProfileName(CollisionProxyProfileName);
+}
+
 #if WITH_EDITOR
 void APrefabActor::PostEditChangeProperty(struct FPropertyChangedEvent& Event)
 {
@@ -162,6 +320,17 @@ void APrefabActor::PostDuplicate(EDuplicateMode::Type DuplicateMode)
 	}
 }
 
+void APrefabActor::PostEditUndo()
+{
+	Super::PostEditUndo();
+
+	// Undo restores the attachment state directly, without the attach / detach notifications
+	InvalidateDescendants();
+	if (PrefabComponent) {
+		PrefabComponent->InvalidateCachedBounds();
+	}
+}
+
 FName APrefabActor::GetCustomIconName() const
 {
 	static const FName PrefabIconName("ClassIcon.PrefabActor");
@@ -370,7 +539,33 @@ void APrefabActor::UnstageAllChanges()
 
 void APrefabActor::LoadPrefab()
 {
-	FPrefabTools::LoadStateFromPrefabAsset(this, FPrefabLoadSettings());
+	LoadPrefabWithSettings(FPrefabLoadSettings());
+}
+
+void APrefabActor::LoadPrefabWithSettings(const FPrefabLoadSettings& InSettings)
+{
+	if (!bMaterialized) {
+		// The asset may have changed, the bounds of the root and the proxy follow it
+		if (PrefabComponent) {
+			PrefabComponent->InvalidateCachedBounds();
+			PrefabComponent->UpdateBounds();
+		}
+		UpdateCollisionProxy();
+		return;
+	}
+
+	// A synchronous build supersedes a queued materialization
+	const bool bWasMaterializePending = bMaterializePending;
+	if (bWasMaterializePending) {
+		bMaterializePending = false;
+		MaterializeRequestId++;
+	}
+
+	FPrefabTools::LoadStateFromPrefabAsset(this, InSettings);
+
+	if (bWasMaterializePending) {
+		UpdateCollisionProxy();
+	}
 }
 
 void APrefabActor::SavePrefab()
@@ -400,13 +595,12 @@ void APrefabActor::RandomizeSeed(const FRandomStream& InRandom, bool bRecursive)
 {
 	Seed = FPrefabTools::GetRandomSeed(InRandom);
 	if (bRecursive) {
-		TArray<AActor*> AttachedChildren;
-		GetAttachedActors(AttachedChildren);
-		for (AActor* AttachedActor : AttachedChildren) {
+		ForEachAttachedActors([&InRandom, bRecursive](AActor* AttachedActor) {
 			if (APrefabActor* ChildPrefab = Cast<APrefabActor>(AttachedActor)) {
 				ChildPrefab->RandomizeSeed(InRandom, bRecursive);
 			}
-		}
+			return true;
+		});
 	}
 }
 
@@ -421,6 +615,89 @@ void APrefabActor::HandleBuildComplete()
 	}
 }
 
+namespace {
+	void AppendAttachedActorsRecursive(const AActor* InActor, TArray<TWeakObjectPtr<AActor>>& OutActors) {
+		InActor->ForEachAttachedActors([&OutActors](AActor* ChildActor) {
+			OutActors.Add(ChildActor);
+			if (const APrefabActor* ChildPrefab = Cast<APrefabActor>(ChildActor)) {
+				// Reuse the nested prefab's own cache
+				OutActors.Append(ChildPrefab->GetDescendants());
+			}
+			else {
+				AppendAttachedActorsRecursive(ChildActor, OutActors);
+			}
+			return true;
+		});
+	}
+}
+
+const TArray<TWeakObjectPtr<AActor>>& APrefabActor::GetDescendants() const
+{
+	if (bDescendantsDirty) {
+		// Reset keeps the allocation around, so rebuilding does not reallocate unless the hierarchy grew
+		CachedDescendants.Reset();
+		AppendAttachedActorsRecursive(this, CachedDescendants);
+		bDescendantsDirty = false;
+	}
+	return CachedDescendants;
+}
+
+void APrefabActor::ForEachDescendant(TFunctionRef<void(AActor*)> Visit) const
+{
+	const TArray<TWeakObjectPtr<AActor>>& Descendants = GetDescendants();
+	for (int32 Index = 0; Index < Descendants.Num(); Index++) {
+		if (AActor* Descendant = Descendants[Index].Get()) {
+			Visit(Descendant);
+		}
+	}
+}
+
+void APrefabActor::HandleChildActorAttached(AActor* ChildActor)
+{
+	if (!ChildActor) return;
+
+	// Append the new subtree to every prefab up the chain that has a valid cache. Dirty caches are rebuilt on demand
+	for (AActor* Actor = this; Actor; Actor = Actor->GetAttachParentActor()) {
+		APrefabActor* Prefab = Cast<APrefabActor>(Actor);
+		if (Prefab && !Prefab->bDescendantsDirty) {
+			Prefab->CachedDescendants.Add(ChildActor);
+			AppendAttachedActorsRecursive(ChildActor, Prefab->CachedDescendants);
+		}
+	}
+}
+
+void APrefabActor::HandleAttachmentChanged(AActor* InChildActor, const AActor* InParentActor)
+{
+	// The prefab components report the attachments made directly to a prefab
+	if (!InParentActor || InParentActor->IsA<APrefabActor>()) {
+		return;
+	}
+
+	const APrefabActor* NearestPrefab = nullptr;
+	for (const AActor* Actor = InParentActor; Actor; Actor = Actor->GetAttachParentActor()) {
+		if (const APrefabActor* Prefab = Cast<APrefabActor>(Actor)) {
+			Prefab->bDescendantsDirty = true;
+			if (!NearestPrefab) {
+				NearestPrefab = Prefab;
+			}
+		}
+	}
+
+	// The moves of the new actor change the bounds of the prefab it is now part of
+	if (NearestPrefab && NearestPrefab->PrefabComponent) {
+		NearestPrefab->PrefabComponent->HandleDescendantAttachmentChanged(InChildActor);
+	}
+}
+
+void APrefabActor::InvalidateDescendants()
+{
+	for (AActor* Actor = this; Actor; Actor = Actor->GetAttachParentActor()) {
+		if (APrefabActor* Prefab = Cast<APrefabActor>(Actor)) {
+			Prefab->bDescendantsDirty = true;
+		}
+	}
+}
+
 ////////////////////////////////// FPrefabBuildSystem //////////////////////////////////
 FPrefabBuildSystem::FPrefabBuildSystem(double InTimePerFrame)
 	: TimePerFrame(InTimePerFrame)
@@ -431,10 +708,14 @@ void FPrefabBuildSystem::Tick()
 {
 	double StartTime = FPlatformTime::Seconds();
 	
-	
+	int32 NumExecuted = 0;
 	while (BuildStack.Num() > 0) {
 		FPrefabBuildSystemCommandPtr Item = BuildStack.Pop();
-		Item->Execute(*this);
+		{
+			PREFAB_TRACE_SCOPE(TEXT("PrefabBuild.%s"), *Item->GetTraceName());
+			Item->Execute(*this);
+		}
+		NumExecuted++;
 
 		if (TimePerFrame > 0) {
 			double ElapsedTime = FPlatformTime::Seconds() - StartTime;
@@ -443,6 +724,17 @@ void FPrefabBuildSystem::Tick()
 			}
 		}
 	}
+
+	// The budget use goes above 1 when a single command overruns the frame budget
+	TRACE_COUNTER_SET(PrefabBuildSystem_QueueDepth, BuildStack.Num());
+	TRACE_COUNTER_SET(PrefabBuildSystem_CommandsPerTick, NumExecuted);
+	const float BudgetUsed = TimePerFrame > 0 ? (FPlatformTime::Seconds() - StartTime) / TimePerFrame : 0.0f;
+	if (TimePerFrame > 0) {
+		TRACE_COUNTER_SET(PrefabBuildSystem_BudgetUsed, BudgetUsed);
+	}
+	if (FPrefabSpawnTelemetry* SpawnTelemetry = FGlobalPrefabSpawnTelemetry::Get()) {
+		SpawnTelemetry->NotifyBuildSystemTick(BuildStack.Num(), BudgetUsed);
+	}
 }
 
 void FPrefabBuildSystem::Reset()
@@ -462,6 +754,25 @@ FPrefabBuildSystemCommand_BuildPrefab::FPrefabBuildSystemCommand_BuildPrefab(TWe
 {
 }
 
+FPrefabBuildSystemCommand_BuildPrefab::FPrefabBuildSystemCommand_BuildPrefab(TWeakObjectPtr<APrefabActor> InPrefab, TSharedPtr<FRandomStream> InSharedRandom)
+	: Prefab(InPrefab)
+	, bRandomizeNestedSeed(true)
+	, Random(InSharedRandom.Get())
+	, SharedRandom(InSharedRandom)
+{
+}
+
+FString FPrefabBuildSystemCommand_BuildPrefab::GetTraceName() const
+{
+	if (!Prefab.IsValid()) {
+		return TEXT("BuildPrefab [NONE]");
+	}
+	if (!Prefab->PrefabComponent) {
+		return FString::Printf(TEXT("BuildPrefab %s"), *Prefab->GetName());
+	}
+	return FString::Printf(TEXT("BuildPrefab %s [Asset=%s]"), *Prefab->GetName(), *Prefab->PrefabComponent->PrefabAssetInterface.GetAssetName());
+}
+
 void FPrefabBuildSystemCommand_BuildPrefab::Execute(FPrefabBuildSystem& BuildSystem)
 {
 	if (Prefab.IsValid()) {
@@ -482,16 +793,17 @@ void FPrefabBuildSystemCommand_BuildPrefab::Execute(FPrefabBuildSystem& BuildSys
 		BuildSystem.PushCommand(CmdBuildComplete);
 		
 		// Add the child prefabs to the stack
-		TArray<AActor*> ChildActors;
 		{
 			SCOPE_CYCLE_COUNTER(STAT_Randomize_GetChildActor);
-			Prefab->GetAttachedActors(ChildActors);
-		}
-		for (AActor* ChildActor : ChildActors) {
-			if (APrefabActor* ChildPrefab = Cast<APrefabActor>(ChildActor)) {
-				const FPrefabBuildSystemCommandPtr CmdBuildPrefab = MakeShareable(new FPrefabBuildSystemCommand_BuildPrefab(ChildPrefab, bRandomizeNestedSeed, Random));
-				BuildSystem.PushCommand(CmdBuildPrefab);
-			}
+			Prefab->ForEachAttachedActors([this, &BuildSystem](AActor* ChildActor) {
+				if (APrefabActor* ChildPrefab = Cast<APrefabActor>(ChildActor)) {
+					const FPrefabBuildSystemCommandPtr CmdBuildPrefab = SharedRandom.IsValid()
+						? MakeShareable(new FPrefabBuildSystemCommand_BuildPrefab(ChildPrefab, SharedRandom))
+						: MakeShareable(new FPrefabBuildSystemCommand_BuildPrefab(ChildPrefab, bRandomizeNestedSeed, Random));
+					BuildSystem.PushCommand(CmdBuildPrefab);
+				}
+				return true;
+			});
 		}
 	}
 }
@@ -505,6 +817,17 @@ FPrefabBuildSystemCommand_BuildPrefabSync::FPrefabBuildSystemCommand_BuildPrefab
 {
 }
 
+FString FPrefabBuildSystemCommand_BuildPrefabSync::GetTraceName() const
+{
+	if (!Prefab.IsValid()) {
+		return TEXT("BuildPrefabSync [NONE]");
+	}
+	if (!Prefab->PrefabComponent) {
+		return FString::Printf(TEXT("BuildPrefabSync %s"), *Prefab->GetName());
+	}
+	return FString::Printf(TEXT("BuildPrefabSync %s [Asset=%s]"), *Prefab->GetName(), *Prefab->PrefabComponent->PrefabAssetInterface.GetAssetName());
+}
+
 void FPrefabBuildSystemCommand_BuildPrefabSync::Execute(FPrefabBuildSystem& BuildSystem)
 {
 	double StartTime = FPlatformTime::Seconds();
@@ -535,6 +858,111 @@ void FPrefabBuildSystemCommand_NotifyBuildComplete::Execute(FPrefabBuildSystem&
 	}
 }
 
+FString FPrefabBuildSystemCommand_NotifyBuildComplete::GetTraceName() const
+{
+	return FString::Printf(TEXT("NotifyBuildComplete %s"), Prefab.IsValid() ? *Prefab->GetName() : TEXT("[NONE]"));
+}
+
+
+/////////////////////////////////////
+
+FPrefabBuildSystemCommand_MaterializePrefab::FPrefabBuildSystemCommand_MaterializePrefab(TWeakObjectPtr<APrefabActor> InPrefab, uint32 InRequestId)
+	: FPrefabBuildSystemCommand_BuildPrefab(InPrefab, MakeShareable(new FRandomStream(InPrefab.IsValid() ? InPrefab->Seed : 0)))
+	, MaterializedPrefab(InPrefab)
+	, RequestId(InRequestId)
+{
+}
+
+void FPrefabBuildSystemCommand_MaterializePrefab::Execute(FPrefabBuildSystem& BuildSystem)
+{
+	if (!MaterializedPrefab.IsValid() || !MaterializedPrefab->IsMaterializeRequestPending(RequestId)) {
+		return;
+	}
+
+	// Pushed first, so it runs after the children below
+	BuildSystem.PushCommand(MakeShareable(new FPrefabBuildSystemCommand_NotifyMaterializeComplete(MaterializedPrefab, RequestId)));
+	FPrefabBuildSystemCommand_BuildPrefab::Execute(BuildSystem);
+}
+
+FString FPrefabBuildSystemCommand_MaterializePrefab::GetTraceName() const
+{
+	return FString::Printf(TEXT("MaterializePrefab %s"), MaterializedPrefab.IsValid() ? *MaterializedPrefab->GetName() : TEXT("[NONE]"));
+}
+
+/////////////////////////////////////
+
+FPrefabBuildSystemCommand_NotifyMaterializeComplete::FPrefabBuildSystemCommand_NotifyMaterializeComplete(TWeakObjectPtr<APrefabActor> InPrefab, uint32 InRequestId)
+	: Prefab(InPrefab)
+	, RequestId(InRequestId)
+{
+}
+
+void FPrefabBuildSystemCommand_NotifyMaterializeComplete::Execute(FPrefabBuildSystem& BuildSystem)
+{
+	if (Prefab.IsValid()) {
+		Prefab->HandleMaterializeBuildComplete(RequestId);
+	}
+}
+
+FString FPrefabBuildSystemCommand_NotifyMaterializeComplete::GetTraceName() const
+{
+	return FString::Printf(TEXT("NotifyMaterializeComplete %s"), Prefab.IsValid() ? *Prefab->GetName() : TEXT("[NONE]"));
+}
+
+/////////////////////////////////////
+
+FPrefabBuildSystemCommand_BuildReplicatedPrefab::FPrefabBuildSystemCommand_BuildReplicatedPrefab(TWeakObjectPtr<AReplicablePrefabActor> InPrefab)
+	: Prefab(InPrefab)
+{
+}
+
+void FPrefabBuildSystemCommand_BuildReplicatedPrefab::Execute(FPrefabBuildSystem& BuildSystem)
+{
+	if (Prefab.IsValid()) {
+		Prefab->BuildFromReplicatedState();
+	}
+}
+
+FString FPrefabBuildSystemCommand_BuildReplicatedPrefab::GetTraceName() const
+{
+	return FString::Printf(TEXT("BuildReplicatedPrefab %s"), Prefab.IsValid() ? *Prefab->GetName() : TEXT("[NONE]"));
+}
+
+/////////////////////////////////////
+
+bool FPrefabReplicatedBuildState::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	UObject* PrefabObject = Prefab;
+	bOutSuccess = Map->SerializeObject(Ar, UPrefabricatorAssetInterface::StaticClass(), PrefabObject);
+	if (Ar.IsLoading()) {
+		Prefab = Cast<UPrefabricatorAssetInterface>(PrefabObject);
+	}
+
+	Ar << Seed;
+	Ar << NetIdentity;
+
+	uint8 bReplicatedChildren = bHasReplicatedChildren ? 1 : 0;
+	Ar.SerializeBits(&bReplicatedChildren, 1);
+	bHasReplicatedChildren = bReplicatedChildren != 0;
+
+	bool bLocationSuccess = true;
+	Location.NetSerialize(Ar, Map, bLocationSuccess);
+	Rotation.SerializeCompressedShort(Ar);
+
+	// Most pieces are not scaled, so the scale costs a single bit
+	uint8 bHasScale = Ar.IsSaving() && !Scale.Equals(FVector::OneVector) ? 1 : 0;
+	Ar.SerializeBits(&bHasScale, 1);
+	bool bScaleSuccess = true;
+	if (bHasScale) {
+		Scale.NetSerialize(Ar, Map, bScaleSuccess);
+	}
+	else if (Ar.IsLoading()) {
+		Scale = FVector::OneVector;
+	}
+
+	bOutSuccess = bOutSuccess && bLocationSuccess && bScaleSuccess;
+	return true;
+}
 
 /////////////////////////////////////
 
@@ -547,6 +975,17 @@ void AReplicablePrefabActor::GetLifetimeReplicatedProps(TArray<FLifetimeProperty
 {
 	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
 
+	DOREPLIFETIME(AReplicablePrefabActor, BuildState);
+}
+
+void AReplicablePrefabActor::PostInitializeComponents()
+{
+	// Spawned seed-only prefabs are built from the replicated state once play begins, with the same nested seeds as the clients
+	if (IsSeedOnly() && !IsNetStartupActor()) {
+		bBuildOnCreation = false;
+	}
+
+	Super::PostInitializeComponents();
 }
 
 void AReplicablePrefabActor::BeginPlay()
@@ -556,8 +995,197 @@ void AReplicablePrefabActor::BeginPlay()
 		bReplicates = false;
 		SetRemoteRoleForBackwardsCompat(ROLE_SimulatedProxy);
 		SetReplicates(true);
+
+		// Prefabs placed in the map are loaded along with their children on the clients, so there is nothing to rebuild
+		if (ReplicationMode == EPrefabReplicationMode::SeedOnly && !IsNetStartupActor()) {
+			// The clients place the prefab from the replicated state, and the pieces rarely change once built
+			SetReplicateMovement(false);
+			SetNetDormancy(DORM_DormantAll);
+			UpdateBuildState();
+			RequestBuild(false);
+		}
 	}
 
 	Super::BeginPlay();
 }
 
+void AReplicablePrefabActor::SetReplicatedSeed(int32 InSeed)
+{
+	if (!HasAuthority() || !IsSeedOnly()) {
+		return;
+	}
+
+	SetReplicatedPrefab(PrefabComponent->PrefabAssetInterface.LoadSynchronous(), InSeed, ReplicationMode);
+}
+
+void AReplicablePrefabActor::SetReplicatedPrefab(UPrefabricatorAssetInterface* InPrefab, int32 InSeed, EPrefabReplicationMode InReplicationMode)
+{
+	if (!HasAuthority()) {
+		return;
+	}
+
+	PrefabComponent->PrefabAssetInterface = InPrefab;
+	Seed = InSeed;
+
+	// Before BeginPlay (deferred spawns), the state is captured when play begins
+	if (!HasActorBegunPlay()) {
+		ReplicationMode = InReplicationMode;
+		return;
+	}
+
+	if (ReplicationMode != InReplicationMode) {
+		UE_LOG(LogPrefabActor, Warning, TEXT("%s: the replication mode can only be changed before play begins"), *GetName());
+	}
+
+	if (IsSeedOnly() && !IsNetStartupActor()) {
+		UpdateBuildState();
+		FlushNetDormancy();
+		RequestBuild(false);
+	}
+	else {
+		LoadPrefab();
+	}
+}
+
+void AReplicablePrefabActor::LoadPrefabWithSettings(const FPrefabLoadSettings& InSettings)
+{
+	// Seed-only prefabs are rebuilt from the replicated state, so it has to follow any asset or seed change on the server
+	const bool bIsNested = Cast<APrefabActor>(GetAttachParentActor()) != nullptr;
+	if (IsSeedOnly() && HasAuthority() && HasActorBegunPlay() && !IsNetStartupActor() && !bIsNested) {
+		UpdateBuildState();
+		FlushNetDormancy();
+		BuildFromReplicatedState(true);
+		return;
+	}
+
+	Super::LoadPrefabWithSettings(InSettings);
+}
+
+void AReplicablePrefabActor::UpdateBuildState()
+{
+	BuildState.Prefab = PrefabComponent->PrefabAssetInterface.LoadSynchronous();
+	BuildState.Seed = Seed;
+
+	const FTransform& Transform = GetActorTransform();
+	BuildState.Location = Transform.GetLocation();
+	BuildState.Rotation = Transform.Rotator();
+	BuildState.Scale = Transform.GetScale3D();
+
+	if (!BuildState.NetIdentity.IsValid()) {
+		BuildState.NetIdentity = FGuid::NewGuid();
+	}
+}
+
+bool AReplicablePrefabActor::IsBuildUpToDate() const
+{
+	return bBuiltFromState && BuiltPrefab.Get() == BuildState.Prefab && BuiltSeed == BuildState.Seed;
+}
+
+void AReplicablePrefabActor::OnRep_BuildState()
+{
+	// The state is only filled in by seed-only prefabs
+	if (!BuildState.Prefab) {
+		return;
+	}
+
+	// The movement is not replicated, the clients place their copy from the replicated state
+	SetActorTransform(BuildState.GetTransform());
+
+	if (!IsBuildUpToDate()) {
+		// The replicated children are addressed by name, they have to exist before their actor channels are opened
+		RequestBuild(bBuildOnArrival || BuildState.bHasReplicatedChildren);
+	}
+}
+
+void AReplicablePrefabActor::RequestBuild(bool bImmediate)
+{
+	UWorld* World = GetWorld();
+	UPrefabMaterializationSubsystem* Scheduler = World ? World->GetSubsystem<UPrefabMaterializationSubsystem>() : nullptr;
+	if (bImmediate || !Scheduler) {
+		BuildFromReplicatedState();
+	}
+	else {
+		Scheduler->EnqueueCommand(MakeShareable(new FPrefabBuildSystemCommand_BuildReplicatedPrefab(this)));
+	}
+}
+
+void AReplicablePrefabActor::BuildFromReplicatedState(bool bForce)
+{
+	// A nested replicable prefab is rebuilt along with the prefab it belongs to
+	if (Cast<APrefabActor>(GetAttachParentActor())) {
+		return;
+	}
+
+	// A queued build may have been overtaken by a build on arrival
+	if (!bForce && IsBuildUpToDate()) {
+		return;
+	}
+
+	UPrefabricatorAssetInterface* PrefabAssetInterface = BuildState.Prefab;
+	if (!PrefabAssetInterface) {
+		return;
+	}
+
+	PrefabComponent->PrefabAssetInterface = PrefabAssetInterface;
+	Seed = BuildState.Seed;
+
+	// The nested seeds are drawn from a stream of the root seed, in the same order on every machine
+	FRandomStream Random(Seed);
+	FPrefabLoadSettings LoadSettings;
+	LoadSettings.bRandomizeNestedSeed = true;
+	LoadSettings.Random = &Random;
+	FPrefabTools::LoadStateFromPrefabAsset(this, LoadSettings);
+
+	const bool bHasReplicatedChildren = AssignChildNetIdentities(this, BuildState.NetIdentity);
+
+	BuiltPrefab = PrefabAssetInterface;
+	BuiltSeed = Seed;
+	bBuiltFromState = true;
+
+	if (HasAuthority() && BuildState.bHasReplicatedChildren != bHasReplicatedChildren) {
+		BuildState.bHasReplicatedChildren = bHasReplicatedChildren;
+		FlushNetDormancy();
+		ForceNetUpdate();
+	}
+}
+
+bool AReplicablePrefabActor::AssignChildNetIdentities(AActor* InParent, const FGuid& InParentKey) const
+{
+	const bool bIsServer = HasAuthority();
+	bool bFoundReplicatedChild = false;
+	InParent->ForEachAttachedActors([this, &InParentKey, bIsServer, &bFoundReplicatedChild](AActor* ChildActor) {
+		USceneComponent* ChildRoot = ChildActor->GetRootComponent();
+		UPrefabricatorAssetUserData* PrefabUserData = ChildRoot ? ChildRoot->GetAssetUserData<UPrefabricatorAssetUserData>() : nullptr;
+		if (!PrefabUserData) {
+			return true;
+		}
+
+		// Item ids are only unique within an asset, so the key covers the whole chain of nested prefabs, starting from the net identity
+		const FGuid ChildKey = FGuid::NewDeterministicGuid(InParentKey.ToString() + PrefabUserData->ItemID.ToString());
+		if (ChildActor->GetIsReplicated()) {
+			bFoundReplicatedChild = true;
+			const FName StableName(*FString::Printf(TEXT("%s_Net%s"), *ChildActor->GetClass()->GetName(), *ChildKey.ToString(EGuidFormats::Base36Encoded)));
+			if (ChildActor->GetFName() != StableName) {
+				if (StaticFindObjectFast(nullptr, ChildActor->GetOuter(), StableName)) {
+					UE_LOG(LogPrefabActor, Warning, TEXT("Cannot rename %s to %s, the name is already taken. It will not be mapped to the server actor"), *ChildActor->GetName(), *StableName.ToString());
+					return true;
+				}
+				ChildActor->Rename(*StableName.ToString(), nullptr, REN_DontCreateRedirectors | REN_NonTransactional | REN_DoNotDirty);
+			}
+
+			// Like the actors loaded with the map, the child is addressed by its path instead of being spawned on the clients
+			ChildActor->bNetStartup = true;
+			if (!bIsServer) {
+				ChildActor->SetRole(ROLE_SimulatedProxy);
+				ChildActor->SetRemoteRoleForBackwardsCompat(ROLE_Authority);
+			}
+		}
+
+		if (Cast<APrefabActor>(ChildActor)) {
+			bFoundReplicatedChild |= AssignChildNetIdentities(ChildActor, ChildKey);
+		}
+		return true;
+	});
+	return bFoundReplicatedChild;
+}
+
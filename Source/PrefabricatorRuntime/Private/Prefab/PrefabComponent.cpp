@@ -40,20 +40,143 @@ void UPrefabComponent::OnRegister()
 		SpriteComponent->Mobility = EComponentMobility::Static;
 	}
 #endif //WITH_EDITORONLY_DATA
+
+	// The children of a loaded prefab were attached before this component existed, OnChildAttached never saw them
+	for (USceneComponent* ChildComponent : GetAttachChildren()) {
+		BindChildTransformUpdated(ChildComponent);
+	}
 }
 
 FBoxSphereBounds UPrefabComponent::CalcBounds(const FTransform& LocalToWorld) const
 {
 	APrefabActor* PrefabActor = Cast<APrefabActor>(GetOwner());
 	if (PrefabActor) {
-		FBox BoundsBox = FPrefabTools::GetPrefabBounds(PrefabActor);
-		return FBoxSphereBounds(BoundsBox);
+		// Only the cached local box is transformed here, so moving the prefab does not walk the child hierarchy
+		FBox LocalBounds = GetCachedLocalBounds(true);
+		if (LocalBounds.IsValid) {
+			return FBoxSphereBounds(LocalBounds.TransformBy(LocalToWorld));
+		}
+		return FBoxSphereBounds(LocalToWorld.GetLocation(), FVector::ZeroVector, 0);
 	}
 	else {
 		return FBoxSphereBounds(EForceInit::ForceInitToZero);
 	}
 }
 
+FBox UPrefabComponent::GetCachedLocalBounds(bool bNonColliding) const
+{
+	const int32 CacheIndex = bNonColliding ? 1 : 0;
+	if (!bCachedLocalBoundsValid[CacheIndex]) {
+		FBox LocalBounds(ForceInit);
+		APrefabActor* PrefabActor = Cast<APrefabActor>(GetOwner());
+		if (PrefabActor) {
+			LocalBounds = FPrefabTools::CalculatePrefabLocalBounds(PrefabActor, bNonColliding);
+
+			// The prefab has not been built yet. Fall back to the bounds that were captured when the asset was saved
+			if (!LocalBounds.IsValid) {
+				if (UPrefabricatorAsset* PrefabAsset = Cast<UPrefabricatorAsset>(PrefabAssetInterface.Get())) {
+					LocalBounds = PrefabAsset->LocalBounds;
+				}
+			}
+		}
+
+		CachedLocalBounds[CacheIndex] = LocalBounds;
+		bCachedLocalBoundsValid[CacheIndex] = true;
+	}
+	return CachedLocalBounds[CacheIndex];
+}
+
+void UPrefabComponent::InvalidateCachedBounds()
+{
+	// A nested prefab's bounds contribute to all the prefabs above it
+	for (USceneComponent* Component = this; Component; Component = Component->GetAttachParent()) {
+		if (UPrefabComponent* PrefabComponent = Cast<UPrefabComponent>(Component)) {
+			PrefabComponent->bCachedLocalBoundsValid[0] = false;
+			PrefabComponent->bCachedLocalBoundsValid[1] = false;
+		}
+	}
+}
+
+void UPrefabComponent::HandleDescendantAttachmentChanged(AActor* InChildActor)
+{
+	if (InChildActor) {
+		if (InChildActor->GetAttachParentActor()) {
+			BindChildTransformUpdated(InChildActor->GetRootComponent());
+		}
+		else {
+			UnbindChildTransformUpdated(InChildActor->GetRootComponent());
+		}
+	}
+	InvalidateCachedBounds();
+}
+
+void UPrefabComponent::OnChildAttached(USceneComponent* ChildComponent)
+{
+	Super::OnChildAttached(ChildComponent);
+
+	if (ChildComponent) {
+		BindChildTransformUpdated(ChildComponent);
+
+		AActor* ChildActor = ChildComponent->GetOwner();
+		APrefabActor* PrefabActor = Cast<APrefabActor>(GetOwner());
+		if (PrefabActor && ChildActor && ChildActor != PrefabActor && ChildActor->GetRootComponent() == ChildComponent) {
+			PrefabActor->HandleChildActorAttached(ChildActor);
+		}
+	}
+	InvalidateCachedBounds();
+}
+
+void UPrefabComponent::OnChildDetached(USceneComponent* ChildComponent)
+{
+	Super::OnChildDetached(ChildComponent);
+
+	if (ChildComponent) {
+		UnbindChildTransformUpdated(ChildComponent);
+	}
+	if (APrefabActor* PrefabActor = Cast<APrefabActor>(GetOwner())) {
+		PrefabActor->InvalidateDescendants();
+	}
+	InvalidateCachedBounds();
+}
+
+void UPrefabComponent::BindChildTransformUpdated(USceneComponent* InComponent)
+{
+	if (!InComponent) {
+		return;
+	}
+
+	// Bound once, however many times the component is visited
+	InComponent->TransformUpdated.RemoveAll(this);
+	InComponent->TransformUpdated.AddUObject(this, &UPrefabComponent::HandleChildTransformUpdated);
+	if (!InComponent->IsA<UPrefabComponent>()) {
+		for (USceneComponent* ChildComponent : InComponent->GetAttachChildren()) {
+			BindChildTransformUpdated(ChildComponent);
+		}
+	}
+}
+
+void UPrefabComponent::UnbindChildTransformUpdated(USceneComponent* InComponent)
+{
+	if (!InComponent) {
+		return;
+	}
+
+	InComponent->TransformUpdated.RemoveAll(this);
+	if (!InComponent->IsA<UPrefabComponent>()) {
+		for (USceneComponent* ChildComponent : InComponent->GetAttachChildren()) {
+			UnbindChildTransformUpdated(ChildComponent);
+		}
+	}
+}
+
+void UPrefabComponent::HandleChildTransformUpdated(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport)
+{
+	// Updates propagated from the prefab itself do not change the local bounds
+	if (!EnumHasAnyFlags(UpdateTransformFlags, EUpdateTransformFlags::PropagateFromParent)) {
+		InvalidateCachedBounds();
+	}
+}
+
 
 #if WITH_EDITOR
 void UPrefabComponent::OnAttachmentChanged()
@@ -0,0 +1,63 @@
+//$ Copyright 2015-23, Code Respawn Technologies Pvt Ltd - All Rights Reserved $//
+
+#include "Prefab/PrefabInstanceTemplateSubsystem.h"
+
+#include "Engine/Level.h"
+#include "Engine/World.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogPrefabInstanceTemplates, Log, All);
+
+void UPrefabInstanceTemplateSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	LevelRemovedHandle = FWorldDelegates::LevelRemovedFromWorld.AddUObject(this, &UPrefabInstanceTemplateSubsystem::HandleLevelRemovedFromWorld);
+}
+
+void UPrefabInstanceTemplateSubsystem::Deinitialize()
+{
+	FWorldDelegates::LevelRemovedFromWorld.Remove(LevelRemovedHandle);
+	LevelRemovedHandle.Reset();
+	Templates.Reset();
+
+	Super::Deinitialize();
+}
+
+bool UPrefabInstanceTemplateSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	// The prefab previews of the editor are built from templates too
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE
+		|| WorldType == EWorldType::Editor || WorldType == EWorldType::EditorPreview;
+}
+
+FPrefabInstanceTemplates* UPrefabInstanceTemplateSubsystem::GetTemplates(const UWorld* InWorld)
+{
+	UPrefabInstanceTemplateSubsystem* Subsystem = InWorld ? InWorld->GetSubsystem<UPrefabInstanceTemplateSubsystem>() : nullptr;
+	return Subsystem ? &Subsystem->Templates : nullptr;
+}
+
+void UPrefabInstanceTemplateSubsystem::FlushLevel(ULevel* InLevel)
+{
+	const int32 NumFlushed = Templates.FlushLevel(InLevel);
+	UE_LOG(LogPrefabInstanceTemplates, Verbose, TEXT("Flushed %d prefab instance templates of level %s"), NumFlushed, *GetNameSafe(InLevel));
+}
+
+void UPrefabInstanceTemplateSubsystem::Flush()
+{
+	Templates.Reset();
+}
+
+void UPrefabInstanceTemplateSubsystem::HandleLevelRemovedFromWorld(ULevel* InLevel, UWorld* InWorld)
+{
+	if (InWorld != GetWorld()) {
+		return;
+	}
+
+	// A null level means every level of the world was removed
+	if (InLevel) {
+		FlushLevel(InLevel);
+	}
+	else {
+		Flush();
+	}
+}
@@ -0,0 +1,253 @@
+//$ Copyright 2015-23, Code Respawn Technologies Pvt Ltd - All Rights Reserved $//
+
+#include "Prefab/PrefabLayoutResolver.h"
+
+#include "Asset/PrefabricatorAsset.h"
+#include "Prefab/PrefabActor.h"
+#include "Prefab/PrefabTools.h"
+
+#include "Async/Async.h"
+#include "Engine/AssetManager.h"
+#include "Engine/StreamableManager.h"
+#include "Math/RandomStream.h"
+#include "UObject/GarbageCollection.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogPrefabLayoutResolver, Log, All);
+
+void FPrefabResolvedLayout::Reset()
+{
+	Items.Reset();
+	RequiredAssets.Reset();
+	UnresolvedAssets.Reset();
+}
+
+namespace {
+	static const FName PrefabAssetInterfacePropertyName = "PrefabAssetInterface";
+
+	struct FLayoutResolveContext {
+		FPrefabResolvedLayout& Layout;
+		const FRandomStream& Random;
+		TSet<FSoftObjectPath> RequiredAssets;
+		TSet<FSoftObjectPath> UnresolvedAssets;
+		bool bCanLoad = false;
+	};
+
+	template<typename T>
+	T* ResolveLayoutObject(FLayoutResolveContext& Context, const FSoftObjectPath& InPath) {
+		if (InPath.IsNull()) {
+			return nullptr;
+		}
+		Context.RequiredAssets.Add(InPath);
+		UObject* Object = Context.bCanLoad ? InPath.TryLoad() : InPath.ResolveObject();
+		if (!Object) {
+			Context.UnresolvedAssets.Add(InPath);
+		}
+		return Cast<T>(Object);
+	}
+
+	UClass* ResolveLayoutClass(FLayoutResolveContext& Context, const FSoftClassPath& InClassPath) {
+		if (InClassPath.IsNull()) {
+			return nullptr;
+		}
+		Context.RequiredAssets.Add(InClassPath);
+		UClass* Class = Context.bCanLoad ? InClassPath.TryLoadClass<UObject>() : InClassPath.ResolveClass();
+		if (!Class) {
+			Context.UnresolvedAssets.Add(InClassPath);
+		}
+		return Class;
+	}
+
+	void GatherReferencedAssets(const FPrefabricatorItemBase& InItem, TArray<FSoftObjectPath>& OutAssets) {
+		for (const FPrefabricatorProperty& Property : InItem.SerializedProperties) {
+			if (Property.PropertyName == PrefabAssetInterfacePropertyName) {
+				continue;
+			}
+			for (const FPrefabricatorPropertyAssetMapping& Mapping : Property.AssetSoftReferenceMappings) {
+				if (!Mapping.AssetReference.IsNull()) {
+					OutAssets.AddUnique(Mapping.AssetReference);
+				}
+			}
+			for (const auto& SerializedItemEntry : Property.SerializedItems) {
+				for (const FPrefabricatorPropertyAssetMapping& Mapping : SerializedItemEntry.Value.AssetSoftReferenceMappings) {
+					if (!Mapping.AssetReference.IsNull()) {
+						OutAssets.AddUnique(Mapping.AssetReference);
+					}
+				}
+			}
+		}
+	}
+
+	FPrefabResolvedItem& AddResolvedItem(FLayoutResolveContext& Context, const FPrefabricatorItemBase& InItem, UPrefabricatorAsset* InPrefabAsset, const FTransform& InWorldTransform, int32 InDepth) {
+		FPrefabResolvedItem& Item = Context.Layout.Items.AddDefaulted_GetRef();
+		Item.Class = InItem.ClassPathRef.IsValid() ? InItem.ClassPathRef : FSoftClassPath(InItem.ClassPath);
+		Item.WorldTransform = InWorldTransform;
+		Item.PrefabItemID = InItem.PrefabItemID;
+		Item.SourcePrefab = InPrefabAsset;
+		Item.Depth = InDepth;
+		GatherReferencedAssets(InItem, Item.ReferencedAssets);
+		for (const FSoftObjectPath& AssetPath : Item.ReferencedAssets) {
+			Context.RequiredAssets.Add(AssetPath);
+		}
+		return Item;
+	}
+
+	void ResolveLayoutRecursive(FLayoutResolveContext& Context, UPrefabricatorAssetInterface* InPrefab, int32 InSeed, const FTransform& InTransform, int32 InDepth) {
+		if (!InPrefab) {
+			return;
+		}
+
+		if (InDepth >= FPrefabLayoutResolver::MaxNestingDepth) {
+			UE_LOG(LogPrefabLayoutResolver, Warning, TEXT("Prefab nesting is too deep, possible circular reference: %s"), *InPrefab->GetPathName());
+			return;
+		}
+
+		FPrefabAssetSelectionConfig SelectionConfig;
+		SelectionConfig.Seed = InSeed;
+		const TSoftObjectPtr<UPrefabricatorAsset> PrefabAssetPtr = InPrefab->SelectPrefabAsset(SelectionConfig);
+		UPrefabricatorAsset* PrefabAsset = ResolveLayoutObject<UPrefabricatorAsset>(Context, PrefabAssetPtr.ToSoftObjectPath());
+		if (!PrefabAsset) {
+			return;
+		}
+
+		// Components added to the root of the prefab actor
+		for (const FPrefabricatorComponentData& CompItemData : PrefabAsset->ComponentItems) {
+			FPrefabResolvedItem& Item = AddResolvedItem(Context, CompItemData, PrefabAsset, CompItemData.RelativeTransform * InTransform, InDepth);
+			Item.bIsRootComponent = true;
+			ResolveLayoutClass(Context, Item.Class);
+		}
+
+		// Child actors. The iteration order (and thus the random stream consumption) matches LoadStateFromPrefabAsset
+		for (const FPrefabricatorActorData& ActorItemData : PrefabAsset->ActorItems) {
+			const FSoftClassPath ClassPath = ActorItemData.ClassPathRef.IsValid() ? ActorItemData.ClassPathRef : FSoftClassPath(ActorItemData.ClassPath);
+			UClass* ActorClass = ResolveLayoutClass(Context, ClassPath);
+			if (!ActorClass) {
+				continue;
+			}
+
+			const FTransform WorldTransform = ActorItemData.RelativeTransform * InTransform;
+			if (ActorClass->IsChildOf(APrefabActor::StaticClass())) {
+				const int32 ChildSeed = FPrefabTools::GetRandomSeed(Context.Random);
+				const FSoftObjectPath ChildPrefabPath = FPrefabLayoutResolver::GetNestedPrefabPath(ActorItemData);
+				UPrefabricatorAssetInterface* ChildPrefab = ResolveLayoutObject<UPrefabricatorAssetInterface>(Context, ChildPrefabPath);
+				ResolveLayoutRecursive(Context, ChildPrefab, ChildSeed, WorldTransform, InDepth + 1);
+			}
+			else {
+				AddResolvedItem(Context, ActorItemData, PrefabAsset, WorldTransform, InDepth);
+			}
+		}
+	}
+}
+
+FSoftObjectPath FPrefabLayoutResolver::GetNestedPrefabPath(const FPrefabricatorActorData& InActorData)
+{
+	for (const FPrefabricatorComponentData& ComponentData : InActorData.ComponentItems) {
+		if (const FPrefabricatorProperty* Property = ComponentData.FindProperty(PrefabAssetInterfacePropertyName)) {
+			// The mapping tracks redirects, so prefer it over the exported text
+			if (Property->AssetSoftReferenceMappings.Num() > 0 && !Property->AssetSoftReferenceMappings[0].AssetReference.IsNull()) {
+				return Property->AssetSoftReferenceMappings[0].AssetReference;
+			}
+			return FSoftObjectPath(Property->ExportedValue);
+		}
+	}
+	return FSoftObjectPath();
+}
+
+void FPrefabLayoutResolver::Resolve(UPrefabricatorAssetInterface* InPrefab, int32 InSeed, const FTransform& InTransform, FPrefabResolvedLayout& OutLayout)
+{
+	OutLayout.Reset();
+	if (!InPrefab) {
+		return;
+	}
+
+	// Mirrors SpawnPrefab: the top level seed is drawn from a stream initialized with the user seed,
+	// and the same stream is then used for the nested prefabs
+	FRandomStream Random(InSeed);
+	const int32 PrefabSeed = FPrefabTools::GetRandomSeed(Random);
+
+	FLayoutResolveContext Context{ OutLayout, Random };
+	Context.bCanLoad = IsInGameThread();
+	ResolveLayoutRecursive(Context, InPrefab, PrefabSeed, InTransform, 0);
+
+	OutLayout.RequiredAssets = Context.RequiredAssets.Array();
+	OutLayout.UnresolvedAssets = Context.UnresolvedAssets.Array();
+}
+
+namespace {
+	struct FAsyncLayoutResolveState {
+		TSoftObjectPtr<UPrefabricatorAssetInterface> Prefab;
+		int32 Seed = 0;
+		FTransform Transform;
+		FPrefabLayoutResolvedDelegate OnResolved;
+
+		// Keeps the streamed assets alive until the final pass completes
+		TArray<TSharedPtr<FStreamableHandle>> StreamingHandles;
+		TSet<FSoftObjectPath> RequestedAssets;
+	};
+	typedef TSharedRef<FAsyncLayoutResolveState, ESPMode::ThreadSafe> FAsyncLayoutResolveStateRef;
+
+	void HandleAsyncResolvePassComplete(FAsyncLayoutResolveStateRef State, TSharedRef<FPrefabResolvedLayout, ESPMode::ThreadSafe> Layout);
+
+	void RunAsyncResolvePass(FAsyncLayoutResolveStateRef State) {
+		AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [State]() {
+			TSharedRef<FPrefabResolvedLayout, ESPMode::ThreadSafe> Layout = MakeShared<FPrefabResolvedLayout, ESPMode::ThreadSafe>();
+			{
+				// Block garbage collection while we read the prefab assets
+				FGCScopeGuard GCGuard;
+				UPrefabricatorAssetInterface* Prefab = State->Prefab.Get();
+				if (Prefab) {
+					FPrefabLayoutResolver::Resolve(Prefab, State->Seed, State->Transform, *Layout);
+				}
+				else if (!State->Prefab.IsNull()) {
+					Layout->UnresolvedAssets.Add(State->Prefab.ToSoftObjectPath());
+				}
+			}
+
+			AsyncTask(ENamedThreads::GameThread, [State, Layout]() {
+				HandleAsyncResolvePassComplete(State, Layout);
+			});
+		});
+	}
+
+	void HandleAsyncResolvePassComplete(FAsyncLayoutResolveStateRef State, TSharedRef<FPrefabResolvedLayout, ESPMode::ThreadSafe> Layout) {
+		TArray<FSoftObjectPath> AssetsToStream;
+		for (const FSoftObjectPath& AssetPath : Layout->UnresolvedAssets) {
+			if (!State->RequestedAssets.Contains(AssetPath)) {
+				AssetsToStream.Add(AssetPath);
+			}
+		}
+
+		// Done if everything resolved, or if the remaining assets have already failed to stream in
+		if (AssetsToStream.Num() == 0 || !UAssetManager::IsInitialized()) {
+			if (!Layout->IsComplete()) {
+				UE_LOG(LogPrefabLayoutResolver, Warning, TEXT("Prefab layout resolved with %d missing assets: %s"), Layout->UnresolvedAssets.Num(), *State->Prefab.ToString());
+			}
+			State->OnResolved.ExecuteIfBound(*Layout);
+			State->StreamingHandles.Reset();
+			return;
+		}
+
+		State->RequestedAssets.Append(AssetsToStream);
+		TSharedPtr<FStreamableHandle> Handle = UAssetManager::GetStreamableManager().RequestAsyncLoad(AssetsToStream, FStreamableDelegate::CreateLambda([State]() {
+			RunAsyncResolvePass(State);
+		}));
+
+		if (Handle.IsValid()) {
+			State->StreamingHandles.Add(Handle);
+		}
+		else {
+			RunAsyncResolvePass(State);
+		}
+	}
+}
+
+void FPrefabLayoutResolver::ResolveAsync(const TSoftObjectPtr<UPrefabricatorAssetInterface>& InPrefab, int32 InSeed, const FTransform& InTransform, FPrefabLayoutResolvedDelegate InOnResolved)
+{
+	check(IsInGameThread());
+
+	FAsyncLayoutResolveStateRef State = MakeShared<FAsyncLayoutResolveState, ESPMode::ThreadSafe>();
+	State->Prefab = InPrefab;
+	State->Seed = InSeed;
+	State->Transform = InTransform;
+	State->OnResolved = InOnResolved;
+	RunAsyncResolvePass(State);
+}
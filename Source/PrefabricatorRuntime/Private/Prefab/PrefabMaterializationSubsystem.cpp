@@ -0,0 +1,137 @@
+//$ Copyright 2015-23, Code Respawn Technologies Pvt Ltd - All Rights Reserved $//
+
+#include "Prefab/PrefabMaterializationSubsystem.h"
+
+#include "Prefab/PrefabActor.h"
+#include "Prefab/PrefabComponent.h"
+#include "PrefabricatorSettings.h"
+#include "Utils/PrefabricatorStats.h"
+
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+
+void UPrefabMaterializationSubsystem::Deinitialize()
+{
+	if (BuildSystem.IsValid()) {
+		BuildSystem->Reset();
+		BuildSystem.Reset();
+	}
+	Prefabs.Reset();
+
+	Super::Deinitialize();
+}
+
+bool UPrefabMaterializationSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UPrefabMaterializationSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UPrefabMaterializationSubsystem, STATGROUP_Tickables);
+}
+
+void UPrefabMaterializationSubsystem::RegisterPrefab(APrefabActor* InPrefab)
+{
+	if (InPrefab) {
+		Prefabs.AddUnique(InPrefab);
+	}
+}
+
+void UPrefabMaterializationSubsystem::UnregisterPrefab(APrefabActor* InPrefab)
+{
+	Prefabs.RemoveSingleSwap(InPrefab);
+}
+
+void UPrefabMaterializationSubsystem::EnqueueBuild(APrefabActor* InPrefab, uint32 InRequestId)
+{
+	if (!InPrefab) return;
+
+	// The nested seeds are derived from the actor's seed, so the rebuilt children match the ones that were released
+	EnqueueCommand(MakeShareable(new FPrefabBuildSystemCommand_MaterializePrefab(InPrefab, InRequestId)));
+}
+
+void UPrefabMaterializationSubsystem::EnqueueCommand(FPrefabBuildSystemCommandPtr InCommand)
+{
+	if (!InCommand.IsValid()) return;
+
+	if (!BuildSystem.IsValid()) {
+		const UPrefabricatorSettings* PS = GetDefault<UPrefabricatorSettings>();
+		BuildSystem = MakeShareable(new FPrefabBuildSystem(PS->MaterializationBuildTimePerFrame));
+	}
+	BuildSystem->PushCommand(InCommand);
+}
+
+void UPrefabMaterializationSubsystem::GatherViewLocations(TArray<FVector>& OutViewLocations) const
+{
+	// On a server this covers the view of every connected player
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It) {
+		if (APlayerController* PlayerController = It->Get()) {
+			FVector ViewLocation;
+			FRotator ViewRotation;
+			PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+			OutViewLocations.Add(ViewLocation);
+		}
+	}
+}
+
+void UPrefabMaterializationSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_Materialization_Tick);
+
+	TArray<FVector> ViewLocations;
+	GatherViewLocations(ViewLocations);
+
+	if (ViewLocations.Num() > 0) {
+		// Releasing the children destroys actors inline, so a teleport or the first tick would otherwise hitch.
+		// The prefabs over the limit are still out of range next frame and are released then
+		const int32 MaxDematerializations = GetDefault<UPrefabricatorSettings>()->MaxDematerializationsPerFrame;
+		int32 NumDematerialized = 0;
+		for (int32 Index = Prefabs.Num() - 1; Index >= 0; Index--) {
+			APrefabActor* Prefab = Prefabs[Index].Get();
+			if (!Prefab || !Prefab->PrefabComponent) {
+				Prefabs.RemoveAtSwap(Index);
+				continue;
+			}
+
+			// Dematerialized prefabs fall back to the bounds stored in the asset
+			const FBox WorldBounds = Prefab->PrefabComponent->GetCachedLocalBounds().TransformBy(Prefab->PrefabComponent->GetComponentTransform());
+			const FVector PrefabLocation = Prefab->GetActorLocation();
+			float MinDistanceSq = TNumericLimits<float>::Max();
+			for (const FVector& ViewLocation : ViewLocations) {
+				const float DistanceSq = WorldBounds.IsValid
+					? WorldBounds.ComputeSquaredDistanceToPoint(ViewLocation)
+					: FVector::DistSquared(PrefabLocation, ViewLocation);
+				MinDistanceSq = FMath::Min(MinDistanceSq, DistanceSq);
+			}
+
+			// The gap between the two radii keeps prefabs on the boundary from being rebuilt every frame
+			const float MaterializeRadius = Prefab->MaterializeRadius;
+			const float DematerializeRadius = FMath::Max(Prefab->DematerializeRadius, MaterializeRadius);
+			if (!Prefab->IsMaterialized() && MinDistanceSq <= FMath::Square(MaterializeRadius)) {
+				Prefab->Materialize();
+			}
+			else if (Prefab->IsMaterialized() && MinDistanceSq > FMath::Square(DematerializeRadius)) {
+				if (MaxDematerializations <= 0 || NumDematerialized < MaxDematerializations) {
+					Prefab->Dematerialize();
+					NumDematerialized++;
+				}
+			}
+		}
+	}
+
+	if (BuildSystem.IsValid()) {
+		BuildSystem->Tick();
+	}
+
+	int32 NumMaterialized = 0;
+	for (const TWeakObjectPtr<APrefabActor>& PrefabPtr : Prefabs) {
+		const APrefabActor* Prefab = PrefabPtr.Get();
+		if (Prefab && Prefab->IsMaterialized()) {
+			NumMaterialized++;
+		}
+	}
+	SET_DWORD_STAT(STAT_Materialization_NumRegistered, Prefabs.Num());
+	SET_DWORD_STAT(STAT_Materialization_NumMaterialized, NumMaterialized);
+}
+
@@ -6,14 +6,20 @@
 #include "Asset/PrefabricatorAssetUserData.h"
 #include "Prefab/PrefabActor.h"
 #include "Prefab/PrefabComponent.h"
+#include "Prefab/PrefabInstanceTemplateSubsystem.h"
 #include "PrefabricatorSettings.h"
 #include "Utils/PrefabricatorService.h"
 #include "Utils/PrefabricatorStats.h"
+#include "Utils/PrefabricatorTelemetry.h"
+#include "Utils/PrefabricatorTrace.h"
 
 #include "Engine/Selection.h"
 #include "EngineUtils.h"
 #include "GameFramework/Actor.h"
+#include "HAL/LowLevelMemTracker.h"
 #include "HAL/UnrealMemory.h"
+#include "Misc/MemStack.h"
+#include "ProfilingDebugging/CountersTrace.h"
 #include "PropertyPathHelpers.h"
 #include "Serialization/ObjectAndNameAsStringProxyArchive.h"
 #include "Serialization/ObjectReader.h"
@@ -29,6 +35,9 @@
 
 DEFINE_LOG_CATEGORY_STATIC(LogPrefabTools, Log, All);
 
+TRACE_DECLARE_INT_COUNTER(PrefabTemplateCache_Hits, TEXT("Prefabricator/TemplateCache/Hits"));
+TRACE_DECLARE_INT_COUNTER(PrefabTemplateCache_Misses, TEXT("Prefabricator/TemplateCache/Misses"));
+
 #define LOCTEXT_NAMESPACE "PrefabTools"
 
 namespace
@@ -38,7 +47,7 @@ namespace
 		return Comp && !Comp->IsA(UBillboardComponent::StaticClass()) && !Comp->IsA(UPrefabComponent::StaticClass());
 	}
 
-	void ForceUpdateActorLabel(AActor* InActor, const FString ActorLabel)
+	void ForceUpdateActorLabel(AActor* InActor, const FString& ActorLabel)
 	{
 #if WITH_EDITOR
 		// Must set actor's label after the item has actually been added to the hierarchy
@@ -53,6 +62,39 @@ namespace
 		});
 #endif
 	}
+
+	/** Finds the component by the path name it was saved with (relative to the owning actor) */
+	UActorComponent* FindComponentByPathName(AActor* InActor, const FString& InPathName)
+	{
+		// Components are almost always outered to the actor, where the path name is just the object name.
+		// Compare those through FName and only build path strings for the nested ones
+		const FName ComponentName(*InPathName, FNAME_Find);
+		if (!ComponentName.IsNone()) {
+			for (UActorComponent* Component : InActor->GetComponents()) {
+				if (Component && Component->GetOuter() == InActor && Component->GetFName() == ComponentName) {
+					return Component;
+				}
+			}
+		}
+
+		for (UActorComponent* Component : InActor->GetComponents()) {
+			if (Component && Component->GetOuter() != InActor && Component->GetPathName(InActor) == InPathName) {
+				return Component;
+			}
+		}
+		return nullptr;
+	}
+
+	void CompletePrefabBuild(APrefabActor* PrefabActor, bool bNotifyBuildComplete)
+	{
+		// Child properties (meshes, transforms) have changed, so the cached bounds are stale
+		PrefabActor->PrefabComponent->InvalidateCachedBounds();
+		PrefabActor->PrefabComponent->UpdateBounds();
+
+		if (bNotifyBuildComplete) {
+			PrefabActor->HandleBuildComplete();
+		}
+	}
 }
 
 void FPrefabTools::GetSelectedActors(TArray<AActor*>& OutActors)
@@ -76,7 +118,9 @@ void FPrefabTools::ParentActors(AActor* ParentActor, AActor* ChildActor)
 	if (ChildActor && ParentActor) {
 		{
 			SCOPE_CYCLE_COUNTER(STAT_ParentActors1);
+			AActor* PreviousParentActor = ChildActor->GetAttachParentActor();
 			ChildActor->DetachFromActor(FDetachmentTransformRules(EDetachmentRule::KeepWorld, false));
+			APrefabActor::HandleAttachmentChanged(ChildActor, PreviousParentActor);
 		}
 		{
 			SCOPE_CYCLE_COUNTER(STAT_ParentActors2);
@@ -84,6 +128,7 @@ void FPrefabTools::ParentActors(AActor* ParentActor, AActor* ChildActor)
 			if (Service.IsValid()) {
 				Service->ParentActors(ParentActor, ChildActor);
 			}
+			APrefabActor::HandleAttachmentChanged(ChildActor, ParentActor);
 		}
 	}
 }
@@ -107,29 +152,10 @@ int32 FPrefabTools::GetRandomSeed(const FRandomStream& InRandom)
 	return InRandom.RandRange(0, 10000000);
 }
 
-void FPrefabTools::IterateChildrenRecursive(APrefabActor* Prefab, TFunction<void(AActor*)> Visit)
+void FPrefabTools::IterateChildrenRecursive(APrefabActor* Prefab, TFunctionRef<void(AActor*)> Visit)
 {
-	TArray<AActor*> Stack;
-	{
-		TArray<AActor*> AttachedActors;
-		Prefab->GetAttachedActors(AttachedActors);
-		for (AActor* Child : AttachedActors) {
-			Stack.Push(Child);
-		}
-	}
-
-	while (Stack.Num() > 0) {
-		AActor* Top = Stack.Pop();
-
-		Visit(Top);
-
-		{
-			TArray<AActor*> AttachedActors;
-			Top->GetAttachedActors(AttachedActors);
-			for (AActor* Child : AttachedActors) {
-				Stack.Push(Child);
-			}
-		}
+	if (Prefab) {
+		Prefab->ForEachDescendant(Visit);
 	}
 }
 
@@ -264,17 +290,15 @@ void FPrefabTools::AssignAssetUserData(UActorComponent* InComp, const FGuid& InI
 	PrefabUserData->ItemID = InItemID;
 }
 
+/** Adds the item to the new container, moving the previously saved data over if it exists. Items that are not carried over are dropped */
 template <typename T>
-T* GetOrCreateData(TMap<FGuid, T>& DataContainer, FGuid ItemID)
+int32 AddSavedData(TArray<T>& NewDataContainer, TArray<T>& OldDataContainer, int32 OldIndex, const FGuid& ItemID)
 {
-	T* Data = DataContainer.Find(ItemID);
-	if (!Data)
-	{
-		Data = &DataContainer.Add(ItemID);
-	}
-	Data->bIsStale = false;
-	Data->PrefabItemID = ItemID;
-	return Data;
+	T& Data = OldDataContainer.IsValidIndex(OldIndex)
+		? NewDataContainer.Add_GetRef(MoveTemp(OldDataContainer[OldIndex]))
+		: NewDataContainer.AddDefaulted_GetRef();
+	Data.PrefabItemID = ItemID;
+	return NewDataContainer.Num() - 1;
 }
 
 template <typename T>
@@ -304,18 +328,9 @@ void FPrefabTools::SaveStateToPrefabAsset(APrefabActor* PrefabActor)
 
 	PrefabAsset->PrefabMobility = PrefabActor->GetRootComponent()->Mobility;
 
-	for (auto& ActorDataItem : PrefabAsset->ActorData)
-	{
-		ActorDataItem.Value.bIsStale = true;
-		for (auto& CompDataItem : ActorDataItem.Value.Components)
-		{
-			CompDataItem.Value.bIsStale = true;
-		}
-	}
-	for (auto& Item : PrefabAsset->ComponentData)
-	{
-		Item.Value.bIsStale = true;
-	}
+	// Make sure we don't write on top of the legacy item storage
+	PrefabAsset->ConvertLegacyItemStorage();
+	PrefabAsset->ConvertLegacyProperties();
 
 	TArray<UActorComponent*> Components;
 	PrefabActor->GetComponents(Components, false);
@@ -330,22 +345,25 @@ void FPrefabTools::SaveStateToPrefabAsset(APrefabActor* PrefabActor)
 		FGuid ItemId;
 	};
 
+	// The items are rebuilt in attachment order, so the stored order matches the spawn order
+	TArray<FPrefabricatorComponentData> ComponentItems;
+	TArray<FPrefabricatorActorData> ActorItems;
+
 	FPrefabActorLookup ActorCrossReferences;
 	TArray<FSaveContext> ItemsToSave;
 	// Support for saving components at the root of the prefab
 	for (UActorComponent* Comp : Components) {
 		if (!IsSupportedPrefabRootComponent(Comp))
 			continue;
-		UPrefabricatorAssetUserData* CompUserData = Comp->GetAssetUserData<UPrefabricatorAssetUserData>();
 		FGuid ItemID = GetOrCreateItemId(PrefabActor, Comp);
 		AssignAssetUserData(Comp, ItemID, PrefabActor);
-		FPrefabricatorComponentData* CompData = GetOrCreateData(PrefabAsset->ComponentData, ItemID);
 		// TODO: Support child actor referencing prefab component
 		// ActorCrossReferences.Register(ChildActor, ItemID);
 
 		FSaveContext SaveInfo;
 		SaveInfo.Comp = Comp;
 		SaveInfo.ItemId = ItemID;
+		SaveInfo.ItemIndex = AddSavedData(ComponentItems, PrefabAsset->ComponentItems, PrefabAsset->FindComponentItemIndex(ItemID), ItemID);
 		ItemsToSave.Add(SaveInfo);
 	}
 
@@ -353,60 +371,42 @@ void FPrefabTools::SaveStateToPrefabAsset(APrefabActor* PrefabActor)
 		if (ChildActor && ChildActor->GetRootComponent()) {
 			FGuid ItemID = GetOrCreateItemId(PrefabActor, ChildActor->GetRootComponent());
 			AssignAssetUserData(ChildActor, ItemID, PrefabActor);
-			FPrefabricatorActorData* ActorData = GetOrCreateData(PrefabAsset->ActorData, ItemID);
 			ActorCrossReferences.Register(ChildActor, ItemID);
 
 			FSaveContext SaveInfo;
 			SaveInfo.ItemId = ItemID;
 			SaveInfo.ChildActor = ChildActor;
+			SaveInfo.ItemIndex = AddSavedData(ActorItems, PrefabAsset->ActorItems, PrefabAsset->FindActorItemIndex(ItemID), ItemID);
 			ItemsToSave.Add(SaveInfo);
 		}
 	}
 
+	// Anything that was not carried over belonged to actors / components that are no longer in the prefab
+	PrefabAsset->ComponentItems = MoveTemp(ComponentItems);
+	PrefabAsset->ActorItems = MoveTemp(ActorItems);
+	PrefabAsset->RebuildItemIndex();
+
 	for (const FSaveContext& SaveInfo : ItemsToSave) {
 		if (AActor* ChildActor = SaveInfo.ChildActor)
 		{
 			if (ChildActor && ChildActor->GetRootComponent()) {
-				if (FPrefabricatorActorData* ActorData = PrefabAsset->ActorData.Find(SaveInfo.ItemId))
-				{
-					SaveActorState(ChildActor, PrefabActor, ActorCrossReferences, *ActorData);
-				}
+				SaveActorState(ChildActor, PrefabActor, ActorCrossReferences, PrefabAsset->ActorItems[SaveInfo.ItemIndex]);
 			}
 		}
 		else if (UActorComponent* Comp = SaveInfo.Comp)
 		{
-			if (FPrefabricatorComponentData* CompData = PrefabAsset->ComponentData.Find(SaveInfo.ItemId))
-			{
-				SaveComponentState(Comp, PrefabActor, ActorCrossReferences, *CompData);
-			}
-		}
-	}
-
-	for (auto ItComp = PrefabAsset->ComponentData.CreateIterator(); ItComp; ++ItComp)
-	{
-		if (ItComp->Value.bIsStale)
-		{
-			ItComp.RemoveCurrent();
+			SaveComponentState(Comp, PrefabActor, ActorCrossReferences, PrefabAsset->ComponentItems[SaveInfo.ItemIndex]);
 		}
 	}
-	for (auto ItActor = PrefabAsset->ActorData.CreateIterator(); ItActor; ++ItActor)
-	{
-		for (auto ItComp = PrefabAsset->ComponentData.CreateIterator(); ItComp; ++ItComp)
-		{
-			if (ItComp->Value.bIsStale)
-			{
-				ItComp.RemoveCurrent();
-			}
-		}
-		if (ItActor->Value.bIsStale)
-		{
-			ItActor.RemoveCurrent();
-		}
-	}
-
 
+	PrefabAsset->RebuildCrossReferenceTables();
 	PrefabAsset->Version = (uint32)EPrefabricatorAssetVersion::LatestVersion;
 
+	// The nested assets are in use by the child prefabs of this actor, so they are already loaded
+	PrefabAsset->RebuildFlattenedData();
+
+	PrefabActor->PrefabComponent->InvalidateCachedBounds();
+	PrefabAsset->LocalBounds = PrefabActor->PrefabComponent->GetCachedLocalBounds(true);
 	PrefabActor->PrefabComponent->UpdateBounds();
 
 	// Regenerate a new update id for the prefab asset
@@ -421,6 +421,7 @@ void FPrefabTools::SaveStateToPrefabAsset(APrefabActor* PrefabActor)
 }
 
 namespace {
+	static const FName PrefabAssetInterfacePropertyName = "PrefabAssetInterface";
 
 	FString GetPropertySerializedItemPath(const FString& PropertyPath, const FProperty* Property, int32 PropertyElementIndex = -1)
 	{
@@ -432,7 +433,7 @@ namespace {
 		return NewPropertyPath;
 	}
 
-	FPrefabPropertySerializedItem* GetOrCreatePropertySerializedItem(UPrefabricatorProperty* PrefabProperty, FString PropertyPath)
+	FPrefabPropertySerializedItem* GetOrCreatePropertySerializedItem(FPrefabricatorProperty* PrefabProperty, const FString& PropertyPath)
 	{
 		FPrefabPropertySerializedItem* Item = nullptr;
 		if (PrefabProperty)
@@ -446,7 +447,7 @@ namespace {
 		return Item;
 	}
 
-	FPrefabPropertySerializedItem* GetPropertySerializedItem(UPrefabricatorProperty* PrefabProperty, FString PropertyPath)
+	const FPrefabPropertySerializedItem* GetPropertySerializedItem(const FPrefabricatorProperty* PrefabProperty, const FString& PropertyPath)
 	{
 		if (PrefabProperty)
 		{
@@ -514,7 +515,7 @@ namespace {
 		APrefabActor* PrefabActor = nullptr;
 		UObject* ObjToDeserialize = nullptr;
 		//void* BackupValuePtr = nullptr;
-		UPrefabricatorProperty* PrefabProperty = nullptr;
+		const FPrefabricatorProperty* PrefabProperty = nullptr;
 
 	};
 
@@ -643,22 +644,22 @@ namespace {
 		return nullptr;
 	}
 
-	void DeserializeFields(UObject* InObjToDeserialize, const TMap<FString, TObjectPtr<UPrefabricatorProperty>>& InProperties) {
+	void DeserializeFields(UObject* InObjToDeserialize, const TArray<FPrefabricatorProperty>& InProperties) {
 		if (!InObjToDeserialize) return;
+		PREFAB_TRACE_SCOPE(TEXT("Prefab.DeserializeFields %s [Class=%s Properties=%d]"), *InObjToDeserialize->GetName(), *InObjToDeserialize->GetClass()->GetName(), InProperties.Num());
 
 		auto Comp = Cast<UActorComponent>(InObjToDeserialize);
 		AActor*  Actor = Comp ? Comp->GetOwner() : Cast<AActor>(InObjToDeserialize);
 		APrefabActor* PrefabActor = Actor ? _GetNearestActorOfType<APrefabActor>(Actor) : nullptr;
 
-		for (auto& PrefabPropertyEntry : InProperties) {
-			auto PrefabProperty = PrefabPropertyEntry.Value;
-			// If its a struct property, still let us use the value found in PrefabProperty->ExportedValue
+		static const FName AssetUserDataPropertyName = "AssetUserData";
+		for (const FPrefabricatorProperty& PrefabProperty : InProperties) {
+			// If its a struct property, still let us use the value found in PrefabProperty.ExportedValue
 			// as a starting point, only the object reference will be fixed-up.
-			if (!PrefabProperty || (PrefabProperty->bIsCrossReferencedActor && !PrefabProperty->bContainsStructProperty)) continue;
-			FString PropertyName = PrefabProperty->PropertyName;
-			if (PropertyName == "AssetUserData") continue;		// Skip this as assignment is very slow and is not needed
+			if (PrefabProperty.bIsCrossReferencedActor && !PrefabProperty.bContainsStructProperty) continue;
+			if (PrefabProperty.PropertyName == AssetUserDataPropertyName) continue;		// Skip this as assignment is very slow and is not needed
 
-			FProperty* Property = InObjToDeserialize->GetClass()->FindPropertyByName(*PropertyName);
+			FProperty* Property = InObjToDeserialize->GetClass()->FindPropertyByName(PrefabProperty.PropertyName);
 			if (Property) {
 				// do not overwrite properties that have a default sub object or an archetype object
 				if (FObjectProperty* ObjProperty = CastField<FObjectProperty>(Property)) {
@@ -668,17 +669,12 @@ namespace {
 					}
 				}
 
-				{
-					SCOPE_CYCLE_COUNTER(STAT_DeserializeFields_Iterate_LoadValue);
-					PrefabProperty->LoadReferencedAssetValues();
-				}
-
 				{
 					SCOPE_CYCLE_COUNTER(STAT_DeserializeFields_Iterate_SetValue);			
 					FDeserializeContext Context;
 					Context.ObjToDeserialize = InObjToDeserialize;
 					Context.PrefabActor = PrefabActor;
-					Context.PrefabProperty = PrefabProperty;
+					Context.PrefabProperty = &PrefabProperty;
 					DeserializeProperty(Context, Property);					
 				}
 			}
@@ -691,8 +687,8 @@ namespace {
 		UObject* ObjToSerialize = nullptr;
 		UObject* ObjTemplate = nullptr;
 		const FPrefabActorLookup& CrossReferences;
-		UPrefabricatorProperty* PrefabProperty = nullptr;
-		UPrefabricatorProperty* OldPrefabProperty = nullptr;
+		FPrefabricatorProperty* PrefabProperty = nullptr;
+		const FPrefabricatorProperty* OldPrefabProperty = nullptr;
 	};
 
 	// SerializeObjectProperty method to reuse the code.
@@ -709,9 +705,8 @@ namespace {
 			return false;
 		}
 
-		FString ObjectPath = PropertyObjectValue->GetPathName();
 		FGuid CrossRefPrefabItem;
-		if (Context.CrossReferences.GetPrefabItemId(ObjectPath, CrossRefPrefabItem)) {
+		if (Context.CrossReferences.GetPrefabItemId(PropertyObjectValue, CrossRefPrefabItem)) {
 			Context.PrefabProperty->bIsCrossReferencedActor = true;
 			// Obtain property path relative to object provided
 
@@ -899,36 +894,36 @@ namespace {
 				continue;
 			}
 
-			UPrefabricatorProperty* PrefabProperty = nullptr;
-			FString PropertyName = Property->GetName();
-
-			
 			if (ShouldSkipSerialization(Property, ObjToSerialize, PrefabActor)) {
 				continue;
 			}
 
-			FString PropertyPath = GetPropertySerializedItemPath("", Property);	
-			UPrefabricatorProperty* OldPrefabProperty = Entry.Properties.FindRef(PropertyPath);			
-			PrefabProperty = NewObject<UPrefabricatorProperty>(PrefabAsset);
-			PrefabProperty->PropertyName = PropertyName;
+			const FPrefabricatorProperty* OldPrefabProperty = Entry.FindProperty(Property->GetFName());
+			FPrefabricatorProperty PrefabProperty;
+			PrefabProperty.PropertyName = Property->GetFName();
 
-			FSerializePropertyContext Context{ PrefabActor, ObjToSerialize, ObjTemplate, CrossReferences, PrefabProperty, OldPrefabProperty };
+			FSerializePropertyContext Context{ PrefabActor, ObjToSerialize, ObjTemplate, CrossReferences, &PrefabProperty, OldPrefabProperty };
 			SerializeProperty(Context, Property);
 
 			// Root export value only supported for this property for legacy reasons.
-			//!PrefabProperty->bIsCrossReferencedActor || PrefabProperty->bContainsStructProperty)
-			if (PrefabProperty->PropertyName == "PrefabAssetInterface")
+			//!PrefabProperty.bIsCrossReferencedActor || PrefabProperty.bContainsStructProperty)
+			if (PrefabProperty.PropertyName == PrefabAssetInterfacePropertyName)
 			{
-				GetPropertyData(Property, ObjToSerialize, ObjTemplate, PrefabProperty->ExportedValue);
+				GetPropertyData(Property, ObjToSerialize, ObjTemplate, PrefabProperty.ExportedValue);
 			}
 			FString DummyString;
 			GetPropertyData(Property, ObjToSerialize, ObjTemplate, DummyString);
 			if (DummyString == "Dummy")
 				return;
-			PrefabProperty->SaveReferencedAssetValues();
+			PrefabProperty.SaveReferencedAssetValues();
 
 			// Override previous property
-			Entry.Properties.Add(PropertyPath, PrefabProperty);
+			if (FPrefabricatorProperty* ExistingProperty = Entry.FindProperty(PrefabProperty.PropertyName)) {
+				*ExistingProperty = MoveTemp(PrefabProperty);
+			}
+			else {
+				Entry.SerializedProperties.Add(MoveTemp(PrefabProperty));
+			}
 		}
 	}
 
@@ -949,9 +944,9 @@ namespace {
 	}
 
 	// TODO: THIS IS BROKEN
-	void DumpSerializedProperties(const TArray<UPrefabricatorProperty*>& InProperties) {
-		// for (UPrefabricatorProperty* Property : InProperties) {
-		// 	UE_LOG(LogPrefabTools, Log, TEXT("%s: %s"), *Property->PropertyName, *Property->ExportedValue);
+	void DumpSerializedProperties(const TArray<FPrefabricatorProperty>& InProperties) {
+		// for (const FPrefabricatorProperty& Property : InProperties) {
+		// 	UE_LOG(LogPrefabTools, Log, TEXT("%s: %s"), *Property.PropertyName.ToString(), *Property.ExportedValue);
 		// }
 
 	}
@@ -960,13 +955,13 @@ namespace {
 		//UE_LOG(LogPrefabTools, Log, TEXT("############################################################"));
 		//UE_LOG(LogPrefabTools, Log, TEXT("Actor Properties: %s"), *InActorData.ClassPathRef.GetAssetPathString());
 		//UE_LOG(LogPrefabTools, Log, TEXT("================="));
-		//DumpSerializedProperties(InActorData.Properties);
+		//DumpSerializedProperties(InActorData.SerializedProperties);
 
-		//for (const FPrefabricatorComponentData& ComponentData : InActorData.Components) {
+		//for (const FPrefabricatorComponentData& ComponentData : InActorData.ComponentItems) {
 		//	UE_LOG(LogPrefabTools, Log, TEXT(""));
 		//	UE_LOG(LogPrefabTools, Log, TEXT("Component Properties: %s"), *ComponentData.Name);
 		//	UE_LOG(LogPrefabTools, Log, TEXT("================="));
-		//	DumpSerializedProperties(ComponentData.Properties);
+		//	DumpSerializedProperties(ComponentData.SerializedProperties);
 		//}
 	}
 }
@@ -1034,19 +1029,23 @@ void FPrefabTools::SaveActorState(
 	TArray<UActorComponent*> Components;
 	InActor->GetComponents(Components);
 
+	TArray<FPrefabricatorComponentData> ComponentItems;
+	ComponentItems.Reserve(Components.Num());
 	for (UActorComponent* Component : Components) {
 		FGuid ItemID = GetOrCreateItemId(PrefabActor, Component);
-		FPrefabricatorComponentData* ComponentData = GetOrCreateData(OutActorData.Components, ItemID);
-		ComponentData->Name = Component->GetPathName(InActor);
+		const int32 OldIndex = OutActorData.ComponentItems.IndexOfByPredicate([&ItemID](const FPrefabricatorComponentData& Item) { return Item.PrefabItemID == ItemID; });
+		FPrefabricatorComponentData& ComponentData = ComponentItems[AddSavedData(ComponentItems, OutActorData.ComponentItems, OldIndex, ItemID)];
+		ComponentData.Name = Component->GetPathName(InActor);
 		if (USceneComponent* SceneComponent = Cast<USceneComponent>(Component)) {
-			ComponentData->RelativeTransform = SceneComponent->GetComponentTransform();
+			ComponentData.RelativeTransform = SceneComponent->GetComponentTransform();
 		}
 		else {
-			ComponentData->RelativeTransform = FTransform::Identity;
+			ComponentData.RelativeTransform = FTransform::Identity;
 		}
 		UObject* ComponentTemplate = FindBestComponentInCDO(ActorCDO, Component);
-		SerializeFields(*ComponentData, Component, ComponentTemplate, PrefabActor, CrossReferences);
+		SerializeFields(ComponentData, Component, ComponentTemplate, PrefabActor, CrossReferences);
 	}
+	OutActorData.ComponentItems = MoveTemp(ComponentItems);
 
 	//DumpSerializedData(OutActorData);
 }
@@ -1071,15 +1070,28 @@ void FPrefabTools::LoadComponentState(UActorComponent* InComp, const FPrefabrica
 	if (!InComp) {
 		return;
 	}
+	PREFAB_TRACE_SCOPE(TEXT("Prefab.LoadComponentState %s [Class=%s Properties=%d]"), *InComp->GetName(), *InComp->GetClass()->GetName(), InCompData.SerializedProperties.Num());
 
 	TSharedPtr<IPrefabricatorService> Service = FPrefabricatorService::Get();
 	if (Service.IsValid()) {
 		SCOPE_CYCLE_COUNTER(STAT_LoadActorState_BeginTransaction);
 	}
 
+	if (FPrefabDeferredRegistrationScope* DeferredRegistration = FPrefabDeferredRegistrationScope::Get()) {
+		// Tear down the render and physics state once, the component is registered again when the build completes
+		if (InSettings.bUnregisterComponentsBeforeLoading && InComp->IsRegistered()) {
+			InComp->UnregisterComponent();
+			DeferredRegistration->DeferComponentRegistration(InComp);
+		}
+
+		SCOPE_CYCLE_COUNTER(STAT_LoadActorState_DeserializeFieldsActor);
+		DeserializeFields(InComp, InCompData.SerializedProperties);
+		return;
+	}
+
 	{
 		SCOPE_CYCLE_COUNTER(STAT_LoadActorState_DeserializeFieldsActor);
-		DeserializeFields(InComp, InCompData.Properties);
+		DeserializeFields(InComp, InCompData.SerializedProperties);
 	}
 
 	bool bPreviouslyRegister;
@@ -1107,6 +1119,7 @@ void FPrefabTools::LoadActorState(AActor* InActor, const FPrefabricatorActorData
 	if (!InActor) {
 		return;
 	}
+	PREFAB_TRACE_SCOPE(TEXT("Prefab.LoadActorState %s [Class=%s Properties=%d Components=%d]"), *InActor->GetName(), *InActor->GetClass()->GetName(), InActorData.SerializedProperties.Num(), InActorData.ComponentItems.Num());
 
 	TSharedPtr<IPrefabricatorService> Service = FPrefabricatorService::Get();
 	if (Service.IsValid()) {
@@ -1114,22 +1127,52 @@ void FPrefabTools::LoadActorState(AActor* InActor, const FPrefabricatorActorData
 		//Service->BeginTransaction(LOCTEXT("TransLabel_LoadPrefab", "Load Prefab"));
 	}
 
-	{
-		SCOPE_CYCLE_COUNTER(STAT_LoadActorState_DeserializeFieldsActor);
-		DeserializeFields(InActor, InActorData.Properties);
+	static const FName BodyInstancePropertyName = "BodyInstance";
+
+	if (FPrefabDeferredRegistrationScope* DeferredRegistration = FPrefabDeferredRegistrationScope::Get()) {
+		// Unregister everything up front and let the build scope register the actor once all its properties are in
+		const bool bUnregisterComponents = InSettings.bUnregisterComponentsBeforeLoading;
+		if (bUnregisterComponents) {
+			SCOPE_CYCLE_COUNTER(STAT_LoadActorState_UnregisterComponent);
+			InActor->UnregisterAllComponents();
+		}
+		DeferredRegistration->DeferActorRegistration(InActor, bUnregisterComponents);
+
+		{
+			SCOPE_CYCLE_COUNTER(STAT_LoadActorState_DeserializeFieldsActor);
+			DeserializeFields(InActor, InActorData.SerializedProperties);
+		}
+
+		for (const FPrefabricatorComponentData& ComponentData : InActorData.ComponentItems) {
+			if (UActorComponent* Component = FindComponentByPathName(InActor, ComponentData.Name)) {
+				{
+					SCOPE_CYCLE_COUNTER(STAT_LoadActorState_DeserializeFieldsComponents);
+					DeserializeFields(Component, ComponentData.SerializedProperties);
+				}
+
+				// Unregistered components create their physics state from the loaded body instance when they are registered
+				if (!bUnregisterComponents && ComponentData.FindProperty(BodyInstancePropertyName)) {
+					DeferredRegistration->DeferPhysicsStateRecreate(Cast<UPrimitiveComponent>(Component));
+				}
+			}
+		}
+
+#if WITH_EDITOR
+		if (InActorData.Name.Len() > 0) {
+			ForceUpdateActorLabel(InActor, InActorData.Name);
+		}
+#endif // WITH_EDITOR
+		return;
 	}
 
-	TMap<FString, UActorComponent*> ComponentsByName;
-	for (UActorComponent* Comp : InActor->GetComponents()) {
-		FString ComponentPath = Comp->GetPathName(InActor);
-		ComponentsByName.Add(ComponentPath, Comp);
+	{
+		SCOPE_CYCLE_COUNTER(STAT_LoadActorState_DeserializeFieldsActor);
+		DeserializeFields(InActor, InActorData.SerializedProperties);
 	}
 
 	{
-		for (auto& ComponentDataEntry : InActorData.Components) {
-			auto& ComponentData = ComponentDataEntry.Value;
-			if (UActorComponent** SearchResult = ComponentsByName.Find(ComponentData.Name)) {
-				UActorComponent* Component = *SearchResult;
+		for (const FPrefabricatorComponentData& ComponentData : InActorData.ComponentItems) {
+			if (UActorComponent* Component = FindComponentByPathName(InActor, ComponentData.Name)) {
 				bool bPreviouslyRegister;
 				{
 					//SCOPE_CYCLE_COUNTER(STAT_LoadActorState_UnregisterComponent);
@@ -1141,7 +1184,7 @@ void FPrefabTools::LoadActorState(AActor* InActor, const FPrefabricatorActorData
 
 				{
 					SCOPE_CYCLE_COUNTER(STAT_LoadActorState_DeserializeFieldsComponents);
-					DeserializeFields(Component, ComponentData.Properties);
+					DeserializeFields(Component, ComponentData.SerializedProperties);
 				}
 
 				{
@@ -1155,12 +1198,8 @@ void FPrefabTools::LoadActorState(AActor* InActor, const FPrefabricatorActorData
 				{
 					if (UPrimitiveComponent* Primitive = Cast<UPrimitiveComponent>(Component)) {
 						bool bRecreatePhysicsState = false;
-						for (auto& PrefabPropertyEntry : ComponentData.Properties) {
-							auto PrefabProperty = PrefabPropertyEntry.Value;
-							if (PrefabProperty->PropertyName == "BodyInstance") {
-								bRecreatePhysicsState = true;
-								break;
-							}
+						if (ComponentData.FindProperty(BodyInstancePropertyName)) {
+							bRecreatePhysicsState = true;
 						}
 						if (bRecreatePhysicsState) {
 							Primitive->InitializeComponent();
@@ -1219,37 +1258,65 @@ void FPrefabTools::GetActorChildren(AActor* InParent, TArray<AActor*>& OutChildr
 }
 
 namespace {
-	void GetPrefabBoundsRecursive(AActor* InActor, FBox& OutBounds, bool bNonColliding, const TSet<UClass*>& IgnoreActorClasses) {
+	/**
+	 * Accumulates the bounds of the actor tree in the space defined by InSpaceTransform (world space if bWorldSpace is set).
+	 * Nested prefabs contribute their cached local bounds instead of walking their subtree
+	 */
+	void GetPrefabBoundsRecursive(AActor* InActor, const FTransform& InSpaceTransform, bool bWorldSpace, FBox& OutBounds, bool bNonColliding, const TSet<UClass*>& IgnoreActorClasses) {
 		if (InActor && InActor->IsLevelBoundsRelevant()) {
-			const bool bIgnoreBounds = InActor->IsA<APrefabActor>() || IgnoreActorClasses.Contains(InActor->GetClass()); 
+			APrefabActor* NestedPrefab = Cast<APrefabActor>(InActor);
+			if (NestedPrefab && NestedPrefab->PrefabComponent) {
+				const FBox NestedLocalBounds = NestedPrefab->PrefabComponent->GetCachedLocalBounds(bNonColliding);
+				if (NestedLocalBounds.IsValid) {
+					const FTransform& NestedTransform = NestedPrefab->PrefabComponent->GetComponentTransform();
+					OutBounds += NestedLocalBounds.TransformBy(bWorldSpace ? NestedTransform : NestedTransform.GetRelativeTransform(InSpaceTransform));
+				}
+				return;
+			}
+
+			const bool bIgnoreBounds = IgnoreActorClasses.Contains(InActor->GetClass());
 			if (!bIgnoreBounds) {
 				FBox ActorBounds(ForceInit);
 				for (const UActorComponent* ActorComponent : InActor->GetComponents()) {
 					if (const UPrimitiveComponent* InPrimComp = Cast<UPrimitiveComponent>(ActorComponent)) {
 						if (!IgnoreActorClasses.Contains(InPrimComp->GetClass())) {
 							if (InPrimComp->IsRegistered() && (bNonColliding || InPrimComp->IsCollisionEnabled())) {
-								ActorBounds += InPrimComp->Bounds.GetBox();
+								ActorBounds += bWorldSpace
+									? InPrimComp->Bounds.GetBox()
+									: InPrimComp->CalcBounds(InPrimComp->GetComponentTransform().GetRelativeTransform(InSpaceTransform)).GetBox();
 							}
 						}
 					}
 				}
 				
 				if (ActorBounds.GetExtent() == FVector::ZeroVector) {
-					ActorBounds = FBox({ InActor->GetActorLocation() });
+					const FVector ActorLocation = InActor->GetActorLocation();
+					ActorBounds = FBox({ bWorldSpace ? ActorLocation : InSpaceTransform.InverseTransformPosition(ActorLocation) });
 				}
 				OutBounds += ActorBounds;
 			}
 
-			TArray<AActor*> AttachedActors;
-			InActor->GetAttachedActors(AttachedActors);
-			for (AActor* AttachedActor : AttachedActors) {
-				GetPrefabBoundsRecursive(AttachedActor, OutBounds, bNonColliding, IgnoreActorClasses);
-			}
+			InActor->ForEachAttachedActors([&](AActor* AttachedActor) {
+				GetPrefabBoundsRecursive(AttachedActor, InSpaceTransform, bWorldSpace, OutBounds, bNonColliding, IgnoreActorClasses);
+				return true;
+			});
 		}
 	}
 
 	void DestroyActorTree(AActor* InActor) {
 		if (!InActor) return;
+		if (APrefabActor* Prefab = Cast<APrefabActor>(InActor)) {
+			// The cached list is ordered parents first, so destroy it back to front to remove children before their parents
+			const TArray<TWeakObjectPtr<AActor>> Descendants = Prefab->GetDescendants();
+			for (int32 Index = Descendants.Num() - 1; Index >= 0; Index--) {
+				if (AActor* Descendant = Descendants[Index].Get()) {
+					Descendant->Destroy();
+				}
+			}
+			Prefab->Destroy();
+			return;
+		}
+
 		TArray<AActor*> Children;
 		InActor->GetAttachedActors(Children);
 
@@ -1265,7 +1332,24 @@ FBox FPrefabTools::GetPrefabBounds(AActor* PrefabActor, bool bNonColliding)
 {
 	const UPrefabricatorSettings* Settings = GetDefault<UPrefabricatorSettings>();
 	FBox Result(EForceInit::ForceInit);
-	GetPrefabBoundsRecursive(PrefabActor, Result, bNonColliding, Settings->IgnoreBoundingBoxForObjects);
+	GetPrefabBoundsRecursive(PrefabActor, FTransform::Identity, true, Result, bNonColliding, Settings->IgnoreBoundingBoxForObjects);
+	return Result;
+}
+
+FBox FPrefabTools::CalculatePrefabLocalBounds(APrefabActor* PrefabActor, bool bNonColliding)
+{
+	FBox Result(EForceInit::ForceInit);
+	if (!PrefabActor || !PrefabActor->PrefabComponent) {
+		return Result;
+	}
+
+	const UPrefabricatorSettings* Settings = GetDefault<UPrefabricatorSettings>();
+	const FTransform& PrefabTransform = PrefabActor->PrefabComponent->GetComponentTransform();
+
+	PrefabActor->ForEachAttachedActors([&](AActor* AttachedActor) {
+		GetPrefabBoundsRecursive(AttachedActor, PrefabTransform, false, Result, bNonColliding, Settings->IgnoreBoundingBoxForObjects);
+		return true;
+	});
 	return Result;
 }
 
@@ -1279,6 +1363,38 @@ namespace
 		Comp->UnregisterComponent();
 		Comp->DestroyComponent();
 	}
+
+	/** True if the prefab has no children or prefab components left from an earlier build, so there is nothing to reuse */
+	bool IsUnbuiltPrefab(APrefabActor* PrefabActor)
+	{
+		bool bHasChildren = false;
+		PrefabActor->ForEachAttachedActors([&bHasChildren](AActor*) {
+			bHasChildren = true;
+			return false;
+		});
+		if (bHasChildren) {
+			return false;
+		}
+
+		for (UActorComponent* Comp : PrefabActor->GetComponents()) {
+			if (IsSupportedPrefabRootComponent(Comp)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/** Number of prefabs the prefab actor is nested in */
+	int32 GetPrefabNestingDepth(const AActor* InActor)
+	{
+		int32 Depth = 0;
+		for (const AActor* Parent = InActor->GetAttachParentActor(); Parent; Parent = Parent->GetAttachParentActor()) {
+			if (Parent->IsA<APrefabActor>()) {
+				Depth++;
+			}
+		}
+		return Depth;
+	}
 }
 
 void FPrefabTools::LoadStateFromPrefabAsset(APrefabActor* PrefabActor, const FPrefabLoadSettings& InSettings)
@@ -1295,18 +1411,44 @@ void FPrefabTools::LoadStateFromPrefabAsset(APrefabActor* PrefabActor, const FPr
 		return;
 	}
 
+	LLM_SCOPE_BYNAME(TEXT("Prefabricator/LoadState"));
+	INC_DWORD_STAT(STAT_LoadStateFromPrefabAsset_NumLoads);
+	PREFAB_TRACE_SCOPE(TEXT("Prefab.LoadState %s [Actor=%s Components=%d Actors=%d Depth=%d %s]"), *PrefabAsset->GetPathName(), *PrefabActor->GetName(),
+		PrefabAsset->ComponentItems.Num(), PrefabAsset->ActorItems.Num(), GetPrefabNestingDepth(PrefabActor), InSettings.bSynchronousBuild ? TEXT("Sync") : TEXT("Async"));
+
+	// The temporaries of this build come from the thread's frame arena and are released when the build returns.
+	// Nested synchronous builds push their own marks on top of this one
+	FMemStack& MemStack = FMemStack::Get();
+	FMemMark MemMark(MemStack);
+	const int32 MemStackBytesAtStart = MemStack.GetByteCount();
+
+	// Only the outermost build of this call stack owns the scope. The components of the whole build are registered when it ends
+	FPrefabDeferredRegistrationScope DeferredRegistrationScope(InSettings.bDeferComponentRegistration);
+
+	if (InSettings.bSynchronousBuild && PrefabAsset->ResolveFlattenedData() && IsUnbuiltPrefab(PrefabActor)) {
+		// Fresh instance of a pre-flattened asset. The whole tree is built in one pass
+		LoadStateFromFlattenedData(PrefabActor, PrefabAsset, 0, InSettings);
+		INC_DWORD_STAT_BY(STAT_LoadStateFromPrefabAsset_ArenaBytes, MemStack.GetByteCount() - MemStackBytesAtStart);
+		return;
+	}
+
+	// The flattened path records a sample for each of its entries
+	FPrefabSpawnTelemetryScope SpawnTelemetryScope(PrefabAsset);
 	PrefabActor->GetRootComponent()->SetMobility(PrefabAsset->PrefabMobility);
 
 	// Pool existing child actors that belong to this prefab
-	TArray<AActor*> ExistingActorPool;
-	GetActorChildren(PrefabActor, ExistingActorPool);	
-
-	FPrefabInstanceTemplates* LoadState = FGlobalPrefabInstanceTemplates::Get();
+	TArray<AActor*, TMemStackAllocator<>> ExistingActorPool;
+	PrefabActor->ForEachAttachedActors([&ExistingActorPool](AActor* ChildActor) {
+		ExistingActorPool.Add(ChildActor);
+		return true;
+	});
 
 	// If prefab is out of data, clear out all old components
-	TMap<FGuid, UActorComponent*> ReusableCompByItemID;
+	// The reusable objects are indexed by their item index in the asset
+	TArray<UActorComponent*, TMemStackAllocator<>> ReusableCompByItemIndex;
+	ReusableCompByItemIndex.SetNumZeroed(PrefabAsset->ComponentItems.Num());
 	{
-		TArray<UActorComponent*> PrefabComponents;
+		TArray<UActorComponent*, TMemStackAllocator<>> PrefabComponents;
 		PrefabActor->GetComponents(PrefabComponents, false);	
 		for (auto& Comp : PrefabComponents)
 		{
@@ -1322,52 +1464,57 @@ void FPrefabTools::LoadStateFromPrefabAsset(APrefabActor* PrefabActor, const FPr
 				continue;
 			}
 
-			ReusableCompByItemID.Add(PrefabUserData->ItemID, Comp);
+			const int32 ItemIndex = PrefabAsset->FindComponentItemIndex(PrefabUserData->ItemID);
+			if (ItemIndex != INDEX_NONE) {
+				ReusableCompByItemIndex[ItemIndex] = Comp;
+			}
 		}	
 	}
 
-	TMap<FGuid, AActor*> ActorByItemID;	
-	for (AActor* ExistingActor : ExistingActorPool) {
+	// Maps the item index to the slot of the reusable actor in the pool
+	TArray<int32, TMemStackAllocator<>> PoolIndexByItemIndex;
+	PoolIndexByItemIndex.Init(INDEX_NONE, PrefabAsset->ActorItems.Num());
+	for (int32 PoolIndex = 0; PoolIndex < ExistingActorPool.Num(); PoolIndex++) {
+		AActor* ExistingActor = ExistingActorPool[PoolIndex];
 		if (ExistingActor && ExistingActor->GetRootComponent()) {
 			UPrefabricatorAssetUserData* PrefabUserData = ExistingActor->GetRootComponent()->GetAssetUserData<UPrefabricatorAssetUserData>();
 			if (PrefabUserData && PrefabUserData->PrefabActor == PrefabActor) {
-				TArray<AActor*> ChildActors;
-				ExistingActor->GetAttachedActors(ChildActors);
-				if (ChildActors.Num() == 0) {
+				bool bHasChildren = false;
+				ExistingActor->ForEachAttachedActors([&bHasChildren](AActor*) {
+					bHasChildren = true;
+					return false;
+				});
+				if (!bHasChildren) {
 					// Only reuse actors that have no children
-					ActorByItemID.Add(PrefabUserData->ItemID, ExistingActor);
+					const int32 ItemIndex = PrefabAsset->FindActorItemIndex(PrefabUserData->ItemID);
+					if (ItemIndex != INDEX_NONE) {
+						PoolIndexByItemIndex[ItemIndex] = PoolIndex;
+					}
 				}
 			}
 		}
 	}
 
 	// PostLoad after internal object references have been resolved
-	TArray<UObject*> PostLoadObjects;
-	TMap<FGuid, UActorComponent*> PrefabItemToComponentMap;
+	TArray<UObject*, TMemStackAllocator<>> PostLoadObjects;
+	PostLoadObjects.Reserve(PrefabAsset->ComponentItems.Num() + PrefabAsset->ActorItems.Num());
+	TArray<UActorComponent*, TMemStackAllocator<>> ComponentByItemIndex;
+	ComponentByItemIndex.SetNumZeroed(PrefabAsset->ComponentItems.Num());
 
 	// Prefab component support
-	for (auto& CompItemDataEntry : PrefabAsset->ComponentData) {
-		auto& CompItemData = CompItemDataEntry.Value;
-		if (!CompItemData.ClassPathRef.IsValid()) {
-			CompItemData.ClassPathRef = CompItemData.ClassPath;
-		}
-
-		if (CompItemData.ClassPathRef.GetAssetPathString() != CompItemData.ClassPath) {
-			CompItemData.ClassPath = CompItemData.ClassPathRef.GetAssetPathString();
-		}
-
-		UClass* CompClass = LoadObject<UClass>(nullptr, *CompItemData.ClassPathRef.GetAssetPathString());
+	for (int32 ItemIndex = 0; ItemIndex < PrefabAsset->ComponentItems.Num(); ItemIndex++) {
+		const FPrefabricatorComponentData& CompItemData = PrefabAsset->ComponentItems[ItemIndex];
+		// The class path string of older items is moved over to the soft class path in UPrefabricatorAsset::PostLoad
+		UClass* CompClass = CompItemData.ClassPathRef.TryLoadClass<UObject>();
 		if (!CompClass) continue;
 
 		UActorComponent* Comp = nullptr;
 		// The prefab is not out of date. try to reuse an existing component
-		Comp = ReusableCompByItemID.FindRef(CompItemData.PrefabItemID);
+		Comp = ReusableCompByItemIndex[ItemIndex];
 		if (Comp) {
-			FString ExistingClassName = Comp->GetClass()->GetPathName();
-			FString RequiredClassName = CompItemData.ClassPathRef.GetAssetPathString();
-			if (ExistingClassName == RequiredClassName) {
+			if (Comp->GetClass() == CompClass) {
 				// We can reuse this component
-				ReusableCompByItemID.Remove(CompItemData.PrefabItemID);
+				ReusableCompByItemIndex[ItemIndex] = nullptr;
 			}
 			else {
 				Comp = nullptr;
@@ -1375,55 +1522,34 @@ void FPrefabTools::LoadStateFromPrefabAsset(APrefabActor* PrefabActor, const FPr
 		}
 
 		if (!Comp) {
-			// Create a new child actor.  Try to create it from an existing template actor that is already preset in the scene
-
-			Comp = PrefabActor->AddComponentByClass(CompClass, false, CompItemData.RelativeTransform, false);
-			if (Comp->GetName() != CompItemData.Name) {
-				Comp->Rename(*CompItemData.Name);
-			}
-			// Load the prefab properties in
-			LoadComponentState(Comp, CompItemData, InSettings);
+			Comp = SpawnComponentItem(PrefabActor, CompItemData, CompClass, InSettings);
 			PostLoadObjects.Add(Comp);
 		}
 
 		AssignAssetUserData(Comp, CompItemData.PrefabItemID, PrefabActor);
 
-		{
-			UActorComponent*& CompRef = PrefabItemToComponentMap.FindOrAdd(CompItemData.PrefabItemID);
-			CompRef = Comp;
-		}
+		ComponentByItemIndex[ItemIndex] = Comp;
 	}
 
-	// Actor component support
-	TMap<FGuid, AActor*> PrefabItemToActorMap;
+	// Actor component support. The spawned actors are indexed by their item index, which is also what the cross reference tables point to
+	TArray<AActor*, TMemStackAllocator<>> ActorByItemIndex;
+	ActorByItemIndex.SetNumZeroed(PrefabAsset->ActorItems.Num());
 	if(TSharedPtr<IPrefabricatorService> Service = FPrefabricatorService::Get()) {
-		UWorld* World = PrefabActor->GetWorld();
-		for (auto& ActorItemDataEntry : PrefabAsset->ActorData) {
-			auto& ActorItemData = ActorItemDataEntry.Value;
-			// Handle backward compatibility
-			if (!ActorItemData.ClassPathRef.IsValid()) {
-				ActorItemData.ClassPathRef = ActorItemData.ClassPath;
-			}
-
-			if (ActorItemData.ClassPathRef.GetAssetPathString() != ActorItemData.ClassPath) {
-				ActorItemData.ClassPath = ActorItemData.ClassPathRef.GetAssetPathString();
-			}
-
-			UClass* ActorClass = LoadObject<UClass>(nullptr, *ActorItemData.ClassPathRef.GetAssetPathString());
+		for (int32 ItemIndex = 0; ItemIndex < PrefabAsset->ActorItems.Num(); ItemIndex++) {
+			const FPrefabricatorActorData& ActorItemData = PrefabAsset->ActorItems[ItemIndex];
+			UClass* ActorClass = ActorItemData.ClassPathRef.TryLoadClass<UObject>();
 			if (!ActorClass) continue;
 
 			// Try to re-use an existing actor from this prefab
 			AActor* ChildActor = nullptr;
 			// The prefab is not out of date. try to reuse an existing actor item
-			if (AActor** SearchResult = ActorByItemID.Find(ActorItemData.PrefabItemID)) {
-				ChildActor = *SearchResult;
+			const int32 PoolIndex = PoolIndexByItemIndex[ItemIndex];
+			if (PoolIndex != INDEX_NONE) {
+				ChildActor = ExistingActorPool[PoolIndex];
 				if (ChildActor) {
-					FString ExistingClassName = ChildActor->GetClass()->GetPathName();
-					FString RequiredClassName = ActorItemData.ClassPathRef.GetAssetPathString();
-					if (ExistingClassName == RequiredClassName) {
-						// We can reuse this actor
-						ExistingActorPool.Remove(ChildActor);
-						ActorByItemID.Remove(ActorItemData.PrefabItemID);
+					if (ChildActor->GetClass() == ActorClass) {
+						// We can reuse this actor. Clear the pool slot so it doesn't get destroyed
+						ExistingActorPool[PoolIndex] = nullptr;
 					}
 					else {
 						ChildActor = nullptr;
@@ -1431,28 +1557,11 @@ void FPrefabTools::LoadStateFromPrefabAsset(APrefabActor* PrefabActor, const FPr
 				}
 			}
 
-			FTransform WorldTransform = ActorItemData.RelativeTransform * PrefabActor->GetTransform();
 			if (!ChildActor) {
-				// Create a new child actor.  Try to create it from an existing template actor that is already preset in the scene
-				AActor* Template = nullptr;
-				if (LoadState && InSettings.bCanLoadFromCachedTemplate) {
-					Template = LoadState->GetTemplate(ActorItemData.PrefabItemID, PrefabAsset->LastUpdateID);
-				}
-
-				ChildActor = Service->SpawnActor(ActorClass, WorldTransform, PrefabActor->GetLevel(), Template);
-
-				ParentActors(PrefabActor, ChildActor);
-
-				bool bPrefabOutOfDate = PrefabActor->LastUpdateID != PrefabAsset->LastUpdateID;
-				if (Template == nullptr || bPrefabOutOfDate) {
-					// We couldn't use a template,  so load the prefab properties in
-					LoadActorState(ChildActor, ActorItemData, InSettings);
+				bool bStateLoaded = false;
+				ChildActor = SpawnActorItem(*Service, PrefabActor, PrefabAsset, ActorItemData, ActorClass, InSettings, bStateLoaded);
+				if (bStateLoaded) {
 					PostLoadObjects.Add(ChildActor);
-
-					// Save this as a template for future reuse
-					if (LoadState && InSettings.bCanSaveToCachedTemplate) {
-						LoadState->RegisterTemplate(ActorItemData.PrefabItemID, PrefabAsset->LastUpdateID, ChildActor);
-					}
 				}
 			}
 			else {
@@ -1462,6 +1571,7 @@ void FPrefabTools::LoadStateFromPrefabAsset(APrefabActor* PrefabActor, const FPr
 
 				// Update the world transform.   The reuse happens only on leaf actors (which don't have any further child actors)
 				if (ChildActor->GetRootComponent()) {
+					const FTransform WorldTransform = ActorItemData.RelativeTransform * PrefabActor->GetTransform();
 					EComponentMobility::Type OldChildMobility = ChildActor->GetRootComponent()->Mobility;
 					ChildActor->GetRootComponent()->SetMobility(EComponentMobility::Movable);
 					ChildActor->SetActorTransform(WorldTransform);
@@ -1475,10 +1585,7 @@ void FPrefabTools::LoadStateFromPrefabAsset(APrefabActor* PrefabActor, const FPr
 
 			AssignAssetUserData(ChildActor, ActorItemData.PrefabItemID, PrefabActor);
 
-			{
-				AActor*& ChildActorRef = PrefabItemToActorMap.FindOrAdd(ActorItemData.PrefabItemID);
-				ChildActorRef = ChildActor;
-			}
+			ActorByItemIndex[ItemIndex] = ChildActor;
 
 			if (APrefabActor* ChildPrefab = Cast<APrefabActor>(ChildActor)) {
 				SCOPE_CYCLE_COUNTER(STAT_LoadStateFromPrefabAsset5);
@@ -1493,212 +1600,271 @@ void FPrefabTools::LoadStateFromPrefabAsset(APrefabActor* PrefabActor, const FPr
 		}		
 	}
 
-	// Fix up the cross references
-	for (auto& ComponentDataEntry : PrefabAsset->ComponentData) {
-		auto& ComponentData = ComponentDataEntry.Value;
-		UActorComponent** CompPtr = PrefabItemToComponentMap.Find(ComponentData.PrefabItemID);
-		if (!CompPtr) continue;
-		{
-			UActorComponent* Comp = *CompPtr;
-			FixupCrossReferences(ComponentData.Properties, Comp, PrefabItemToActorMap);
-		}
+	FixupItemCrossReferences(PrefabAsset, ComponentByItemIndex, ActorByItemIndex);
+
+	for (auto Comp : PostLoadObjects)
+	{
+		Comp->PostLoad();
 	}
 
-	for (auto& ActorItemDataEntry : PrefabAsset->ActorData) {
-		auto& ActorItemData = ActorItemDataEntry.Value;
-		AActor** ActorPtr = PrefabItemToActorMap.Find(ActorItemData.PrefabItemID);
-		if (!ActorPtr) continue;
+	// Destroy the unused actors from the pool
+	for (AActor* UnusedActor : ExistingActorPool) {
+		DestroyActorTree(UnusedActor);
+	}
 
-		AActor* Actor = *ActorPtr;
-		FixupCrossReferences(ActorItemData.Properties, Actor, PrefabItemToActorMap);
+	PrefabActor->LastUpdateID = PrefabAsset->LastUpdateID;
+	INC_DWORD_STAT_BY(STAT_LoadStateFromPrefabAsset_ArenaBytes, MemStack.GetByteCount() - MemStackBytesAtStart);
 
-		TMap<FString, UActorComponent*> ComponentByPath;
-		for (UActorComponent* Component : Actor->GetComponents()) {
-			FString ComponentPath = Component->GetPathName(Actor);
-			UActorComponent*& ComponentRef = ComponentByPath.FindOrAdd(ComponentPath);
-			ComponentRef = Component;
+	if (FPrefabDeferredRegistrationScope* DeferredRegistration = FPrefabDeferredRegistrationScope::Get()) {
+		// The bounds and the post spawn listeners need the registered components
+		DeferredRegistration->DeferBuildComplete(PrefabActor, InSettings.bSynchronousBuild);
+	}
+	else {
+		CompletePrefabBuild(PrefabActor, InSettings.bSynchronousBuild);
+	}
+}
+
+UActorComponent* FPrefabTools::SpawnComponentItem(APrefabActor* PrefabActor, const FPrefabricatorComponentData& InCompData, UClass* InCompClass, const FPrefabLoadSettings& InSettings)
+{
+	UActorComponent* Comp = PrefabActor->AddComponentByClass(InCompClass, false, InCompData.RelativeTransform, false);
+	if (Comp->GetName() != InCompData.Name) {
+		Comp->Rename(*InCompData.Name);
+	}
+	// Load the prefab properties in
+	LoadComponentState(Comp, InCompData, InSettings);
+	return Comp;
+}
+
+AActor* FPrefabTools::SpawnActorItem(IPrefabricatorService& Service, APrefabActor* PrefabActor, UPrefabricatorAsset* PrefabAsset, const FPrefabricatorActorData& InActorData, UClass* InActorClass, const FPrefabLoadSettings& InSettings, bool& bOutStateLoaded)
+{
+	// Create a new child actor.  Try to create it from an existing template actor that is already preset in the scene
+	FPrefabInstanceTemplates* LoadState = UPrefabInstanceTemplateSubsystem::GetTemplates(PrefabActor->GetWorld());
+	AActor* Template = nullptr;
+	if (LoadState && InSettings.bCanLoadFromCachedTemplate) {
+		Template = LoadState->GetTemplate(InActorData.PrefabItemID, PrefabAsset->LastUpdateID);
+		if (Template) {
+			TRACE_COUNTER_INCREMENT(PrefabTemplateCache_Hits);
+		}
+		else {
+			TRACE_COUNTER_INCREMENT(PrefabTemplateCache_Misses);
 		}
+	}
+	PREFAB_TRACE_SCOPE(TEXT("Prefab.SpawnActor %s [Asset=%s Template=%s]"), *InActorClass->GetName(), *PrefabAsset->GetName(),
+		Template ? TEXT("Hit") : (InSettings.bCanLoadFromCachedTemplate ? TEXT("Miss") : TEXT("Off")));
+
+	const FTransform WorldTransform = InActorData.RelativeTransform * PrefabActor->GetTransform();
+	AActor* ChildActor = Service.SpawnActor(InActorClass, WorldTransform, PrefabActor->GetLevel(), Template);
+	if (FPrefabSpawnTelemetry* SpawnTelemetry = FGlobalPrefabSpawnTelemetry::Get()) {
+		SpawnTelemetry->NotifyActorSpawned(Template != nullptr, LoadState && InSettings.bCanLoadFromCachedTemplate);
+	}
 
-		for (auto& ComponentDataEntry : ActorItemData.Components) {
-			auto& CompData = ComponentDataEntry.Value;
-			UActorComponent** ComponentPtr = ComponentByPath.Find(CompData.Name);
-			UActorComponent* Component = ComponentPtr ? *ComponentPtr : nullptr;
-			if (!ComponentPtr) continue;
+	ParentActors(PrefabActor, ChildActor);
 
-			FixupCrossReferences(CompData.Properties, Component, PrefabItemToActorMap);
+	bOutStateLoaded = false;
+	bool bPrefabOutOfDate = PrefabActor->LastUpdateID != PrefabAsset->LastUpdateID;
+	if (Template == nullptr || bPrefabOutOfDate) {
+		// We couldn't use a template,  so load the prefab properties in
+		LoadActorState(ChildActor, InActorData, InSettings);
+		bOutStateLoaded = true;
+
+		// Save this as a template for future reuse
+		if (LoadState && InSettings.bCanSaveToCachedTemplate) {
+			LoadState->RegisterTemplate(InActorData.PrefabItemID, PrefabAsset->LastUpdateID, ChildActor);
 		}
 	}
-	for (auto Comp : PostLoadObjects)
-	{
-		Comp->PostLoad();
+	return ChildActor;
+}
+
+void FPrefabTools::FixupItemCrossReferences(const UPrefabricatorAsset* PrefabAsset, TArrayView<UActorComponent* const> ComponentByItemIndex, TArrayView<AActor* const> ActorByItemIndex)
+{
+	// The tables index directly into the spawned actor list
+	if (ActorByItemIndex.Num() == 0) {
+		return;
 	}
 
-	// Destroy the unused actors from the pool
-	for (AActor* UnusedActor : ExistingActorPool) {
-		DestroyActorTree(UnusedActor);
+	for (int32 ItemIndex = 0; ItemIndex < PrefabAsset->ComponentItems.Num(); ItemIndex++) {
+		const FPrefabricatorComponentData& ComponentData = PrefabAsset->ComponentItems[ItemIndex];
+		if (ComponentData.CrossReferences.Num() == 0) continue;
+
+		if (UActorComponent* Comp = ComponentByItemIndex[ItemIndex]) {
+			FixupCrossReferences(ComponentData.CrossReferences, Comp, ActorByItemIndex);
+		}
 	}
 
-	PrefabActor->LastUpdateID = PrefabAsset->LastUpdateID;
+	for (int32 ItemIndex = 0; ItemIndex < PrefabAsset->ActorItems.Num(); ItemIndex++) {
+		const FPrefabricatorActorData& ActorItemData = PrefabAsset->ActorItems[ItemIndex];
+		AActor* Actor = ActorByItemIndex[ItemIndex];
+		if (!Actor) continue;
+
+		if (ActorItemData.CrossReferences.Num() > 0) {
+			FixupCrossReferences(ActorItemData.CrossReferences, Actor, ActorByItemIndex);
+		}
 
-	if (InSettings.bSynchronousBuild) {
-		PrefabActor->HandleBuildComplete();
+		for (const FPrefabricatorComponentData& CompData : ActorItemData.ComponentItems) {
+			if (CompData.CrossReferences.Num() == 0) continue;
+
+			if (UActorComponent* Component = FindComponentByPathName(Actor, CompData.Name)) {
+				FixupCrossReferences(CompData.CrossReferences, Component, ActorByItemIndex);
+			}
+		}
 	}
 }
 
-namespace
+void FPrefabTools::LoadStateFromFlattenedData(APrefabActor* PrefabActor, UPrefabricatorAsset* TopLevelAsset, int32 EntryIndex, const FPrefabLoadSettings& InSettings)
 {
-	struct FFixupCrossReferencesContext
-	{
-		UObject* ObjPtr;
-		UPrefabricatorProperty* PrefabProperty;
-		TMap<FGuid, AActor*>& PrefabItemToActorMap;
-	};
+	SCOPE_CYCLE_COUNTER(STAT_LoadStateFromFlattenedData);
+	INC_DWORD_STAT(STAT_LoadStateFromFlattenedData_NumPrefabs);
 
-	void FixupCrossReferences_ObjectHelper(
-		FFixupCrossReferencesContext& Context
-		, void* ObjectPtr
-		, const FObjectPropertyBase* ObjectProperty
-		, const FString& PropertyPath
-		, int32 Index=-1
-	)
-	{
-		FString NewPropertyPath = GetPropertySerializedItemPath(PropertyPath, ObjectProperty, Index);
+	// The asset was resolved (and checked against its flattened update id) once for the whole tree
+	const FPrefabricatorFlattenedPrefab& Entry = TopLevelAsset->FlattenedPrefabs[EntryIndex];
+	UPrefabricatorAsset* PrefabAsset = TopLevelAsset->GetFlattenedPrefabAsset(EntryIndex);
+	check(PrefabAsset);
+	FPrefabSpawnTelemetryScope SpawnTelemetryScope(PrefabAsset);
+	PREFAB_TRACE_SCOPE(TEXT("Prefab.LoadFlattened %s [Actor=%s Components=%d Actors=%d Depth=%d Entry=%d/%d]"), *PrefabAsset->GetPathName(), *PrefabActor->GetName(),
+		PrefabAsset->ComponentItems.Num(), PrefabAsset->ActorItems.Num(), GetPrefabNestingDepth(PrefabActor), EntryIndex, TopLevelAsset->FlattenedPrefabs.Num());
 
-		auto Item = GetPropertySerializedItem(Context.PrefabProperty, NewPropertyPath);
-		if (!Item) return;
+	PrefabActor->GetRootComponent()->SetMobility(PrefabAsset->PrefabMobility);
 
-		AActor** SearchResult = Context.PrefabItemToActorMap.Find(Item->CrossReferencePrefabActorId);
-		if (!SearchResult) return;
-		AActor* CrossReference = *SearchResult;
+	// The instance is unbuilt, so there are no existing items to reuse. The actors still come from the cached templates
+	// (bCanLoadFromCachedTemplate) through SpawnActorItem, same as on the level by level path
+	TArray<UObject*, TMemStackAllocator<>> PostLoadObjects;
+	PostLoadObjects.Reserve(PrefabAsset->ComponentItems.Num() + PrefabAsset->ActorItems.Num());
 
-		ObjectProperty->SetObjectPropertyValue(ObjectPtr, CrossReference);
+	TArray<UActorComponent*, TMemStackAllocator<>> ComponentByItemIndex;
+	ComponentByItemIndex.SetNumZeroed(PrefabAsset->ComponentItems.Num());
+	for (int32 ItemIndex = 0; ItemIndex < PrefabAsset->ComponentItems.Num(); ItemIndex++) {
+		const FPrefabricatorComponentData& CompItemData = PrefabAsset->ComponentItems[ItemIndex];
+		UClass* CompClass = CompItemData.ClassPathRef.TryLoadClass<UObject>();
+		if (!CompClass) continue;
 
-		////////
-		FString ActorName = CrossReference ? CrossReference->GetName() : "[NONE]";
-		UE_LOG(LogPrefabTools, Log, TEXT("Cross Reference: %s -> %s"), *Item->CrossReferencePrefabActorId.ToString(), *ActorName);
-		////////
+		UActorComponent* Comp = SpawnComponentItem(PrefabActor, CompItemData, CompClass, InSettings);
+		PostLoadObjects.Add(Comp);
+		AssignAssetUserData(Comp, CompItemData.PrefabItemID, PrefabActor);
+		ComponentByItemIndex[ItemIndex] = Comp;
 	}
 
-	void FixupCrossReferences_StructHelper(
-		FFixupCrossReferencesContext& Context
-		, void* StructPtr
-		, const FStructProperty* StructProperty
-		, const FString& PropertyPath
-		, int32 PropertyElementIndex=-1
-	);
+	TArray<AActor*, TMemStackAllocator<>> ActorByItemIndex;
+	ActorByItemIndex.SetNumZeroed(PrefabAsset->ActorItems.Num());
+	if (TSharedPtr<IPrefabricatorService> Service = FPrefabricatorService::Get()) {
+		// The child entries follow their parent in the same order as the actor items that spawn them
+		const int32 SubtreeEnd = EntryIndex + Entry.SubtreeSize;
+		int32 ChildEntryIndex = EntryIndex + 1;
 
-	void FixupCrossReferences_ArrayHelper(
-		FFixupCrossReferencesContext& Context
-		, void* ArrayPtr
-		, const FArrayProperty* ArrayProperty
-		, const FString& PropertyPath
-		, int32 PropertyElementIndex=-1
-	)
-	{
-		FString NewPropertyPath = GetPropertySerializedItemPath(PropertyPath, ArrayProperty, PropertyElementIndex);
+		for (int32 ItemIndex = 0; ItemIndex < PrefabAsset->ActorItems.Num(); ItemIndex++) {
+			const FPrefabricatorActorData& ActorItemData = PrefabAsset->ActorItems[ItemIndex];
+			UClass* ActorClass = ActorItemData.ClassPathRef.TryLoadClass<UObject>();
+			if (!ActorClass) continue;
 
-		if (const FObjectPropertyBase* ObjectProperty = CastField<FObjectPropertyBase>(ArrayProperty->Inner))
-		{
-			auto Item = GetPropertySerializedItem(Context.PrefabProperty, NewPropertyPath);
-			if (!Item)
-				return;
-			
-			FScriptArrayHelper Helper(ArrayProperty, ArrayPtr);
-			// The array may have different length by default.
-			if (Helper.Num() < Item->ArrayLength)
-			{
-				Helper.AddValues(Item->ArrayLength - Helper.Num());
+			bool bStateLoaded = false;
+			AActor* ChildActor = SpawnActorItem(*Service, PrefabActor, PrefabAsset, ActorItemData, ActorClass, InSettings, bStateLoaded);
+			if (bStateLoaded) {
+				PostLoadObjects.Add(ChildActor);
 			}
-			for (int32 Index = 0; Index < Helper.Num(); Index++)
-			{
-				void* ValuePtr = Helper.GetRawPtr(Index);
-				FixupCrossReferences_ObjectHelper(Context, ValuePtr, ObjectProperty, NewPropertyPath, Index);
+
+			ForceUpdateActorLabel(ChildActor, ActorItemData.Name);
+			AssignAssetUserData(ChildActor, ActorItemData.PrefabItemID, PrefabActor);
+			ActorByItemIndex[ItemIndex] = ChildActor;
+
+			APrefabActor* ChildPrefab = Cast<APrefabActor>(ChildActor);
+			if (!ChildPrefab) continue;
+
+			if (InSettings.bRandomizeNestedSeed && InSettings.Random) {
+				// This is a nested child prefab.  Randomize the seed of the child prefab
+				ChildPrefab->Seed = FPrefabTools::GetRandomSeed(*InSettings.Random);
 			}
-		}
-		else if (const FStructProperty* StructProperty = CastField<FStructProperty>(ArrayProperty->Inner))
-		{
-			auto Item = GetPropertySerializedItem(Context.PrefabProperty, NewPropertyPath);
-			if (!Item)
-				return;
 
-			FScriptArrayHelper Helper(ArrayProperty, ArrayPtr);
-			// The array may have different length by default.
-			if (Helper.Num() < Item->ArrayLength)
-			{
-				Helper.AddValues(Item->ArrayLength - Helper.Num());
+			int32 NestedEntryIndex = INDEX_NONE;
+			if (ChildEntryIndex < SubtreeEnd && TopLevelAsset->FlattenedPrefabs[ChildEntryIndex].ParentActorItemIndex == ItemIndex) {
+				NestedEntryIndex = ChildEntryIndex;
+				ChildEntryIndex += TopLevelAsset->FlattenedPrefabs[ChildEntryIndex].SubtreeSize;
 			}
-			for (int32 Index = 0; Index < Helper.Num(); Index++)
-			{
-				void* ValuePtr = Helper.GetRawPtr(Index);
-				FixupCrossReferences_StructHelper(Context, ValuePtr, StructProperty, NewPropertyPath, Index);
+
+			// Choice points and children that don't point to the flattened asset are built on their own
+			const bool bCanUseFlattenedEntry = NestedEntryIndex != INDEX_NONE
+				&& !TopLevelAsset->FlattenedPrefabs[NestedEntryIndex].bIsChoicePoint
+				&& ChildPrefab->PrefabComponent
+				&& ChildPrefab->PrefabComponent->PrefabAssetInterface.ToSoftObjectPath() == TopLevelAsset->FlattenedPrefabs[NestedEntryIndex].PrefabAsset.ToSoftObjectPath()
+				&& IsUnbuiltPrefab(ChildPrefab);
+
+			if (bCanUseFlattenedEntry) {
+				LoadStateFromFlattenedData(ChildPrefab, TopLevelAsset, NestedEntryIndex, InSettings);
+			}
+			else {
+				LoadStateFromPrefabAsset(ChildPrefab, InSettings);
 			}
 		}
 	}
 
-    void FixupCrossReferences_StructHelper(
-        FFixupCrossReferencesContext& Context
-        , void* StructPtr
-        , const FStructProperty* StructProperty
-        , const FString& PropertyPath
-        , int32 PropertyElementIndex
-    )
-    {
-        FString NewPropertyPath = GetPropertySerializedItemPath(PropertyPath, StructProperty, PropertyElementIndex);
-
-        for (TFieldIterator<FProperty> It(StructProperty->Struct); It; ++It) {
-            FProperty* InnerProperty = *It;
-
-            if (const FStructProperty* StructProperty = CastField<FStructProperty>(InnerProperty)) {
-                void* ValuePtr = StructProperty->ContainerPtrToValuePtr<void>(StructPtr, 0);
-                FixupCrossReferences_StructHelper(Context, ValuePtr, StructProperty, NewPropertyPath);
-            }
-            // Support for TArrays (TODO: Adds support for sets and maps).
-            else if (const FArrayProperty* ArrayProperty = CastField<FArrayProperty>(InnerProperty)) {
-                void* ValuePtr = ArrayProperty->ContainerPtrToValuePtr<void>(StructPtr, 0);
-                FixupCrossReferences_ArrayHelper(Context, ValuePtr, ArrayProperty, NewPropertyPath);
-            }
-            // Changed from FObjectProperty to FObjectPropertyBase to support also soft references.
-            else if (const FObjectPropertyBase* ObjProperty = CastField<FObjectPropertyBase>(InnerProperty)) {
-                void* ValuePtr = ObjProperty->ContainerPtrToValuePtr<void>(StructPtr, 0);
-                FixupCrossReferences_ObjectHelper(Context, ValuePtr, ObjProperty, NewPropertyPath);
-            }
-        }
-    }
+	FixupItemCrossReferences(PrefabAsset, ComponentByItemIndex, ActorByItemIndex);
+
+	for (UObject* Obj : PostLoadObjects) {
+		Obj->PostLoad();
+	}
+
+	PrefabActor->LastUpdateID = PrefabAsset->LastUpdateID;
+
+	// The nested prefabs of this entry were completed before it, same as on the level by level path
+	if (FPrefabDeferredRegistrationScope* DeferredRegistration = FPrefabDeferredRegistrationScope::Get()) {
+		DeferredRegistration->DeferBuildComplete(PrefabActor, InSettings.bSynchronousBuild);
+	}
+	else {
+		CompletePrefabBuild(PrefabActor, InSettings.bSynchronousBuild);
+	}
 }
 
 void FPrefabTools::FixupCrossReferences(
-	const UPrefabricatorPropertyMap& PrefabProperties
+	const TArray<FPrefabricatorCrossReference>& CrossReferences
 	, UObject* ObjToWrite
-	, TMap<FGuid, AActor*>& PrefabItemToActorMap)
+	, TArrayView<AActor* const> TargetActors)
 {
-	for (auto& PrefabPropertyEntry : PrefabProperties) {
-		auto& PrefabProperty = PrefabPropertyEntry.Value;
-		if (!PrefabProperty || !PrefabProperty->bIsCrossReferencedActor) continue;
-
-		FFixupCrossReferencesContext Context{ ObjToWrite , PrefabProperty , PrefabItemToActorMap };
-
-		FProperty* Property = ObjToWrite->GetClass()->FindPropertyByName(*PrefabProperty->PropertyName);
-		FString PropertyPath = "";
+	if (!ObjToWrite) return;
+	PREFAB_TRACE_SCOPE(TEXT("Prefab.FixupCrossReferences %s [References=%d]"), *ObjToWrite->GetName(), CrossReferences.Num());
+
+	for (const FPrefabricatorCrossReference& CrossReference : CrossReferences) {
+		if (!TargetActors.IsValidIndex(CrossReference.TargetIndex)) continue;
+		AActor* CrossReferenceActor = TargetActors[CrossReference.TargetIndex];
+
+		// Walk the property path down to the object property
+		const UStruct* ContainerStruct = ObjToWrite->GetClass();
+		void* ContainerPtr = ObjToWrite;
+		for (int32 SegmentIndex = 0; SegmentIndex < CrossReference.PropertyPath.Num(); SegmentIndex++) {
+			const FPrefabricatorPropertyPathSegment& Segment = CrossReference.PropertyPath[SegmentIndex];
+			FProperty* Property = FindFProperty<FProperty>(ContainerStruct, Segment.PropertyName);
+			if (!Property) break;
+
+			void* ValuePtr = Property->ContainerPtrToValuePtr<void>(ContainerPtr);
+			if (Segment.ArrayIndex != INDEX_NONE) {
+				// Support for TArrays (TODO: Adds support for sets and maps).
+				const FArrayProperty* ArrayProperty = CastField<FArrayProperty>(Property);
+				if (!ArrayProperty) break;
+
+				FScriptArrayHelper Helper(ArrayProperty, ValuePtr);
+				// The array may have different length by default.
+				const int32 RequiredLength = FMath::Max(Segment.ArrayLength, Segment.ArrayIndex + 1);
+				if (Helper.Num() < RequiredLength) {
+					Helper.AddValues(RequiredLength - Helper.Num());
+				}
+				ValuePtr = Helper.GetRawPtr(Segment.ArrayIndex);
+				Property = ArrayProperty->Inner;
+			}
 
-		// Support for TArrays (TODO: Adds support for sets and maps).
-		if (const FStructProperty* StructProperty = CastField<FStructProperty>(Property))
-		{
-			void* ValuePtr = Property->ContainerPtrToValuePtr<void>(ObjToWrite);
-			FixupCrossReferences_StructHelper(Context, ValuePtr, StructProperty, PropertyPath);
-		}
-		else if (const FArrayProperty* ArrayProperty = CastField<FArrayProperty>(Property))
-		{
-			void* ValuePtr = Property->ContainerPtrToValuePtr<void>(ObjToWrite);
-			FixupCrossReferences_ArrayHelper(Context, ValuePtr, ArrayProperty, PropertyPath);
-		}
-		// FObjectProperty instead of FObjectPropertyBase to support also soft references
-		else if (const FObjectPropertyBase* ObjectProperty = CastField<FObjectPropertyBase>(Property)) 
-		{
-			void* ValuePtr = Property->ContainerPtrToValuePtr<void>(ObjToWrite);
-			FixupCrossReferences_ObjectHelper(Context, ValuePtr, ObjectProperty, PropertyPath);
+			const bool bLastSegment = SegmentIndex == CrossReference.PropertyPath.Num() - 1;
+			if (bLastSegment) {
+				// FObjectPropertyBase instead of FObjectProperty to also support soft references
+				if (const FObjectPropertyBase* ObjectProperty = CastField<FObjectPropertyBase>(Property)) {
+					ObjectProperty->SetObjectPropertyValue(ValuePtr, CrossReferenceActor);
+					UE_LOG(LogPrefabTools, Verbose, TEXT("Cross Reference: %s -> %s"), *Segment.PropertyName.ToString(), CrossReferenceActor ? *CrossReferenceActor->GetName() : TEXT("[NONE]"));
+				}
+			}
+			else if (const FStructProperty* StructProperty = CastField<FStructProperty>(Property)) {
+				ContainerStruct = StructProperty->Struct;
+				ContainerPtr = ValuePtr;
+			}
+			else {
+				// Note: there cannot be more than array, structs, and straight up object deemed as cross ref
+				break;
+			}
 		}
-		// Note: there cannot be more than array, structs, and straight up object deemed as cross ref
-		// Nothing to do here
 	}
 }
 
@@ -1716,6 +1882,18 @@ void FPrefabVersionControl::UpgradeToLatestVersion(UPrefabricatorAsset* PrefabAs
 		UpgradeFromVersion_AddedSoftReferencesPrefabFix(PrefabAsset);
 	}
 
+	if (PrefabAsset->Version == (int32)EPrefabricatorAssetVersion::AddedSoftReferenceOffsets) {
+		UpgradeFromVersion_AddedSoftReferenceOffsets(PrefabAsset);
+	}
+
+	if (PrefabAsset->Version == (int32)EPrefabricatorAssetVersion::AddedPropertyStructs) {
+		UpgradeFromVersion_AddedPropertyStructs(PrefabAsset);
+	}
+
+	if (PrefabAsset->Version == (int32)EPrefabricatorAssetVersion::AddedCrossReferenceTable) {
+		UpgradeFromVersion_AddedCrossReferenceTable(PrefabAsset);
+	}
+
 	//....
 
 }
@@ -1742,30 +1920,62 @@ void FPrefabVersionControl::UpgradeFromVersion_AddedSoftReferencesPrefabFix(UPre
 {
 	check(PrefabAsset->Version == (int32)EPrefabricatorAssetVersion::AddedSoftReference_PrefabFix);
 
+	// Rescan the exported values so the mappings record where each reference lives in the text
+	RefreshReferenceList(PrefabAsset);
+
+	PrefabAsset->Version = (int32)EPrefabricatorAssetVersion::AddedSoftReferenceOffsets;
+}
+
+void FPrefabVersionControl::UpgradeFromVersion_AddedSoftReferenceOffsets(UPrefabricatorAsset* PrefabAsset)
+{
+	check(PrefabAsset->Version == (int32)EPrefabricatorAssetVersion::AddedSoftReferenceOffsets);
+
+	// Move the per-property objects inline. This already happens on load, but the asset is only dirtied here
+	PrefabAsset->ConvertLegacyProperties();
+	PrefabAsset->Modify();
+
+	PrefabAsset->Version = (int32)EPrefabricatorAssetVersion::AddedPropertyStructs;
+}
+
+void FPrefabVersionControl::UpgradeFromVersion_AddedPropertyStructs(UPrefabricatorAsset* PrefabAsset)
+{
+	check(PrefabAsset->Version == (int32)EPrefabricatorAssetVersion::AddedPropertyStructs);
+
+	// Move the items out of the guid maps, the cross reference tables index the actor items directly
+	PrefabAsset->ConvertLegacyItemStorage();
+	PrefabAsset->RebuildItemIndex();
+	PrefabAsset->RebuildCrossReferenceTables();
+	PrefabAsset->Modify();
+
+	PrefabAsset->Version = (int32)EPrefabricatorAssetVersion::AddedCrossReferenceTable;
+}
+
+void FPrefabVersionControl::UpgradeFromVersion_AddedCrossReferenceTable(UPrefabricatorAsset* PrefabAsset)
+{
+	check(PrefabAsset->Version == (int32)EPrefabricatorAssetVersion::AddedCrossReferenceTable);
+
 	// Handle upgrade here to move to the next version
 }
 
 void FPrefabVersionControl::RefreshReferenceList(UPrefabricatorAsset* PrefabAsset)
 {
-	for (auto& ComponentDataEntry : PrefabAsset->ComponentData) {
-		auto& ComponentData = ComponentDataEntry.Value;
-		for (auto& ComponentPropertyEntry : ComponentData.Properties) {
-			auto& ComponentProperty = ComponentPropertyEntry.Value;
-			ComponentProperty->SaveReferencedAssetValues();
+	// Earlier versions are upgraded from the legacy item storage and property objects
+	PrefabAsset->ConvertLegacyItemStorage();
+	PrefabAsset->ConvertLegacyProperties();
+
+	for (FPrefabricatorComponentData& ComponentData : PrefabAsset->ComponentItems) {
+		for (FPrefabricatorProperty& ComponentProperty : ComponentData.SerializedProperties) {
+			ComponentProperty.SaveReferencedAssetValues();
 		}
 	}
-	for (auto& ActorDataEntry : PrefabAsset->ActorData) {
-		auto& ActorData = ActorDataEntry.Value;
-		for (auto& ActorPropertyEntry : ActorData.Properties) {
-			auto& ActorProperty = ActorPropertyEntry.Value;
-			ActorProperty->SaveReferencedAssetValues();
+	for (FPrefabricatorActorData& ActorData : PrefabAsset->ActorItems) {
+		for (FPrefabricatorProperty& ActorProperty : ActorData.SerializedProperties) {
+			ActorProperty.SaveReferencedAssetValues();
 		}
 
-		for (auto& ComponentDataEntry : ActorData.Components) {
-			auto& ComponentData = ComponentDataEntry.Value;
-			for (auto& ComponentPropertyEntry : ComponentData.Properties) {
-				auto& ComponentProperty = ComponentPropertyEntry.Value;
-				ComponentProperty->SaveReferencedAssetValues();
+		for (FPrefabricatorComponentData& ComponentData : ActorData.ComponentItems) {
+			for (FPrefabricatorProperty& ComponentProperty : ComponentData.SerializedProperties) {
+				ComponentProperty.SaveReferencedAssetValues();
 			}
 		}
 	}
@@ -1773,73 +1983,175 @@ void FPrefabVersionControl::RefreshReferenceList(UPrefabricatorAsset* PrefabAsse
 	PrefabAsset->Modify();
 }
 
-/////////////////////// FGlobalPrefabLoadState /////////////////////// 
+/////////////////////// FPrefabDeferredRegistrationScope /////////////////////// 
+
+FPrefabDeferredRegistrationScope* FPrefabDeferredRegistrationScope::ActiveScope = nullptr;
 
-FPrefabInstanceTemplates* FGlobalPrefabInstanceTemplates::Instance = nullptr;
-void FGlobalPrefabInstanceTemplates::_CreateSingleton()
+FPrefabDeferredRegistrationScope::FPrefabDeferredRegistrationScope(bool bInEnabled)
 {
-	check(Instance == nullptr);
-	Instance = new FPrefabInstanceTemplates();
+	// Builds spawn actors and only run on the game thread. Nested builds are folded into the outermost scope
+	if (bInEnabled && !ActiveScope && IsInGameThread()) {
+		ActiveScope = this;
+		bOwnsScope = true;
+	}
 }
 
-void FGlobalPrefabInstanceTemplates::_ReleaseSingleton()
+FPrefabDeferredRegistrationScope::~FPrefabDeferredRegistrationScope()
 {
-	delete Instance;
-	Instance = nullptr;
+	if (bOwnsScope) {
+		ActiveScope = nullptr;
+		Flush();
+	}
 }
 
+void FPrefabDeferredRegistrationScope::DeferActorRegistration(AActor* InActor, bool bComponentsUnregistered)
+{
+	if (InActor) {
+		Actors.Add({ InActor, bComponentsUnregistered });
+	}
+}
+
+void FPrefabDeferredRegistrationScope::DeferComponentRegistration(UActorComponent* InComponent)
+{
+	if (InComponent) {
+		Components.Add(InComponent);
+	}
+}
+
+void FPrefabDeferredRegistrationScope::DeferPhysicsStateRecreate(UPrimitiveComponent* InComponent)
+{
+	if (InComponent) {
+		PhysicsComponents.AddUnique(InComponent);
+	}
+}
+
+void FPrefabDeferredRegistrationScope::DeferBuildComplete(APrefabActor* InPrefabActor, bool bNotifyBuildComplete)
+{
+	if (InPrefabActor) {
+		CompletedPrefabs.Add({ InPrefabActor, bNotifyBuildComplete });
+	}
+}
+
+void FPrefabDeferredRegistrationScope::Flush()
+{
+	SCOPE_CYCLE_COUNTER(STAT_DeferredRegistration_Flush);
+
+	// Register everything in one pass. Each component creates its render and physics state once, with the loaded properties
+	for (const FDeferredActor& Entry : Actors) {
+		if (AActor* Actor = Entry.Actor.Get()) {
+			if (Entry.bComponentsUnregistered) {
+				Actor->RegisterAllComponents();
+			}
+			else {
+				Actor->ReregisterAllComponents();
+			}
+			INC_DWORD_STAT_BY(STAT_DeferredRegistration_NumComponents, Actor->GetComponents().Num());
+		}
+	}
+
+	for (const TWeakObjectPtr<UActorComponent>& ComponentPtr : Components) {
+		UActorComponent* Component = ComponentPtr.Get();
+		if (Component && !Component->IsRegistered()) {
+			Component->RegisterComponent();
+			INC_DWORD_STAT(STAT_DeferredRegistration_NumComponents);
+		}
+	}
+
+	// Only needed for the components that stayed registered while loading. Same steps as the immediate path in
+	// LoadActorState: the component is initialized again before its physics state is rebuilt from the loaded body instance
+	for (const TWeakObjectPtr<UPrimitiveComponent>& PrimitivePtr : PhysicsComponents) {
+		UPrimitiveComponent* Primitive = PrimitivePtr.Get();
+		if (Primitive && Primitive->IsRegistered()) {
+			Primitive->InitializeComponent();
+			Primitive->RecreatePhysicsState();
+		}
+	}
+
+	// Nested prefabs complete before their parents, so the parents see up to date child bounds
+	for (const FDeferredBuildComplete& Entry : CompletedPrefabs) {
+		if (APrefabActor* PrefabActor = Entry.PrefabActor.Get()) {
+			CompletePrefabBuild(PrefabActor, Entry.bNotifyBuildComplete);
+		}
+	}
+
+	Actors.Reset();
+	Components.Reset();
+	PhysicsComponents.Reset();
+	CompletedPrefabs.Reset();
+}
+
+///////////////////////////////// FPrefabInstanceTemplates /////////////////////////////////
+
 void FPrefabInstanceTemplates::RegisterTemplate(const FGuid& InPrefabItemId, FGuid InPrefabLastUpdateId, AActor* InActor)
 {
+	FWriteScopeLock WriteLock(Lock);
 	FPrefabInstanceTemplateInfo& TemplateRef = PrefabItemTemplates.FindOrAdd(InPrefabItemId);
 	TemplateRef.TemplatePtr = InActor;
+	TemplateRef.LevelKey = InActor ? InActor->GetLevel() : nullptr;
 	TemplateRef.PrefabLastUpdateId = InPrefabLastUpdateId;
 }
 
-AActor* FPrefabInstanceTemplates::GetTemplate(const FGuid& InPrefabItemId, FGuid InPrefabLastUpdateId)
+AActor* FPrefabInstanceTemplates::GetTemplate(const FGuid& InPrefabItemId, FGuid InPrefabLastUpdateId) const
 {
-	FPrefabInstanceTemplateInfo* SearchResult = PrefabItemTemplates.Find(InPrefabItemId);
-	if (!SearchResult) return nullptr;
-	FPrefabInstanceTemplateInfo& Info = *SearchResult;
-	AActor* Actor = Info.TemplatePtr.Get();
+	// A stale entry is left in place, the build that missed registers its own actor over it
+	return FindTemplate(InPrefabItemId, InPrefabLastUpdateId).Get();
+}
 
-	if (Info.PrefabLastUpdateId != InPrefabLastUpdateId) {
-		// The prefab has been changed since we last cached this template. Invalidate it
-		Actor = nullptr;
+TWeakObjectPtr<AActor> FPrefabInstanceTemplates::FindTemplate(const FGuid& InPrefabItemId, FGuid InPrefabLastUpdateId) const
+{
+	FReadScopeLock ReadLock(Lock);
+	const FPrefabInstanceTemplateInfo* SearchResult = PrefabItemTemplates.Find(InPrefabItemId);
+	if (!SearchResult || SearchResult->PrefabLastUpdateId != InPrefabLastUpdateId) {
+		// The prefab has been changed since we last cached this template
+		return nullptr;
 	}
+	return SearchResult->TemplatePtr;
+}
 
-	// Remove from the map if the actor state is stale
-	if (!Actor) {
-		PrefabItemTemplates.Remove(InPrefabItemId);
+int32 FPrefabInstanceTemplates::FlushLevel(ULevel* InLevel)
+{
+	FWriteScopeLock WriteLock(Lock);
+	const TObjectKey<ULevel> LevelKey(InLevel);
+	const int32 NumBefore = PrefabItemTemplates.Num();
+	for (auto It = PrefabItemTemplates.CreateIterator(); It; ++It) {
+		if (It.Value().LevelKey == LevelKey || !It.Value().TemplatePtr.IsValid()) {
+			It.RemoveCurrent();
+		}
 	}
+	return NumBefore - PrefabItemTemplates.Num();
+}
+
+void FPrefabInstanceTemplates::Reset()
+{
+	FWriteScopeLock WriteLock(Lock);
+	PrefabItemTemplates.Reset();
+}
 
-	return Actor;
+int32 FPrefabInstanceTemplates::Num() const
+{
+	FReadScopeLock ReadLock(Lock);
+	return PrefabItemTemplates.Num();
 }
 
 
 ///////////////////////////////// FPrefabSaveModeCrossReferences ///////////////////////////////// 
 
 
-void FPrefabActorLookup::Register(const FString& InActorPath, const FGuid& InPrefabItemId)
-{
-	FGuid& ItemIdRef = ActorPathToItemId.FindOrAdd(InActorPath);
-	ItemIdRef = InPrefabItemId;
-}
-
 void FPrefabActorLookup::Register(AActor* InActor, const FGuid& InPrefabItemId)
 {
 	if (!InActor) return;
-	Register(InActor->GetPathName(), InPrefabItemId);
+	ObjectToItemId.Add(InActor, InPrefabItemId);
 }
 
 void FPrefabActorLookup::Register(UActorComponent* InComp, const FGuid& InPrefabItemId)
 {
 	if (!InComp) return;
-	Register(InComp->GetName(), InPrefabItemId);
+	ObjectToItemId.Add(InComp, InPrefabItemId);
 }
 
-bool FPrefabActorLookup::GetPrefabItemId(const FString& InObjectPath, FGuid& OutCrossRefPrefabItem) const
+bool FPrefabActorLookup::GetPrefabItemId(const UObject* InObject, FGuid& OutCrossRefPrefabItem) const
 {
-	const FGuid* SearchResult = ActorPathToItemId.Find(InObjectPath);
+	const FGuid* SearchResult = ObjectToItemId.Find(InObject);
 	if (SearchResult) {
 		OutCrossRefPrefabItem = *SearchResult;
 		return true;
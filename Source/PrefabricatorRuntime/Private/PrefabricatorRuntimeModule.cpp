@@ -2,8 +2,8 @@
 
 #include "PrefabricatorRuntimeModule.h"
 
-#include "Prefab/PrefabTools.h"
 #include "Utils/PrefabricatorService.h"
+#include "Utils/PrefabricatorTelemetry.h"
 
 class FPrefabricatorRuntime : public IPrefabricatorRuntime
 {
@@ -22,7 +22,7 @@ void FPrefabricatorRuntime::StartupModule()
 		FPrefabricatorService::Set(MakeShareable(new FPrefabricatorRuntimeService));
 	}
 
-	FGlobalPrefabInstanceTemplates::_CreateSingleton();
+	FGlobalPrefabSpawnTelemetry::_CreateSingleton();
 }
 
 
@@ -31,6 +31,6 @@ void FPrefabricatorRuntime::ShutdownModule()
 	// Clear the service object
 	FPrefabricatorService::Set(nullptr);
 
-	FGlobalPrefabInstanceTemplates::_ReleaseSingleton();
+	FGlobalPrefabSpawnTelemetry::_ReleaseSingleton();
 }
 
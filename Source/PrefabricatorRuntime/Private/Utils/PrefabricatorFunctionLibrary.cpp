@@ -9,25 +9,39 @@
 
 #include "Engine/Engine.h"
 
-APrefabActor* UPrefabricatorBlueprintLibrary::SpawnPrefab(const UObject* WorldContextObject, UPrefabricatorAssetInterface* Prefab, const FTransform& Transform, int32 Seed)
+APrefabActor* UPrefabricatorBlueprintLibrary::SpawnPrefab(const UObject* WorldContextObject, UPrefabricatorAssetInterface* Prefab, const FTransform& Transform, int32 Seed, EPrefabReplicationMode ReplicationMode)
 {
 	APrefabActor* PrefabActor = nullptr;
 	UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::LogAndReturnNull);
-	if (World) {
-		if (Prefab->bReplicates) {
-			FActorSpawnParameters SpawnParams;
-			PrefabActor = World->SpawnActor<AReplicablePrefabActor>(AReplicablePrefabActor::StaticClass(), Transform);
-		}
-		else {
-			PrefabActor = World->SpawnActor<APrefabActor>(APrefabActor::StaticClass(), Transform);
-		}
-		
+	if (World && Prefab) {
+		// Deferred, so the asset and the seed are set before the actor begins play and captures its replicated state
+		UClass* PrefabClass = Prefab->bReplicates ? AReplicablePrefabActor::StaticClass() : APrefabActor::StaticClass();
+		PrefabActor = World->SpawnActorDeferred<APrefabActor>(PrefabClass, Transform);
 
 		if (PrefabActor) {
-			PrefabActor->PrefabComponent->PrefabAssetInterface = Prefab;
-
 			FRandomStream Random(Seed);
-			RandomizePrefab(PrefabActor, Random);
+			const int32 PrefabSeed = FPrefabTools::GetRandomSeed(Random);
+
+			AReplicablePrefabActor* ReplicablePrefab = Cast<AReplicablePrefabActor>(PrefabActor);
+			if (ReplicablePrefab) {
+				ReplicablePrefab->SetReplicatedPrefab(Prefab, PrefabSeed, ReplicationMode);
+			}
+			else {
+				PrefabActor->PrefabComponent->PrefabAssetInterface = Prefab;
+				PrefabActor->Seed = PrefabSeed;
+			}
+
+			// Built below with the nested seeds drawn from the stream
+			PrefabActor->bBuildOnCreation = false;
+			PrefabActor->FinishSpawning(Transform);
+
+			// Seed-only prefabs request their build when they begin play
+			if (!ReplicablePrefab || !ReplicablePrefab->IsSeedOnly()) {
+				FPrefabLoadSettings LoadSettings;
+				LoadSettings.bRandomizeNestedSeed = true;
+				LoadSettings.Random = &Random;
+				PrefabActor->LoadPrefabWithSettings(LoadSettings);
+			}
 		}
 	}
 	return PrefabActor;
@@ -35,12 +49,21 @@ APrefabActor* UPrefabricatorBlueprintLibrary::SpawnPrefab(const UObject* WorldCo
 
 void UPrefabricatorBlueprintLibrary::RandomizePrefab(APrefabActor* PrefabActor, const FRandomStream& InRandom)
 {
+	// Seed-only prefabs derive the nested seeds from their own seed, and have to refresh their replicated state
+	AReplicablePrefabActor* ReplicablePrefab = Cast<AReplicablePrefabActor>(PrefabActor);
+	if (ReplicablePrefab && ReplicablePrefab->IsSeedOnly()) {
+		PrefabActor->RandomizeSeed(InRandom, false);
+		PrefabActor->LoadPrefab();
+		return;
+	}
+
 	PrefabActor->RandomizeSeed(InRandom);
 
+	// On-demand prefabs that are not materialized only keep the new seed
 	FPrefabLoadSettings LoadSettings;
 	LoadSettings.bRandomizeNestedSeed = true;
 	LoadSettings.Random = &InRandom;
-	FPrefabTools::LoadStateFromPrefabAsset(PrefabActor, LoadSettings);
+	PrefabActor->LoadPrefabWithSettings(LoadSettings);
 }
 
 void UPrefabricatorBlueprintLibrary::UnlinkPrefab(APrefabActor* PrefabActor) {
@@ -51,12 +74,20 @@ void UPrefabricatorBlueprintLibrary::GetAllAttachedActors(AActor* Prefab, TArray
 {
 	if (!Prefab) return;
 
-	TArray<AActor*> ChildActors;
-	Prefab->GetAttachedActors(ChildActors);
-	for (AActor* ChildActor : ChildActors) {
+	if (APrefabActor* PrefabActor = Cast<APrefabActor>(Prefab)) {
+		// Prefabs keep a flattened list of their descendants
+		AttachedActors.Reserve(AttachedActors.Num() + PrefabActor->GetDescendants().Num());
+		PrefabActor->ForEachDescendant([&AttachedActors](AActor* Descendant) {
+			AttachedActors.Add(Descendant);
+		});
+		return;
+	}
+
+	Prefab->ForEachAttachedActors([&AttachedActors](AActor* ChildActor) {
 		AttachedActors.Add(ChildActor);
 		GetAllAttachedActors(ChildActor, AttachedActors);
-	}
+		return true;
+	});
 }
 
 void UPrefabricatorBlueprintLibrary::SetPrefabAsset(APrefabActor* PrefabActor, UPrefabricatorAssetInterface* Prefab, bool bReloadPrefab)
@@ -80,3 +111,7 @@ APrefabActor* UPrefabricatorBlueprintLibrary::FindTopMostPrefabActor(AActor* InA
 	return TopmostPrefab;
 }
 
+void UPrefabricatorBlueprintLibrary::ResolvePrefabLayout(UPrefabricatorAssetInterface* Prefab, const FTransform& Transform, int32 Seed, FPrefabResolvedLayout& OutLayout)
+{
+	FPrefabLayoutResolver::Resolve(Prefab, Seed, Transform, OutLayout);
+}
@@ -0,0 +1,448 @@
+//$ Copyright 2015-23, Code Respawn Technologies Pvt Ltd - All Rights Reserved $//
+
+#include "Utils/PrefabricatorTelemetry.h"
+
+#include "Asset/PrefabricatorAsset.h"
+#include "PrefabricatorSettings.h"
+#include "Utils/PrefabricatorStats.h"
+
+#include "HAL/IConsoleManager.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogPrefabTelemetry, Log, All);
+
+namespace
+{
+	float GetPercentile(const TArray<float>& InSortedValues, float InPercentile)
+	{
+		if (InSortedValues.Num() == 0) {
+			return 0;
+		}
+		const int32 Index = FMath::Clamp(FMath::CeilToInt(InPercentile * InSortedValues.Num()) - 1, 0, InSortedValues.Num() - 1);
+		return InSortedValues[Index];
+	}
+
+	FString FormatBucketLabel(TArrayView<const float> InLimits, int32 InBucketIndex, const TCHAR* InPrefix, const TCHAR* InUnit)
+	{
+		if (InLimits.IsValidIndex(InBucketIndex)) {
+			return FString::Printf(TEXT("%s<%g%s"), InPrefix, InLimits[InBucketIndex], InUnit);
+		}
+		return FString::Printf(TEXT("%s>=%g%s"), InPrefix, InLimits.Last(), InUnit);
+	}
+
+	void AddToHistogram(TArray<int32>& InOutHistogram, TArrayView<const float> InLimits, float InValue)
+	{
+		int32 Bucket = 0;
+		while (Bucket < InLimits.Num() && InValue >= InLimits[Bucket]) {
+			Bucket++;
+		}
+		InOutHistogram[Bucket]++;
+	}
+
+	void AppendHistogramHeader(FString& InOutHeader, TArrayView<const float> InLimits, const TCHAR* InPrefix, const TCHAR* InUnit)
+	{
+		for (int32 Bucket = 0; Bucket <= InLimits.Num(); Bucket++) {
+			InOutHeader += TEXT(",") + FormatBucketLabel(InLimits, Bucket, InPrefix, InUnit);
+		}
+	}
+
+	void AppendHistogramRow(FString& InOutRow, const TArray<int32>& InHistogram)
+	{
+		for (int32 Count : InHistogram) {
+			InOutRow += FString::Printf(TEXT(",%d"), Count);
+		}
+	}
+
+	FString FormatHitRate(float InHitRate)
+	{
+		return InHitRate < 0 ? TEXT("-") : FString::Printf(TEXT("%.1f"), InHitRate * 100.0f);
+	}
+
+	FAutoConsoleCommand PrintTelemetryCommand(
+		TEXT("Prefabricator.Telemetry.Print"),
+		TEXT("Prints the spawn cost of the most expensive prefab assets. Usage: Prefabricator.Telemetry.Print [MaxAssets=20]"),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args) {
+			if (FPrefabSpawnTelemetry* Telemetry = FGlobalPrefabSpawnTelemetry::Get()) {
+				Telemetry->PrintToLog(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 20);
+			}
+			else {
+				UE_LOG(LogPrefabTelemetry, Warning, TEXT("Prefab spawn telemetry is disabled in the project settings"));
+			}
+		}));
+
+	FAutoConsoleCommand DumpTelemetryCommand(
+		TEXT("Prefabricator.Telemetry.DumpCsv"),
+		TEXT("Writes the spawn cost of all the prefab assets to a CSV file in Saved/Prefabricator/Telemetry"),
+		FConsoleCommandDelegate::CreateLambda([]() {
+			if (FPrefabSpawnTelemetry* Telemetry = FGlobalPrefabSpawnTelemetry::Get()) {
+				Telemetry->DumpCsv();
+			}
+		}));
+
+	FAutoConsoleCommand ResetTelemetryCommand(
+		TEXT("Prefabricator.Telemetry.Reset"),
+		TEXT("Clears the collected prefab spawn telemetry"),
+		FConsoleCommandDelegate::CreateLambda([]() {
+			if (FPrefabSpawnTelemetry* Telemetry = FGlobalPrefabSpawnTelemetry::Get()) {
+				Telemetry->Reset();
+			}
+		}));
+
+	FAutoConsoleCommand CsvIntervalTelemetryCommand(
+		TEXT("Prefabricator.Telemetry.CsvInterval"),
+		TEXT("Dumps the prefab spawn telemetry to a CSV file every N seconds. 0 stops the periodic dumps. Usage: Prefabricator.Telemetry.CsvInterval <Seconds>"),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args) {
+			if (FPrefabSpawnTelemetry* Telemetry = FGlobalPrefabSpawnTelemetry::Get()) {
+				Telemetry->SetCsvDumpInterval(Args.Num() > 0 ? FCString::Atof(*Args[0]) : 0.0f);
+			}
+		}));
+}
+
+///////////////////////////////// FPrefabAssetTelemetry /////////////////////////////////
+
+void FPrefabAssetTelemetry::AddSample(const FPrefabSpawnSample& InSample, int32 InWindowSize)
+{
+	InWindowSize = FMath::Max(1, InWindowSize);
+	if (Samples.Num() > InWindowSize) {
+		// The window was shrunk in the settings. Start over with the new size
+		Samples.Reset();
+		NextSample = 0;
+	}
+
+	if (Samples.Num() < InWindowSize) {
+		Samples.Add(InSample);
+	}
+	else {
+		Samples[NextSample] = InSample;
+	}
+	NextSample = (NextSample + 1) % InWindowSize;
+	TotalSpawns++;
+}
+
+TArrayView<const float> FPrefabAssetTelemetryStats::GetTimeBucketLimits()
+{
+	static const float Limits[] = { 0.1f, 0.5f, 1.0f, 2.0f, 5.0f, 10.0f, 20.0f, 50.0f };
+	return MakeArrayView(Limits);
+}
+
+TArrayView<const float> FPrefabAssetTelemetryStats::GetActorBucketLimits()
+{
+	static const float Limits[] = { 1.0f, 5.0f, 10.0f, 25.0f, 50.0f, 100.0f, 250.0f, 500.0f };
+	return MakeArrayView(Limits);
+}
+
+TArrayView<const float> FPrefabAssetTelemetryStats::GetHitRateBucketLimits()
+{
+	static const float Limits[] = { 25.0f, 50.0f, 75.0f, 90.0f, 100.0f };
+	return MakeArrayView(Limits);
+}
+
+///////////////////////////////// FPrefabSpawnTelemetry /////////////////////////////////
+
+FPrefabSpawnTelemetry::FPrefabSpawnTelemetry()
+{
+	CsvDumpInterval = GetDefault<UPrefabricatorSettings>()->SpawnTelemetryCsvDumpInterval;
+	NextCsvDumpTime = FPlatformTime::Seconds() + CsvDumpInterval;
+}
+
+FPrefabSpawnTelemetry::~FPrefabSpawnTelemetry()
+{
+	if (TickerHandle.IsValid()) {
+		FTSTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+	}
+}
+
+void FPrefabSpawnTelemetry::StartTicker()
+{
+	if (!TickerHandle.IsValid()) {
+		TickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FPrefabSpawnTelemetry::Tick));
+	}
+}
+
+bool FPrefabSpawnTelemetry::IsEnabled() const
+{
+	return GetDefault<UPrefabricatorSettings>()->bEnableSpawnTelemetry;
+}
+
+void FPrefabSpawnTelemetry::RecordSpawn(const UPrefabricatorAsset* InPrefabAsset, const FPrefabSpawnSample& InSample)
+{
+	if (!InPrefabAsset) {
+		return;
+	}
+
+	FPrefabAssetTelemetry* AssetTelemetry = Assets.Find(InPrefabAsset);
+	if (!AssetTelemetry) {
+		AssetTelemetry = &Assets.Add(InPrefabAsset);
+		AssetTelemetry->AssetPath = InPrefabAsset->GetPathName();
+	}
+	AssetTelemetry->AddSample(InSample, GetDefault<UPrefabricatorSettings>()->SpawnTelemetryWindowSize);
+}
+
+void FPrefabSpawnTelemetry::NotifyActorSpawned(bool bFromTemplate, bool bTemplateCacheUsed)
+{
+	NumActorsSpawned++;
+	if (bTemplateCacheUsed) {
+		if (bFromTemplate) {
+			NumTemplateHits++;
+		}
+		else {
+			NumTemplateMisses++;
+		}
+	}
+}
+
+void FPrefabSpawnTelemetry::NotifyBuildSystemTick(int32 InNumPendingCommands, float InBudgetUsed)
+{
+	// Several build systems (randomizers, materialization) can tick in the same frame and share the frame time
+	FramePendingCommands += InNumPendingCommands;
+	FrameBudgetUsed += InBudgetUsed;
+}
+
+void FPrefabSpawnTelemetry::GetAssetStats(TArray<FPrefabAssetTelemetryStats>& OutStats) const
+{
+	const TArrayView<const float> TimeLimits = FPrefabAssetTelemetryStats::GetTimeBucketLimits();
+	const TArrayView<const float> ActorLimits = FPrefabAssetTelemetryStats::GetActorBucketLimits();
+	const TArrayView<const float> HitRateLimits = FPrefabAssetTelemetryStats::GetHitRateBucketLimits();
+
+	OutStats.Reset(Assets.Num());
+	TArray<float> SortedTimes;
+	for (const auto& Entry : Assets) {
+		const FPrefabAssetTelemetry& AssetTelemetry = Entry.Value;
+		if (AssetTelemetry.Samples.Num() == 0) {
+			continue;
+		}
+
+		FPrefabAssetTelemetryStats& Stats = OutStats.AddDefaulted_GetRef();
+		Stats.AssetPath = AssetTelemetry.AssetPath;
+		Stats.TotalSpawns = AssetTelemetry.TotalSpawns;
+		Stats.NumSamples = AssetTelemetry.Samples.Num();
+		Stats.TimeHistogram.SetNumZeroed(TimeLimits.Num() + 1);
+		Stats.ActorHistogram.SetNumZeroed(ActorLimits.Num() + 1);
+		Stats.HitRateHistogram.SetNumZeroed(HitRateLimits.Num() + 1);
+
+		SortedTimes.Reset();
+		int64 TotalActors = 0;
+		int64 TotalHits = 0;
+		int64 TotalMisses = 0;
+		for (const FPrefabSpawnSample& Sample : AssetTelemetry.Samples) {
+			SortedTimes.Add(Sample.TimeMs);
+			TotalActors += Sample.NumActors;
+			TotalHits += Sample.NumTemplateHits;
+			TotalMisses += Sample.NumTemplateMisses;
+			Stats.MaxActors = FMath::Max(Stats.MaxActors, Sample.NumActors);
+
+			AddToHistogram(Stats.TimeHistogram, TimeLimits, Sample.TimeMs);
+			AddToHistogram(Stats.ActorHistogram, ActorLimits, Sample.NumActors);
+			const int32 NumLookups = Sample.NumTemplateHits + Sample.NumTemplateMisses;
+			if (NumLookups > 0) {
+				AddToHistogram(Stats.HitRateHistogram, HitRateLimits, Sample.NumTemplateHits * 100.0f / NumLookups);
+			}
+		}
+		SortedTimes.Sort();
+
+		float TotalMs = 0;
+		for (float TimeMs : SortedTimes) {
+			TotalMs += TimeMs;
+		}
+		Stats.AvgMs = TotalMs / Stats.NumSamples;
+		Stats.P50Ms = GetPercentile(SortedTimes, 0.5f);
+		Stats.P95Ms = GetPercentile(SortedTimes, 0.95f);
+		Stats.MaxMs = SortedTimes.Last();
+		Stats.AvgActors = static_cast<float>(TotalActors) / Stats.NumSamples;
+		if (TotalHits + TotalMisses > 0) {
+			Stats.TemplateHitRate = static_cast<float>(TotalHits) / (TotalHits + TotalMisses);
+		}
+	}
+
+	OutStats.Sort([](const FPrefabAssetTelemetryStats& A, const FPrefabAssetTelemetryStats& B) {
+		return A.AvgMs > B.AvgMs;
+	});
+}
+
+void FPrefabSpawnTelemetry::PrintToLog(int32 InMaxAssets) const
+{
+	TArray<FPrefabAssetTelemetryStats> Stats;
+	GetAssetStats(Stats);
+
+	UE_LOG(LogPrefabTelemetry, Log, TEXT("Prefab spawn telemetry: %d assets, %d live instances, %d pending build commands, build budget %.1f%% (peak %.1f%%)"),
+		Stats.Num(), NumLiveInstances, LastFramePendingCommands, LastFrameBudgetUsed * 100.0f, PeakBudgetUsed * 100.0f);
+	UE_LOG(LogPrefabTelemetry, Log, TEXT("%10s %10s %10s %10s %8s %8s %8s  %s"), TEXT("AvgMs"), TEXT("P50Ms"), TEXT("P95Ms"), TEXT("MaxMs"),
+		TEXT("Actors"), TEXT("Hit%"), TEXT("Spawns"), TEXT("Asset"));
+
+	const int32 NumToPrint = InMaxAssets > 0 ? FMath::Min(InMaxAssets, Stats.Num()) : Stats.Num();
+	for (int32 Idx = 0; Idx < NumToPrint; Idx++) {
+		const FPrefabAssetTelemetryStats& Entry = Stats[Idx];
+		UE_LOG(LogPrefabTelemetry, Log, TEXT("%10.3f %10.3f %10.3f %10.3f %8.1f %8s %8lld  %s"), Entry.AvgMs, Entry.P50Ms, Entry.P95Ms, Entry.MaxMs,
+			Entry.AvgActors, *FormatHitRate(Entry.TemplateHitRate), Entry.TotalSpawns, *Entry.AssetPath);
+	}
+}
+
+bool FPrefabSpawnTelemetry::WriteCsv(const FString& InPath) const
+{
+	TArray<FPrefabAssetTelemetryStats> Stats;
+	GetAssetStats(Stats);
+
+	FString Header = TEXT("Prefab,TotalSpawns,WindowSamples,AvgMs,P50Ms,P95Ms,MaxMs,AvgActors,MaxActors,TemplateHitRate");
+	AppendHistogramHeader(Header, FPrefabAssetTelemetryStats::GetTimeBucketLimits(), TEXT(""), TEXT("ms"));
+	AppendHistogramHeader(Header, FPrefabAssetTelemetryStats::GetActorBucketLimits(), TEXT("Actors"), TEXT(""));
+	AppendHistogramHeader(Header, FPrefabAssetTelemetryStats::GetHitRateBucketLimits(), TEXT("Hit"), TEXT("%"));
+
+	TArray<FString> Rows;
+	Rows.Reserve(Stats.Num() + 1);
+	Rows.Add(Header);
+	for (const FPrefabAssetTelemetryStats& Entry : Stats) {
+		FString Row = FString::Printf(TEXT("%s,%lld,%d,%.3f,%.3f,%.3f,%.3f,%.1f,%d,%s"),
+			*ToCsvField(Entry.AssetPath),
+			Entry.TotalSpawns,
+			Entry.NumSamples,
+			Entry.AvgMs,
+			Entry.P50Ms,
+			Entry.P95Ms,
+			Entry.MaxMs,
+			Entry.AvgActors,
+			Entry.MaxActors,
+			*FormatHitRate(Entry.TemplateHitRate));
+		AppendHistogramRow(Row, Entry.TimeHistogram);
+		AppendHistogramRow(Row, Entry.ActorHistogram);
+		AppendHistogramRow(Row, Entry.HitRateHistogram);
+		Rows.Add(Row);
+	}
+	return FFileHelper::SaveStringArrayToFile(Rows, *InPath);
+}
+
+FString FPrefabSpawnTelemetry::DumpCsv() const
+{
+	const FString Path = FPaths::ProjectSavedDir() / TEXT("Prefabricator") / TEXT("Telemetry")
+		/ FString::Printf(TEXT("PrefabSpawnTelemetry_%s.csv"), *FDateTime::Now().ToString());
+	if (!WriteCsv(Path)) {
+		UE_LOG(LogPrefabTelemetry, Error, TEXT("Cannot write the prefab spawn telemetry to %s"), *Path);
+		return FString();
+	}
+	UE_LOG(LogPrefabTelemetry, Log, TEXT("Prefab spawn telemetry written to %s"), *Path);
+	return Path;
+}
+
+void FPrefabSpawnTelemetry::Reset()
+{
+	Assets.Reset();
+	NumActorsSpawned = 0;
+	NumTemplateHits = 0;
+	NumTemplateMisses = 0;
+	PeakBudgetUsed = 0;
+}
+
+void FPrefabSpawnTelemetry::SetCsvDumpInterval(float InSeconds)
+{
+	CsvDumpInterval = FMath::Max(0.0f, InSeconds);
+	NextCsvDumpTime = FPlatformTime::Seconds() + CsvDumpInterval;
+}
+
+FString FPrefabSpawnTelemetry::ToCsvField(const FString& InValue)
+{
+	if (InValue.Contains(TEXT(",")) || InValue.Contains(TEXT("\"")) || InValue.Contains(TEXT("\n")) || InValue.Contains(TEXT("\r"))) {
+		return FString::Printf(TEXT("\"%s\""), *InValue.Replace(TEXT("\""), TEXT("\"\"")));
+	}
+	return InValue;
+}
+
+bool FPrefabSpawnTelemetry::Tick(float DeltaTime)
+{
+	if (!IsEnabled()) {
+		// Started again by FGlobalPrefabSpawnTelemetry::Get once the telemetry is enabled
+		TickerHandle.Reset();
+		return false;
+	}
+
+	// The core ticker runs once per frame, so whatever the build systems reported since the last tick is a full frame
+	LastFramePendingCommands = FramePendingCommands;
+	LastFrameBudgetUsed = FrameBudgetUsed;
+	PeakBudgetUsed = FMath::Max(PeakBudgetUsed, FrameBudgetUsed);
+	FramePendingCommands = 0;
+	FrameBudgetUsed = 0;
+
+	SET_DWORD_STAT(STAT_Telemetry_NumLiveInstances, NumLiveInstances);
+	SET_DWORD_STAT(STAT_Telemetry_NumPendingCommands, LastFramePendingCommands);
+	SET_DWORD_STAT(STAT_Telemetry_NumTrackedAssets, Assets.Num());
+	SET_FLOAT_STAT(STAT_Telemetry_BudgetUsed, LastFrameBudgetUsed * 100.0f);
+	SET_FLOAT_STAT(STAT_Telemetry_PeakBudgetUsed, PeakBudgetUsed * 100.0f);
+	const int64 NumTemplateLookups = NumTemplateHits + NumTemplateMisses;
+	SET_FLOAT_STAT(STAT_Telemetry_TemplateHitRate, NumTemplateLookups > 0 ? NumTemplateHits * 100.0f / NumTemplateLookups : 0.0f);
+
+	if (CsvDumpInterval > 0 && Assets.Num() > 0) {
+		const double Now = FPlatformTime::Seconds();
+		if (Now >= NextCsvDumpTime) {
+			DumpCsv();
+			NextCsvDumpTime = Now + CsvDumpInterval;
+		}
+	}
+	return true;
+}
+
+///////////////////////////////// FGlobalPrefabSpawnTelemetry /////////////////////////////////
+
+FPrefabSpawnTelemetry* FGlobalPrefabSpawnTelemetry::Instance = nullptr;
+
+FPrefabSpawnTelemetry* FGlobalPrefabSpawnTelemetry::Get()
+{
+	if (!Instance || !Instance->IsEnabled()) {
+		return nullptr;
+	}
+	Instance->StartTicker();
+	return Instance;
+}
+
+void FGlobalPrefabSpawnTelemetry::NotifyInstanceBeginPlay()
+{
+	if (Instance) {
+		Instance->NotifyInstanceBeginPlay();
+	}
+}
+
+void FGlobalPrefabSpawnTelemetry::NotifyInstanceEndPlay()
+{
+	if (Instance) {
+		Instance->NotifyInstanceEndPlay();
+	}
+}
+
+void FGlobalPrefabSpawnTelemetry::_CreateSingleton()
+{
+	check(Instance == nullptr);
+	Instance = new FPrefabSpawnTelemetry();
+}
+
+void FGlobalPrefabSpawnTelemetry::_ReleaseSingleton()
+{
+	check(Instance);
+	delete Instance;
+	Instance = nullptr;
+}
+
+///////////////////////////////// FPrefabSpawnTelemetryScope /////////////////////////////////
+
+FPrefabSpawnTelemetryScope::FPrefabSpawnTelemetryScope(const UPrefabricatorAsset* InPrefabAsset)
+	: Telemetry(FGlobalPrefabSpawnTelemetry::Get())
+	, PrefabAsset(InPrefabAsset)
+{
+	if (Telemetry) {
+		StartTime = FPlatformTime::Seconds();
+		StartNumActors = Telemetry->GetNumActorsSpawned();
+		StartNumHits = Telemetry->GetNumTemplateHits();
+		StartNumMisses = Telemetry->GetNumTemplateMisses();
+	}
+}
+
+FPrefabSpawnTelemetryScope::~FPrefabSpawnTelemetryScope()
+{
+	if (Telemetry) {
+		FPrefabSpawnSample Sample;
+		Sample.TimeMs = static_cast<float>((FPlatformTime::Seconds() - StartTime) * 1000.0);
+		// The counters go back to zero if the telemetry is reset in the middle of the build
+		Sample.NumActors = static_cast<int32>(FMath::Max<int64>(0, Telemetry->GetNumActorsSpawned() - StartNumActors));
+		Sample.NumTemplateHits = static_cast<int32>(FMath::Max<int64>(0, Telemetry->GetNumTemplateHits() - StartNumHits));
+		Sample.NumTemplateMisses = static_cast<int32>(FMath::Max<int64>(0, Telemetry->GetNumTemplateMisses() - StartNumMisses));
+		Telemetry->RecordSpawn(PrefabAsset, Sample);
+	}
+}
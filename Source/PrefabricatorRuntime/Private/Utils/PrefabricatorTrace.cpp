@@ -0,0 +1,25 @@
+//$ Copyright 2015-23, Code Respawn Technologies Pvt Ltd - All Rights Reserved $//
+
+#include "Utils/PrefabricatorTrace.h"
+
+#if PREFABRICATOR_TRACE_ENABLED
+
+UE_TRACE_CHANNEL_DEFINE(PrefabricatorChannel);
+
+FPrefabTraceScope::FPrefabTraceScope(TFunctionRef<FString()> InGetEventName)
+	: bEnabled(UE_TRACE_CHANNELEXPR_IS_ENABLED(CpuChannel | PrefabricatorChannel))
+{
+	if (bEnabled) {
+		FCpuProfilerTrace::OutputBeginDynamicEvent(*InGetEventName());
+	}
+}
+
+FPrefabTraceScope::~FPrefabTraceScope()
+{
+	if (bEnabled) {
+		FCpuProfilerTrace::OutputEndEvent();
+	}
+}
+
+#endif // PREFABRICATOR_TRACE_ENABLED
+
@@ -23,6 +23,13 @@ struct PREFABRICATORRUNTIME_API FPrefabricatorPropertyAssetMapping {
 
 	UPROPERTY()
 	bool bUseQuotes = false;
+
+	/** Character offset of the object path inside the exported value. INDEX_NONE for data saved before offsets were recorded */
+	UPROPERTY()
+	int32 PathOffset = INDEX_NONE;
+
+	UPROPERTY()
+	int32 PathLength = 0;
 };
 
 
@@ -49,13 +56,69 @@ struct PREFABRICATORRUNTIME_API FPrefabPropertySerializedItem
 };
 
 
-namespace
+/** One step of a property path, e.g. "Targets[2]" */
+USTRUCT()
+struct PREFABRICATORRUNTIME_API FPrefabricatorPropertyPathSegment
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	FName PropertyName;
+
+	/** Element of the array property to step into. INDEX_NONE if the property is not an array */
+	UPROPERTY()
+	int32 ArrayIndex = INDEX_NONE;
+
+	/** Saved length of the array, so it can be grown before the element is written */
+	UPROPERTY()
+	int32 ArrayLength = INDEX_NONE;
+};
+
+/** An object property of an item that points to another actor of the same prefab */
+USTRUCT()
+struct PREFABRICATORRUNTIME_API FPrefabricatorCrossReference
+{
+	GENERATED_BODY()
+
+	/** Index of the referenced actor item in UPrefabricatorAsset::ActorItems */
+	UPROPERTY()
+	int32 TargetIndex = INDEX_NONE;
+
+	UPROPERTY()
+	TArray<FPrefabricatorPropertyPathSegment> PropertyPath;
+};
+
+/** A serialized property of a prefab item. Stored inline in the item, so it does not cost a UObject */
+USTRUCT()
+struct PREFABRICATORRUNTIME_API FPrefabricatorProperty
 {
-	//PREFABRICATORRUNTIME_API FString ResolveObjectPath(TSoftObjectPtr<UObject> Reference);
+	GENERATED_BODY()
 
-	PREFABRICATORRUNTIME_API bool LoadReferencedAssetValues(FPrefabricatorPropertyAssetMapping& Mapping, FString& OutExportedValue);
-}
+	UPROPERTY(EditAnywhere)
+	FName PropertyName;
 
+	UPROPERTY(EditAnywhere)
+	FString ExportedValue;
+
+	UPROPERTY(EditAnywhere)
+	TArray<FPrefabricatorPropertyAssetMapping> AssetSoftReferenceMappings;
+
+	UPROPERTY(EditAnywhere)
+	bool bIsCrossReferencedActor = false;
+
+	UPROPERTY(EditAnywhere)
+	bool bContainsStructProperty = false;
+
+	UPROPERTY(EditAnywhere)
+	TMap<FString, FPrefabPropertySerializedItem> SerializedItems;
+
+	void SaveReferencedAssetValues();
+
+	/** Rewrites the exported values whose soft references were redirected. Returns true if anything changed */
+	bool ResolveReferencedAssetValues();
+};
+
+/** Legacy per-property object. Only loaded from older assets and converted to FPrefabricatorProperty on load */
 UCLASS(BlueprintType)
 class PREFABRICATORRUNTIME_API UPrefabricatorProperty : public UObject {
 	GENERATED_BODY()
@@ -78,8 +141,7 @@ public:
 	UPROPERTY(EditAnywhere)
 	TMap<FString, FPrefabPropertySerializedItem> SerializedItems;
 
-	void SaveReferencedAssetValues();
-	void LoadReferencedAssetValues();
+	void ConvertTo(FPrefabricatorProperty& OutProperty) const;
 };
 using UPrefabricatorPropertyMap = TMap<FString, TObjectPtr<UPrefabricatorProperty>>;
 
@@ -101,14 +163,23 @@ struct PREFABRICATORRUNTIME_API FPrefabricatorItemBase
 	FTransform RelativeTransform;
 
 	UPROPERTY(EditAnywhere)
+	TArray<FPrefabricatorProperty> SerializedProperties;
+
+	/** Object properties of this item that reference other actors in the prefab. Built from SerializedProperties on save */
+	UPROPERTY()
+	TArray<FPrefabricatorCrossReference> CrossReferences;
+
+	/** Legacy property objects, emptied once converted to SerializedProperties */
+	UPROPERTY()
 	TMap<FString, TObjectPtr<UPrefabricatorProperty>> Properties;
 
+	FPrefabricatorProperty* FindProperty(const FName& InPropertyName);
+	const FPrefabricatorProperty* FindProperty(const FName& InPropertyName) const;
+	bool ConvertLegacyProperties();
+
 #if WITH_EDITORONLY_DATA
 	UPROPERTY(EditAnywhere)
 	FString Name;
-
-	UPROPERTY(EditAnywhere)
-	bool bIsStale = false;
 #endif // WITH_EDITORONLY_DATA
 };
 
@@ -124,9 +195,47 @@ struct PREFABRICATORRUNTIME_API FPrefabricatorActorData : public FPrefabricatorI
     GENERATED_BODY()
 
     UPROPERTY(EditAnywhere, meta = (TitleProperty = Name))
+    TArray<FPrefabricatorComponentData> ComponentItems;
+
+    /** Legacy component storage, emptied once moved to ComponentItems */
+    UPROPERTY()
     TMap<FGuid, FPrefabricatorComponentData> Components;
 };
 
+/**
+ * A nested prefab of the fully expanded tree of a prefab asset. The entries are stored depth first, in the order the
+ * nested prefabs are spawned, so the subtree of an entry is the range [Index, Index + SubtreeSize)
+ */
+USTRUCT()
+struct PREFABRICATORRUNTIME_API FPrefabricatorFlattenedPrefab
+{
+	GENERATED_BODY()
+
+	/** Index of the parent entry. INDEX_NONE for the top level asset */
+	UPROPERTY()
+	int32 ParentIndex = INDEX_NONE;
+
+	/** Index of the actor item in the parent's asset that spawns this prefab */
+	UPROPERTY()
+	int32 ParentActorItemIndex = INDEX_NONE;
+
+	/** Number of entries of the subtree, including this one */
+	UPROPERTY()
+	int32 SubtreeSize = 1;
+
+	/** The expanded prefab asset. Null for choice points */
+	UPROPERTY()
+	TSoftObjectPtr<UPrefabricatorAsset> PrefabAsset;
+
+	/** LastUpdateID of the prefab asset when it was flattened */
+	UPROPERTY()
+	FGuid PrefabAssetUpdateID;
+
+	/** The nested prefab points to a collection. The asset is picked from the seed of the instance and built on its own */
+	UPROPERTY()
+	bool bIsChoicePoint = false;
+};
+
 struct FPrefabAssetSelectionConfig {
 	int32 Seed = 0;
 };
@@ -153,12 +262,18 @@ public:
 
 public:
 	virtual class UPrefabricatorAsset* GetPrefabAsset(const FPrefabAssetSelectionConfig& InConfig) { return nullptr; }
+
+	/** Picks the prefab asset for the given config without loading it. Safe to call from worker threads */
+	virtual TSoftObjectPtr<class UPrefabricatorAsset> SelectPrefabAsset(const FPrefabAssetSelectionConfig& InConfig) const;
 };
 
 enum class EPrefabricatorAssetVersion {
 	InitialVersion = 0,
 	AddedSoftReference,
 	AddedSoftReference_PrefabFix,
+	AddedSoftReferenceOffsets,
+	AddedPropertyStructs,
+	AddedCrossReferenceTable,
 
 	//----------- Versions should be placed above this line -----------------
 	LastVersionPlusOne,
@@ -179,15 +294,29 @@ class PREFABRICATORRUNTIME_API UPrefabricatorAsset : public UPrefabricatorAssetI
 	GENERATED_UCLASS_BODY()
 public:
 
+	/** Components added to the root of the prefab actor */
 	UPROPERTY(EditAnywhere, meta = (TitleProperty = Name))
+	TArray<FPrefabricatorComponentData> ComponentItems;
+
+	/** Child actors of the prefab, in the order they are attached (and spawned) */
+	UPROPERTY(EditAnywhere, meta = (TitleProperty = Name))
+	TArray<FPrefabricatorActorData> ActorItems;
+
+	/** Legacy item storage, emptied once moved to ComponentItems / ActorItems */
+	UPROPERTY()
 	TMap<FGuid, FPrefabricatorComponentData> ComponentData;
 
-	UPROPERTY(EditAnywhere, meta=(TitleProperty=Name))
+	UPROPERTY()
 	TMap<FGuid, FPrefabricatorActorData> ActorData;
 
 	UPROPERTY(EditAnywhere)
 	TEnumAsByte<EComponentMobility::Type> PrefabMobility;
 
+	// Bounds of the prefab in its own local space, captured on save.
+	// Used by instances that have not been built yet
+	UPROPERTY(VisibleAnywhere)
+	FBox LocalBounds = FBox(ForceInit);
+
 	// The ID that is regenerated on every update
 	// This allows prefab actors to test against their own LastUpdateID and determine if a refresh is needed
 	UPROPERTY(EditAnywhere)
@@ -201,12 +330,72 @@ public:
 	UPROPERTY(EditAnywhere)
 	uint32 Version;
 
+	// Store the fully expanded tree of nested prefabs with the asset, so an instance is built in a single pass
+	// instead of resolving the asset of every nested prefab on its own. Rebuilt when the prefab is saved from the level
+	// and by the upgrade commandlet
+	UPROPERTY(EditAnywhere)
+	bool bPreflattenNestedPrefabs = false;
+
+	UPROPERTY()
+	TArray<FPrefabricatorFlattenedPrefab> FlattenedPrefabs;
+
 public:
 	virtual UPrefabricatorAsset* GetPrefabAsset(const FPrefabAssetSelectionConfig& InConfig) override;
+	virtual TSoftObjectPtr<UPrefabricatorAsset> SelectPrefabAsset(const FPrefabAssetSelectionConfig& InConfig) const override;
+
+	virtual void PostLoad() override;
+#if WITH_EDITOR
+	virtual void PreSave(FObjectPreSaveContext SaveContext) override;
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif // WITH_EDITOR
+
+	/** Patches the serialized property text of soft references that were redirected. Returns the number of properties updated */
+	int32 ResolveSoftReferenceRedirects();
+
+	/** Moves the legacy property objects of every item into the inline property arrays. Returns true if anything was converted */
+	bool ConvertLegacyProperties();
+
+	/** Moves the items of the legacy GUID keyed maps into the item arrays. Returns true if anything was converted */
+	bool ConvertLegacyItemStorage();
+
+	/** Returns the index of the item in ActorItems / ComponentItems, or INDEX_NONE */
+	int32 FindActorItemIndex(const FGuid& InItemID) const;
+	int32 FindComponentItemIndex(const FGuid& InItemID) const;
+
+	/** Rebuilds the item id lookups. Call after adding, removing or reordering items */
+	void RebuildItemIndex();
+
+	/** Rebuilds the per-item cross reference tables from the serialized properties */
+	void RebuildCrossReferenceTables();
+
+	/** Expands the nested prefabs of this asset into FlattenedPrefabs. Clears them if bPreflattenNestedPrefabs is not set */
+	void RebuildFlattenedData();
+
+	/** Rebuilds the flattened data and returns true if it differs from the stored one. Loads the nested assets */
+	bool UpdateFlattenedData();
+
+	/**
+	 * Loads the assets of the flattened tree. Returns false if there is no flattened data or if any of the nested
+	 * assets has changed since it was flattened, in which case the instances are built level by level
+	 */
+	bool ResolveFlattenedData();
+
+	/** The asset of a flattened entry. Only valid after ResolveFlattenedData succeeded. Null for choice points */
+	UPrefabricatorAsset* GetFlattenedPrefabAsset(int32 InEntryIndex) const { return ResolvedFlattenedAssets.IsValidIndex(InEntryIndex) ? ResolvedFlattenedAssets[InEntryIndex].Get() : nullptr; }
 
 	//void AddCacheEntry(UPrefabricatorProperty* Property, const FString& PropertyPath, const FGuid& Guid);
 
 	//UPrefabricatorProperty* GetCacheEntry(const FGuid& Guid, const FString& PropertyPath);
+
+private:
+	bool IsFlattenedDataUpToDate() const;
+
+private:
+	TMap<FGuid, int32> ActorItemIndexByID;
+	TMap<FGuid, int32> ComponentItemIndexByID;
+
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UPrefabricatorAsset>> ResolvedFlattenedAssets;
 };
 
 
@@ -246,6 +435,7 @@ public:
 
 public:
 	virtual UPrefabricatorAsset* GetPrefabAsset(const FPrefabAssetSelectionConfig& InConfig) override;
+	virtual TSoftObjectPtr<UPrefabricatorAsset> SelectPrefabAsset(const FPrefabAssetSelectionConfig& InConfig) const override;
 };
 
 
@@ -253,6 +443,8 @@ class PREFABRICATORRUNTIME_API FPrefabricatorAssetUtils {
 public:
 	static FVector FindPivot(const TArray<AActor*>& InActors);
 	static EComponentMobility::Type FindMobility(const TArray<AActor*>& InActors);
-	
+
+	/** Visits the root components, the child actors and the components of the child actors */
+	static void ForEachPrefabItem(UPrefabricatorAsset* InPrefabAsset, TFunctionRef<void(FPrefabricatorItemBase&)> Visit);
 };
 
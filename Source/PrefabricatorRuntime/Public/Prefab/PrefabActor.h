@@ -3,6 +3,7 @@
 #pragma once
 #include "CoreMinimal.h"
 #include "Engine/AssetUserData.h"
+#include "Engine/NetSerialization.h"
 #include "GameFramework/Actor.h"
 
 #include "Templates/Tuple.h"
@@ -10,7 +11,10 @@
 #include "PrefabActor.generated.h"
 
 class UPrefabricatorAsset;
+class UPrefabricatorAssetInterface;
 class IPropertyHandle;
+class UBoxComponent;
+struct FPrefabLoadSettings;
 
 
 UCLASS(BlueprintType, EditInlineNew, CollapseCategories, HideDropdown)
@@ -119,6 +123,9 @@ public:
 	virtual void Destroyed() override;
 	virtual void PostLoad() override;
 	virtual void PostActorCreated() override;
+	virtual void PostInitializeComponents() override;
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 #if WITH_EDITOR
 	virtual void PostEditChangeProperty(struct FPropertyChangedEvent&) override;
@@ -130,6 +137,7 @@ public:
 	//void HandlePropertyChangedEvent(FPropertyChangedEvent& PropertyChangedEvent);
 
 	virtual void PostDuplicate(EDuplicateMode::Type DuplicateMode) override;
+	virtual void PostEditUndo() override;
 	virtual FName GetCustomIconName() const override;
 #endif // WITH_EDITOR
 	/// End of AActor Interface 
@@ -137,6 +145,12 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Prefabricator")
 	void LoadPrefab();
 
+	/**
+	 * Builds the children from the prefab asset. Every build of a spawned prefab goes through here, so an on-demand prefab
+	 * that is not materialized only keeps its asset and seed, and builds the children once a player comes near
+	 */
+	virtual void LoadPrefabWithSettings(const FPrefabLoadSettings& InSettings);
+
 	UFUNCTION(BlueprintCallable, Category = "Prefabricator")
 	void SavePrefab();
 
@@ -150,6 +164,44 @@ public:
 	void RandomizeSeed(const FRandomStream& InRandom, bool bRecursive = true);
 	void HandleBuildComplete();
 
+	/** 
+	 * Flattened list of all the actors attached below this prefab, parents before their children.
+	 * The list is cached and only rebuilt after the attachment hierarchy changes (see HandleAttachmentChanged).
+	 * Entries may be stale (null) if an actor was destroyed without being detached first
+	 */
+	const TArray<TWeakObjectPtr<AActor>>& GetDescendants() const;
+
+	/** Visits every actor attached below this prefab without allocating. Do not modify the hierarchy from the visitor */
+	void ForEachDescendant(TFunctionRef<void(AActor*)> Visit) const;
+
+	/** Called by the prefab component when an actor is attached directly to this prefab */
+	void HandleChildActorAttached(AActor* ChildActor);
+
+	/** Flags the cached descendant list of this prefab and all the parent prefabs as dirty */
+	void InvalidateDescendants();
+
+	/**
+	 * Call after an actor is attached to, or detached from, an actor that is not a prefab. Flags the descendant lists of
+	 * the prefabs above the parent as dirty, and updates the child transforms their bounds follow. The prefab tools and the editor attachments report it on their own, game
+	 * code that reparents actors below a prefab child calls it directly
+	 */
+	static void HandleAttachmentChanged(AActor* InChildActor, const AActor* InParentActor);
+
+	/** Builds the children of a dematerialized prefab. Asynchronous builds are time sliced by the materialization subsystem */
+	UFUNCTION(BlueprintCallable, Category = "Prefabricator")
+	void Materialize(bool bSynchronous = false);
+
+	/** Destroys the children and keeps only the prefab root (and the optional collision proxy) */
+	UFUNCTION(BlueprintCallable, Category = "Prefabricator")
+	void Dematerialize();
+
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Prefabricator")
+	bool IsMaterialized() const { return bMaterialized; }
+
+	/** Called by the build system once the children of an asynchronous materialization are built */
+	void HandleMaterializeBuildComplete(uint32 InRequestId);
+	bool IsMaterializeRequestPending(uint32 InRequestId) const { return bMaterializePending && MaterializeRequestId == InRequestId; }
+
 public:
 	// The last update ID of the prefab asset when this actor was refreshed from it
 	// This is used to test if the prefab has changed since we last recreated it
@@ -158,6 +210,51 @@ public:
 
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Prefabricator")
 	int32 Seed;
+
+	/**
+	 * In game, only keep the children around while a player is near. Far away instances are just the prefab root
+	 * with the bounds of the asset. Has no effect in the editor
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Prefabricator|Materialization")
+	bool bMaterializeOnDemand = false;
+
+	/** The children are built when a player view comes within this distance of the prefab bounds */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Prefabricator|Materialization", Meta = (EditCondition = "bMaterializeOnDemand", ClampMin = 0))
+	float MaterializeRadius = 20000.0f;
+
+	/** The children are released once every player view is beyond this distance. Should be larger than the materialize radius */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Prefabricator|Materialization", Meta = (EditCondition = "bMaterializeOnDemand", ClampMin = 0))
+	float DematerializeRadius = 25000.0f;
+
+	/** Spawn a box matching the prefab bounds while the children are released, so the prefab still blocks */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Prefabricator|Materialization", Meta = (EditCondition = "bMaterializeOnDemand"))
+	bool bUseCollisionProxy = false;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Prefabricator|Materialization", Meta = (EditCondition = "bMaterializeOnDemand && bUseCollisionProxy"))
+	FName CollisionProxyProfileName = TEXT("BlockAll");
+
+	/** Build the children when the actor is spawned in game. Cleared on deferred spawns that build them with their own settings (e.g. SpawnPrefab) */
+	bool bBuildOnCreation = true;
+
+private:
+	void DestroyAttachedActors();
+	bool ShouldMaterializeOnDemand() const;
+	void UpdateCollisionProxy();
+
+	UPROPERTY(Transient)
+	TObjectPtr<UBoxComponent> CollisionProxy;
+
+	bool bMaterialized = true;
+
+	/** An asynchronous materialization is queued or running. The collision proxy is kept until it completes */
+	bool bMaterializePending = false;
+	uint32 MaterializeRequestId = 0;
+
+	/** Spawned in game, the children are built once the deferred spawn properties are applied (see PostInitializeComponents) */
+	bool bCreationBuildPending = false;
+
+	mutable TArray<TWeakObjectPtr<AActor>> CachedDescendants;
+	mutable bool bDescendantsDirty = true;
 };
 
 /////////////////////////////// BuildSystem /////////////////////////////// 
@@ -168,6 +265,9 @@ class PREFABRICATORRUNTIME_API FPrefabBuildSystemCommand {
 public:
 	virtual ~FPrefabBuildSystemCommand() {}
 	virtual void Execute(FPrefabBuildSystem& BuildSystem) = 0;
+
+	/** Name of the command in trace captures */
+	virtual FString GetTraceName() const { return TEXT("Command"); }
 };
 typedef TSharedPtr<FPrefabBuildSystemCommand> FPrefabBuildSystemCommandPtr;
 
@@ -176,12 +276,17 @@ class PREFABRICATORRUNTIME_API FPrefabBuildSystemCommand_BuildPrefab : public FP
 public:
 	FPrefabBuildSystemCommand_BuildPrefab(TWeakObjectPtr<APrefabActor> InPrefab, bool bInRandomizeNestedSeed, FRandomStream* InRandom);
 
+	/** Randomizes the nested seeds from a stream shared by all the commands of the build, since each command is released once it runs */
+	FPrefabBuildSystemCommand_BuildPrefab(TWeakObjectPtr<APrefabActor> InPrefab, TSharedPtr<FRandomStream> InSharedRandom);
+
 	virtual void Execute(FPrefabBuildSystem& BuildSystem) override;
+	virtual FString GetTraceName() const override;
 
 private:
 	TWeakObjectPtr<APrefabActor> Prefab;
 	bool bRandomizeNestedSeed = false;
 	FRandomStream* Random = nullptr;
+	TSharedPtr<FRandomStream> SharedRandom;
 };
 
 class PREFABRICATORRUNTIME_API FPrefabBuildSystemCommand_BuildPrefabSync : public FPrefabBuildSystemCommand {
@@ -189,6 +294,7 @@ public:
 	FPrefabBuildSystemCommand_BuildPrefabSync(TWeakObjectPtr<APrefabActor> InPrefab, bool bInRandomizeNestedSeed, FRandomStream* InRandom);
 
 	virtual void Execute(FPrefabBuildSystem& BuildSystem) override;
+	virtual FString GetTraceName() const override;
 
 private:
 	TWeakObjectPtr<APrefabActor> Prefab;
@@ -200,12 +306,54 @@ class PREFABRICATORRUNTIME_API FPrefabBuildSystemCommand_NotifyBuildComplete : p
 public:
 	FPrefabBuildSystemCommand_NotifyBuildComplete(TWeakObjectPtr<APrefabActor> InPrefab);
 	virtual void Execute(FPrefabBuildSystem& BuildSystem) override;
+	virtual FString GetTraceName() const override;
+
+private:
+	TWeakObjectPtr<APrefabActor> Prefab;
+};
+
+
+/** Builds the children of an on-demand prefab. Skipped if the prefab was dematerialized again before the command ran */
+class PREFABRICATORRUNTIME_API FPrefabBuildSystemCommand_MaterializePrefab : public FPrefabBuildSystemCommand_BuildPrefab {
+public:
+	FPrefabBuildSystemCommand_MaterializePrefab(TWeakObjectPtr<APrefabActor> InPrefab, uint32 InRequestId);
+
+	virtual void Execute(FPrefabBuildSystem& BuildSystem) override;
+	virtual FString GetTraceName() const override;
+
+private:
+	TWeakObjectPtr<APrefabActor> MaterializedPrefab;
+	uint32 RequestId = 0;
+};
+
+/** Completes a materialization once all the children are built */
+class PREFABRICATORRUNTIME_API FPrefabBuildSystemCommand_NotifyMaterializeComplete : public FPrefabBuildSystemCommand {
+public:
+	FPrefabBuildSystemCommand_NotifyMaterializeComplete(TWeakObjectPtr<APrefabActor> InPrefab, uint32 InRequestId);
+
+	virtual void Execute(FPrefabBuildSystem& BuildSystem) override;
+	virtual FString GetTraceName() const override;
 
 private:
 	TWeakObjectPtr<APrefabActor> Prefab;
+	uint32 RequestId = 0;
 };
 
 
+class AReplicablePrefabActor;
+
+/** Rebuilds a seed-only replicated prefab from its replicated state, in a single command */
+class PREFABRICATORRUNTIME_API FPrefabBuildSystemCommand_BuildReplicatedPrefab : public FPrefabBuildSystemCommand {
+public:
+	FPrefabBuildSystemCommand_BuildReplicatedPrefab(TWeakObjectPtr<AReplicablePrefabActor> InPrefab);
+
+	virtual void Execute(FPrefabBuildSystem& BuildSystem) override;
+	virtual FString GetTraceName() const override;
+
+private:
+	TWeakObjectPtr<AReplicablePrefabActor> Prefab;
+};
+
 class PREFABRICATORRUNTIME_API FPrefabBuildSystem {
 public:
 	FPrefabBuildSystem(double InTimePerFrame);
@@ -221,12 +369,115 @@ private:
 
 
 
+UENUM(BlueprintType)
+enum class EPrefabReplicationMode : uint8
+{
+	/** Replicate the prefab actor. The replicated children are replicated one by one */
+	Actors,
+
+	/** 
+	 * Replicate only the asset, seed and transform. The server and every client rebuild the same hierarchy from them.
+	 * Children that replicate their own state get a stable name from their PrefabItemID so both sides map to the same actor
+	 */
+	SeedOnly
+};
+
+/** Everything a client needs to rebuild a seed-only replicated prefab */
+USTRUCT()
+struct PREFABRICATORRUNTIME_API FPrefabReplicatedBuildState {
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TObjectPtr<UPrefabricatorAssetInterface> Prefab;
+
+	UPROPERTY()
+	int32 Seed = 0;
+
+	UPROPERTY()
+	FVector_NetQuantize10 Location;
+
+	UPROPERTY()
+	FRotator Rotation = FRotator::ZeroRotator;
+
+	UPROPERTY()
+	FVector_NetQuantize10 Scale = FVector::OneVector;
+
+	/** Server assigned id the stable names of the replicated children are derived from. Invalid until the state is set */
+	UPROPERTY()
+	FGuid NetIdentity;
+
+	/** Set by the server once it built children that replicate their own state. The clients then build on arrival */
+	UPROPERTY()
+	bool bHasReplicatedChildren = false;
+
+	FTransform GetTransform() const { return FTransform(Rotation, Location, Scale); }
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
+};
+
+template<>
+struct TStructOpsTypeTraits<FPrefabReplicatedBuildState> : public TStructOpsTypeTraitsBase2<FPrefabReplicatedBuildState> {
+	enum {
+		WithNetSerializer = true
+	};
+};
+
 UCLASS(Blueprintable, ConversionRoot, ComponentWrapperClass)
 class PREFABRICATORRUNTIME_API AReplicablePrefabActor : public APrefabActor {
 	GENERATED_UCLASS_BODY()
 public:
 	void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+	virtual void PostInitializeComponents() override;
 	virtual void BeginPlay() override;
 
+	/// APrefabActor Interface
+	virtual void LoadPrefabWithSettings(const FPrefabLoadSettings& InSettings) override;
+	/// End of APrefabActor Interface
+
+	/** Rebuilds the children from the replicated state. Called by the build scheduler, which skips prefabs that are already up to date */
+	void BuildFromReplicatedState(bool bForce = false);
+
+	/** Changes the seed on the server. The clients rebuild the prefab once the new state arrives */
+	UFUNCTION(BlueprintCallable, BlueprintAuthorityOnly, Category = "Prefabricator|Replication")
+	void SetReplicatedSeed(int32 InSeed);
+
+	/** Changes the asset and the seed on the server, and rebuilds the prefab everywhere in the given mode */
+	UFUNCTION(BlueprintCallable, BlueprintAuthorityOnly, Category = "Prefabricator|Replication")
+	void SetReplicatedPrefab(UPrefabricatorAssetInterface* InPrefab, int32 InSeed, EPrefabReplicationMode InReplicationMode);
+
+	bool IsSeedOnly() const { return ReplicationMode == EPrefabReplicationMode::SeedOnly; }
+
+public:
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Prefabricator|Replication")
+	EPrefabReplicationMode ReplicationMode = EPrefabReplicationMode::Actors;
+
+	/**
+	 * Build on the clients as soon as the state arrives, instead of through the time sliced build scheduler.
+	 * Prefabs with children that replicate their own state always build on arrival, so the children exist before their
+	 * actor channels are opened
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Prefabricator|Replication", Meta = (EditCondition = "ReplicationMode == EPrefabReplicationMode::SeedOnly"))
+	bool bBuildOnArrival = false;
+
+private:
+	UFUNCTION()
+	void OnRep_BuildState();
+
+	void RequestBuild(bool bImmediate);
+	void UpdateBuildState();
+	bool IsBuildUpToDate() const;
+
+	/**
+	 * Gives the replicated children a name derived from the PrefabItemID chain, so the server and the clients can address them.
+	 * Returns true if any replicated child was found
+	 */
+	bool AssignChildNetIdentities(AActor* InParent, const FGuid& InParentKey) const;
+
+	UPROPERTY(ReplicatedUsing = OnRep_BuildState)
+	FPrefabReplicatedBuildState BuildState;
+
+	/** The state the children were last built from */
+	TWeakObjectPtr<UPrefabricatorAssetInterface> BuiltPrefab;
+	int32 BuiltSeed = 0;
+	bool bBuiltFromState = false;
 };
 
@@ -23,7 +23,33 @@ public:
 
 	virtual void OnAttachmentChanged() override;
 #endif // WITH_EDITOR
-	
+
+	/** Bounds of the prefab's children in the space of this component. Computed on demand and cached */
+	FBox GetCachedLocalBounds(bool bNonColliding = true) const;
+
+	/** Flags the cached bounds of this prefab and all the parent prefabs as dirty */
+	void InvalidateCachedBounds();
+
+	/** An actor was attached below a non-prefab child of this prefab, or detached from it (see APrefabActor::HandleAttachmentChanged) */
+	void HandleDescendantAttachmentChanged(AActor* InChildActor);
+
+protected:
+	virtual void OnChildAttached(USceneComponent* ChildComponent) override;
+	virtual void OnChildDetached(USceneComponent* ChildComponent) override;
+
+private:
+	/**
+	 * Invalidates the bounds when the component, or anything attached below it, moves. Stops at the nested prefabs,
+	 * they invalidate the bounds of their parents themselves
+	 */
+	void BindChildTransformUpdated(USceneComponent* InComponent);
+	void UnbindChildTransformUpdated(USceneComponent* InComponent);
+	void HandleChildTransformUpdated(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport);
+
+	// Indexed by bNonColliding
+	mutable FBox CachedLocalBounds[2];
+	mutable bool bCachedLocalBoundsValid[2] = { false, false };
+
 private:
 #if WITH_EDITORONLY_DATA
 	UPROPERTY()
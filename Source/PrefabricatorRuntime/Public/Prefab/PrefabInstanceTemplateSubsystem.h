@@ -0,0 +1,46 @@
+//$ Copyright 2015-23, Code Respawn Technologies Pvt Ltd - All Rights Reserved $//
+
+#pragma once
+#include "CoreMinimal.h"
+#include "Prefab/PrefabTools.h"
+
+#include "Subsystems/WorldSubsystem.h"
+#include "PrefabInstanceTemplateSubsystem.generated.h"
+
+class ULevel;
+
+/**
+ * Owns the prefab instance templates of a world (see FPrefabInstanceTemplates). Every world has its own cache, so the
+ * builds never clone an actor of another world (PIE clients, a server hosting several worlds). The templates of a
+ * level are flushed when the level is removed from the world, and the whole cache goes away with the world
+ */
+UCLASS()
+class PREFABRICATORRUNTIME_API UPrefabInstanceTemplateSubsystem : public UWorldSubsystem {
+	GENERATED_BODY()
+public:
+	/// USubsystem Interface
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	/// End of USubsystem Interface
+
+	/**
+	 * Returns the template cache of the world, or null if the world has none. Call it on the game thread, the
+	 * returned cache can then be read from worker threads for as long as the world is alive
+	 */
+	static FPrefabInstanceTemplates* GetTemplates(const UWorld* InWorld);
+
+	FPrefabInstanceTemplates& GetTemplates() { return Templates; }
+
+	void FlushLevel(ULevel* InLevel);
+	void Flush();
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	void HandleLevelRemovedFromWorld(ULevel* InLevel, UWorld* InWorld);
+
+private:
+	FPrefabInstanceTemplates Templates;
+	FDelegateHandle LevelRemovedHandle;
+};
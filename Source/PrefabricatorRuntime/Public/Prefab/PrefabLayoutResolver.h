@@ -0,0 +1,90 @@
+//$ Copyright 2015-23, Code Respawn Technologies Pvt Ltd - All Rights Reserved $//
+
+#pragma once
+#include "CoreMinimal.h"
+#include "UObject/SoftObjectPath.h"
+#include "UObject/SoftObjectPtr.h"
+
+#include "PrefabLayoutResolver.generated.h"
+
+class UPrefabricatorAsset;
+class UPrefabricatorAssetInterface;
+struct FPrefabricatorActorData;
+
+/** A leaf actor / component that a prefab would spawn, with the transform it would be spawned at */
+USTRUCT(BlueprintType)
+struct PREFABRICATORRUNTIME_API FPrefabResolvedItem {
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "Prefabricator")
+	FSoftClassPath Class;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Prefabricator")
+	FTransform WorldTransform;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Prefabricator")
+	FGuid PrefabItemID;
+
+	/** The prefab asset (after collection selection) that owns this item */
+	UPROPERTY(BlueprintReadOnly, Category = "Prefabricator")
+	TSoftObjectPtr<UPrefabricatorAsset> SourcePrefab;
+
+	/** Nesting depth of the owning prefab. Items of the top level prefab have a depth of 0 */
+	UPROPERTY(BlueprintReadOnly, Category = "Prefabricator")
+	int32 Depth = 0;
+
+	/** True if this is a component added to the root of the prefab actor, rather than a child actor */
+	UPROPERTY(BlueprintReadOnly, Category = "Prefabricator")
+	bool bIsRootComponent = false;
+
+	/** Assets referenced by the serialized properties of this item (meshes, materials etc) */
+	UPROPERTY(BlueprintReadOnly, Category = "Prefabricator")
+	TArray<FSoftObjectPath> ReferencedAssets;
+};
+
+USTRUCT(BlueprintType)
+struct PREFABRICATORRUNTIME_API FPrefabResolvedLayout {
+	GENERATED_BODY()
+
+	/** Flattened list of leaf items, in the same order LoadStateFromPrefabAsset would spawn them */
+	UPROPERTY(BlueprintReadOnly, Category = "Prefabricator")
+	TArray<FPrefabResolvedItem> Items;
+
+	/** Unique list of every asset, class and prefab the layout needs. Use this to preload before spawning */
+	UPROPERTY(BlueprintReadOnly, Category = "Prefabricator")
+	TArray<FSoftObjectPath> RequiredAssets;
+
+	/** Assets that were not in memory while resolving off the game thread. The layout is partial if this is not empty */
+	UPROPERTY(BlueprintReadOnly, Category = "Prefabricator")
+	TArray<FSoftObjectPath> UnresolvedAssets;
+
+	bool IsComplete() const { return UnresolvedAssets.Num() == 0; }
+	void Reset();
+};
+
+DECLARE_DELEGATE_OneParam(FPrefabLayoutResolvedDelegate, const FPrefabResolvedLayout&);
+
+/**
+ * Resolves what a prefab would spawn for a given seed and transform without creating any actors.
+ * The random stream is consumed in the same order as UPrefabricatorBlueprintLibrary::SpawnPrefab
+ * so the result matches a synchronous spawn with the same seed.
+ */
+class PREFABRICATORRUNTIME_API FPrefabLayoutResolver {
+public:
+	/**
+	 * Resolves the layout on the calling thread. On the game thread missing assets are loaded synchronously,
+	 * on other threads only assets already in memory are used and the rest are reported in UnresolvedAssets
+	 */
+	static void Resolve(UPrefabricatorAssetInterface* InPrefab, int32 InSeed, const FTransform& InTransform, FPrefabResolvedLayout& OutLayout);
+
+	/**
+	 * Resolves the layout on a worker thread. Missing assets are streamed in asynchronously and the worker pass
+	 * is repeated until the layout is complete. The delegate is invoked on the game thread
+	 */
+	static void ResolveAsync(const TSoftObjectPtr<UPrefabricatorAssetInterface>& InPrefab, int32 InSeed, const FTransform& InTransform, FPrefabLayoutResolvedDelegate InOnResolved);
+
+	/** Returns the prefab asset interface a serialized nested prefab actor points to */
+	static FSoftObjectPath GetNestedPrefabPath(const FPrefabricatorActorData& InActorData);
+
+	static const int32 MaxNestingDepth = 32;
+};
@@ -0,0 +1,52 @@
+//$ Copyright 2015-23, Code Respawn Technologies Pvt Ltd - All Rights Reserved $//
+
+#pragma once
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "PrefabMaterializationSubsystem.generated.h"
+
+class APrefabActor;
+class FPrefabBuildSystem;
+class FPrefabBuildSystemCommand;
+typedef TSharedPtr<FPrefabBuildSystemCommand> FPrefabBuildSystemCommandPtr;
+
+/**
+ * Materializes the children of on-demand prefabs (APrefabActor::bMaterializeOnDemand) when a player view comes
+ * within their materialize radius, and releases them again once every view is beyond the dematerialize radius.
+ * Materialization goes through a time sliced build system so a burst of prefabs is spread over several frames
+ */
+UCLASS()
+class PREFABRICATORRUNTIME_API UPrefabMaterializationSubsystem : public UTickableWorldSubsystem {
+	GENERATED_BODY()
+public:
+	/// USubsystem Interface
+	virtual void Deinitialize() override;
+	/// End of USubsystem Interface
+
+	/// FTickableGameObject Interface
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	/// End of FTickableGameObject Interface
+
+	void RegisterPrefab(APrefabActor* InPrefab);
+	void UnregisterPrefab(APrefabActor* InPrefab);
+
+	/** Queues a time sliced build of the prefab's children. The request id lets the prefab cancel the build if it is dematerialized first */
+	void EnqueueBuild(APrefabActor* InPrefab, uint32 InRequestId);
+
+	/** Queues a command on the time sliced build system */
+	void EnqueueCommand(FPrefabBuildSystemCommandPtr InCommand);
+
+	int32 GetNumRegisteredPrefabs() const { return Prefabs.Num(); }
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	void GatherViewLocations(TArray<FVector>& OutViewLocations) const;
+
+private:
+	TArray<TWeakObjectPtr<APrefabActor>> Prefabs;
+	TSharedPtr<FPrefabBuildSystem> BuildSystem;
+};
+
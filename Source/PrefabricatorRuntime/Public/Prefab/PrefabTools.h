@@ -3,12 +3,17 @@
 #pragma once
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "UObject/ObjectKey.h"
 
 class APrefabActor;
+class IPrefabricatorService;
+class ULevel;
 class UPrefabricatorAsset;
+class UPrimitiveComponent;
 struct FPrefabricatorActorData;
 struct FPrefabricatorComponentData;
-class UPrefabricatorProperty;
+struct FPrefabricatorProperty;
+struct FPrefabricatorCrossReference;
 struct FRandomStream;
 
 struct PREFABRICATORRUNTIME_API FPrefabLoadSettings {
@@ -17,46 +22,93 @@ struct PREFABRICATORRUNTIME_API FPrefabLoadSettings {
 	bool bSynchronousBuild = true;
 	bool bCanLoadFromCachedTemplate = true;
 	bool bCanSaveToCachedTemplate = true;
+	/** Registers the components of the whole build (including synchronously built nested prefabs) in a single pass at the end */
+	bool bDeferComponentRegistration = true;
 	const FRandomStream* Random = nullptr;
 };
 
+/**
+ * Collects the actors and components loaded during a prefab build and registers them when the outermost build completes,
+ * instead of unregistering / registering each of them around the property load. This way the render proxies and
+ * physics bodies are created once per component. Game thread only
+ */
+class PREFABRICATORRUNTIME_API FPrefabDeferredRegistrationScope {
+public:
+	FPrefabDeferredRegistrationScope(bool bInEnabled);
+	~FPrefabDeferredRegistrationScope();
+
+	/** Returns the active scope, or null if the registration is not being deferred */
+	FORCEINLINE static FPrefabDeferredRegistrationScope* Get() { return ActiveScope; }
+
+	void DeferActorRegistration(AActor* InActor, bool bComponentsUnregistered);
+	void DeferComponentRegistration(UActorComponent* InComponent);
+	void DeferPhysicsStateRecreate(UPrimitiveComponent* InComponent);
+	void DeferBuildComplete(APrefabActor* InPrefabActor, bool bNotifyBuildComplete);
+
+private:
+	void Flush();
+
+	struct FDeferredActor {
+		TWeakObjectPtr<AActor> Actor;
+		bool bComponentsUnregistered = false;
+	};
+
+	struct FDeferredBuildComplete {
+		TWeakObjectPtr<APrefabActor> PrefabActor;
+		bool bNotifyBuildComplete = false;
+	};
+
+	TArray<FDeferredActor> Actors;
+	TArray<TWeakObjectPtr<UActorComponent>> Components;
+	TArray<TWeakObjectPtr<UPrimitiveComponent>> PhysicsComponents;
+	TArray<FDeferredBuildComplete> CompletedPrefabs;
+	bool bOwnsScope = false;
+
+	static FPrefabDeferredRegistrationScope* ActiveScope;
+};
+
 struct PREFABRICATORRUNTIME_API FPrefabInstanceTemplateInfo {
 	TWeakObjectPtr<AActor> TemplatePtr;
+	/** The level of the template actor. Only used to flush the templates of a level, never dereferenced */
+	TObjectKey<ULevel> LevelKey;
 	FGuid PrefabLastUpdateId;
 };
 
+/**
+ * Actors built from a prefab item, cloned by the next builds of the same item instead of loading the item state again.
+ * Each world owns its own cache (see UPrefabInstanceTemplateSubsystem). The lookups can run on any thread, the template
+ * actors are only dereferenced on the game thread
+ */
 class PREFABRICATORRUNTIME_API FPrefabInstanceTemplates {
 public:
 	void RegisterTemplate(const FGuid& InPrefabItemId, FGuid InPrefabLastUpdateId, AActor* InActor);
-	AActor* GetTemplate(const FGuid& InPrefabItemId, FGuid InPrefabLastUpdateId);
 
-private:
-	TMap<FGuid, FPrefabInstanceTemplateInfo> PrefabItemTemplates;
-};
+	/** Game thread: returns the template of the prefab item, or null if there is none or it is out of date */
+	AActor* GetTemplate(const FGuid& InPrefabItemId, FGuid InPrefabLastUpdateId) const;
 
-class PREFABRICATORRUNTIME_API FGlobalPrefabInstanceTemplates {
-public:
-	FORCEINLINE static FPrefabInstanceTemplates* Get() { return Instance; }
+	/** Any thread: the template of the prefab item if it is up to date, to be resolved on the game thread */
+	TWeakObjectPtr<AActor> FindTemplate(const FGuid& InPrefabItemId, FGuid InPrefabLastUpdateId) const;
 
-	static void _CreateSingleton();
-	static void _ReleaseSingleton();
+	/** Drops the templates of the level, and the ones whose actor was destroyed. Returns the number of dropped templates */
+	int32 FlushLevel(ULevel* InLevel);
+	void Reset();
+	int32 Num() const;
 
 private:
-	static FPrefabInstanceTemplates* Instance;
+	TMap<FGuid, FPrefabInstanceTemplateInfo> PrefabItemTemplates;
+	mutable FRWLock Lock;
 };
 
 class FPrefabActorLookup {
 public:
-	void Register(const FString& InActorPath, const FGuid& InPrefabItemId);
 	void Register(AActor* InActor, const FGuid& InPrefabItemId);
 	void Register(UActorComponent* InComp, const FGuid& InPrefabItemId);
-	bool GetPrefabItemId(const FString& InObjectPath, FGuid& OutCrossRefPrefabItem) const;
+	bool GetPrefabItemId(const UObject* InObject, FGuid& OutCrossRefPrefabItem) const;
 
 private:
-	TMap<FString, FGuid> ActorPathToItemId;
+	TMap<const UObject*, FGuid> ObjectToItemId;
 };
 
-using UPrefabricatorPropertyMap = TMap<FString, TObjectPtr<class UPrefabricatorProperty>>;
 class PREFABRICATORRUNTIME_API FPrefabTools {
 public:
 	static bool CanCreatePrefab();
@@ -70,12 +122,15 @@ public:
 	static void SaveStateToPrefabAsset(APrefabActor* PrefabActor);
 	static void LoadStateFromPrefabAsset(APrefabActor* PrefabActor, const FPrefabLoadSettings& InSettings = FPrefabLoadSettings());
 
-	static void FixupCrossReferences(const UPrefabricatorPropertyMap& PrefabProperties, UObject* ObjToWrite, TMap<FGuid, AActor*>& PrefabItemToActorMap);
+	/** Writes the resolved target actors into the object properties listed in the cross reference table of an item */
+	static void FixupCrossReferences(const TArray<FPrefabricatorCrossReference>& CrossReferences, UObject* ObjToWrite, TArrayView<AActor* const> TargetActors);
 
 	static void UnlinkAndDestroyPrefabActor(APrefabActor* PrefabActor);
 	static void GetActorChildren(AActor* InParent, TArray<AActor*>& OutChildren);
 
 	static FBox GetPrefabBounds(AActor* PrefabActor, bool bNonColliding = true);
+	/** Walks the children of the prefab and returns their bounds in the space of the prefab. Use UPrefabComponent::GetCachedLocalBounds instead */
+	static FBox CalculatePrefabLocalBounds(APrefabActor* PrefabActor, bool bNonColliding = true);
 	static bool ShouldIgnorePropertySerialization(const FName& PropertyName);
 	static bool ShouldForcePropertySerialization(const FName& PropertyName);
 
@@ -86,7 +141,7 @@ public:
 	static UPrefabricatorAsset* CreatePrefabAsset();
 	static int32 GetRandomSeed(const FRandomStream& Random);
 
-	static void IterateChildrenRecursive(APrefabActor* Actor, TFunction<void(AActor*)> Visit);
+	static void IterateChildrenRecursive(APrefabActor* Actor, TFunctionRef<void(AActor*)> Visit);
 
 private:
 	static void SaveActorState(AActor* InActor, APrefabActor* PrefabActor, const FPrefabActorLookup& CrossReferences, FPrefabricatorActorData& OutActorData);
@@ -94,6 +149,14 @@ private:
 	static void LoadActorState(AActor* InActor, const FPrefabricatorActorData& InActorData, const FPrefabLoadSettings& InSettings);
 	static void LoadComponentState(UActorComponent* InComp, const FPrefabricatorComponentData& InCompData, const FPrefabLoadSettings& InSettings);
 
+	static UActorComponent* SpawnComponentItem(APrefabActor* PrefabActor, const FPrefabricatorComponentData& InCompData, UClass* InCompClass, const FPrefabLoadSettings& InSettings);
+	/** Spawns a new child actor for the item, from a cached template if possible. bOutStateLoaded is set if the item state was loaded into the actor (and it needs a PostLoad) */
+	static AActor* SpawnActorItem(IPrefabricatorService& Service, APrefabActor* PrefabActor, UPrefabricatorAsset* PrefabAsset, const FPrefabricatorActorData& InActorData, UClass* InActorClass, const FPrefabLoadSettings& InSettings, bool& bOutStateLoaded);
+	static void FixupItemCrossReferences(const UPrefabricatorAsset* PrefabAsset, TArrayView<UActorComponent* const> ComponentByItemIndex, TArrayView<AActor* const> ActorByItemIndex);
+
+	/** Builds the entry of the flattened tree of TopLevelAsset into a freshly spawned prefab actor, and the nested prefabs of its subtree along with it */
+	static void LoadStateFromFlattenedData(APrefabActor* PrefabActor, UPrefabricatorAsset* TopLevelAsset, int32 EntryIndex, const FPrefabLoadSettings& InSettings);
+
 };
 
 class PREFABRICATORRUNTIME_API FPrefabVersionControl {
@@ -104,6 +167,9 @@ private:
 	static void UpgradeFromVersion_InitialVersion(UPrefabricatorAsset* Prefab);
 	static void UpgradeFromVersion_AddedSoftReferences(UPrefabricatorAsset* Prefab);
 	static void UpgradeFromVersion_AddedSoftReferencesPrefabFix(UPrefabricatorAsset* Prefab);
+	static void UpgradeFromVersion_AddedSoftReferenceOffsets(UPrefabricatorAsset* Prefab);
+	static void UpgradeFromVersion_AddedPropertyStructs(UPrefabricatorAsset* Prefab);
+	static void UpgradeFromVersion_AddedCrossReferenceTable(UPrefabricatorAsset* Prefab);
 
 private:
 	static void RefreshReferenceList(UPrefabricatorAsset* Prefab);
@@ -35,6 +35,29 @@ public:
 	UPROPERTY(config, EditAnywhere, Category = "General Settings", Meta=(ConfigRestartRequired=true))
 	TSet<UClass*> IgnoreBoundingBoxForObjects;
 	
+	/** Time budget (in seconds) per frame for building the children of on-demand prefabs that come into range */
+	UPROPERTY(config, EditAnywhere, Category = "Materialization")
+	float MaterializationBuildTimePerFrame = 0.002f;
+
+	/** Maximum number of on-demand prefabs released per frame once they go out of range. The rest are released over the next frames (0 = no limit) */
+	UPROPERTY(config, EditAnywhere, Category = "Materialization", Meta=(ClampMin=0))
+	int32 MaxDematerializationsPerFrame = 8;
+
+	/**
+	 * Collect the runtime spawn cost of the prefab assets (see "stat prefabricator" and the Prefabricator.Telemetry console commands).
+	 * Off by default, it adds bookkeeping to every prefab build
+	 */
+	UPROPERTY(config, EditAnywhere, Category = "Telemetry")
+	bool bEnableSpawnTelemetry = false;
+
+	/** Number of recent builds kept for each prefab asset */
+	UPROPERTY(config, EditAnywhere, Category = "Telemetry", Meta=(ClampMin=1, EditCondition="bEnableSpawnTelemetry"))
+	int32 SpawnTelemetryWindowSize = 64;
+
+	/** Dump the spawn telemetry to Saved/Prefabricator/Telemetry every N seconds. 0 disables the periodic dumps */
+	UPROPERTY(config, EditAnywhere, Category = "Telemetry", Meta=(ClampMin=0, EditCondition="bEnableSpawnTelemetry"))
+	float SpawnTelemetryCsvDumpInterval = 0;
+
 	/** Use this angle while saving the prefab asset */
 	UPROPERTY(config, EditAnywhere, Category = "Thumbnail")
 	float DefaultThumbnailPitch = -11.25;
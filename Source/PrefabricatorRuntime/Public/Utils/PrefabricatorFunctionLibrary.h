@@ -2,6 +2,9 @@
 
 #pragma once
 #include "CoreMinimal.h"
+#include "Prefab/PrefabActor.h"
+#include "Prefab/PrefabLayoutResolver.h"
+
 #include "Kismet/BlueprintFunctionLibrary.h"
 #include "PrefabricatorFunctionLibrary.generated.h"
 
@@ -14,8 +17,9 @@ class PREFABRICATORRUNTIME_API UPrefabricatorBlueprintLibrary : public UBlueprin
 {
 	GENERATED_BODY()
 public:
+	/** Replicated prefab assets spawn a replicable prefab actor, the replication mode is ignored otherwise */
 	UFUNCTION(BlueprintCallable, Category = "Prefabricator")
-	static APrefabActor* SpawnPrefab(const UObject* WorldContextObject, UPrefabricatorAssetInterface* Prefab, const FTransform& Transform, int32 Seed);
+	static APrefabActor* SpawnPrefab(const UObject* WorldContextObject, UPrefabricatorAssetInterface* Prefab, const FTransform& Transform, int32 Seed, EPrefabReplicationMode ReplicationMode = EPrefabReplicationMode::Actors);
 
 	UFUNCTION(BlueprintCallable, Category = "Prefabricator")
 	static void RandomizePrefab(APrefabActor* PrefabActor, const FRandomStream& InRandom);
@@ -31,5 +35,9 @@ public:
 
 	UFUNCTION(BlueprintCallable, Category = "Prefabricator")
 	static APrefabActor* FindTopMostPrefabActor(AActor* InActor);
+
+	/** Returns what SpawnPrefab would create for the same prefab, transform and seed, without spawning any actors */
+	UFUNCTION(BlueprintCallable, Category = "Prefabricator")
+	static void ResolvePrefabLayout(UPrefabricatorAssetInterface* Prefab, const FTransform& Transform, int32 Seed, FPrefabResolvedLayout& OutLayout);
 };
 
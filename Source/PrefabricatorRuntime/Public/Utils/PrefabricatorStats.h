@@ -14,6 +14,24 @@ DECLARE_CYCLE_STAT(TEXT("LoadStateFromPrefabAsset 2"), STAT_LoadStateFromPrefabA
 DECLARE_CYCLE_STAT(TEXT("LoadStateFromPrefabAsset 3"), STAT_LoadStateFromPrefabAsset3, STATGROUP_Prefabricator);
 DECLARE_CYCLE_STAT(TEXT("LoadStateFromPrefabAsset 4"), STAT_LoadStateFromPrefabAsset4, STATGROUP_Prefabricator);
 DECLARE_CYCLE_STAT(TEXT("LoadStateFromPrefabAsset 5"), STAT_LoadStateFromPrefabAsset5, STATGROUP_Prefabricator);
+DECLARE_DWORD_COUNTER_STAT(TEXT("LoadStateFromPrefabAsset - Loads"), STAT_LoadStateFromPrefabAsset_NumLoads, STATGROUP_Prefabricator);
+DECLARE_DWORD_COUNTER_STAT(TEXT("LoadStateFromPrefabAsset - Arena Bytes"), STAT_LoadStateFromPrefabAsset_ArenaBytes, STATGROUP_Prefabricator);
+DECLARE_CYCLE_STAT(TEXT("LoadStateFromFlattenedData"), STAT_LoadStateFromFlattenedData, STATGROUP_Prefabricator);
+DECLARE_DWORD_COUNTER_STAT(TEXT("LoadStateFromFlattenedData - Prefabs"), STAT_LoadStateFromFlattenedData_NumPrefabs, STATGROUP_Prefabricator);
+
+DECLARE_CYCLE_STAT(TEXT("Deferred Registration - Flush"), STAT_DeferredRegistration_Flush, STATGROUP_Prefabricator);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Deferred Registration - Components"), STAT_DeferredRegistration_NumComponents, STATGROUP_Prefabricator);
+
+DECLARE_CYCLE_STAT(TEXT("Materialization - Tick"), STAT_Materialization_Tick, STATGROUP_Prefabricator);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Materialization - Registered Prefabs"), STAT_Materialization_NumRegistered, STATGROUP_Prefabricator);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Materialization - Materialized Prefabs"), STAT_Materialization_NumMaterialized, STATGROUP_Prefabricator);
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Telemetry - Live Prefab Instances"), STAT_Telemetry_NumLiveInstances, STATGROUP_Prefabricator);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Telemetry - Pending Build Commands"), STAT_Telemetry_NumPendingCommands, STATGROUP_Prefabricator);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Telemetry - Tracked Assets"), STAT_Telemetry_NumTrackedAssets, STATGROUP_Prefabricator);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Telemetry - Build Budget Used %"), STAT_Telemetry_BudgetUsed, STATGROUP_Prefabricator);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Telemetry - Peak Build Budget Used %"), STAT_Telemetry_PeakBudgetUsed, STATGROUP_Prefabricator);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Telemetry - Template Hit Rate %"), STAT_Telemetry_TemplateHitRate, STATGROUP_Prefabricator);
 
 DECLARE_CYCLE_STAT(TEXT("ParentActors - [ALL]"), STAT_ParentActors, STATGROUP_Prefabricator);
 DECLARE_CYCLE_STAT(TEXT("ParentActors - 1"), STAT_ParentActors1, STATGROUP_Prefabricator);
@@ -30,12 +48,10 @@ DECLARE_CYCLE_STAT(TEXT("LoadActorState - Reg Comp"), STAT_LoadActorState_Regist
 
 DECLARE_CYCLE_STAT(TEXT("DeserializeFields - BuildMap"), STAT_DeserializeFields_BuildMap, STATGROUP_Prefabricator);
 DECLARE_CYCLE_STAT(TEXT("DeserializeFields - Iterate"), STAT_DeserializeFields_Iterate, STATGROUP_Prefabricator);
-DECLARE_CYCLE_STAT(TEXT("DeserializeFields - Iterate -> LoadValue"), STAT_DeserializeFields_Iterate_LoadValue, STATGROUP_Prefabricator);
 DECLARE_CYCLE_STAT(TEXT("DeserializeFields - Iterate -> SetValue"), STAT_DeserializeFields_Iterate_SetValue, STATGROUP_Prefabricator);
 
 DECLARE_CYCLE_STAT(TEXT("LoadRefVal"), STAT_LoadReferencedAssetValues, STATGROUP_Prefabricator);
 DECLARE_CYCLE_STAT(TEXT("LoadRefVal - GetAssetPathName"), STAT_LoadReferencedAssetValues_GetAssetPathName, STATGROUP_Prefabricator);
 DECLARE_CYCLE_STAT(TEXT("LoadRefVal - Replacements 1"), STAT_LoadReferencedAssetValues_Replacements1, STATGROUP_Prefabricator);
 DECLARE_CYCLE_STAT(TEXT("LoadRefVal - Replacements 2"), STAT_LoadReferencedAssetValues_Replacements2, STATGROUP_Prefabricator);
-DECLARE_CYCLE_STAT(TEXT("LoadRefVal - Modify"), STAT_LoadReferencedAssetValues_Modify, STATGROUP_Prefabricator);
 
@@ -0,0 +1,155 @@
+//$ Copyright 2015-23, Code Respawn Technologies Pvt Ltd - All Rights Reserved $//
+
+#pragma once
+#include "CoreMinimal.h"
+#include "Containers/Ticker.h"
+#include "UObject/ObjectKey.h"
+
+class UPrefabricatorAsset;
+
+/** A single build of a prefab asset. Nested synchronous builds are included in the numbers of their parent */
+struct FPrefabSpawnSample {
+	float TimeMs = 0;
+	int32 NumActors = 0;
+	int32 NumTemplateHits = 0;
+	int32 NumTemplateMisses = 0;
+};
+
+/** The most recent spawn samples of a prefab asset, kept in a ring buffer */
+struct PREFABRICATORRUNTIME_API FPrefabAssetTelemetry {
+	FString AssetPath;
+	TArray<FPrefabSpawnSample> Samples;
+	int32 NextSample = 0;
+	int64 TotalSpawns = 0;
+
+	void AddSample(const FPrefabSpawnSample& InSample, int32 InWindowSize);
+};
+
+/** Summary of the sample window of an asset */
+struct PREFABRICATORRUNTIME_API FPrefabAssetTelemetryStats {
+	FString AssetPath;
+	int64 TotalSpawns = 0;
+	int32 NumSamples = 0;
+	float AvgMs = 0;
+	float P50Ms = 0;
+	float P95Ms = 0;
+	float MaxMs = 0;
+	float AvgActors = 0;
+	int32 MaxActors = 0;
+
+	/** Template cache hit rate [0..1]. Negative if the template cache was not used */
+	float TemplateHitRate = -1;
+
+	/** Number of samples in each bucket of the matching GetXXXBucketLimits(). The last bucket is open ended */
+	TArray<int32> TimeHistogram;
+	TArray<int32> ActorHistogram;
+
+	/** Only the samples that looked up the template cache */
+	TArray<int32> HitRateHistogram;
+
+	static TArrayView<const float> GetTimeBucketLimits();
+	static TArrayView<const float> GetActorBucketLimits();
+
+	/** In percent */
+	static TArrayView<const float> GetHitRateBucketLimits();
+};
+
+/**
+ * Runtime spawn cost of the prefab assets: build time, spawned actor count and template cache hit rate over a rolling
+ * window of the most recent builds of each asset, along with a few global gauges (live prefab instances, pending build
+ * commands and the build budget used per frame).
+ *
+ * The gauges are published to "stat prefabricator". The per-asset data is printed with Prefabricator.Telemetry.Print and
+ * dumped to Saved/Prefabricator/Telemetry, either on demand or periodically (see UPrefabricatorSettings)
+ * All the calls are expected on the game thread
+ */
+class PREFABRICATORRUNTIME_API FPrefabSpawnTelemetry {
+public:
+	FPrefabSpawnTelemetry();
+	~FPrefabSpawnTelemetry();
+
+	bool IsEnabled() const;
+
+	void RecordSpawn(const UPrefabricatorAsset* InPrefabAsset, const FPrefabSpawnSample& InSample);
+	void NotifyActorSpawned(bool bFromTemplate, bool bTemplateCacheUsed);
+	void NotifyBuildSystemTick(int32 InNumPendingCommands, float InBudgetUsed);
+	void NotifyInstanceBeginPlay() { NumLiveInstances++; }
+	void NotifyInstanceEndPlay() { NumLiveInstances = FMath::Max(0, NumLiveInstances - 1); }
+
+	/** Publishes the gauges every frame while the telemetry is enabled. The ticker removes itself once it is disabled */
+	void StartTicker();
+
+	/** Running totals of the spawned actors. Used by FPrefabSpawnTelemetryScope to find the share of a single build */
+	int64 GetNumActorsSpawned() const { return NumActorsSpawned; }
+	int64 GetNumTemplateHits() const { return NumTemplateHits; }
+	int64 GetNumTemplateMisses() const { return NumTemplateMisses; }
+
+	/** Sorted by the average build time, most expensive first */
+	void GetAssetStats(TArray<FPrefabAssetTelemetryStats>& OutStats) const;
+
+	void PrintToLog(int32 InMaxAssets) const;
+	bool WriteCsv(const FString& InPath) const;
+
+	/** Writes a time stamped CSV in Saved/Prefabricator/Telemetry. Returns the file path, or an empty string on failure */
+	FString DumpCsv() const;
+	void Reset();
+
+	void SetCsvDumpInterval(float InSeconds);
+
+	/** Quotes a CSV field that contains a separator, a quote or a line break */
+	static FString ToCsvField(const FString& InValue);
+
+private:
+	bool Tick(float DeltaTime);
+
+private:
+	TMap<TObjectKey<UPrefabricatorAsset>, FPrefabAssetTelemetry> Assets;
+
+	int64 NumActorsSpawned = 0;
+	int64 NumTemplateHits = 0;
+	int64 NumTemplateMisses = 0;
+	int32 NumLiveInstances = 0;
+
+	/** Build system activity of the frame in progress, and of the last completed frame */
+	int32 FramePendingCommands = 0;
+	float FrameBudgetUsed = 0;
+	int32 LastFramePendingCommands = 0;
+	float LastFrameBudgetUsed = 0;
+	float PeakBudgetUsed = 0;
+
+	float CsvDumpInterval = 0;
+	double NextCsvDumpTime = 0;
+
+	FTSTicker::FDelegateHandle TickerHandle;
+};
+
+class PREFABRICATORRUNTIME_API FGlobalPrefabSpawnTelemetry {
+public:
+	/** Returns null if the telemetry is disabled in the settings */
+	static FPrefabSpawnTelemetry* Get();
+
+	/** The live instances are counted while the telemetry is disabled too, so the gauge is right once it is enabled */
+	static void NotifyInstanceBeginPlay();
+	static void NotifyInstanceEndPlay();
+
+	static void _CreateSingleton();
+	static void _ReleaseSingleton();
+
+private:
+	static FPrefabSpawnTelemetry* Instance;
+};
+
+/** Measures a single prefab build and records it to the telemetry when it goes out of scope */
+class PREFABRICATORRUNTIME_API FPrefabSpawnTelemetryScope {
+public:
+	FPrefabSpawnTelemetryScope(const UPrefabricatorAsset* InPrefabAsset);
+	~FPrefabSpawnTelemetryScope();
+
+private:
+	FPrefabSpawnTelemetry* Telemetry = nullptr;
+	const UPrefabricatorAsset* PrefabAsset = nullptr;
+	double StartTime = 0;
+	int64 StartNumActors = 0;
+	int64 StartNumHits = 0;
+	int64 StartNumMisses = 0;
+};
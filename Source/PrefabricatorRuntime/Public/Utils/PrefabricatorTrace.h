@@ -0,0 +1,35 @@
+//$ Copyright 2015-23, Code Respawn Technologies Pvt Ltd - All Rights Reserved $//
+
+#pragma once
+#include "CoreMinimal.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "Trace/Trace.h"
+
+#define PREFABRICATOR_TRACE_ENABLED (CPUPROFILERTRACE_ENABLED && !UE_BUILD_SHIPPING)
+
+#if PREFABRICATOR_TRACE_ENABLED
+
+UE_TRACE_CHANNEL_EXTERN(PrefabricatorChannel, PREFABRICATORRUNTIME_API);
+
+/**
+ * Insights timing event whose name is built at runtime, so a capture shows which asset or item was being processed.
+ * The name is only formatted while both the cpu and the prefabricator channels are enabled (-trace=cpu,prefabricator)
+ */
+class PREFABRICATORRUNTIME_API FPrefabTraceScope {
+public:
+	FPrefabTraceScope(TFunctionRef<FString()> InGetEventName);
+	~FPrefabTraceScope();
+
+private:
+	bool bEnabled = false;
+};
+
+#define PREFAB_TRACE_SCOPE(Format, ...) \
+	FPrefabTraceScope PREPROCESSOR_JOIN(PrefabTraceScope_, __LINE__)([&]() { return FString::Printf(Format, ##__VA_ARGS__); })
+
+#else
+
+#define PREFAB_TRACE_SCOPE(Format, ...)
+
+#endif // PREFABRICATOR_TRACE_ENABLED
+